@@ -4,6 +4,7 @@
 #include "stringSplit.h"
 #include "stringex.h"
 #include <string.h>
+#include <map>
 // #include "stdafx.h"
 
 using namespace stringSplit;
@@ -18,19 +19,30 @@ CConsoleHelper::CConsoleHelper(void)
 	strHV = "";
 	strI = "";
 	iDeviceType = 1;
+	LastXmtCmd = XMTPT_SEND_STATUS;
+	MetricsExporter.SetTransportMetrics(&TransportMetrics);
+	StatusRxTimeNs = 0;
+	StatusDeviceId = -1;
+	DP5Proto.PIN.TxTimeNs = 0;
+	DP5Proto.PIN.RxTimeNs = 0;
+	DP5Proto.SPECTRUM.RxTimeNs = 0;
+	GetDppLog();		// constructed before this object completes, so destroyed after it (the destructor logs)
 }
 
 CConsoleHelper::~CConsoleHelper(void)
 {
+	DiagMonitor.Stop();
+	SpectrumArchive.Close();
+	Journal.Close();
 }
 
 void CConsoleHelper::KeepMX2_Alive()
 {
 	if (LibUsb_SendCommand(XMTPT_KEEP_ALIVE_LOCK))
 	{
-		cout << "Keep Alive Lock Sent" << endl;
+		DPP_LOG_DEBUG("mx2", "Keep Alive Lock Sent");
 	} else {
-		cout << "Failed to send Alive Lock" << endl;
+		DPP_LOG_WARN("mx2", "Failed to send Alive Lock");
 	}
 }
 
@@ -40,7 +52,7 @@ void CConsoleHelper::SendMX2_Volume(string strVol)
 	strCmd = "VOLU=";
 	strCmd += strVol;
 	strCmd += ";";
-	cout << "strCmd: " << strCmd << endl;
+	DPP_LOG_DEBUG("mx2", "strCmd: %s", strCmd.c_str());
 
     SendCommandDataMX2(XMTPT_TEXT_CONFIGURATION_MX2, strCmd);
 }
@@ -59,7 +71,7 @@ void CConsoleHelper::SendMX2_HVandI(string stringHV, string stringI)
 	strCmd += strfn.Format("%0.2f;", dblHV);
 	strCmd += "CUSE=";
 	strCmd += strfn.Format("%0.2f;", dblI);
-	cout << "strCmd: " << strCmd << endl;
+	DPP_LOG_DEBUG("mx2", "strCmd: %s", strCmd.c_str());
 
     SendCommandDataMX2(XMTPT_TEXT_CONFIGURATION_MX2, strCmd);
 }
@@ -77,7 +89,7 @@ void CConsoleHelper::SendMX2_HV(string stringHV)
 	strCmd = "HVSE=";
 	strCmd += strfn.Format("%0.2f;", dblHV);
 	
-	cout << "strCmd: " << strCmd << endl;
+	DPP_LOG_DEBUG("mx2", "strCmd: %s", strCmd.c_str());
 
     SendCommandDataMX2(XMTPT_TEXT_CONFIGURATION_MX2, strCmd);
 }
@@ -117,26 +129,124 @@ void CConsoleHelper::SendCommandDataMX2(TRANSMIT_PACKET_TYPE XmtCmd, string strD
 
 void CConsoleHelper::SendCommandData(TRANSMIT_PACKET_TYPE XmtCmd, BYTE DataOut[])
 {
+	DPP_TRACE_SPAN("request", XmtCmd);
     bool bHaveBuffer;
 	int bSentPkt;
 	
     bHaveBuffer = (bool) SndCmd.DP5_CMD_Data(DP5Proto.BufferOUT, XmtCmd, DataOut);
     if (bHaveBuffer) {
-		bSentPkt = DppLibUsb.SendPacketUSB(DppLibUsb.DppLibusbHandle, DP5Proto.BufferOUT, DP5Proto.PacketIn);
+		bSentPkt = LibUsb_SendPacket(XmtCmd);
         if (bSentPkt) {
 			RemCallParsePacket(DP5Proto.PacketIn);
 		}  else {
-			cout << "SendCommandData in ConsoleHelper.cpp  - bSentPkt is false" << endl;
+			DPP_LOG_ERROR("usb", "SendCommandData in ConsoleHelper.cpp  - bSentPkt is false");
         }
     } else {
-		cout << "SendCommandData in ConsoleHelper.cpp - Does not have buffer" << endl;
+		DPP_LOG_ERROR("usb", "SendCommandData in ConsoleHelper.cpp - Does not have buffer");
 	}
 }
 
 
+// sends DP5Proto.BufferOUT and receives DP5Proto.PacketIn, records the transfer in TransportMetrics
+int CConsoleHelper::LibUsb_SendPacket(TRANSMIT_PACKET_TYPE XmtCmd)
+{
+	long lBytesOut;
+	int iResult;
+
+	lBytesOut = (DP5Proto.BufferOUT[4] * 256) + DP5Proto.BufferOUT[5] + 8;
+	{
+		lock_guard<mutex> Lock(UsbLock);
+		iResult = DppLibUsb.SendPacketUSB(DppLibUsb.DppLibusbHandle, DP5Proto.BufferOUT, DP5Proto.PacketIn);
+		DPP_LOG_PACKET_TRACE("usb", XmtCmd, DP5Proto.PacketIn[2], DP5Proto.PacketIn[3], DppLibUsb.llRxTimeNs - DppLibUsb.llTxTimeNs, "%ld bytes out, result %d", lBytesOut, iResult);
+		DiagMonitor.NotePoll(DppLibUsb.llRxTimeNs);
+		TransportMetrics.RecordTransfer(XmtCmd, lBytesOut, iResult, (DppLibUsb.llRxTimeNs - DppLibUsb.llTxTimeNs) / 1000);
+		DP5Proto.PIN.TxTimeNs = DppLibUsb.llTxTimeNs;		// read under UsbLock, the packet carries its own transfer times
+		DP5Proto.PIN.RxTimeNs = DppLibUsb.llRxTimeNs;
+		LastXmtCmd = XmtCmd;
+	}
+	// a due diagnostic request goes out from this thread in the gap after the poll,
+	// its own buffers leave DP5Proto.PacketIn for the caller
+	DiagMonitor.ServiceRequest();
+	return iResult;
+}
+
+// diagnostics monitor request, uses its own buffers and gives up if another transfer holds the USB
+DIAG_REQUEST_RESULT CConsoleHelper::LibUsb_TryDiagnostics(DiagDataType *Diag, int *iDppType)
+{
+	CSendCommand DiagCmd;
+	CParsePacket DiagParse;
+	long lBytesOut;
+	int iResult;
+
+	*iDppType = StatusDeviceId;
+	if ((*iDppType < 0) || ! DppLibUsb.bDeviceConnected) {
+		return drFailed;		// no DPP status yet, or a Mini-X2 (no diagnostic data)
+	}
+	memset(DiagBufferOUT, 0, sizeof(DiagBufferOUT));
+	DPP_TRACE_SPAN("diag_request", XMTPT_SEND_DIAGNOSTIC_DATA);
+	if (! DiagCmd.DP5_CMD(DiagBufferOUT, XMTPT_SEND_DIAGNOSTIC_DATA)) {
+		return drFailed;
+	}
+	lBytesOut = (DiagBufferOUT[4] * 256) + DiagBufferOUT[5] + 8;
+	unique_lock<mutex> Lock(UsbLock, try_to_lock);
+	if (! Lock.owns_lock()) {
+		return drBusy;
+	}
+	if (! DppLibUsb.bDeviceConnected) {
+		return drFailed;		// closed while waiting
+	}
+	iResult = DppLibUsb.SendPacketUSB(DppLibUsb.DppLibusbHandle, DiagBufferOUT, DiagPacketIn);
+	TransportMetrics.RecordTransfer(XMTPT_SEND_DIAGNOSTIC_DATA, lBytesOut, iResult, (DppLibUsb.llRxTimeNs - DppLibUsb.llTxTimeNs) / 1000);
+	Lock.unlock();
+	if (iResult <= 0) {
+		return drFailed;
+	}
+	if (DiagParse.ParsePacket(DiagPacketIn, &DiagPIN) != preqProcessDiagData) {
+		return drFailed;
+	}
+	DP5Stat.Process_Diagnostics(DiagPIN, Diag, *iDppType);
+	return drDone;
+}
+
+bool CConsoleHelper::StartDiagMonitor(long lPeriodMs)
+{
+	return DiagMonitor.Start(lPeriodMs, [this](DiagDataType *Diag, int *iDevice) { return LibUsb_TryDiagnostics(Diag, iDevice); });
+}
+
+// passes a processed DPP status to the status consumers
+// a status that came with a spectrum is journaled in the spectrum record
+void CConsoleHelper::StatusReceived(long long llTxTimeNs, long long llRxTimeNs, bool bWithSpectrum)
+{
+	DPP_TRACE_SPAN("status_deliver");
+	StatusRxTimeNs = llRxTimeNs;
+	StatusDeviceId = DP5Stat.m_DP5_Status.DEVICE_ID;
+	Telemetry.RecordStatus(&DP5Stat.m_DP5_Status);
+	MetricsExporter.RecordStatus(&DP5Stat.m_DP5_Status);
+	CountRate.Update(&DP5Stat.m_DP5_Status);
+	StatusEvents.ProcessStatus(&DP5Stat.m_DP5_Status);
+	if ((llTxTimeNs > 0) && (llRxTimeNs >= llTxTimeNs)) {		// status with its transfer times
+		ClockSync.AddSample(DP5Stat.m_DP5_Status.RealTime, llTxTimeNs, llRxTimeNs);
+	}
+	if (Journal.IsOpen() && ! bWithSpectrum) {
+		Journal.AppendStatus(DP5Stat.m_DP5_Status.RAW, llRxTimeNs);
+	}
+}
+
+// passes a processed Mini-X2 status to the status consumers
+void CConsoleHelper::StatusReceivedMX2(long long llRxTimeNs)
+{
+	DPP_TRACE_SPAN("status_deliver_mx2");
+	StatusRxTimeNs = llRxTimeNs;
+	StatusDeviceId = -1;			// no diagnostic data on the Mini-X2
+	Telemetry.RecordStatusMX2(&DP5Stat.STATUS_MNX);
+	MetricsExporter.RecordStatusMX2(&DP5Stat.STATUS_MNX);
+	StatusEvents.ProcessStatusMX2(&DP5Stat.STATUS_MNX);
+}
+
 void CConsoleHelper::RemCallParsePacket(BYTE PacketIn[])
 {
     ParsePkt.DppState.ReqProcess = ParsePkt.ParsePacket(PacketIn, &DP5Proto.PIN);
+    TransportMetrics.RecordResponse(LastXmtCmd, ParsePkt.DppState.ReqProcess, &DP5Proto.PIN);
     ParsePacketEx(DP5Proto.PIN, ParsePkt.DppState);
 	//cout << "received: " << endl;
 }
@@ -146,41 +256,40 @@ void CConsoleHelper::ParsePacketEx(Packet_In PIN, DppStateType DppState)
 	switch (DppState.ReqProcess) {
 		case preqProcessStatus:
 			iDeviceType = 1;
-			cout << "RemCallParsePkt: ProcessStatus" << endl;
-			long idxStatus;
-			for(idxStatus=0;idxStatus<64;idxStatus++) {
-				DP5Stat.m_DP5_Status.RAW[idxStatus] = DP5Proto.PIN.DATA[idxStatus];
-			}
+			DPP_LOG_PACKET_DEBUG("parse", DppState.ReqProcess, PIN.PID1, PIN.PID2, PIN.RxTimeNs - PIN.TxTimeNs, "RemCallParsePkt: ProcessStatus");
+			memcpy(DP5Stat.m_DP5_Status.RAW, DP5Proto.PIN.DATA, sizeof(DP5Stat.m_DP5_Status.RAW));
 			DP5Stat.Process_Status(&DP5Stat.m_DP5_Status);
+			StatusReceived(PIN.TxTimeNs, PIN.RxTimeNs, false);
 			DppStatusString = DP5Stat.GetStatusValueStrings(DP5Stat.m_DP5_Status);
-			cout << DppStatusString << endl;
+			DPP_LOG_INFO("status", "%s", DppStatusString.c_str());
 			break;
 		case preqProcessStatusMX2:
 			iDeviceType = 2;
-			cout << "RemCallParsePkt: ProcessStatusMX2" << endl;
-			for(idxStatus=0;idxStatus<64;idxStatus++) {
-				DP5Stat.STATUS_MNX.RAW[idxStatus] = DP5Proto.PIN.DATA[idxStatus];
-			}
+			DPP_LOG_PACKET_DEBUG("parse", DppState.ReqProcess, PIN.PID1, PIN.PID2, PIN.RxTimeNs - PIN.TxTimeNs, "RemCallParsePkt: ProcessStatusMX2");
+			memcpy(DP5Stat.STATUS_MNX.RAW, DP5Proto.PIN.DATA, sizeof(DP5Stat.STATUS_MNX.RAW));
 			DP5Stat.Process_MNX_Status(&DP5Stat.STATUS_MNX);
+			StatusReceivedMX2(PIN.RxTimeNs);
 			DppStatusString = DP5Stat.MiniX2_StatusToString(DP5Stat.STATUS_MNX);
 			//cout << DppStatusString << endl;
 			break;
 		case preqProcessSpectrum:
-		cout << "RemCallParsePkt: ProcessSpectrum" << endl;	
+			DPP_LOG_PACKET_DEBUG("parse", DppState.ReqProcess, PIN.PID1, PIN.PID2, PIN.RxTimeNs - PIN.TxTimeNs, "RemCallParsePkt: ProcessSpectrum");
 			ProcessSpectrumEx(PIN, ParsePkt.DppState);
 			break;
 		//case preqProcessScopeData:
 		//	ProcessScopeDataEx(DP5Proto.PIN, ParsePkt.DppState);
 		//	break;
 		case preqProcessTextData:
-			cout << "RemCallParsePkt: ProcessTextData" << endl;
+			DPP_LOG_PACKET_DEBUG("parse", DppState.ReqProcess, PIN.PID1, PIN.PID2, PIN.RxTimeNs - PIN.TxTimeNs, "RemCallParsePkt: ProcessTextData");
 			ProcessTextDataEx(PIN, ParsePkt.DppState);
 			break;
-		//case preqProcessDiagData:
-		//	ProcessDiagDataEx(DP5Proto.PIN, ParsePkt.DppState);
-		//	break;
+		case preqProcessDiagData:
+			DPP_LOG_PACKET_DEBUG("parse", DppState.ReqProcess, PIN.PID1, PIN.PID2, PIN.RxTimeNs - PIN.TxTimeNs, "RemCallParsePkt: ProcessDiagData");
+			DP5Stat.Process_Diagnostics(PIN, &DP5Stat.DiagData, DP5Stat.m_DP5_Status.DEVICE_ID);
+			DiagMonitor.AddDiagnostics(&DP5Stat.DiagData, DP5Stat.m_DP5_Status.DEVICE_ID, (PIN.RxTimeNs - PIN.TxTimeNs) * 1.0e-6);
+			break;
 		case preqProcessCfgRead:
-			cout << "RemCallParsePkt: ProcessCfgRead" << endl;
+			DPP_LOG_PACKET_DEBUG("parse", DppState.ReqProcess, PIN.PID1, PIN.PID2, PIN.RxTimeNs - PIN.TxTimeNs, "RemCallParsePkt: ProcessCfgRead");
 			if (iDeviceType == 2) {
 				ProcessCfgReadM2Ex(DP5Proto.PIN, ParsePkt.DppState);
 			}
@@ -190,34 +299,34 @@ void CConsoleHelper::ParsePacketEx(Packet_In PIN, DppStateType DppState)
 			
 			break;
 		case preqProcessTubeInterlockTableMX2:
-			cout << "RemCallParsePkt: ProcessTubeInterlockTable" << endl;
+			DPP_LOG_PACKET_DEBUG("parse", DppState.ReqProcess, PIN.PID1, PIN.PID2, PIN.RxTimeNs - PIN.TxTimeNs, "RemCallParsePkt: ProcessTubeInterlockTable");
 			ProcessTubeInterlockTableMX2Ex(DP5Proto.PIN, ParsePkt.DppState);
 			break;
 		case preqProcessWarmupTableMX2:
-			cout << "RemCallParsePkt: ProcessWarmupTable" << endl;
+			DPP_LOG_PACKET_DEBUG("parse", DppState.ReqProcess, PIN.PID1, PIN.PID2, PIN.RxTimeNs - PIN.TxTimeNs, "RemCallParsePkt: ProcessWarmupTable");
 			ProcessWarmupTableMX2Ex(PIN, DppState);
 			break;
 		case preqProcessTimestampRecordMX2:
-			cout << "RemCallParsePkt: ProcessTimestampRecord" << endl;
+			DPP_LOG_PACKET_DEBUG("parse", DppState.ReqProcess, PIN.PID1, PIN.PID2, PIN.RxTimeNs - PIN.TxTimeNs, "RemCallParsePkt: ProcessTimestampRecord");
 			ProcessTimestampRecordMX2Ex(PIN, DppState);
 			break;
 		case preqProcessFaultRecordMX2:
-			cout << "RemCallParsePkt: ProcessFaultRecord" << endl;
+			DPP_LOG_PACKET_DEBUG("parse", DppState.ReqProcess, PIN.PID1, PIN.PID2, PIN.RxTimeNs - PIN.TxTimeNs, "RemCallParsePkt: ProcessFaultRecord");
 			ProcessFaultRecordMX2Ex(PIN, DppState);
 			break;
 		case preqProcessNetFindRead:
-			cout << "RemCallParsePkt: Netfinder" << endl;
+			DPP_LOG_PACKET_DEBUG("parse", DppState.ReqProcess, PIN.PID1, PIN.PID2, PIN.RxTimeNs - PIN.TxTimeNs, "RemCallParsePkt: Netfinder");
 			ProcessNetFinderM2Ex(PIN, DppState);
 			break;
 		case preqProcessAck:
-			cout << "RemCallParsePkt: ProcessAck" << endl;
-			cout<< ParsePkt.PID2_TextToString("ACK", DP5Proto.PIN.PID2) <<endl;
+			DPP_LOG_PACKET_DEBUG("parse", DppState.ReqProcess, PIN.PID1, PIN.PID2, PIN.RxTimeNs - PIN.TxTimeNs, "RemCallParsePkt: ProcessAck");
+			DPP_LOG_INFO("parse", "%s", ParsePkt.PID2_TextToString("ACK", DP5Proto.PIN.PID2).c_str());
 			break;
 		case preqProcessError:
-			cout << "RemCallParsePkt: preqProcessError" << endl;
+			DPP_LOG_WARN("parse", "RemCallParsePkt: preqProcessError");
 			break;
 		default:
-			cout << "RemCallParsePkt: default" << endl;
+			DPP_LOG_WARN("parse", "RemCallParsePkt: default");
 			break;
 	}
 }
@@ -232,19 +341,18 @@ void CConsoleHelper::ProcessNetFinderM2Ex(Packet_In PIN, DppStateType DppState)
 		strNetFinder += strCh;
 	}
 
-	cout << "NetFinderPacket" << endl;
-	cout << strNetFinder << endl;
+	DPP_LOG_INFO("mx2", "NetFinderPacket\n%s", strNetFinder.c_str());
 }
 
 void CConsoleHelper::ProcessTimestampRecordMX2Ex(Packet_In PIN, DppStateType DppState)
 {
 	string strTimeStamp;
-	cout << "TimeStampNotCompleted" << endl;
+	DPP_LOG_INFO("mx2", "TimeStampNotCompleted");
 }
 
 void CConsoleHelper::ProcessWarmupTableMX2Ex(Packet_In PIN, DppStateType DppState)
 {
-	cout << "Not Configured Yet" << endl;
+	DPP_LOG_INFO("mx2", "Not Configured Yet");
 	//Process_MNX_Warmup_Table();
 }
 
@@ -334,7 +442,7 @@ void CConsoleHelper::ProcessFaultRecordMX2Ex(Packet_In PIN, DppStateType DppStat
 	string strFault;
 	// CDP5Status DP5Status;
 	strFault = DP5Status.Process_MNX_Fault_Record(PIN);
-	cout << strFault << endl;
+	DPP_LOG_INFO("mx2", "%s", strFault.c_str());
 }
 
 
@@ -409,6 +517,8 @@ bool CConsoleHelper::LibUsb_Close_Connection()
 {	
 	bConnectionClosed = false;
 
+	DiagMonitor.Stop();		// no diagnostic requests on the closing handle
+	lock_guard<mutex> Lock(UsbLock);
 	if (DppLibUsb.bDeviceConnected) { // clean-up: close usb connection
 		DppLibUsb.bDeviceConnected = false;
 		DppLibUsb.CloseUSBDevice(DppLibUsb.DppLibusbHandle);
@@ -422,6 +532,7 @@ bool CConsoleHelper::LibUsb_Close_Connection()
 
 bool CConsoleHelper::LibUsb_SendCommand(TRANSMIT_PACKET_TYPE XmtCmd)
 {
+	DPP_TRACE_SPAN("request", XmtCmd);
     bool bHaveBuffer;
     int bSentPkt;
 	bool bMessageSent;
@@ -431,7 +542,7 @@ bool CConsoleHelper::LibUsb_SendCommand(TRANSMIT_PACKET_TYPE XmtCmd)
 		memset(&DP5Proto.BufferOUT[0],0,sizeof(DP5Proto.BufferOUT));
 		bHaveBuffer = (bool) SndCmd.DP5_CMD(DP5Proto.BufferOUT, XmtCmd);
 		if (bHaveBuffer) {
-			bSentPkt = DppLibUsb.SendPacketUSB(DppLibUsb.DppLibusbHandle, DP5Proto.BufferOUT, DP5Proto.PacketIn);
+			bSentPkt = LibUsb_SendPacket(XmtCmd);
 			if (bSentPkt) {
 				RemCallParsePacket(DP5Proto.PacketIn);
 	            bMessageSent = true;
@@ -484,6 +595,7 @@ void CConsoleHelper::CreateConfigOptions(CONFIG_OPTIONS *CfgOptions, string strC
 //					Creates and sends a full readback command
 bool CConsoleHelper::LibUsb_SendCommand_Config(TRANSMIT_PACKET_TYPE XmtCmd, CONFIG_OPTIONS CfgOptions)
 {
+	DPP_TRACE_SPAN("request", XmtCmd);
     bool bHaveBuffer;
     int bSentPkt;
 	bool bMessageSent;
@@ -493,7 +605,7 @@ bool CConsoleHelper::LibUsb_SendCommand_Config(TRANSMIT_PACKET_TYPE XmtCmd, CONF
 		memset(&DP5Proto.BufferOUT[0],0,sizeof(DP5Proto.BufferOUT));
 		bHaveBuffer = (bool) SndCmd.DP5_CMD_Config(DP5Proto.BufferOUT, XmtCmd, CfgOptions);
 		if (bHaveBuffer) {
-			bSentPkt = DppLibUsb.SendPacketUSB(DppLibUsb.DppLibusbHandle, DP5Proto.BufferOUT, DP5Proto.PacketIn);
+			bSentPkt = LibUsb_SendPacket(XmtCmd);
 			if (bSentPkt) {
 				bMessageSent = true;
 	            RemCallParsePacket(DP5Proto.PacketIn);
@@ -504,6 +616,214 @@ bool CConsoleHelper::LibUsb_SendCommand_Config(TRANSMIT_PACKET_TYPE XmtCmd, CONF
 }
 
 
+// sends a configuration packet and parses the response packet,
+// the response is left in DP5Proto.PIN and is not routed for display/configuration processing
+long CConsoleHelper::LibUsb_SendConfigPacket(TRANSMIT_PACKET_TYPE XmtCmd, string strCfg)
+{
+	DPP_TRACE_SPAN("request", XmtCmd);
+	CONFIG_OPTIONS CfgOptions;
+	bool bHaveBuffer;
+	int bSentPkt;
+
+	if (! DppLibUsb.bDeviceConnected) {
+		return preqProcessNone;
+	}
+	CreateConfigOptions(&CfgOptions, strCfg, DP5Stat, false);
+	memset(&DP5Proto.BufferOUT[0],0,sizeof(DP5Proto.BufferOUT));
+	bHaveBuffer = (bool) SndCmd.DP5_CMD_Config(DP5Proto.BufferOUT, XmtCmd, CfgOptions);
+	if (! bHaveBuffer) {
+		return preqProcessNone;
+	}
+	bSentPkt = LibUsb_SendPacket(XmtCmd);
+	if (bSentPkt <= 0) {
+		return preqProcessNone;
+	}
+	ParsePkt.DppState.ReqProcess = ParsePkt.ParsePacket(DP5Proto.PacketIn, &DP5Proto.PIN);
+	TransportMetrics.RecordResponse(XmtCmd, ParsePkt.DppState.ReqProcess, &DP5Proto.PIN);
+	return ParsePkt.DppState.ReqProcess;
+}
+
+bool CConsoleHelper::CfgValuesMatch(string strSent, string strRead, double dblTolerance)
+{
+	double dblSent;
+	double dblRead;
+	char *pEnd;
+	const char *pSent;
+	const char *pRead;
+
+	strSent = SndCmd.AsciiCmdUtil.ShortenCmdValues(strSent + ";");
+	strRead = SndCmd.AsciiCmdUtil.ShortenCmdValues(strRead + ";");
+	if (strSent == strRead) {
+		return true;
+	}
+	strSent = strSent.substr(0, strSent.length() - 1);
+	strRead = strRead.substr(0, strRead.length() - 1);
+	pSent = strSent.c_str();
+	pRead = strRead.c_str();
+	dblSent = strtod(pSent, &pEnd);
+	if ((pEnd == pSent) || (*pEnd != '\0')) return false;
+	dblRead = strtod(pRead, &pEnd);
+	if ((pEnd == pRead) || (*pEnd != '\0')) return false;
+	return (fabs(dblSent - dblRead) <= (dblTolerance * max(fabs(dblSent), fabs(dblRead))) + 1e-9);
+}
+
+// Configuration apply transaction
+//		1. send the configuration (split at command boundaries into DP5_MAX_CFG_SIZE packets)
+//		2. read back exactly the commands sent, SCA commands are queried under their SCAI index
+//		3. compare sent and read back values, readback packets are parsed directly
+// dblTolerance is the relative tolerance for numeric values quantized by the device (0.01=1%)
+bool CConsoleHelper::LibUsb_ApplyConfig(string strCfg, CFG_APPLY_RESULT *CfgResult, double dblTolerance)
+{
+	map<string, size_t> mapItems;
+	map<string, size_t>::iterator itItem;
+	CFG_APPLY_ITEM CfgItem;
+	vector<string> vPackets;
+	string strCmd;
+	string strValue;
+	string strKey;
+	string strPacket;
+	string strToken;
+	size_t lStart;
+	size_t lEnd;
+	size_t lEq;
+	size_t idxItem;
+	size_t idxPacket;
+	int iScaIndex;
+	int iLastSca;
+	long lReqProcess;
+	long idxData;
+	char ch;
+
+	CfgResult->bSent = false;
+	CfgResult->AckPID2 = PID2_ACK_OK;
+	CfgResult->bReadBack = false;
+	CfgResult->iMismatches = 0;
+	CfgResult->Items.clear();
+
+	// collect touched commands, the last value sent for a command is the expected value
+	strCfg = SndCmd.AsciiCmdUtil.RemWhitespace(SndCmd.AsciiCmdUtil.MakeUpper(strCfg));
+	iScaIndex = 0;
+	for (lStart=0;lStart<strCfg.length();lStart=lEnd+1) {
+		lEnd = strCfg.find(';', lStart);
+		if (lEnd == string::npos) lEnd = strCfg.length();
+		lEq = strCfg.find('=', lStart);
+		if ((lEq == string::npos) || (lEq != lStart + 4) || (lEq >= lEnd)) continue;
+		strCmd = strCfg.substr(lStart, 4);
+		strValue = strCfg.substr(lEq + 1, lEnd - lEq - 1);
+		if ((strValue.length() == 0) || (strValue == "?") || (strCmd == "RESC")) continue;
+		if (strCmd == "SCAI") {
+			iScaIndex = atoi(strValue.c_str());
+			continue;
+		}
+		CfgItem.strCmd = strCmd;
+		CfgItem.iScaIndex = (strCmd.compare(0, 3, "SCA") == 0) ? iScaIndex : 0;
+		CfgItem.strSent = strValue;
+		CfgItem.strRead = "";
+		CfgItem.bMatch = false;
+		strKey = strCmd + to_string(CfgItem.iScaIndex);
+		itItem = mapItems.find(strKey);
+		if (itItem == mapItems.end()) {
+			mapItems[strKey] = CfgResult->Items.size();
+			CfgResult->Items.push_back(CfgItem);
+		} else {
+			CfgResult->Items[itItem->second].strSent = strValue;
+		}
+	}
+
+	// send configuration
+	while (strCfg.length() > DP5_MAX_CFG_SIZE) {
+		lEnd = strCfg.rfind(';', DP5_MAX_CFG_SIZE - 1);
+		if (lEnd == string::npos) return false;
+		vPackets.push_back(strCfg.substr(0, lEnd + 1));
+		strCfg = strCfg.substr(lEnd + 1);
+	}
+	if (strCfg.length() > 0) vPackets.push_back(strCfg);
+	for (idxPacket=0;idxPacket<vPackets.size();idxPacket++) {
+		lReqProcess = LibUsb_SendConfigPacket(XMTPT_SEND_CONFIG_PACKET_EX, vPackets[idxPacket]);
+		if (lReqProcess != preqProcessAck) {
+			return false;
+		}
+		CfgResult->AckPID2 = DP5Proto.PIN.PID2;
+		if ((DP5Proto.PIN.PID2 != PID2_ACK_OK) && (DP5Proto.PIN.PID2 != PID2_ACK_OK_ETHERNET_SHARE_REQ)) {
+			return false;
+		}
+	}
+	CfgResult->bSent = true;
+	if (CfgResult->Items.size() == 0) {
+		CfgResult->bReadBack = true;
+		return true;
+	}
+
+	// build the readback queries for the touched commands only
+	vPackets.clear();
+	strPacket = "";
+	iLastSca = 0;
+	for (idxItem=0;idxItem<CfgResult->Items.size();idxItem++) {
+		strToken = CfgResult->Items[idxItem].strCmd + "=?;";
+		if ((CfgResult->Items[idxItem].iScaIndex != 0) && (CfgResult->Items[idxItem].iScaIndex != iLastSca)) {
+			strToken = "SCAI=" + to_string(CfgResult->Items[idxItem].iScaIndex) + ";" + strToken;
+		}
+		if (strPacket.length() + strToken.length() > DP5_MAX_CFG_SIZE) {
+			vPackets.push_back(strPacket);
+			strPacket = "";
+			if (CfgResult->Items[idxItem].iScaIndex != 0) {
+				strToken = "SCAI=" + to_string(CfgResult->Items[idxItem].iScaIndex) + ";" + CfgResult->Items[idxItem].strCmd + "=?;";
+			}
+		}
+		strPacket += strToken;
+		iLastSca = CfgResult->Items[idxItem].iScaIndex;
+	}
+	vPackets.push_back(strPacket);
+
+	// read back and compare, values are taken straight from the packet data
+	for (idxPacket=0;idxPacket<vPackets.size();idxPacket++) {
+		lReqProcess = LibUsb_SendConfigPacket(XMTPT_READ_CONFIG_PACKET_EX, vPackets[idxPacket]);
+		if (lReqProcess != preqProcessCfgRead) {
+			break;
+		}
+		iScaIndex = 0;
+		strCmd = "";
+		strValue = "";
+		lEq = 0;
+		for (idxData=0;idxData<DP5Proto.PIN.LEN;idxData++) {
+			ch = (char)DP5Proto.PIN.DATA[idxData];
+			if (ch == ';') {
+				if ((lEq == 4) && (strCmd == "SCAI")) {
+					iScaIndex = atoi(strValue.c_str());
+				} else if (lEq == 4) {
+					strKey = strCmd + to_string((strCmd.compare(0, 3, "SCA") == 0) ? iScaIndex : 0);
+					itItem = mapItems.find(strKey);
+					if (itItem != mapItems.end()) {
+						CfgResult->Items[itItem->second].strRead = strValue;
+					}
+				}
+				strCmd = "";
+				strValue = "";
+				lEq = 0;
+			} else if ((ch == '=') && (lEq == 0)) {
+				lEq = strCmd.length();
+			} else if (ch > ' ') {
+				if (lEq == 0) {
+					strCmd += (char)toupper((unsigned char)ch);
+				} else {
+					strValue += (char)toupper((unsigned char)ch);
+				}
+			}
+		}
+		if (idxPacket == vPackets.size() - 1) {
+			CfgResult->bReadBack = true;
+		}
+	}
+	for (idxItem=0;idxItem<CfgResult->Items.size();idxItem++) {
+		CfgItem = CfgResult->Items[idxItem];
+		CfgResult->Items[idxItem].bMatch = (CfgItem.strRead.length() > 0) && CfgValuesMatch(CfgItem.strSent, CfgItem.strRead, dblTolerance);
+		if (! CfgResult->Items[idxItem].bMatch) {
+			CfgResult->iMismatches++;
+		}
+	}
+	return (CfgResult->bReadBack && (CfgResult->iMismatches == 0));
+}
+
 bool CConsoleHelper::LibUsb_ReceiveData()
 {
 	bool bDataReceived;
@@ -530,24 +850,21 @@ bool CConsoleHelper::ReceiveData()
 	//cout << "ParsePkt: " << ParsePkt.DppState.ReqProcess << endl;
 	switch (ParsePkt.DppState.ReqProcess) {
 		case preqProcessStatus:
-			long idxStatus;
-			for(idxStatus=0;idxStatus<64;idxStatus++) {
-				DP5Stat.m_DP5_Status.RAW[idxStatus] = DP5Proto.PIN.DATA[idxStatus];
-			}
+			memcpy(DP5Stat.m_DP5_Status.RAW, DP5Proto.PIN.DATA, sizeof(DP5Stat.m_DP5_Status.RAW));
 			DP5Stat.Process_Status(&DP5Stat.m_DP5_Status);
+			StatusReceived(DP5Proto.PIN.TxTimeNs, DP5Proto.PIN.RxTimeNs, false);
 			//DP5Stat.Process_MNX_Status(&DP5Stat.STATUS_MNX);
 			DppStatusString = DP5Stat.ShowStatusValueStrings(DP5Stat.m_DP5_Status);
 			//DppStatusString = DP5Stat.MiniX2_StatusToString(DP5Stat.STATUS_MNX);
 			break;
 		case preqProcessStatusMX2:
-			for(idxStatus=0;idxStatus<64;idxStatus++) {
-				DP5Stat.STATUS_MNX.RAW[idxStatus] = DP5Proto.PIN.DATA[idxStatus];
-			}
+			memcpy(DP5Stat.STATUS_MNX.RAW, DP5Proto.PIN.DATA, sizeof(DP5Stat.STATUS_MNX.RAW));
 			//DP5Stat.Process_Status(&DP5Stat.m_DP5_Status);
 			DP5Stat.Process_MNX_Status(&DP5Stat.STATUS_MNX);
+			StatusReceivedMX2(DP5Proto.PIN.RxTimeNs);
 			//DppStatusString = DP5Stat.ShowStatusValueStrings(DP5Stat.m_DP5_Status);
 			DppStatusString = DP5Stat.MiniX2_StatusToString(DP5Stat.STATUS_MNX);
-			cout << DppStatusString <<endl;
+			DPP_LOG_INFO("status", "%s", DppStatusString.c_str());
 			break;
 		case preqProcessSpectrum:
 			ProcessSpectrumEx(DP5Proto.PIN, ParsePkt.DppState);
@@ -559,9 +876,10 @@ bool CConsoleHelper::ReceiveData()
 			ProcessTextDataEx(DP5Proto.PIN, ParsePkt.DppState);
 
 			break;
-		//case preqProcessDiagData:
-		//	ProcessDiagDataEx(DP5Proto.PIN, ParsePkt.DppState);
-		//	break;
+		case preqProcessDiagData:
+			DP5Stat.Process_Diagnostics(DP5Proto.PIN, &DP5Stat.DiagData, DP5Stat.m_DP5_Status.DEVICE_ID);
+			DiagMonitor.AddDiagnostics(&DP5Stat.DiagData, DP5Stat.m_DP5_Status.DEVICE_ID, (DP5Proto.PIN.RxTimeNs - DP5Proto.PIN.TxTimeNs) * 1.0e-6);
+			break;
 		case preqProcessCfgRead:
 			ProcessCfgReadEx(DP5Proto.PIN, ParsePkt.DppState);
 			//cout << "ProcessCgfReadM2Ex" << endl;
@@ -579,8 +897,8 @@ bool CConsoleHelper::ReceiveData()
 		// 	ProcessFaultRecordMX2Ex(PIN, DppState);
 		// 	break;
 		case preqProcessAck:
-			cout << "ProcessAck" << endl;
-			cout << ParsePkt.PID2_TextToString("ACK", DP5Proto.PIN.PID2) << endl;
+			DPP_LOG_DEBUG("parse", "ProcessAck");
+			DPP_LOG_INFO("parse", "%s", ParsePkt.PID2_TextToString("ACK", DP5Proto.PIN.PID2).c_str());
 			// ProcessAck(DP5Proto.PIN.PID2);
 			break;
 		//case preqProcessError:
@@ -617,7 +935,7 @@ void CConsoleHelper::ProcessTubeInterlockTableMX2Ex(Packet_In PIN, DppStateType
 	    
     DP5Stat.strMX2AdvancedDisplay = DP5Stat.Process_MNX_Tube_Table(PIN, &DP5Stat.TubeInterlockTable);
 	// The Tube and Interlock Table is needed to setup the graphics and parameter constraints
-	cout << strTubeInterlockTable << endl;
+	DPP_LOG_INFO("mx2", "%s", strTubeInterlockTable.c_str());
 
     if (DP5Stat.bHaveTubeType) {
         strStatus = "Tube and Interlock Table Received\r\n";
@@ -631,21 +949,50 @@ void CConsoleHelper::ProcessTubeInterlockTableMX2Ex(Packet_In PIN, DppStateType
 void CConsoleHelper::ProcessSpectrumEx(Packet_In PIN, DppStateType DppState)
 {
 	long idxSpectrum;
-	long idxStatus;
 
 	DP5Proto.SPECTRUM.CHANNELS = (short)(256 * pow(2.0,(((PIN.PID2 - 1) & 14) / 2)));
+	DP5Proto.SPECTRUM.RxTimeNs = PIN.RxTimeNs;
 
-	for(idxSpectrum=0;idxSpectrum<DP5Proto.SPECTRUM.CHANNELS;idxSpectrum++) {
-        DP5Proto.SPECTRUM.DATA[idxSpectrum] = (long)(PIN.DATA[idxSpectrum * 3]) + (long)(PIN.DATA[idxSpectrum * 3 + 1]) * 256 + (long)(PIN.DATA[idxSpectrum * 3 + 2]) * 65536;
+	{
+		DPP_TRACE_SPAN("spectrum_decode", DP5Proto.SPECTRUM.CHANNELS);
+		DP5Proto.SPECTRUM.PREFIX[0] = 0;
+		for(idxSpectrum=0;idxSpectrum<DP5Proto.SPECTRUM.CHANNELS;idxSpectrum++) {
+			DP5Proto.SPECTRUM.DATA[idxSpectrum] = (long)(PIN.DATA[idxSpectrum * 3]) + (long)(PIN.DATA[idxSpectrum * 3 + 1]) * 256 + (long)(PIN.DATA[idxSpectrum * 3 + 2]) * 65536;
+			DP5Proto.SPECTRUM.PREFIX[idxSpectrum + 1] = DP5Proto.SPECTRUM.PREFIX[idxSpectrum] + DP5Proto.SPECTRUM.DATA[idxSpectrum];	// ROI index
+		}
 	}
+	// delivery to the consumers up to the journal handoff, the status is a nested span
+	DPP_TRACE_SPAN("spectrum_deliver");
+	MetricsExporter.RecordSpectrum();
 
     if ((PIN.PID2 & 1) == 0) {    // spectrum + status
-		for(idxStatus=0;idxStatus<64;idxStatus++) {
-			DP5Stat.m_DP5_Status.RAW[idxStatus] = PIN.DATA[idxStatus + DP5Proto.SPECTRUM.CHANNELS * 3];
-		}
+		memcpy(DP5Stat.m_DP5_Status.RAW, &PIN.DATA[DP5Proto.SPECTRUM.CHANNELS * 3], sizeof(DP5Stat.m_DP5_Status.RAW));
         DP5Stat.Process_Status(&DP5Stat.m_DP5_Status);
+		StatusReceived(PIN.TxTimeNs, PIN.RxTimeNs, true);
 		DppStatusString = DP5Stat.ShowStatusValueStrings(DP5Stat.m_DP5_Status);
     }
+	if (SpectrumArchive.IsWriting()) {
+		// times of the last status, raw status only when it came with the spectrum
+		if (! SpectrumArchive.Append(DP5Proto.SPECTRUM.DATA, DP5Proto.SPECTRUM.CHANNELS, ((PIN.PID2 & 1) == 0) ? DP5Stat.m_DP5_Status.RAW : NULL,
+			DP5Stat.m_DP5_Status.AccumulationTime, DP5Stat.m_DP5_Status.RealTime, PIN.RxTimeNs)) {
+			DPP_LOG_WARN("file", "Spectrum archive append failed (%d channels)", (int)DP5Proto.SPECTRUM.CHANNELS);
+		}
+	}
+	if (SpectrumStore.IsEnabled() && ! SpectrumStore.Append(DP5Proto.SPECTRUM.DATA, DP5Proto.SPECTRUM.CHANNELS, PIN.RxTimeNs * 1.0e-9)) {
+		DPP_LOG_WARN("store", "Spectrum store append failed (%d channels)", (int)DP5Proto.SPECTRUM.CHANNELS);
+	}
+	if (SpectrumHistory.IsEnabled()) {
+		SpectrumHistory.Append(DP5Proto.SPECTRUM.DATA, DP5Proto.SPECTRUM.CHANNELS, PIN.RxTimeNs * 1.0e-9);
+	}
+	SpectrumPyramid.Update(DP5Proto.SPECTRUM.DATA, DP5Proto.SPECTRUM.CHANNELS);
+	if (SpectrumMerger.IsEnabled() && ! SpectrumMerger.Update(DP5Stat.m_DP5_Status.SerialNumber, DP5Proto.SPECTRUM.DATA, DP5Proto.SPECTRUM.CHANNELS)) {
+		DPP_LOG_DEBUG("merge", "Spectrum of detector %lu not merged (no calibration)", (unsigned long)DP5Stat.m_DP5_Status.SerialNumber);
+	}
+	if (Journal.IsOpen()) {
+		// queued only, the journal writer thread does the file writes and syncs
+		Journal.AppendSpectrum(DP5Proto.SPECTRUM.DATA, DP5Proto.SPECTRUM.CHANNELS, ((PIN.PID2 & 1) == 0) ? DP5Stat.m_DP5_Status.RAW : NULL,
+			DP5Stat.m_DP5_Status.AccumulationTime, DP5Stat.m_DP5_Status.RealTime, PIN.RxTimeNs);
+	}
 }
 
 void CConsoleHelper::ClearConfigReadFormatFlags()
@@ -686,9 +1033,9 @@ void CConsoleHelper::ProcessCfgReadM2Ex(Packet_In PIN, DppStateType DppState)
 		strMX2CfgIn = strRawCfgIn;
 		bMX2CfgReady = true;
 		strHV = GetCmdData("HVSE", strMX2CfgIn);
-		cout << "Voltage: " << strHV << endl;
+		DPP_LOG_INFO("mx2", "Voltage: %s", strHV.c_str());
 		strI = GetCmdData("CUSE", strMX2CfgIn);
-		cout << "Current: " << strI << endl;
+		DPP_LOG_INFO("mx2", "Current: %s", strI.c_str());
 	}
 }
 
@@ -1066,43 +1413,69 @@ void CConsoleHelper::ConsoleGraph(long lData[], long chan, bool bLog, std::strin
 	long yMax;
 	long idxX;
 	long idxY;
-	double xM;
 	double yM;
 	long i;
 	long x;
 	long y;
 	double logY;
 	long logYLong;
+	long lColumns;
+	long lStart;
+	long lEnd;
+	long idxChan;
+	vector<PYRAMID_POINT> vColumns;
 	//cout << chan << endl;
 
+	// one point (largest channel) per screen column, the received spectrum is read from
+	// SpectrumPyramid, other buffers are scanned with the same column ranges
+	if ((lData != DP5Proto.SPECTRUM.DATA) || (SpectrumPyramid.Channels() != chan) || ! SpectrumPyramid.Query(0, chan, ScreenW, &vColumns)) {
+		if (chan <= 0) {
+			return;
+		}
+		lColumns = (chan < ScreenW) ? chan : ScreenW;
+		vColumns.resize(lColumns);
+		for (i=0;i<lColumns;i++) {
+			lStart = (long)(((long long)i * chan) / lColumns);
+			lEnd = (long)(((long long)(i + 1) * chan) / lColumns);
+			vColumns[i].lMax = lData[lStart];
+			for (idxChan=lStart+1;idxChan<lEnd;idxChan++) {
+				if (lData[idxChan] > vColumns[i].lMax) {
+					vColumns[i].lMax = lData[idxChan];
+				}
+			}
+		}
+	}
+	for (x=0;x<ScreenW;x++) {
+		for (y=0;y<ScreenH;y++) {
+			plot[x][y] = chEmpty;
+		}
+	}
 	yMax = 0;
-	for(i=0;i<chan;i++) {
+	for(i=0;i<(long)vColumns.size();i++) {
 		if (bLog) {
-			logY = log(1.0 + lData[i]);
+			logY = log(1.0 + vColumns[i].lMax);
 			if (yMax < (long)logY) {
 				yMax = (long)logY;
 			}
 		} else {
-			if (yMax < lData[i]) {
-				yMax = lData[i];
+			if (yMax < vColumns[i].lMax) {
+				yMax = vColumns[i].lMax;
 			}
 		}
 	}
 
-	xM = (double)ScreenW / (double)chan;
 	if (yMax < 1) yMax = 1;
 	yM = (double)(((double)(ScreenH)-(double)2.0) / (double)yMax);
 
-	for (i=0;i<chan;i++) {
-		idxX = (long)((double)i * xM);
-		if (idxX >= ScreenW) idxX = ScreenW-1;
+	for (i=0;i<(long)vColumns.size();i++) {
+		idxX = i;		// Query returns one point per column
 		
 		if (bLog) {
-			logY = log(1.0  + lData[i]);
+			logY = log(1.0  + vColumns[i].lMax);
 			logYLong = (long)logY;
 			idxY = (long)((double)logYLong * yM);
 		} else {
-			idxY = (long)((double)lData[i] * yM);
+			idxY = (long)((double)vColumns[i].lMax * yM);
 		}
 		if (idxY >= ScreenH) idxY = ScreenH-2;
 
@@ -1131,81 +1504,58 @@ void CConsoleHelper::ConsoleGraph(long lData[], long chan, bool bLog, std::strin
 		}
 	}
 
+	// one text record, the log sink writes it in order with the status lines
+	strRow = "";
+	strRow.reserve(ScreenH * (ScreenW + 1));
 	for (y=0;y<ScreenH;y++){
 		for (x=0;x<ScreenW;x++){
-			cout << plot[x][(ScreenH-1)-y];
+			strRow += plot[x][(ScreenH-1)-y];
 		}
 #ifndef _WIN32
-		cout << endl;
+		strRow += "\n";
 #endif
 	}
+	GetDppLog().WriteText(strRow);
+}
+
+// fills the .mca file description from the spectrum info and status
+void CConsoleHelper::CreateMCAFileInfo(SpectrumFileType sfInfo, DP4_FORMAT_STATUS cfgStatusLst, MCA_FILE_INFO *McaInfo)
+{
+	McaInfo->strTag = sfInfo.strTag;
+	McaInfo->strDescription = sfInfo.strDescription;
+	McaInfo->SerialNumber = sfInfo.SerialNumber;
+	McaInfo->dblLiveTime = cfgStatusLst.AccumulationTime;
+	McaInfo->dblRealTime = cfgStatusLst.RealTime;
+	McaInfo->strConfig = sfInfo.strSpectrumConfig;
+	McaInfo->strStatus = sfInfo.strSpectrumStatus;	// this functin is included in most examples
 }
 
 string CConsoleHelper::CreateMCAData(long m_larDataBuffer[], SpectrumFileType sfInfo, DP4_FORMAT_STATUS cfgStatusLst)
 {
-	string strMCA;
-	string strText;
-	string strADC;
-	long idxChan;
-	string strData;
-	stringex strfn;
+	MCA_FILE_INFO McaInfo;
 
 	if (cfgStatusLst.SerialNumber <= 0) 
 	{
 		return ("");
 	}
-	strText = "";
-   	strMCA = "";
-    switch(sfInfo.m_iNumChan){
-        case 16384:
-            strADC = "6";
-				break;
-        case 8192:
-            strADC = "5";
-				break;
-        case 4096:
-            strADC = "4";
-				break;
-        case 2048:
-            strADC = "3";
-				break;
-        case 1024:
-            strADC = "2";
-				break;
-        case 512:
-            strADC = "1";
-				break;
-        case 256:
-            strADC = "0";
-				break;
-    }
-    strMCA += "<<PMCA SPECTRUM>>\r\n";
-    strMCA += "TAG - " + sfInfo.strTag + "\r\n";
-    strMCA += "DESCRIPTION - " + sfInfo.strDescription + "\r\n";
-    strMCA += "GAIN - " + strADC + "\r\n";
-    strMCA += "THRESHOLD - 0\r\n";
-    strMCA += "LIVE_MODE - 0\r\n";
-    strMCA += "PRESET_TIME - \r\n";
-	strText = strfn.Format("%lf", cfgStatusLst.AccumulationTime);
-    strMCA += "LIVE_TIME - " + strText + "\r\n";
-	strText = strfn.Format("%lf", cfgStatusLst.RealTime);
-    strMCA += "REAL_TIME - " + strText + "\r\n";
-    strMCA += "START_TIME - \r\n";
-	strText = strfn.Format("%i", sfInfo.SerialNumber);
-    strMCA += "SERIAL_NUMBER - " + strText + "\r\n";
-    strMCA += "<<DATA>>\r\n";
-	for (idxChan=0;idxChan<sfInfo.m_iNumChan;idxChan++) {
-		strData = strfn.Format("%i", m_larDataBuffer[idxChan]);
-		strMCA += strData + "\r\n";
-	}
-    strMCA += "<<END>>\r\n";
-	strMCA += "<<DP5 CONFIGURATION>>\r\n";
-	strMCA += sfInfo.strSpectrumConfig;
-	strMCA += "<<DP5 CONFIGURATION END>>\r\n";
-	strMCA += "<<DPP STATUS>>\r\n";
-	strMCA += sfInfo.strSpectrumStatus;	// this functin is included in most examples
-	strMCA += "<<DPP STATUS END>>\r\n";
-	return (strMCA);
+	CreateMCAFileInfo(sfInfo, cfgStatusLst, &McaInfo);
+	return (McaWriter.FormatToString(&McaInfo, m_larDataBuffer, sfInfo.m_iNumChan));
+}
+
+bool CConsoleHelper::SaveMCAFile(long m_larDataBuffer[], SpectrumFileType sfInfo, DP4_FORMAT_STATUS cfgStatusLst, string strFilename)
+{
+	MCA_FILE_INFO McaInfo;
+
+	if (cfgStatusLst.SerialNumber <= 0) 
+	{
+		return false;
+	}
+	CreateMCAFileInfo(sfInfo, cfgStatusLst, &McaInfo);
+	if (! McaWriter.SaveSpectrum(strFilename, &McaInfo, m_larDataBuffer, sfInfo.m_iNumChan)) {
+		DPP_LOG_ERROR("file", "%s", McaWriter.LastError().c_str());
+		return false;
+	}
+	return true;
 }
 
 void CConsoleHelper::SaveSpectrumStringToFile(string strData, string strFilename)
@@ -1215,13 +1565,13 @@ void CConsoleHelper::SaveSpectrumStringToFile(string strData, string strFilename
 	stringex strfn;
 	
 
-	if ( (out = fopen(strFilename.c_str(),"wb")) == (FILE *) NULL)
-		strError = strfn.Format("Couldn't open %s for writing.\n", strFilename.c_str());
-	else
-	{
-		fprintf(out,"%s",strData.c_str());
+	if ( (out = fopen(strFilename.c_str(),"wb")) == (FILE *) NULL) {
+		strError = strfn.Format("Couldn't open %s for writing.", strFilename.c_str());
+		DPP_LOG_ERROR("file", "%s", strError.c_str());
+	} else {
+		fwrite(strData.c_str(), 1, strData.length(), out);
+		fclose(out);
 	}
-	fclose(out);
 }
 
 string CConsoleHelper::CreateSpectrumConfig(string strRawCfgIn) 
@@ -12,6 +12,25 @@
 #include "ParsePacket.h"		// Packet Parser
 #include "SendCommand.h"		// Command Generator
 #include "DP5Status.h"			// Status Decoder
+#include "DppTelemetry.h"		// Status Telemetry Recorder
+#include "DppTransportMetrics.h"	// USB Transport Metrics
+#include "DppMetricsExporter.h"	// Prometheus Metrics Endpoint
+#include "DppCountRate.h"		// Count Rate / Dead Time
+#include "DppStatusEvents.h"		// Status Change Events
+#include "DppClockSync.h"			// Host/Device Clock Correlation
+#include "DppLog.h"				// Async Leveled Logging
+#include "DppDiagMonitor.h"		// Background Diagnostics Monitor
+#include "DppTrace.h"				// Acquisition Stage Tracing
+#include "DppMcaWriter.h"			// Streaming MCA File Writer
+#include "DppSpectrumArchive.h"		// Binary Spectrum Archive
+#include "DppSpectrumStore.h"		// Chunked Time x Channel Store
+#include "DppJournal.h"			// Acquisition Write-Ahead Journal
+#include "DppSpectrumHistory.h"		// Recent Spectra Ring
+#include "DppSpectrumPyramid.h"		// Min/Max Plot Decimation
+#include "DppRoiIndex.h"			// Prefix Sum ROI Counts
+#include "DppSpectrumMerger.h"		// Multi-Detector Summation
+#include <mutex>
+#include <atomic>
 #include <time.h>				// time library for rand seed
 
 typedef int BOOL;
@@ -29,6 +48,24 @@ typedef struct _SpectrumFileType {
 	string strSpectrumStatus;
 } SpectrumFileType;
 
+/// One command checked by a configuration apply transaction.
+typedef struct _CFG_APPLY_ITEM {
+	string strCmd;				/// 4 character command
+	int iScaIndex;				/// SCAI index for per-SCA commands, 0 otherwise
+	string strSent;				/// value sent
+	string strRead;				/// value read back, empty if not returned
+	bool bMatch;				/// normalized values match
+} CFG_APPLY_ITEM;
+
+/// Result of a configuration apply transaction.
+typedef struct _CFG_APPLY_RESULT {
+	bool bSent;					/// all configuration packets sent and acknowledged
+	unsigned char AckPID2;		/// last acknowledge PID2 (PID2_ACK_OK when accepted)
+	bool bReadBack;				/// verification readback received
+	int iMismatches;			/// commands not matching or not returned
+	vector<CFG_APPLY_ITEM> Items;	/// commands in first sent order
+} CFG_APPLY_RESULT;
+
 class CConsoleHelper
 {
 public:
@@ -85,10 +122,26 @@ public:
 	bool LibUsb_Connect_Specific_DPP(int Num_Device);
 	/// LibUsb close the current connection.
 	bool LibUsb_Close_Connection();
+	/// LibUsb sends the packet in DP5Proto.BufferOUT and records the transfer metrics.
+	int LibUsb_SendPacket(TRANSMIT_PACKET_TYPE XmtCmd);
+	/// Passes a processed DPP status to telemetry, metrics, rates, events, clock correlation and the journal.
+	void StatusReceived(long long llTxTimeNs, long long llRxTimeNs, bool bWithSpectrum);
+	/// Passes a processed Mini-X2 status to telemetry, metrics and events.
+	void StatusReceivedMX2(long long llRxTimeNs);
+	/// LibUsb requests diagnostic data if the USB is free, never waits for other transfers (polling thread or idle monitor).
+	DIAG_REQUEST_RESULT LibUsb_TryDiagnostics(DiagDataType *Diag, int *iDppType);
+	/// Starts the background diagnostics monitor.
+	bool StartDiagMonitor(long lPeriodMs);
 	/// LibUsb send a command that does not require additional processing.
 	bool LibUsb_SendCommand(TRANSMIT_PACKET_TYPE XmtCmd);
 	/// LibUsb send a command that requires configuration options processing.
 	bool LibUsb_SendCommand_Config(TRANSMIT_PACKET_TYPE XmtCmd, CONFIG_OPTIONS CfgOptions);
+	/// LibUsb sends a configuration, reads back only the commands sent and compares the values.
+	bool LibUsb_ApplyConfig(string strCfg, CFG_APPLY_RESULT *CfgResult, double dblTolerance);
+	/// LibUsb sends one configuration packet and parses the response without further processing.
+	long LibUsb_SendConfigPacket(TRANSMIT_PACKET_TYPE XmtCmd, string strCfg);
+	/// Compares a sent and read back configuration value (keywords shortened, numbers within tolerance).
+	bool CfgValuesMatch(string strSent, string strRead, double dblTolerance);
 	///  LibUsb receive data.
 	bool LibUsb_ReceiveData();
 
@@ -102,6 +155,32 @@ public:
 	CParsePacket ParsePkt;
 	/// DPP status processing.
 	CDP5Status DP5Stat;			
+	/// Status telemetry recorder.
+	CDppTelemetry Telemetry;
+	/// Count rates and dead time from consecutive statuses.
+	CDppCountRate CountRate;
+	/// Status change events (flag edges, state changes, thresholds).
+	CDppStatusEvents StatusEvents;
+	/// Device real time to host clock correlation.
+	CDppClockSync ClockSync;
+	/// Host monotonic time (ns) of the USB transfer that returned the last status.
+	long long StatusRxTimeNs;
+	/// DEVICE_ID of the last DPP status (-1 before one, or on a Mini-X2), read by the diagnostics requests.
+	atomic<int> StatusDeviceId;
+	/// USB transfer metrics by command type.
+	CDppTransportMetrics TransportMetrics;
+	/// Metrics endpoint for monitoring scrapes.
+	CDppMetricsExporter MetricsExporter;
+	/// Command of the last packet sent (response metrics).
+	TRANSMIT_PACKET_TYPE LastXmtCmd;
+	/// Background diagnostic data requests and supply/SRAM/PC5 history.
+	CDppDiagMonitor DiagMonitor;
+	/// Serializes USB transfers between the caller and the diagnostics requests.
+	mutex UsbLock;
+	/// Diagnostics monitor packet buffers (kept apart from DP5Proto).
+	unsigned char DiagBufferOUT[520];
+	unsigned char DiagPacketIn[MAX_BULK_IN_TRANSFER_SIZE];
+	Packet_In DiagPIN;
 	
 	// DPP packet processing functions.
 
@@ -214,6 +293,24 @@ public:
 	string strScopeGain;
 
     string CreateMCAData(long m_larDataBuffer[], SpectrumFileType sfInfo, DP4_FORMAT_STATUS cfgStatusLst);
+	/// Fills the .mca file description from the spectrum info and status.
+	void CreateMCAFileInfo(SpectrumFileType sfInfo, DP4_FORMAT_STATUS cfgStatusLst, MCA_FILE_INFO *McaInfo);
+	/// Writes a spectrum file with the streaming writer (queued in async mode).
+	bool SaveMCAFile(long m_larDataBuffer[], SpectrumFileType sfInfo, DP4_FORMAT_STATUS cfgStatusLst, string strFilename);
+	/// Streaming .mca file writer.
+	CDppMcaWriter McaWriter;
+	/// Binary spectrum archive, received spectra are appended while open.
+	CDppSpectrumArchive SpectrumArchive;
+	/// Time x channel store with summary levels, received spectra are added while started.
+	CDppSpectrumStore SpectrumStore;
+	/// Write-ahead journal, received spectra and status are journaled while open.
+	CDppJournal Journal;
+	/// Ring of the most recent spectra with window sum, delta and rate, filled while started.
+	CDppSpectrumHistory SpectrumHistory;
+	/// Min/max/sum levels of the last received spectrum for plotting.
+	CDppSpectrumPyramid SpectrumPyramid;
+	/// Gain matched sum of the detectors' spectra, received spectra are merged while started.
+	CDppSpectrumMerger SpectrumMerger;
 	/// Saves a spectrum data string to a default file (SpectrumData.mca).
 	void SaveSpectrumStringToFile(string strData, string strFilename);
     string CreateSpectrumConfig(string strRawCfgIn);
@@ -1,5 +1,25 @@
 #include "AsciiCmdUtilities.h"
 #include <iostream>
+#include <vector>
+#include <string.h>
+#include <sys/stat.h>
+#ifndef _WIN32
+	#include <fcntl.h>
+	#include <unistd.h>
+	#include <sys/mman.h>
+#endif
+
+// nanoseconds of a file's modification time, edits within the same second change the cache key
+static long ModifiedNs(const struct stat &stFile)
+{
+#if defined(_WIN32)
+	return 0;
+#elif defined(__APPLE__)
+	return (long)stFile.st_mtimespec.tv_nsec;
+#else
+	return (long)stFile.st_mtim.tv_nsec;
+#endif
+}
 
 CAsciiCmdUtilities::CAsciiCmdUtilities(void)
 {
@@ -42,136 +62,164 @@ string CAsciiCmdUtilities::RemWhitespace(string strLine)
 //read and format [DP5 Configuration File]
 string CAsciiCmdUtilities::GetDP5CfgStr(string strFilename)
 {
-	FILE *txtFile;
-	char chLine[LINE_MAX];
 	string strCfg;
-	string strLine;
-	long lPos;
-	char ch;
-	bool bCfgSection;
-	int iCmpCfg;
-	long lPosCfg;
-	stringex strfn;
-
-	bCfgSection = false;
-	iCmpCfg = 1;
-	if (( txtFile = fopen(strFilename.c_str(), "r")) == NULL) {  // Can't open input file
+	string strSca;
+
+	if (! LoadCfgFile(strFilename, &strCfg, &strSca)) {		// Can't open input file
 		return "";
 	}
-	strCfg = "";
-	while((fgets(chLine, LINE_MAX, txtFile)) != NULL) {
-		strLine = strfn.Format("%s",chLine);
-		lPosCfg = (long)strLine.find('[');				// find a section (-1=not found,0=section found,>0=undefined)
-		if (lPosCfg == 0) {								// Locate DP5 Configuration Section
-			iCmpCfg = (long)strLine.find("[DP5 Configuration File]");
-			if (iCmpCfg == 0) {							// Configuration Section Found
-				bCfgSection = true;
-			} else {									// Non-Configuration Section Found
-				bCfgSection = false;
-			}
+	return strCfg;
+}
+
+//read and format [DP5 SCA Configuration]
+string CAsciiCmdUtilities::GetDP5ScaStr(string strFilename)
+{
+	string strCfg;
+	string strSca;
+
+	if (! LoadCfgFile(strFilename, &strCfg, &strSca)) {		// Can't open input file
+		return "";
+	}
+	return strSca;
+}
+
+// reads [DP5 Configuration File], [DP5 CONFIGURATION] and [DP5 SCA Configuration] in one pass,
+// the parsed sections are reused until the file size or modification time changes
+bool CAsciiCmdUtilities::LoadCfgFile(string strFilename, string *strCfg, string *strSca)
+{
+	struct stat stFile;
+	map<string, CFG_FILE_CACHE>::iterator itCache;
+	CFG_FILE_CACHE CfgFile;
+	char *pData;
+
+	if (stat(strFilename.c_str(), &stFile) != 0) {		// Can't find input file
+		return false;
+	}
+	itCache = CfgFileCache.find(strFilename);
+	if ((itCache != CfgFileCache.end()) && (itCache->second.tModified == stFile.st_mtime)
+		&& (itCache->second.lModifiedNs == ModifiedNs(stFile)) && (itCache->second.lSize == (long long)stFile.st_size)) {
+		*strCfg = itCache->second.strCfg;
+		*strSca = itCache->second.strSca;
+		return true;
+	}
+	CfgFile.tModified = stFile.st_mtime;
+	CfgFile.lModifiedNs = ModifiedNs(stFile);
+	CfgFile.lSize = (long long)stFile.st_size;
+	if (stFile.st_size > 0) {
+#ifdef _WIN32
+		FILE *txtFile;
+		if ((txtFile = fopen(strFilename.c_str(), "rb")) == NULL) {
+			return false;
 		}
-		if (bCfgSection) {								// Save Configuration Section Only
-			strLine = MakeUpper(strLine);				// make all uppercase
-			lPos = (long)strLine.find(';');				// find the delimiter (-1=not found,0=commented line)
-			if (lPos > 0) {								// if has delimiter that is not first char
-				strLine = strLine.substr(0,lPos + 1);	// remove string right of delimiter
-				ch = strLine.at(0);					
-				if ((ch >= 'A') && (ch <= 'Z')) {		// if is valid value
-					strLine = RemWhitespace(strLine);	// remove whitespace in command sequence
-					if (strLine.length() > 1) {			// check if command w/delimiter left
-						strCfg += strLine;				// add to command string
-					}
-				}
-			}
+		pData = (char *)malloc((size_t)stFile.st_size);
+		if (pData == NULL) {
+			fclose(txtFile);
+			return false;
+		}
+		CfgFile.lSize = (long long)fread(pData, 1, (size_t)stFile.st_size, txtFile);
+		fclose(txtFile);
+		ParseCfgFileData(pData, (size_t)CfgFile.lSize, &CfgFile.strCfg, &CfgFile.strSca);
+		free(pData);
+#else
+		int fdFile;
+		if ((fdFile = open(strFilename.c_str(), O_RDONLY)) < 0) {
+			return false;
+		}
+		pData = (char *)mmap(NULL, (size_t)stFile.st_size, PROT_READ, MAP_PRIVATE, fdFile, 0);
+		close(fdFile);
+		if (pData == MAP_FAILED) {
+			return false;
 		}
-		strLine = "";
+		ParseCfgFileData(pData, (size_t)stFile.st_size, &CfgFile.strCfg, &CfgFile.strSca);
+		munmap(pData, (size_t)stFile.st_size);
+#endif
 	}
-	fclose(txtFile);
-	if (strCfg.length() > 0) {
-		return strCfg;
-	} else {
-		return "";
+	CfgFileCache[strFilename] = CfgFile;
+	*strCfg = CfgFile.strCfg;
+	*strSca = CfgFile.strSca;
+	return true;
+}
+
+void CAsciiCmdUtilities::ClearCfgFileCache()
+{
+	CfgFileCache.clear();
+}
+
+// case insensitive section header compare, pHeader must be upper case
+static bool IsCfgSection(const char *pLine, const char *pEnd, const char *pHeader)
+{
+	while (*pHeader != '\0') {
+		if ((pLine >= pEnd) || (toupper((unsigned char)*pLine) != *pHeader)) {
+			return false;
+		}
+		pLine++;
+		pHeader++;
 	}
+	return true;
 }
 
-//read and format [DP5 SCA Configuration]
-string CAsciiCmdUtilities::GetDP5ScaStr(string strFilename)
+void CAsciiCmdUtilities::ParseCfgFileData(const char *pData, size_t lSize, string *strCfg, string *strSca)
 {
-	FILE *txtFile;
-	char chLine[LINE_MAX];
-	string strCfg;
-	string strLine;
-	long lPos;
+	const char *pLine;
+	const char *pEnd;
+	const char *pDataEnd;
+	const char *pDelim;
+	const char *pCh;
 	char ch;
-	bool bCfgSection;
-	int iCmpCfg;
-	long lPosCfg;
-	stringex strfn;
 	char chScaOld;
 	char chSCA;
-	int iScaBytes;
-	string strScaIdx;
-	string strScaCmd = "";
+	enum { csNone, csConfig, csSca } CfgSection;
+	string strLine;
 
-	bCfgSection = false;
-	iCmpCfg = 1;
-	if (( txtFile = fopen(strFilename.c_str(), "r")) == NULL) {  // Can't open input file
-		return "";
-	}
+	CfgSection = csNone;
 	chScaOld = '0';
-	chSCA = '9';
-	strCfg = "";
-	while((fgets(chLine, LINE_MAX, txtFile)) != NULL) {
-		strLine = strfn.Format("%s",chLine);
-		lPosCfg = (long)strLine.find('[');				// find a section (-1=not found,0=section found,>0=undefined)
-		if (lPosCfg == 0) {								// Locate DP5 Configuration Section
-			iCmpCfg = (long)strLine.find("[DP5 SCA Configuration]");
-			if (iCmpCfg == 0) {							// Configuration Section Found
-				bCfgSection = true;
-			} else {									// Non-Configuration Section Found
-				bCfgSection = false;
+	strCfg->clear();
+	strSca->clear();
+	strLine.reserve(LINE_MAX);
+	pDataEnd = pData + lSize;
+	for (pLine = pData; pLine < pDataEnd; pLine = pEnd + 1) {
+		pEnd = (const char *)memchr(pLine, '\n', (size_t)(pDataEnd - pLine));
+		if (pEnd == NULL) pEnd = pDataEnd;
+		if (*pLine == '[') {								// Locate DP5 Configuration Sections
+			if (IsCfgSection(pLine, pEnd, "[DP5 CONFIGURATION FILE]") || IsCfgSection(pLine, pEnd, "[DP5 CONFIGURATION]")) {
+				CfgSection = csConfig;
+			} else if (IsCfgSection(pLine, pEnd, "[DP5 SCA CONFIGURATION]")) {
+				CfgSection = csSca;
+			} else {										// Non-Configuration Section Found
+				CfgSection = csNone;
 			}
+			continue;
 		}
-		if (bCfgSection) {								// Save Configuration Section Only
-			strLine = MakeUpper(strLine);				// make all uppercase
-			lPos = (long)strLine.find(';');				// find the delimiter (-1=not found,0=commented line)
-			if (lPos > 0) {								// if has delimiter that is not first char
-				strLine = strLine.substr(0,lPos + 1);	// remove string right of delimiter
-				ch = strLine.at(0);					
-				if ((ch >= 'A') && (ch <= 'Z')) {		// if is valid value
-					strLine = RemWhitespace(strLine);	// remove whitespace in command sequence
-					if (strLine.length() > 1) {			// check if command w/delimiter left
-						//strCfg += strLine;				// add to command string
-						//strcat(strCfg,chLine);				// add to command string
-						chSCA = strLine.at(4);				// determine SCA Index
-						// remove index from SCA Command to create DPP ASCII Command format
-						if ((chSCA > '0') && (chSCA < '9')) {
-							if (chSCA != chScaOld) {		// Is same as current index?
-								chScaOld = chSCA;			// if no, save current index
-								// insert index command into string (SCAI=%c;)
-								strScaIdx = strfn.Format("SCAI=%c;",chSCA);
-								strCfg += strScaIdx;				// add sca index command to string
-								strScaIdx = "";
-							}
-							strScaCmd = strLine.substr(0,4);
-							for (iScaBytes=5;iScaBytes<=lPos;iScaBytes++) {	
-								strScaCmd += strLine.at(iScaBytes);
-							}
-							strCfg += strScaCmd;				// add to command string
-						} else {	// no index to remove, cmd was saved with SCAI command
-							strCfg += strLine;					// add to command string
-						}
-					}
+		if (CfgSection == csNone) continue;
+		pDelim = (const char *)memchr(pLine, ';', (size_t)(pEnd - pLine));	// find the delimiter
+		if ((pDelim == NULL) || (pDelim == pLine)) continue;	// no delimiter or commented line
+		ch = (char)toupper((unsigned char)*pLine);
+		if ((ch < 'A') || (ch > 'Z')) continue;				// not a command
+		strLine.clear();
+		for (pCh = pLine; pCh <= pDelim; pCh++) {			// make uppercase, remove whitespace
+			if ((*pCh == '\0') || (strchr(Whitespace, *pCh) == NULL)) {
+				strLine += (char)toupper((unsigned char)*pCh);
+			}
+		}
+		if (strLine.length() <= 1) continue;				// check if command w/delimiter left
+		if (CfgSection == csConfig) {
+			*strCfg += strLine;
+		} else {
+			chSCA = (strLine.length() > 5) ? strLine[4] : '9';	// determine SCA Index
+			// remove index from SCA Command to create DPP ASCII Command format
+			if ((chSCA > '0') && (chSCA < '9')) {
+				if (chSCA != chScaOld) {					// insert index command (SCAI=%c;)
+					chScaOld = chSCA;
+					*strSca += "SCAI=";
+					*strSca += chSCA;
+					*strSca += ';';
 				}
+				strSca->append(strLine, 0, 4);
+				strSca->append(strLine, 5, string::npos);
+			} else {	// no index to remove, cmd was saved with SCAI command
+				*strSca += strLine;
 			}
 		}
-		strLine = "";
-	}
-	fclose(txtFile);
-	if (strCfg.length() > 0) {
-		return strCfg;
-	} else {
-		return "";
 	}
 }
 
@@ -371,69 +419,85 @@ string CAsciiCmdUtilities::RemoveCmd(string strCmd, string strCfgData)
 string CAsciiCmdUtilities::RemoveCmdByDeviceType(string strCfgDataIn, bool PC5_PRESENT, int DppType, bool isDP5_RevDxGains, unsigned char DPP_ECO)
 {
 	string strCfgData;
-    bool isHVSE;
-    bool isPAPS;
-    bool isTECS;
-    bool isVOLU;
-	bool isCON1;
-	bool isCON2;
-    bool isINOF;
-    bool isBOOT;
-	bool isGATE;
-	bool isPAPZ;
-	bool isSCTC;
-	bool isPREL;
-	bool isDP5_DxK=false;
-	bool isDP5_DxL=false;
 
-	strCfgData = strCfgDataIn;
+	strCfgData = FilterCmdsByMask(strCfgDataIn, GetDeviceCmdMask(PC5_PRESENT, DppType, isDP5_RevDxGains, DPP_ECO));
+	cout <<strCfgData << endl;
+	return strCfgData;
+}
+
+////removes selected command by dpp device type
+string CAsciiCmdUtilities::RemoveCmdByDeviceTypeDP5DxK(string strCfgDataIn, bool PC5_PRESENT, int DppType)
+{
+	// DP5 Rev Dx K,L needs PAPZ, MCA8000D uses the general device rules here
+	return FilterCmdsByMask(strCfgDataIn, CalcDeviceCmdMask(PC5_PRESENT, DppType, true));
+}
+
+////removes MCA8000D commands
+string CAsciiCmdUtilities::Remove_MCA8000D_Cmds(string strCfgDataIn, int DppType)
+{
 	if (DppType == dppMCA8000D) {
-		strCfgData = Remove_MCA8000D_Cmds(strCfgData,DppType);
-		return strCfgData;
+		return FilterCmdsByMask(strCfgDataIn, GetDeviceCmdMask(false, DppType, false, 0));
 	}
+	return strCfgDataIn;
+}
 
-	// DP5 Rev Dx K,L needs PAPZ
-	if ((DppType == dppDP5) && isDP5_RevDxGains) {
-		if ((DPP_ECO & 0x0F) == 0x0A) {
-			isDP5_DxK = true;
-		}
-		if ((DPP_ECO & 0x0F) == 0x0B) {
-			isDP5_DxL = true;
-		}
+// commands the MCA8000D does not accept
+static const DppCmdMask MCA8000D_IllegalCmds =
+	DPP_CMD_BIT(fcCLCK) | DPP_CMD_BIT(fcTPEA) | DPP_CMD_BIT(fcGAIF) | DPP_CMD_BIT(fcGAIN) |
+	DPP_CMD_BIT(fcRESL) | DPP_CMD_BIT(fcTFLA) | DPP_CMD_BIT(fcTPFA) | DPP_CMD_BIT(fcRTDE) |
+	DPP_CMD_BIT(fcAINP) | DPP_CMD_BIT(fcINOF) | DPP_CMD_BIT(fcCUSP) | DPP_CMD_BIT(fcTHFA) |
+	DPP_CMD_BIT(fcDACO) | DPP_CMD_BIT(fcDACF) | DPP_CMD_BIT(fcRTDS) | DPP_CMD_BIT(fcRTDT) |
+	DPP_CMD_BIT(fcBLRM) | DPP_CMD_BIT(fcBLRD) | DPP_CMD_BIT(fcBLRU) | DPP_CMD_BIT(fcPRET) |
+	DPP_CMD_BIT(fcHVSE) | DPP_CMD_BIT(fcTECS) | DPP_CMD_BIT(fcPAPZ) | DPP_CMD_BIT(fcPAPS) |
+	DPP_CMD_BIT(fcTPMO) | DPP_CMD_BIT(fcSCAH) | DPP_CMD_BIT(fcSCAI) | DPP_CMD_BIT(fcSCAL) |
+	DPP_CMD_BIT(fcSCAO) | DPP_CMD_BIT(fcSCAW) | DPP_CMD_BIT(fcBOOT) |
+	DPP_CMD_BIT(fcCON1) | DPP_CMD_BIT(fcCON2) |		// added to list late, recheck at later date 20120817
+	DPP_CMD_BIT(fcVOLU);							// not implemented as of 20120817, will be implemented at some time
+
+// names of the filterable commands, indexed by DPP_FILTER_CMD
+static const char FilterCmdNames[fcCOUNT][5] = {
+	"HVSE", "PAPS", "TECS", "VOLU", "CON1", "CON2", "INOF", "BOOT",
+	"GATE", "PAPZ", "SCTC", "PREL", "CLCK", "TPEA", "GAIF", "GAIN",
+	"RESL", "TFLA", "TPFA", "RTDE", "AINP", "CUSP", "THFA", "DACO",
+	"DACF", "RTDS", "RTDT", "BLRM", "BLRD", "BLRU", "PRET", "TPMO",
+	"SCAH", "SCAI", "SCAL", "SCAO", "SCAW", "GAIA"
+};
+
+// the legal command mask only depends on the device profile, calculate it once per profile
+DppCmdMask CAsciiCmdUtilities::GetDeviceCmdMask(bool PC5_PRESENT, int DppType, bool isDP5_RevDxGains, unsigned char DPP_ECO)
+{
+	unsigned long ulProfile;
+	DppCmdMask LegalCmds;
+	bool isDP5_DxPZ=false;
+	std::map<unsigned long, DppCmdMask>::iterator itMask;
+
+	ulProfile = (unsigned long)(DppType & 0xFF);
+	ulProfile |= (PC5_PRESENT ? 0x100UL : 0);
+	ulProfile |= (isDP5_RevDxGains ? 0x200UL : 0);
+	ulProfile |= ((unsigned long)DPP_ECO << 16);
+	itMask = CmdMaskCache.find(ulProfile);
+	if (itMask != CmdMaskCache.end()) {
+		return itMask->second;
 	}
 
-    isHVSE = (((DppType != dppPX5) && PC5_PRESENT) || DppType == dppPX5);
-    isPAPS = (DppType != dppDP5G) && (DppType != dppTB5);
-    isTECS = (((DppType == dppDP5) && PC5_PRESENT) || (DppType == dppPX5) || (DppType == dppDP5X));
-    isVOLU = (DppType == dppPX5);
-    isCON1 = ((DppType != dppDP5) && (DppType != dppDP5X));
-    isCON2 = ((DppType != dppDP5) && (DppType != dppDP5X));
-    isINOF = (DppType != dppDP5G) && (DppType != dppTB5);
-	isSCTC = (DppType == dppDP5G) || (DppType == dppTB5);
-    isBOOT = ((DppType == dppDP5) || (DppType == dppDP5X));
-	isGATE = ((DppType == dppDP5) || (DppType == dppDP5X));
-	isPAPZ = (DppType == dppPX5) || isDP5_DxK || isDP5_DxL;
-	isPREL = (DppType == dppMCA8000D);
-	if (!isHVSE) { strCfgData = RemoveCmd("HVSE", strCfgData); }  //High Voltage Bias
-	if (!isPAPS) { strCfgData = RemoveCmd("PAPS", strCfgData); }  //Preamp Voltage
-	if (!isTECS) { strCfgData = RemoveCmd("TECS", strCfgData); }  //Cooler Temperature
-	if (!isVOLU) { strCfgData = RemoveCmd("VOLU", strCfgData); }  //px5 speaker
-	if (!isCON1) { strCfgData = RemoveCmd("CON1", strCfgData); }  //connector 1
-	if (!isCON2) { strCfgData = RemoveCmd("CON2", strCfgData); }  //connector 2
-	if (!isINOF) { strCfgData = RemoveCmd("INOF", strCfgData); }  //input offset
-	if (!isBOOT) { strCfgData = RemoveCmd("BOOT", strCfgData); }  //PC5 On At StartUp
-	if (!isGATE) { strCfgData = RemoveCmd("GATE", strCfgData); }  //Gate input
-	if (!isPAPZ) { strCfgData = RemoveCmd("PAPZ", strCfgData); }  //Pole-Zero
-	if (!isSCTC) { strCfgData = RemoveCmd("SCTC", strCfgData); }  //Scintillator Time Constant
-	if (!isPREL) { strCfgData = RemoveCmd("PREL", strCfgData); }  //Preset Live Time
-	cout <<strCfgData << endl;
-	return strCfgData;
+	if (DppType == dppMCA8000D) {
+		LegalCmds = DPP_CMD_MASK_ALL & ~MCA8000D_IllegalCmds;
+	} else {
+		// DP5 Rev Dx K,L needs PAPZ
+		if ((DppType == dppDP5) && isDP5_RevDxGains) {
+			if (((DPP_ECO & 0x0F) == 0x0A) || ((DPP_ECO & 0x0F) == 0x0B)) {
+				isDP5_DxPZ = true;
+			}
+		}
+		LegalCmds = CalcDeviceCmdMask(PC5_PRESENT, DppType, isDP5_DxPZ);
+	}
+	CmdMaskCache[ulProfile] = LegalCmds;
+	return LegalCmds;
 }
 
-////removes selected command by dpp device type
-string CAsciiCmdUtilities::RemoveCmdByDeviceTypeDP5DxK(string strCfgDataIn, bool PC5_PRESENT, int DppType)
+DppCmdMask CAsciiCmdUtilities::CalcDeviceCmdMask(bool PC5_PRESENT, int DppType, bool isDP5_DxPZ)
 {
-	string strCfgData;
+	DppCmdMask LegalCmds;
     bool isHVSE;
     bool isPAPS;
     bool isTECS;
@@ -447,11 +511,6 @@ string CAsciiCmdUtilities::RemoveCmdByDeviceTypeDP5DxK(string strCfgDataIn, bool
 	bool isSCTC;
 	bool isPREL;
 
-	strCfgData = strCfgDataIn;
-	//if (DppType == dppMCA8000D) {
-	//	strCfgData = Remove_MCA8000D_Cmds(strCfgData,DppType);
-	//	return strCfgData;
-	//}
     isHVSE = (((DppType != dppPX5) && PC5_PRESENT) || DppType == dppPX5);
     isPAPS = (DppType != dppDP5G) && (DppType != dppTB5);
     isTECS = (((DppType == dppDP5) && PC5_PRESENT) || (DppType == dppPX5) || (DppType == dppDP5X));
@@ -462,98 +521,193 @@ string CAsciiCmdUtilities::RemoveCmdByDeviceTypeDP5DxK(string strCfgDataIn, bool
 	isSCTC = (DppType == dppDP5G) || (DppType == dppTB5);
     isBOOT = ((DppType == dppDP5) || (DppType == dppDP5X));
 	isGATE = ((DppType == dppDP5) || (DppType == dppDP5X));
-	//isPAPZ = (DppType == dppPX5);		// DP5 Rev Dx K,L needs PAPZ
-	isPAPZ = true;							// DP5 Rev Dx K,L needs PAPZ
+	isPAPZ = (DppType == dppPX5) || isDP5_DxPZ;
 	isPREL = (DppType == dppMCA8000D);
-	if (!isHVSE) { strCfgData = RemoveCmd("HVSE", strCfgData); }  //High Voltage Bias
-	if (!isPAPS) { strCfgData = RemoveCmd("PAPS", strCfgData); }  //Preamp Voltage
-	if (!isTECS) { strCfgData = RemoveCmd("TECS", strCfgData); }  //Cooler Temperature
-	if (!isVOLU) { strCfgData = RemoveCmd("VOLU", strCfgData); }  //px5 speaker
-	if (!isCON1) { strCfgData = RemoveCmd("CON1", strCfgData); }  //connector 1
-	if (!isCON2) { strCfgData = RemoveCmd("CON2", strCfgData); }  //connector 2
-	if (!isINOF) { strCfgData = RemoveCmd("INOF", strCfgData); }  //input offset
-	if (!isBOOT) { strCfgData = RemoveCmd("BOOT", strCfgData); }  //PC5 On At StartUp
-	if (!isGATE) { strCfgData = RemoveCmd("GATE", strCfgData); }  //Gate input
-	if (!isPAPZ) { strCfgData = RemoveCmd("PAPZ", strCfgData); }  //Pole-Zero
-	if (!isSCTC) { strCfgData = RemoveCmd("SCTC", strCfgData); }  //Scintillator Time Constant
-	if (!isPREL) { strCfgData = RemoveCmd("PREL", strCfgData); }  //Preset Live Time
-	return strCfgData;
+
+	LegalCmds = DPP_CMD_MASK_ALL;
+	if (!isHVSE) { LegalCmds &= ~DPP_CMD_BIT(fcHVSE); }  //High Voltage Bias
+	if (!isPAPS) { LegalCmds &= ~DPP_CMD_BIT(fcPAPS); }  //Preamp Voltage
+	if (!isTECS) { LegalCmds &= ~DPP_CMD_BIT(fcTECS); }  //Cooler Temperature
+	if (!isVOLU) { LegalCmds &= ~DPP_CMD_BIT(fcVOLU); }  //px5 speaker
+	if (!isCON1) { LegalCmds &= ~DPP_CMD_BIT(fcCON1); }  //connector 1
+	if (!isCON2) { LegalCmds &= ~DPP_CMD_BIT(fcCON2); }  //connector 2
+	if (!isINOF) { LegalCmds &= ~DPP_CMD_BIT(fcINOF); }  //input offset
+	if (!isBOOT) { LegalCmds &= ~DPP_CMD_BIT(fcBOOT); }  //PC5 On At StartUp
+	if (!isGATE) { LegalCmds &= ~DPP_CMD_BIT(fcGATE); }  //Gate input
+	if (!isPAPZ) { LegalCmds &= ~DPP_CMD_BIT(fcPAPZ); }  //Pole-Zero
+	if (!isSCTC) { LegalCmds &= ~DPP_CMD_BIT(fcSCTC); }  //Scintillator Time Constant
+	if (!isPREL) { LegalCmds &= ~DPP_CMD_BIT(fcPREL); }  //Preset Live Time
+	return LegalCmds;
 }
 
-////removes MCA8000D commands
-string CAsciiCmdUtilities::Remove_MCA8000D_Cmds(string strCfgDataIn, int DppType)
+// walks the ';' delimited command stream once, copying only the legal commands
+string CAsciiCmdUtilities::FilterCmdsByMask(string strCfgDataIn, DppCmdMask LegalCmds)
 {
 	string strCfgData;
-	
-	strCfgData = strCfgDataIn;
-	if (DppType == dppMCA8000D) {
-		strCfgData = RemoveCmd("CLCK", strCfgData);
-		strCfgData = RemoveCmd("TPEA", strCfgData);
-		strCfgData = RemoveCmd("GAIF", strCfgData);
-		strCfgData = RemoveCmd("GAIN", strCfgData);
-		strCfgData = RemoveCmd("RESL", strCfgData);
-		strCfgData = RemoveCmd("TFLA", strCfgData);
-		strCfgData = RemoveCmd("TPFA", strCfgData);
-		//strCfgData = RemoveCmd("PURE", strCfgData);
-		strCfgData = RemoveCmd("RTDE", strCfgData);
-		strCfgData = RemoveCmd("AINP", strCfgData);
-		strCfgData = RemoveCmd("INOF", strCfgData);
-		strCfgData = RemoveCmd("CUSP", strCfgData);
-		strCfgData = RemoveCmd("THFA", strCfgData);
-		strCfgData = RemoveCmd("DACO", strCfgData);
-		strCfgData = RemoveCmd("DACF", strCfgData);
-		strCfgData = RemoveCmd("RTDS", strCfgData);
-		strCfgData = RemoveCmd("RTDT", strCfgData);
-		strCfgData = RemoveCmd("BLRM", strCfgData);
-		strCfgData = RemoveCmd("BLRD", strCfgData);
-		strCfgData = RemoveCmd("BLRU", strCfgData);
-		strCfgData = RemoveCmd("PRET", strCfgData);
-		strCfgData = RemoveCmd("HVSE", strCfgData);
-		strCfgData = RemoveCmd("TECS", strCfgData);
-		strCfgData = RemoveCmd("PAPZ", strCfgData);
-		strCfgData = RemoveCmd("PAPS", strCfgData);
-		strCfgData = RemoveCmd("TPMO", strCfgData);
-		strCfgData = RemoveCmd("SCAH", strCfgData);
-		strCfgData = RemoveCmd("SCAI", strCfgData);
-		strCfgData = RemoveCmd("SCAL", strCfgData);
-		strCfgData = RemoveCmd("SCAO", strCfgData);
-		strCfgData = RemoveCmd("SCAW", strCfgData);
-		strCfgData = RemoveCmd("BOOT", strCfgData);
-
-		// added to list late, recheck at later date 20120817
-		strCfgData = RemoveCmd("CON1", strCfgData);
-		strCfgData = RemoveCmd("CON2", strCfgData);
-
-		// not implemented as of 20120817, will be implemented at some time
-		strCfgData = RemoveCmd("VOLU", strCfgData);	 
+	size_t idxStart;
+	size_t idxEnd;
+	int idxCmd;
+
+	if (LegalCmds == DPP_CMD_MASK_ALL) { return strCfgDataIn; }	// nothing to remove
+	strCfgData.reserve(strCfgDataIn.length());
+	idxStart = 0;
+	while (idxStart < strCfgDataIn.length()) {
+		idxEnd = strCfgDataIn.find(';', idxStart);
+		if (idxEnd == std::string::npos) {			// no delimiter, keep the remainder
+			strCfgData.append(strCfgDataIn, idxStart, std::string::npos);
+			break;
+		}
+		idxCmd = -1;
+		if (((idxEnd - idxStart) > 4) && (strCfgDataIn[idxStart + 4] == '=')) {
+			idxCmd = GetFilterCmdIndex(strCfgDataIn.c_str() + idxStart);
+		}
+		if ((idxCmd < 0) || ((LegalCmds & DPP_CMD_BIT(idxCmd)) != 0)) {
+			strCfgData.append(strCfgDataIn, idxStart, idxEnd - idxStart + 1);
+		}
+		idxStart = idxEnd + 1;
 	}
 	return strCfgData;
 }
 
+int CAsciiCmdUtilities::GetFilterCmdIndex(const char *pCmd)
+{
+	int idxCmd;
+
+	for (idxCmd=0;idxCmd<fcCOUNT;idxCmd++) {
+		if ((pCmd[0] == FilterCmdNames[idxCmd][0]) && (pCmd[1] == FilterCmdNames[idxCmd][1]) &&
+			(pCmd[2] == FilterCmdNames[idxCmd][2]) && (pCmd[3] == FilterCmdNames[idxCmd][3])) {
+			return idxCmd;
+		}
+	}
+	return -1;
+}
+
 // replaces all occurrences of substring in string
 std::string CAsciiCmdUtilities::ReplaceCmdText(std::string strInTextIn, std::string strFrom, std::string strTo)
 {
-	std::string strReplaceText;
-	std::string strInText; 
 	std::string strOutText; 
-	int lFromLen; 
-	int lMatchPos; 
-
-	strInText = strInTextIn;
-	strOutText = "";
-	lFromLen = (int)strFrom.length();
-	while (strInText.length()>0) {
-		lMatchPos = (1+(int)strInText.find(strFrom));
-		if (lMatchPos==0) {
-			strOutText = strOutText+strInText;
-			strInText = "";
+	size_t lFromLen; 
+	size_t lStart; 
+	size_t lMatchPos; 
+
+	lFromLen = strFrom.length();
+	if (lFromLen == 0) {
+		return strInTextIn;
+	}
+	strOutText.reserve(strInTextIn.length());
+	lStart = 0;
+	while ((lMatchPos = strInTextIn.find(strFrom, lStart)) != std::string::npos) {
+		strOutText.append(strInTextIn, lStart, lMatchPos - lStart);
+		strOutText += strTo;
+		lStart = lMatchPos + lFromLen;
+	}
+	strOutText.append(strInTextIn, lStart, std::string::npos);
+	return strOutText;
+}
+
+// A rule ending in the only ';' of its text can only match at the end of a command, so
+// the commands are scanned once and the rules are applied to a command's end in table
+// order, each on the result of the previous one. This gives the same text as one
+// ReplaceCmdText call per rule (e.g. OFFUS; -> OFF; -> OF;) in a single pass, unchanged
+// commands are copied in runs. Other rules fall back to ReplaceCmdText per rule.
+std::string CAsciiCmdUtilities::RewriteCmdText(std::string strInText, const CFG_REWRITE_RULE Rules[], int iNumRules)
+{
+	std::vector<char> vOut;
+	std::vector<size_t> vFromLen(iNumRules > 0 ? iNumRules : 1);
+	std::vector<size_t> vToLen(iNumRules > 0 ? iNumRules : 1);
+	bool bLastChar[256];			// character before the ';' of some rule
+	bool bMatchAll;					// a ";" rule, every command is a candidate
+	const char *pText;
+	const char *pEnd;
+	const char *pFrom;
+	char *pOut;
+	size_t lTextLen;
+	size_t lPos;
+	size_t lCopied;
+	size_t lCmdLen;
+	size_t lGrowth;
+	size_t lCmds;
+	int idxRule;
+	int iFirstRule;
+
+	memset(bLastChar, 0, sizeof(bLastChar));
+	bMatchAll = false;
+	lGrowth = 0;
+	for (idxRule=0;idxRule<iNumRules;idxRule++) {
+		pFrom = Rules[idxRule].strFrom;
+		vFromLen[idxRule] = strlen(pFrom);
+		vToLen[idxRule] = strlen(Rules[idxRule].strTo);
+		if ((vFromLen[idxRule] == 0) || (strchr(pFrom, ';') != pFrom + vFromLen[idxRule] - 1)) {
+			for (idxRule=0;idxRule<iNumRules;idxRule++) {
+				strInText = ReplaceCmdText(strInText, Rules[idxRule].strFrom, Rules[idxRule].strTo);
+			}
+			return strInText;
+		}
+		if (vFromLen[idxRule] == 1) {
+			bMatchAll = true;
 		} else {
-			strOutText = strOutText+strInText.substr(0,lMatchPos-1)+strTo;
-			strInText = std::string(strInText).substr(lMatchPos+lFromLen-1);
+			bLastChar[(unsigned char)pFrom[vFromLen[idxRule] - 2]] = true;
+		}
+		if (vToLen[idxRule] > vFromLen[idxRule]) {
+			lGrowth += vToLen[idxRule] - vFromLen[idxRule];
+		}
+	}
+	pText = strInText.c_str();
+	lTextLen = strInText.length();
+	// output bound: every command may grow by every lengthening rule
+	lCmds = 0;
+	if (lGrowth > 0) {
+		for (lPos=0;lPos<lTextLen;lPos++) {
+			lCmds += (pText[lPos] == ';');
+		}
+	}
+	vOut.resize(lTextLen + lCmds * lGrowth + 1);
+	pOut = &vOut[0];
+	lPos = 0;
+	lCopied = 0;
+	while ((pEnd = (const char *)memchr(pText + lPos, ';', lTextLen - lPos)) != NULL) {
+		lCmdLen = (pEnd - pText) + 1 - lPos;
+		lPos += lCmdLen;
+		if (! bMatchAll && ((lCmdLen < 2) || ! bLastChar[(unsigned char)pEnd[-1]])) {
+			continue;
+		}
+		// first rule matching the command as read, none: the command stays as it is
+		for (iFirstRule=0;iFirstRule<iNumRules;iFirstRule++) {
+			if ((vFromLen[iFirstRule] <= lCmdLen) && (memcmp(pEnd + 1 - vFromLen[iFirstRule], Rules[iFirstRule].strFrom, vFromLen[iFirstRule]) == 0)) {
+				break;
+			}
+		}
+		if (iFirstRule == iNumRules) {
+			continue;
+		}
+		memcpy(pOut, pText + lCopied, lPos - lCopied);
+		pOut += lPos - lCopied;
+		lCopied = lPos;
+		for (idxRule=iFirstRule;idxRule<iNumRules;idxRule++) {
+			if ((vFromLen[idxRule] <= lCmdLen) && (memcmp(pOut - vFromLen[idxRule], Rules[idxRule].strFrom, vFromLen[idxRule]) == 0)) {
+				pOut -= vFromLen[idxRule];
+				memcpy(pOut, Rules[idxRule].strTo, vToLen[idxRule]);
+				pOut += vToLen[idxRule];
+				lCmdLen = lCmdLen - vFromLen[idxRule] + vToLen[idxRule];
+			}
 		}
 	}
-	strReplaceText = strOutText;
-	return strReplaceText;
+	memcpy(pOut, pText + lCopied, lTextLen - lCopied);
+	pOut += lTextLen - lCopied;
+	return std::string(&vOut[0], pOut - &vOut[0]);
+}
+
+// value shortening rules, applied in a single pass
+static const CFG_REWRITE_RULE ShortenCfgRules[] = {
+	{ "US;", ";" },
+	{ "OFF;", "OF;" },
+	{ "RISING;", "RI;" },
+	{ "FALLING;", "FA;" }
+};
+
+std::string CAsciiCmdUtilities::ShortenCmdValues(std::string strCfg)
+{
+	return RewriteCmdText(strCfg, ShortenCfgRules, (int)(sizeof(ShortenCfgRules) / sizeof(ShortenCfgRules[0])));
 }
 
 // breaks ASCII Command string into two chuncks, returns split position
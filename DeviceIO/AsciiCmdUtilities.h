@@ -4,6 +4,8 @@
 #include <math.h>
 #include <string>
 #include <cctype> // std::toupper, std::tolower
+#include <map>
+#include <time.h>
 using namespace std; 
 #include "stringex.h"
 #include "DppConst.h"
@@ -15,6 +17,39 @@ using namespace std;
 #define DP5_MAX_CFG_SIZE 512		/// 512 + 8 Bytes (2 SYNC,2 PID,2 LEN,2 CHKSUM)
 #define Whitespace "\t\n\v\f\r\0x20"	/// $ = Chr$(0) + Chr$(9) + Chr$(10) + Chr$(11) + Chr$(12) + Chr$(13) + Chr$(32)
 
+/// Commands that may be filtered from a configuration by device type, one bit each in a DppCmdMask.
+typedef enum _DPP_FILTER_CMD
+{
+	fcHVSE, fcPAPS, fcTECS, fcVOLU, fcCON1, fcCON2, fcINOF, fcBOOT,
+	fcGATE, fcPAPZ, fcSCTC, fcPREL, fcCLCK, fcTPEA, fcGAIF, fcGAIN,
+	fcRESL, fcTFLA, fcTPFA, fcRTDE, fcAINP, fcCUSP, fcTHFA, fcDACO,
+	fcDACF, fcRTDS, fcRTDT, fcBLRM, fcBLRD, fcBLRU, fcPRET, fcTPMO,
+	fcSCAH, fcSCAI, fcSCAL, fcSCAO, fcSCAW, fcGAIA,
+	fcCOUNT
+} DPP_FILTER_CMD;
+
+/// Legal command bitmask, bit n set when DPP_FILTER_CMD n may be sent to the device.
+typedef unsigned long long DppCmdMask;
+#define DPP_CMD_BIT(fcCmd) ((DppCmdMask)1 << (fcCmd))
+#define DPP_CMD_MASK_ALL (~(DppCmdMask)0)
+
+/// Parsed configuration file sections, cached by path and modification time.
+typedef struct _CFG_FILE_CACHE
+{
+	time_t tModified;			/// file modification time when parsed
+	long lModifiedNs;			/// nanoseconds of the modification time (0 where not available)
+	long long lSize;			/// file size when parsed
+	std::string strCfg;			/// configuration section commands
+	std::string strSca;			/// sca section commands
+} CFG_FILE_CACHE;
+
+/// Text rewrite rule, every occurrence of strFrom is replaced by strTo (single pass when strFrom ends with its only ';').
+typedef struct _CFG_REWRITE_RULE
+{
+	const char *strFrom;		/// text to find
+	const char *strTo;			/// replacement text
+} CFG_REWRITE_RULE;
+
 class CAsciiCmdUtilities
 {
 public:
@@ -28,6 +63,10 @@ public:
 	std::string GetDP5CfgStr(std::string strFilename);
 	/// Reads a SCA configuration from a file.
 	std::string GetDP5ScaStr(std::string strFilename);
+	/// Reads the configuration and SCA sections of a file in one pass (memory mapped, cached by path and mtime).
+	bool LoadCfgFile(std::string strFilename, std::string *strCfg, std::string *strSca);
+	/// Discards all cached configuration files.
+	void ClearCfgFileCache();
 	std::string CreateResTestReadBackCmd(bool bSendCoarseFineGain, int DppType);
 	/// Generates a configuration readback command from a list of all commands.
 	std::string CreateFullReadBackCmd(bool PC5_PRESENT, int DppType, bool isDP5_RevDxGains, unsigned char DPP_ECO);
@@ -41,10 +80,30 @@ public:
 	std::string RemoveCmdByDeviceTypeDP5DxK(std::string strCfgDataIn, bool PC5_PRESENT, int DppType);
 	////removes MCA8000D commands
 	std::string Remove_MCA8000D_Cmds(std::string strCfgDataIn, int DppType);
+	/// Returns the legal command mask for a device profile (cached per profile).
+	DppCmdMask GetDeviceCmdMask(bool PC5_PRESENT, int DppType, bool isDP5_RevDxGains, unsigned char DPP_ECO);
+	/// Removes every command not set in LegalCmds from the command stream in a single pass.
+	std::string FilterCmdsByMask(std::string strCfgDataIn, DppCmdMask LegalCmds);
+	/// Returns the DPP_FILTER_CMD index of a 4 character command, -1 if the command is never filtered.
+	int GetFilterCmdIndex(const char *pCmd);
 	// replaces all occurrences of substring in string
 	std::string ReplaceCmdText(std::string strInTextIn, std::string strFrom, std::string strTo);
+	/// Applies rewrite rules in table order, each to the result of the previous (one pass for command suffix rules).
+	std::string RewriteCmdText(std::string strInText, const CFG_REWRITE_RULE Rules[], int iNumRules);
+	/// Shortens command values (OFF,RISING,FALLING,US units) so long configurations fit in fewer packets.
+	std::string ShortenCmdValues(std::string strCfg);
 	// breaks ASCII Command string into two chuncks, returns split position
 	int GetCmdChunk(std::string strCmd);
 	/// Force string to ASCII bytes.
 	bool CopyAsciiData(unsigned char Data[], string strCfg, long lLen);
+
+private:
+	/// Calculates the legal command mask for a device profile.
+	DppCmdMask CalcDeviceCmdMask(bool PC5_PRESENT, int DppType, bool isDP5_DxPZ);
+	/// Legal command masks already calculated, keyed by packed device profile.
+	std::map<unsigned long, DppCmdMask> CmdMaskCache;
+	/// Parses configuration file data into configuration and SCA command strings.
+	void ParseCfgFileData(const char *pData, size_t lSize, std::string *strCfg, std::string *strSca);
+	/// Configuration files already parsed, keyed by path.
+	std::map<std::string, CFG_FILE_CACHE> CfgFileCache;
 };
@@ -318,6 +318,8 @@ typedef struct _Packet_In {
     unsigned char STATUS;
     unsigned char DATA[32768];
     long CheckSum;
+    long long TxTimeNs;   // host monotonic time when the request was sent (ns)
+    long long RxTimeNs;   // host monotonic time at USB completion (ns)
 } Packet_In;
 
 struct Packet_Out {
@@ -335,6 +337,8 @@ struct Packet_Out {
 struct Spec {
 	long DATA[MAX_BUFFER_DATA];   // this keeps total of static data under 64K VB limit
 	short CHANNELS;
+	long long RxTimeNs;           // host monotonic time at USB completion (ns)
+	unsigned long long PREFIX[MAX_BUFFER_DATA + 1];   // PREFIX[i] = sum of DATA[0..i-1], for ROI counts
 };
 
 class CDP5Protocol
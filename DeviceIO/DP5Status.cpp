@@ -2,6 +2,8 @@
 #include "DP5Status.h"
 #include "stringex.h"
 #include "DppConst.h"
+#include "DppTrace.h"
+#include "DppStatusDecoder.h"
 #include <time.h>
 #include <cstring>
 #ifdef _MSC_VER
@@ -37,6 +39,7 @@ string CDP5Status::MX2TubeTypeEnumToString(MX2TubeTypeEnum mx2ttTubeType)
 
 void CDP5Status::Process_MNX_Status(Stat_MNX *STATUS_MNX)
 {
+	DPP_TRACE_SPAN("status_decode_mx2");
 		 //called by ParsePacket
     float sngTemp=0.0;
     
@@ -763,137 +766,13 @@ void CDP5Status::Create70kV10W_WarmUpTable(MiniX2WarmUpTable *WarmUpTable)
 
 void CDP5Status::Process_Status(DP4_FORMAT_STATUS *m_DP5_Status)
 {
-	bool bDMCA_LiveTime = false;
-	unsigned int uiFwBuild = 0;
-
-	m_DP5_Status->DEVICE_ID = m_DP5_Status->RAW[39];
-    m_DP5_Status->FastCount = DppUtil.LongWordToDouble(0, m_DP5_Status->RAW);
-    m_DP5_Status->SlowCount = DppUtil.LongWordToDouble(4, m_DP5_Status->RAW);
-    m_DP5_Status->GP_COUNTER = DppUtil.LongWordToDouble(8, m_DP5_Status->RAW);
-    m_DP5_Status->AccumulationTime = (float)m_DP5_Status->RAW[12] * 0.001 + (float)(m_DP5_Status->RAW[13] + (float)m_DP5_Status->RAW[14] * 256.0 + (float)m_DP5_Status->RAW[15] * 65536.0) * 0.1;
-	m_DP5_Status->RealTime = ((double)m_DP5_Status->RAW[20] + ((double)m_DP5_Status->RAW[21] * 256.0) + ((double)m_DP5_Status->RAW[22] * 65536.0) + ((double)m_DP5_Status->RAW[23] * 16777216.0)) * 0.001;
-
-	m_DP5_Status->Firmware = m_DP5_Status->RAW[24];
-    m_DP5_Status->FPGA = m_DP5_Status->RAW[25];
-	
-	if (m_DP5_Status->Firmware > 0x65) {
-		m_DP5_Status->Build = m_DP5_Status->RAW[37] & 0xF;		//Build # added in FW6.06
-	} else {
-		m_DP5_Status->Build = 0;
-	}
-
-	//Firmware Version:  6.07  Build:  0 has LiveTime and PREL
-	//DEVICE_ID 0=DP5,1=PX5,2=DP5G,3=MCA8000D,4=TB5
-	if (m_DP5_Status->DEVICE_ID == dppMCA8000D) {
-		if (m_DP5_Status->Firmware >= 0x67) {
-			bDMCA_LiveTime = true;
-		}
-	}
-
-	if (bDMCA_LiveTime) {
-		m_DP5_Status->LiveTime = ((double)m_DP5_Status->RAW[16] + ((double)m_DP5_Status->RAW[17] * 256.0) + ((double)m_DP5_Status->RAW[18] * 65536.0) + ((double)m_DP5_Status->RAW[19] * 16777216.0)) * 0.001;
-	} else {
-		m_DP5_Status->LiveTime = 0;
-	}
-
-    if (m_DP5_Status->RAW[29] < 128) {
-        m_DP5_Status->SerialNumber = (unsigned long)DppUtil.LongWordToDouble(26, m_DP5_Status->RAW);
-    } else {
-        m_DP5_Status->SerialNumber = -1;
-    }
-    
-	// m_DP5_Status->HV = (double)(m_DP5_Status->RAW[31] + (m_DP5_Status->RAW[30] & 15) * 256) * 0.5;					// 0.5V/count
-
-	if (m_DP5_Status->RAW[30] < 128)  {    // not negative
-        m_DP5_Status->HV = ((double)m_DP5_Status->RAW[31] + ((double)m_DP5_Status->RAW[30] * 256.0)) * 0.5;  // 0.5V/count
-	} else {
-		m_DP5_Status->HV = (((double)m_DP5_Status->RAW[31] + ((double)m_DP5_Status->RAW[30] * 256)) - 65536.0) * 0.5; // 0.5V/count
-	}
-      
-	m_DP5_Status->DET_TEMP = (double)((m_DP5_Status->RAW[33]) + (m_DP5_Status->RAW[32] & 15) * 256) * 0.1; // - 273.16;		// 0.1K/count
-    m_DP5_Status->DP5_TEMP = m_DP5_Status->RAW[34] - ((m_DP5_Status->RAW[34] & 128) * 2);
-
-    m_DP5_Status->PresetRtDone = ((m_DP5_Status->RAW[35] & 128) == 128);
-
-	//unsigned char:35 BIT:D6 
-	// == Preset LiveTime Done for MCA8000D
-	// == FAST Thresh locked for other dpp devices
-	m_DP5_Status->PresetLtDone = false;
-	m_DP5_Status->AFAST_LOCKED = false;
-	if (bDMCA_LiveTime) {		// test for MCA8000D
-		m_DP5_Status->PresetLtDone = ((m_DP5_Status->RAW[35] & 64) == 64);
-	} else {
-		m_DP5_Status->AFAST_LOCKED = ((m_DP5_Status->RAW[35] & 64) == 64);
-	}
-    m_DP5_Status->MCA_EN = ((m_DP5_Status->RAW[35] & 32) == 32);
-    m_DP5_Status->PRECNT_REACHED = ((m_DP5_Status->RAW[35] & 16) == 16);
-    m_DP5_Status->SCOPE_DR = ((m_DP5_Status->RAW[35] & 4) == 4);
-    m_DP5_Status->DP5_CONFIGURED = ((m_DP5_Status->RAW[35] & 2) == 2);
+	DPP_TRACE_SPAN("status_decode");
+	CDppStatusDecoder StatusDecoder;
+	DPP_STATUS_DECODED StatusDecoded;
 
-    m_DP5_Status->AOFFSET_LOCKED = ((m_DP5_Status->RAW[36] & 128) == 0);  // 0=locked, 1=searching
-    m_DP5_Status->MCS_DONE = ((m_DP5_Status->RAW[36] & 64) == 64);
-
-    m_DP5_Status->b80MHzMode = ((m_DP5_Status->RAW[36] & 2) == 2);
-    m_DP5_Status->bFPGAAutoClock = ((m_DP5_Status->RAW[36] & 1) == 1);
-
-    m_DP5_Status->PC5_PRESENT = ((m_DP5_Status->RAW[38] & 128) == 128);
-    if  (m_DP5_Status->PC5_PRESENT) {
-        m_DP5_Status->PC5_HV_POL = ((m_DP5_Status->RAW[38] & 64) == 64);
-        m_DP5_Status->PC5_8_5V = ((m_DP5_Status->RAW[38] & 32) == 32);
-    } else {
-        m_DP5_Status->PC5_HV_POL = false;
-        m_DP5_Status->PC5_8_5V = false;
-    }
-
-	if (m_DP5_Status->Firmware >= 0x65) {		// reboot flag added FW6.05
-		if ((m_DP5_Status->RAW[36] & 32) == 32) {
-            m_DP5_Status->ReBootFlag = true;
-		} else {
-			m_DP5_Status->ReBootFlag = false;
-		}
-	} else {
-        m_DP5_Status->ReBootFlag = false;
-	}
-
-	m_DP5_Status->TEC_Voltage = (((double)(m_DP5_Status->RAW[40] & 15) * 256.0) + (double)(m_DP5_Status->RAW[41])) / 758.5;
-	m_DP5_Status->DPP_ECO = m_DP5_Status->RAW[49];
-	m_DP5_Status->bScintHas80MHzOption = false;
-	m_DP5_Status->DPP_options = (m_DP5_Status->RAW[42] & 15);
-	m_DP5_Status->HPGe_HV_INH = false;
-	m_DP5_Status->HPGe_HV_INH_POL = false;
-	m_DP5_Status->AU34_2 = false;
-	m_DP5_Status->isAscInstalled = false;
-	m_DP5_Status->isDP5_RevDxGains = false;
-	if (m_DP5_Status->DEVICE_ID == dppPX5) {
-		if (m_DP5_Status->DPP_options == PX5_OPTION_HPGe_HVPS) {
-			m_DP5_Status->HPGe_HV_INH = ((m_DP5_Status->RAW[42] & 32) == 32);
-			m_DP5_Status->HPGe_HV_INH_POL = ((m_DP5_Status->RAW[42] & 16) == 16);
-			if (m_DP5_Status->DPP_ECO == 1) {
-				m_DP5_Status->isAscInstalled = true;
-				m_DP5_Status->AU34_2 = ((m_DP5_Status->RAW[42] & 64) == 64);
-			}
-		}
-	} else if ((m_DP5_Status->DEVICE_ID == dppDP5G) || (m_DP5_Status->DEVICE_ID == dppTB5)) {
-		if ((m_DP5_Status->DPP_ECO == 1) || (m_DP5_Status->DPP_ECO == 2)) {
-			// DPP_ECO == 2 80MHz option added 20150409
-			m_DP5_Status->bScintHas80MHzOption = true;
-		}
-	} else if (m_DP5_Status->DEVICE_ID == dppDP5) {
-		uiFwBuild = m_DP5_Status->Firmware;
-		uiFwBuild = uiFwBuild << 8;
-		uiFwBuild = uiFwBuild + m_DP5_Status->Build;
-		// uiFwBuild - firmware with build for comparison
-		if (uiFwBuild >= 0x686) {
-			// 0xFF Value indicates old Analog Gain Count of 16
-			// Values < 0xFF indicate new gain count of 24 and new board rev
-			// "DP5 G3 Configuration P" will not be used (==0xFF)
-			if (m_DP5_Status->DPP_ECO < 0xFF) {		
-				m_DP5_Status->isDP5_RevDxGains = true;
-			}
-			
-		}
-
-	}
+	// field offsets, scales, firmware and device gates are in the CDppStatusDecoder field table
+	StatusDecoder.DecodeStatus(m_DP5_Status->RAW, &StatusDecoded);
+	StatusDecoder.ToDP4Status(&StatusDecoded, m_DP5_Status);
 }
 
 string CDP5Status::DP5_Dx_OptionFlags(unsigned char DP5_Dx_Options) {
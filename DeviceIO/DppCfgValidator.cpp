@@ -0,0 +1,353 @@
+#include "DppCfgValidator.h"
+#include <stdlib.h>
+#include <string.h>
+#include <iostream>
+#ifdef _WIN32
+	#include <io.h>
+#else
+	#include <dirent.h>
+#endif
+#include "stringex.h"
+
+// Host-side command table (DP5 Programmer's Guide command list).
+// Numeric limits are sanity bounds wide enough for every supported device,
+// device-specific limits are listed in CfgRangeOverride. They are not taken from
+// the firmware, so values outside them are reported as warnings only.
+static const CFG_CMD_INFO CfgCmdInfo[] = {
+	{ "RESC", cvtEnum,	"Y|YES",					0, 0 },
+	{ "CLCK", cvtEnum,	"AUTO|20|80",				0, 0 },
+	{ "TPEA", cvtFloat,	"",							0.05, 102.4 },
+	{ "GAIF", cvtFloat,	"",							0.75, 1.25 },
+	{ "GAIN", cvtFloat,	"",							0.75, 500 },
+	{ "RESL", cvtFloat,	"OFF",						0, 6553.5 },
+	{ "TFLA", cvtFloat,	"",							0, 51.2 },
+	{ "TPFA", cvtEnum,	"50|100|200|400|800|1600|3200",	0, 0 },
+	{ "PURE", cvtFloat,	"ON|OFF|MAX",				0, 25600 },
+	{ "PURS", cvtFloat,	"",							0, 25600 },
+	{ "SCTC", cvtAny,	"",							0, 0 },
+	{ "RTDE", cvtEnum,	"ON|OFF",					0, 0 },
+	{ "MCAS", cvtEnum,	"NORM|MCS|FAST|PUR|RTD",	0, 0 },
+	{ "MCAC", cvtEnum,	"256|512|1024|2048|4096|8192",	0, 0 },
+	{ "SOFF", cvtFloat,	"OFF",						-8192, 8191 },
+	{ "AINP", cvtEnum,	"POS|NEG",					0, 0 },
+	{ "INOF", cvtFloat,	"DEF|AUTO",					-2048, 2048 },
+	{ "GAIA", cvtInt,	"",							1, 16 },
+	{ "CUSP", cvtInt,	"",							0, 100 },
+	{ "PDMD", cvtEnum,	"NORM|MIN",					0, 0 },
+	{ "THSL", cvtFloat,	"",							0, 24.9 },
+	{ "TLLD", cvtInt,	"OFF",						0, 8191 },
+	{ "THFA", cvtFloat,	"",							0, 512 },
+	{ "DACO", cvtEnum,	"OFF|FAST|SHAPED|INPUT|PEAK",	0, 0 },
+	{ "DACF", cvtFloat,	"",							-2048, 2048 },
+	{ "RTDS", cvtFloat,	"",							0, 1000 },
+	{ "RTDT", cvtFloat,	"",							0, 1000 },
+	{ "RTDD", cvtAny,	"",							0, 0 },
+	{ "RTDW", cvtAny,	"",							0, 0 },
+	{ "BLRM", cvtInt,	"OFF",						0, 1 },
+	{ "BLRD", cvtInt,	"",							0, 3 },
+	{ "BLRU", cvtInt,	"",							0, 3 },
+	{ "GATE", cvtEnum,	"OFF|HIGH|LOW",				0, 0 },
+	{ "AUO1", cvtAny,	"",							0, 0 },
+	{ "AUO2", cvtAny,	"",							0, 0 },
+	{ "PRET", cvtFloat,	"OFF",						0, 99999999.9 },
+	{ "PRER", cvtFloat,	"OFF",						0, 99999999.9 },
+	{ "PREL", cvtFloat,	"OFF",						0, 99999999.9 },
+	{ "PREC", cvtInt,	"OFF",						0, 4294967295.0 },
+	{ "PRCL", cvtInt,	"",							0, 8191 },
+	{ "PRCH", cvtInt,	"",							0, 8191 },
+	{ "HVSE", cvtFloat,	"OFF",						-1500, 1500 },
+	{ "TECS", cvtFloat,	"OFF",						0, 299 },
+	{ "PAPZ", cvtAny,	"",							0, 0 },
+	{ "PAPS", cvtEnum,	"ON|OFF|8.5|5",				0, 0 },
+	{ "SCOE", cvtEnum,	"RI|FA|BOTH|RISING|FALLING",	0, 0 },
+	{ "SCOT", cvtInt,	"",							0, 100 },
+	{ "SCOG", cvtInt,	"",							0, 255 },
+	{ "MCSL", cvtInt,	"",							0, 8191 },
+	{ "MCSH", cvtInt,	"",							0, 8191 },
+	{ "MCST", cvtFloat,	"",							0, 100000 },
+	{ "TPMO", cvtAny,	"",							0, 0 },
+	{ "GPED", cvtEnum,	"RI|FA|RISING|FALLING",		0, 0 },
+	{ "GPIN", cvtAny,	"",							0, 0 },
+	{ "GPME", cvtEnum,	"ON|OFF",					0, 0 },
+	{ "GPGA", cvtEnum,	"ON|OFF",					0, 0 },
+	{ "GPMC", cvtEnum,	"ON|OFF",					0, 0 },
+	{ "MCAE", cvtEnum,	"ON|OFF",					0, 0 },
+	{ "VOLU", cvtEnum,	"ON|OFF",					0, 0 },
+	{ "CON1", cvtAny,	"",							0, 0 },
+	{ "CON2", cvtAny,	"",							0, 0 },
+	{ "BOOT", cvtEnum,	"ON|OFF",					0, 0 },
+	{ "ACKE", cvtEnum,	"ON|OFF",					0, 0 },
+	{ "SCAW", cvtFloat,	"",							0, 100000 },
+	{ "SCAI", cvtInt,	"",							1, 16 },
+	{ "SCAL", cvtInt,	"",							0, 8191 },
+	{ "SCAH", cvtInt,	"",							0, 8191 },
+	{ "SCAO", cvtEnum,	"OFF|HIGH|LOW",				0, 0 }
+};
+
+// Device-specific numeric ranges, first match wins.
+static const CFG_RANGE_OVERRIDE CfgRangeOverride[] = {
+	{ "GAIA", dppDP5, true,		1, 24 }		// dp5 rev dx analog gain table
+};
+
+CDppCfgValidator::CDppCfgValidator(void)
+{
+}
+
+CDppCfgValidator::~CDppCfgValidator(void)
+{
+}
+
+const CFG_CMD_INFO * CDppCfgValidator::GetCmdInfo(const char *pCmd)
+{
+	int idxCmd;
+	int iNumCmds = (int)(sizeof(CfgCmdInfo) / sizeof(CfgCmdInfo[0]));
+
+	for (idxCmd=0;idxCmd<iNumCmds;idxCmd++) {
+		if (strncmp(pCmd, CfgCmdInfo[idxCmd].strCmd, 4) == 0) {
+			return &CfgCmdInfo[idxCmd];
+		}
+	}
+	return NULL;
+}
+
+bool CDppCfgValidator::IsKeyword(string strValue, const char *strKeywords)
+{
+	string strList = strKeywords;
+	size_t lStart = 0;
+	size_t lEnd;
+
+	if (strList.length() == 0) return false;
+	while (lStart <= strList.length()) {
+		lEnd = strList.find('|', lStart);
+		if (lEnd == string::npos) lEnd = strList.length();
+		if (strList.compare(lStart, lEnd - lStart, strValue) == 0) return true;
+		lStart = lEnd + 1;
+	}
+	return false;
+}
+
+string CDppCfgValidator::ValidateCmd(string strCmd, DppCmdMask LegalCmds, int DppType, bool isDP5_RevDxGains, bool *bWarning)
+{
+	stringex strfn;
+	const CFG_CMD_INFO *pInfo;
+	string strName;
+	string strValue;
+	size_t lEq;
+	int iFilterIdx;
+	int idxOvr;
+	int iNumOvr = (int)(sizeof(CfgRangeOverride) / sizeof(CfgRangeOverride[0]));
+	double dblMin;
+	double dblMax;
+	double dblValue;
+	const char *pValue;
+	char *pEnd;
+
+	*bWarning = false;
+	lEq = strCmd.find('=');
+	if ((lEq != 4) || (strCmd.length() < 5)) {
+		return "malformed command, expected NAME=VALUE";
+	}
+	strName = strCmd.substr(0, 4);
+	strValue = strCmd.substr(5);
+	pInfo = GetCmdInfo(strName.c_str());
+	if (pInfo == NULL) {
+		return "unrecognized command";
+	}
+	iFilterIdx = AsciiCmdUtil.GetFilterCmdIndex(strName.c_str());
+	if ((iFilterIdx >= 0) && ((LegalCmds & DPP_CMD_BIT(iFilterIdx)) == 0)) {
+		return "command not supported by " + strfn.Format("device type %d", DppType);
+	}
+	if (strValue.length() == 0) {
+		return "missing value";
+	}
+	if (strValue == "?") {							// readback request
+		return "";
+	}
+	if (IsKeyword(strValue, pInfo->strKeywords)) {
+		return "";
+	}
+	if (pInfo->ValueType == cvtAny) {
+		return "";
+	}
+	// value findings below come from the host-side table
+	*bWarning = true;
+	if (pInfo->ValueType == cvtEnum) {
+		return strfn.Format("value must be one of %s", pInfo->strKeywords);
+	}
+	pValue = strValue.c_str();
+	if (pInfo->ValueType == cvtInt) {
+		dblValue = (double)strtol(pValue, &pEnd, 10);
+	} else {
+		dblValue = strtod(pValue, &pEnd);
+	}
+	if ((pEnd == pValue) || (*pEnd != '\0')) {
+		if (strlen(pInfo->strKeywords) > 0) {
+			return strfn.Format("value must be %s or %s", (pInfo->ValueType == cvtInt) ? "an integer" : "a number", pInfo->strKeywords);
+		}
+		return strfn.Format("value must be %s", (pInfo->ValueType == cvtInt) ? "an integer" : "a number");
+	}
+	dblMin = pInfo->dblMin;
+	dblMax = pInfo->dblMax;
+	for (idxOvr=0;idxOvr<iNumOvr;idxOvr++) {
+		if ((strName == CfgRangeOverride[idxOvr].strCmd) && (DppType == CfgRangeOverride[idxOvr].DppType)
+			&& (isDP5_RevDxGains || !CfgRangeOverride[idxOvr].isDP5_RevDxGains)) {
+			dblMin = CfgRangeOverride[idxOvr].dblMin;
+			dblMax = CfgRangeOverride[idxOvr].dblMax;
+			break;
+		}
+	}
+	if ((dblValue < dblMin) || (dblValue > dblMax)) {
+		return strfn.Format("value out of range (%g to %g)", dblMin, dblMax);
+	}
+	return "";
+}
+
+bool CDppCfgValidator::ValidateCfg(string strCfg, bool PC5_PRESENT, int DppType, bool isDP5_RevDxGains, unsigned char DPP_ECO, vector<CFG_ERROR> *vErrors)
+{
+	DppCmdMask LegalCmds;
+	CFG_ERROR CfgError;
+	string strCmd;
+	string strError;
+	size_t lStart = 0;
+	size_t lEnd;
+	bool bValid = true;
+	bool bWarning;
+
+	LegalCmds = AsciiCmdUtil.GetDeviceCmdMask(PC5_PRESENT, DppType, isDP5_RevDxGains, DPP_ECO);
+	strCfg = AsciiCmdUtil.RemWhitespace(AsciiCmdUtil.MakeUpper(strCfg));
+	while (lStart < strCfg.length()) {
+		lEnd = strCfg.find(';', lStart);
+		if (lEnd == string::npos) lEnd = strCfg.length();
+		strCmd = strCfg.substr(lStart, lEnd - lStart);
+		if (strCmd.length() > 0) {
+			strError = ValidateCmd(strCmd, LegalCmds, DppType, isDP5_RevDxGains, &bWarning);
+			if (strError.length() > 0) {
+				CfgError.lPosition = (long)lStart;
+				CfgError.strCmd = strCmd;
+				CfgError.strError = strError;
+				CfgError.bWarning = bWarning;
+				vErrors->push_back(CfgError);
+				if (! bWarning) {
+					bValid = false;
+				}
+			}
+		}
+		lStart = lEnd + 1;
+	}
+	return bValid;
+}
+
+bool CDppCfgValidator::ValidateCfgFile(string strFilename, bool PC5_PRESENT, int DppType, bool isDP5_RevDxGains, unsigned char DPP_ECO, vector<CFG_ERROR> *vErrors)
+{
+	FILE *cfgFile;
+	CFG_ERROR CfgError;
+	string strCfg;
+	size_t idxErr;
+	size_t lFirstErr;
+	bool bValid;
+
+	if ((cfgFile = fopen(strFilename.c_str(), "r")) == NULL) {
+		CfgError.strFilename = strFilename;
+		CfgError.lPosition = -1;
+		CfgError.strCmd = "";
+		CfgError.strError = "cannot open file";
+		CfgError.bWarning = false;
+		vErrors->push_back(CfgError);
+		return false;
+	}
+	fclose(cfgFile);
+	strCfg = AsciiCmdUtil.GetDP5CfgStr(strFilename);
+	strCfg += AsciiCmdUtil.GetDP5ScaStr(strFilename);
+	if (strCfg.length() == 0) {
+		CfgError.strFilename = strFilename;
+		CfgError.lPosition = -1;
+		CfgError.strCmd = "";
+		CfgError.strError = "no configuration commands found";
+		CfgError.bWarning = false;
+		vErrors->push_back(CfgError);
+		return false;
+	}
+	lFirstErr = vErrors->size();
+	bValid = ValidateCfg(strCfg, PC5_PRESENT, DppType, isDP5_RevDxGains, DPP_ECO, vErrors);
+	for (idxErr=lFirstErr;idxErr<vErrors->size();idxErr++) {
+		(*vErrors)[idxErr].strFilename = strFilename;
+	}
+	return bValid;
+}
+
+long CDppCfgValidator::ValidateCfgDirectory(string strDirectory, bool PC5_PRESENT, int DppType, bool isDP5_RevDxGains, unsigned char DPP_ECO, vector<CFG_ERROR> *vErrors)
+{
+	vector<string> vFiles;
+	string strName;
+	string strExt;
+	size_t idxFile;
+
+	if ((strDirectory.length() > 0) && (strDirectory[strDirectory.length() - 1] != '/') && (strDirectory[strDirectory.length() - 1] != '\\')) {
+		strDirectory += "/";
+	}
+#ifdef _WIN32
+	struct _finddata_t fdFile;
+	intptr_t hFind;
+	if ((hFind = _findfirst((strDirectory + "*.*").c_str(), &fdFile)) != -1) {
+		do {
+			if ((fdFile.attrib & _A_SUBDIR) == 0) vFiles.push_back(fdFile.name);
+		} while (_findnext(hFind, &fdFile) == 0);
+		_findclose(hFind);
+	}
+#else
+	DIR *pDir;
+	struct dirent *pEntry;
+	if ((pDir = opendir(strDirectory.c_str())) != NULL) {
+		while ((pEntry = readdir(pDir)) != NULL) {
+			if (pEntry->d_name[0] != '.') vFiles.push_back(pEntry->d_name);
+		}
+		closedir(pDir);
+	}
+#endif
+	long lNumFiles = 0;
+	for (idxFile=0;idxFile<vFiles.size();idxFile++) {
+		strName = vFiles[idxFile];
+		if (strName.length() < 4) continue;
+		strExt = AsciiCmdUtil.MakeUpper(strName.substr(strName.length() - 4));
+		if ((strExt != ".TXT") && (strExt != ".CFG")) continue;
+		ValidateCfgFile(strDirectory + strName, PC5_PRESENT, DppType, isDP5_RevDxGains, DPP_ECO, vErrors);
+		lNumFiles++;
+	}
+	return lNumFiles;
+}
+
+string CDppCfgValidator::CfgErrorsToString(vector<CFG_ERROR> vErrors)
+{
+	stringex strfn;
+	string strErrors;
+	size_t idxErr;
+
+	strErrors = "";
+	for (idxErr=0;idxErr<vErrors.size();idxErr++) {
+		if (vErrors[idxErr].strFilename.length() > 0) {
+			strErrors += vErrors[idxErr].strFilename + ": ";
+		}
+		if (vErrors[idxErr].strCmd.length() > 0) {
+			strErrors += strfn.Format("%s (pos %ld): ", vErrors[idxErr].strCmd.c_str(), vErrors[idxErr].lPosition);
+		}
+		if (vErrors[idxErr].bWarning) {
+			strErrors += "warning: ";
+		}
+		strErrors += vErrors[idxErr].strError + "\n";
+	}
+	return strErrors;
+}
+
+long CDppCfgValidator::CountWarnings(const vector<CFG_ERROR> &vErrors)
+{
+	long lWarnings;
+	size_t idxErr;
+
+	lWarnings = 0;
+	for (idxErr=0;idxErr<vErrors.size();idxErr++) {
+		if (vErrors[idxErr].bWarning) {
+			lWarnings++;
+		}
+	}
+	return lWarnings;
+}
@@ -0,0 +1,82 @@
+/** CDppCfgValidator CDppCfgValidator */
+#pragma once
+#include <string>
+#include <vector>
+#include "DppConst.h"
+#include "AsciiCmdUtilities.h"
+using namespace std;
+
+/// Kind of value accepted by a configuration command.
+typedef enum _CFG_VALUE_TYPE
+{
+	cvtAny,			/// any non-empty value
+	cvtEnum,		/// one of the listed keywords only
+	cvtInt,			/// listed keyword or integer in range
+	cvtFloat		/// listed keyword or number in range
+} CFG_VALUE_TYPE;
+
+/// Host-side description of a DPP configuration command.
+typedef struct _CFG_CMD_INFO
+{
+	const char *strCmd;			/// 4 character command
+	CFG_VALUE_TYPE ValueType;	/// value type
+	const char *strKeywords;	/// legal keywords, '|' separated ("" for none)
+	double dblMin;				/// numeric minimum
+	double dblMax;				/// numeric maximum
+} CFG_CMD_INFO;
+
+/// Device-specific numeric range that replaces the default command range.
+typedef struct _CFG_RANGE_OVERRIDE
+{
+	const char *strCmd;			/// 4 character command
+	int DppType;				/// device type indicator
+	bool isDP5_RevDxGains;		/// only applies to dp5 dx gains
+	double dblMin;				/// numeric minimum
+	double dblMax;				/// numeric maximum
+} CFG_RANGE_OVERRIDE;
+
+/// One problem found in a configuration.
+typedef struct _CFG_ERROR
+{
+	string strFilename;			/// source file, empty for strings
+	long lPosition;				/// offset of the command in the configuration string
+	string strCmd;				/// command text (NAME=VALUE)
+	string strError;			/// error description
+	bool bWarning;				/// value outside the host-side limits, the DPP decides
+} CFG_ERROR;
+
+/** CDppCfgValidator checks a DPP ASCII configuration on the host before it is sent.
+	Command names, value types, ranges, keywords and device applicability are checked
+	and every error is collected, so a configuration can be fixed in one pass instead of
+	one PID2_ACK_BAD_PARAM / PID2_ACK_UNRECOG at a time.
+	Malformed, unknown and unsupported commands are errors. Value types, keywords and
+	ranges are host-side sanity bounds, not firmware limits, so they are only warnings
+	and the DPP remains the final authority on values.
+*/
+class CDppCfgValidator
+{
+public:
+	CDppCfgValidator(void);
+	~CDppCfgValidator(void);
+	/// Ascii command utilities (device command filters, file readers).
+	CAsciiCmdUtilities AsciiCmdUtil;
+
+	/// Validates a configuration command string, appends errors and warnings to vErrors, returns true if no errors.
+	bool ValidateCfg(string strCfg, bool PC5_PRESENT, int DppType, bool isDP5_RevDxGains, unsigned char DPP_ECO, vector<CFG_ERROR> *vErrors);
+	/// Validates the configuration and SCA sections of a configuration file.
+	bool ValidateCfgFile(string strFilename, bool PC5_PRESENT, int DppType, bool isDP5_RevDxGains, unsigned char DPP_ECO, vector<CFG_ERROR> *vErrors);
+	/// Validates every configuration file (.txt,.cfg) in a directory, returns the number of files checked.
+	long ValidateCfgDirectory(string strDirectory, bool PC5_PRESENT, int DppType, bool isDP5_RevDxGains, unsigned char DPP_ECO, vector<CFG_ERROR> *vErrors);
+	/// Converts a list of configuration errors into a display string.
+	string CfgErrorsToString(vector<CFG_ERROR> vErrors);
+	/// Returns the number of warnings in a list of configuration errors.
+	long CountWarnings(const vector<CFG_ERROR> &vErrors);
+	/// Returns the command description table entry, NULL if the command is unknown.
+	const CFG_CMD_INFO * GetCmdInfo(const char *pCmd);
+
+private:
+	/// Checks one NAME=VALUE command, returns an empty string if the command is legal, bWarning is set for value findings.
+	string ValidateCmd(string strCmd, DppCmdMask LegalCmds, int DppType, bool isDP5_RevDxGains, bool *bWarning);
+	/// Checks a value against a '|' separated keyword list.
+	bool IsKeyword(string strValue, const char *strKeywords);
+};
@@ -0,0 +1,122 @@
+#include "DppClockSync.h"
+#include <string.h>
+#include <math.h>
+
+CDppClockSync::CDppClockSync(void)
+{
+	Reset();
+}
+
+CDppClockSync::~CDppClockSync(void)
+{
+}
+
+void CDppClockSync::Reset()
+{
+	ulNumSamples = 0;
+	bStalled = false;
+	memset(&CurrentFit, 0, sizeof(CurrentFit));
+	CurrentFit.dblRate = 1.0;
+}
+
+void CDppClockSync::AddSample(double dblDeviceTime, long long llTxTimeNs, long long llRxTimeNs)
+{
+	CLOCK_SYNC_SAMPLE *Sample;
+	double dblLast;
+	double dblUncertainty;
+
+	dblDeviceTime += CLOCK_SYNC_RESOLUTION;		// real time is truncated to ms
+	if (ulNumSamples > 0) {
+		dblLast = Samples[(ulNumSamples - 1) & (CLOCK_SYNC_WINDOW - 1)].dblDevice;
+		if (dblDeviceTime == dblLast) {
+			bStalled = true;			// MCA disabled or preset reached
+			return;
+		}
+		if ((dblDeviceTime < dblLast) || bStalled) {
+			Reset();					// cleared, or resumed after the clock stopped
+		}
+	}
+	// the device time was sampled somewhere within the transfer
+	dblUncertainty = (llRxTimeNs - llTxTimeNs) * 0.5e-9 + CLOCK_SYNC_RESOLUTION;
+	Sample = &Samples[ulNumSamples & (CLOCK_SYNC_WINDOW - 1)];
+	Sample->dblHost = (llTxTimeNs + (llRxTimeNs - llTxTimeNs) / 2) * 1.0e-9;
+	Sample->dblDevice = dblDeviceTime;
+	Sample->dblWeight = 1.0 / (dblUncertainty * dblUncertainty);
+	ulNumSamples++;
+	UpdateFit();
+}
+
+void CDppClockSync::UpdateFit()
+{
+	const CLOCK_SYNC_SAMPLE *Sample;
+	long lSamples;
+	long idxSample;
+	double dblHostRef;
+	double dblDeviceRef;
+	double dblSumW, dblSumX, dblSumY;
+	double dblMeanX, dblMeanY;
+	double dblSxx, dblSxy;
+	double dblX, dblY;
+	double dblResidual;
+	double dblSumR2;
+
+	lSamples = (ulNumSamples < CLOCK_SYNC_WINDOW) ? (long)ulNumSamples : CLOCK_SYNC_WINDOW;
+	CurrentFit.lSamples = lSamples;
+	if (lSamples < 2) {
+		CurrentFit.bValid = false;
+		return;
+	}
+	// values relative to the newest sample keep full precision over long runs
+	Sample = &Samples[(ulNumSamples - 1) & (CLOCK_SYNC_WINDOW - 1)];
+	dblHostRef = Sample->dblHost;
+	dblDeviceRef = Sample->dblDevice;
+	dblSumW = 0; dblSumX = 0; dblSumY = 0;
+	for (idxSample=0;idxSample<lSamples;idxSample++) {
+		Sample = &Samples[idxSample];
+		dblSumW += Sample->dblWeight;
+		dblSumX += Sample->dblWeight * (Sample->dblHost - dblHostRef);
+		dblSumY += Sample->dblWeight * (Sample->dblDevice - dblDeviceRef);
+	}
+	dblMeanX = dblSumX / dblSumW;
+	dblMeanY = dblSumY / dblSumW;
+	dblSxx = 0; dblSxy = 0;
+	for (idxSample=0;idxSample<lSamples;idxSample++) {
+		Sample = &Samples[idxSample];
+		dblX = Sample->dblHost - dblHostRef - dblMeanX;
+		dblY = Sample->dblDevice - dblDeviceRef - dblMeanY;
+		dblSxx += Sample->dblWeight * dblX * dblX;
+		dblSxy += Sample->dblWeight * dblX * dblY;
+	}
+	if (dblSxx <= 0) {
+		CurrentFit.bValid = false;
+		return;
+	}
+	CurrentFit.dblRate = dblSxy / dblSxx;
+	CurrentFit.dblHostRef = dblHostRef;
+	CurrentFit.dblDeviceRef = dblDeviceRef + dblMeanY - CurrentFit.dblRate * dblMeanX;
+	CurrentFit.dblDriftPpm = (CurrentFit.dblRate - 1.0) * 1.0e6;
+	dblSumR2 = 0;
+	for (idxSample=0;idxSample<lSamples;idxSample++) {
+		Sample = &Samples[idxSample];
+		dblResidual = (Sample->dblDevice - CurrentFit.dblDeviceRef) - CurrentFit.dblRate * (Sample->dblHost - dblHostRef);
+		dblSumR2 += Sample->dblWeight * dblResidual * dblResidual;
+	}
+	CurrentFit.dblRms = sqrt(dblSumR2 / dblSumW);
+	CurrentFit.bValid = true;
+}
+
+bool CDppClockSync::GetFit(CLOCK_SYNC_FIT *Fit)
+{
+	*Fit = CurrentFit;
+	return CurrentFit.bValid;
+}
+
+double CDppClockSync::DeviceToHost(double dblDeviceTime)
+{
+	return CurrentFit.dblHostRef + (dblDeviceTime - CurrentFit.dblDeviceRef) / CurrentFit.dblRate;
+}
+
+double CDppClockSync::HostToDevice(double dblHostTime)
+{
+	return CurrentFit.dblDeviceRef + (dblHostTime - CurrentFit.dblHostRef) * CurrentFit.dblRate;
+}
@@ -0,0 +1,58 @@
+/** CDppClockSync CDppClockSync */
+#pragma once
+
+#define CLOCK_SYNC_WINDOW 256				/// status samples in the fit (power of 2)
+#define CLOCK_SYNC_RESOLUTION 0.0005		/// half of the 1ms device real time step
+
+/// One host/device time pair.
+typedef struct _CLOCK_SYNC_SAMPLE
+{
+	double dblHost;				/// host monotonic time, transfer midpoint (s)
+	double dblDevice;			/// device real time, centered in its 1ms step (s)
+	double dblWeight;			/// fit weight (short round trips weigh more)
+} CLOCK_SYNC_SAMPLE;
+
+/// Linear host to device clock model, device = dblDeviceRef + (host - dblHostRef) * dblRate.
+typedef struct _CLOCK_SYNC_FIT
+{
+	bool bValid;				/// at least two samples since the device clock (re)started
+	double dblHostRef;			/// host reference time (s)
+	double dblDeviceRef;		/// device time at the host reference (s)
+	double dblRate;				/// device seconds per host second
+	double dblDriftPpm;			/// (rate - 1) in ppm
+	double dblRms;				/// weighted rms residual (s)
+	long lSamples;				/// samples in the fit
+} CLOCK_SYNC_FIT;
+
+/** CDppClockSync correlates the device real time with the host monotonic clock.
+	Each status gives a device real time and the host time of the USB transfer,
+	the transfer midpoint is used and samples are weighted by the round trip time.
+	A weighted least squares line over the last samples gives offset and drift.
+	The device real time stops while the MCA is disabled, the fit restarts when it resumes.
+*/
+class CDppClockSync
+{
+public:
+	CDppClockSync(void);
+	~CDppClockSync(void);
+
+	/// Adds a status real time with the host request and completion times (ns).
+	void AddSample(double dblDeviceTime, long long llTxTimeNs, long long llRxTimeNs);
+	/// Clears all samples.
+	void Reset();
+	/// Returns the current fit.
+	bool GetFit(CLOCK_SYNC_FIT *Fit);
+	/// Converts a device real time to host monotonic time (s).
+	double DeviceToHost(double dblDeviceTime);
+	/// Converts a host monotonic time (s) to device real time.
+	double HostToDevice(double dblHostTime);
+
+private:
+	/// Refits the line to the samples.
+	void UpdateFit();
+
+	CLOCK_SYNC_SAMPLE Samples[CLOCK_SYNC_WINDOW];
+	unsigned long ulNumSamples;		/// samples added since the clock (re)started
+	bool bStalled;					/// device time stopped advancing
+	CLOCK_SYNC_FIT CurrentFit;
+};
@@ -0,0 +1,161 @@
+#include "DppCountRate.h"
+#include <string.h>
+#include <math.h>
+
+// difference of a rolling counter
+static double CounterDelta(double dblNow, double dblPrev, double dblRange)
+{
+	double dblDelta;
+
+	dblDelta = dblNow - dblPrev;
+	if (dblDelta < 0) {
+		dblDelta += dblRange;
+	}
+	return dblDelta;
+}
+
+CDppCountRate::CDppCountRate(void)
+{
+	const double dblDefaultWindows[] = {1.0, 10.0};
+
+	dblPileUpTime = 0;
+	SetWindows(dblDefaultWindows, 2);
+}
+
+CDppCountRate::~CDppCountRate(void)
+{
+}
+
+void CDppCountRate::SetWindows(const double dblWindows[], int iWindows)
+{
+	int idxWindow;
+
+	if (iWindows > COUNT_RATE_MAX_WINDOWS) iWindows = COUNT_RATE_MAX_WINDOWS;
+	if (iWindows < 1) iWindows = 1;
+	for (idxWindow=0;idxWindow<iWindows;idxWindow++) {
+		dblWindow[idxWindow] = dblWindows[idxWindow];
+	}
+	iNumWindows = iWindows;
+	Reset();
+}
+
+void CDppCountRate::SetPileUpTime(double dblSeconds)
+{
+	dblPileUpTime = dblSeconds;
+}
+
+void CDppCountRate::Reset()
+{
+	memset(WindowSum, 0, sizeof(WindowSum));
+	memset(ulWindowStart, 0, sizeof(ulWindowStart));
+	ulHistoryCount = 0;
+	bHavePrevious = false;
+}
+
+void CDppCountRate::AddInterval(COUNT_RATE_INTERVAL *Sum, const COUNT_RATE_INTERVAL *Interval, double dblSign)
+{
+	Sum->dblFast += dblSign * Interval->dblFast;
+	Sum->dblSlow += dblSign * Interval->dblSlow;
+	Sum->dblReal += dblSign * Interval->dblReal;
+	Sum->dblLive += dblSign * Interval->dblLive;
+	Sum->dblAccum += dblSign * Interval->dblAccum;
+}
+
+bool CDppCountRate::Update(const DP4_FORMAT_STATUS *Status)
+{
+	COUNT_RATE_INTERVAL *Interval;
+	unsigned long ulNewest;
+	int idxWindow;
+
+	if (! bHavePrevious || (Status->RealTime < dblPrevReal)) {
+		// first status or spectrum cleared, 32 bit ms real time rolls over after 49 days
+		if (! bHavePrevious || (dblPrevReal - Status->RealTime) < (REALTIME_ROLLOVER / 2)) {
+			bHavePrevious = true;
+			dblPrevFast = Status->FastCount;
+			dblPrevSlow = Status->SlowCount;
+			dblPrevReal = Status->RealTime;
+			dblPrevLive = Status->LiveTime;
+			dblPrevAccum = Status->AccumulationTime;
+			return false;
+		}
+	}
+	if (Status->RealTime == dblPrevReal) {
+		return false;			// acquisition not running
+	}
+	ulNewest = ulHistoryCount;
+	Interval = &History[ulNewest & (COUNT_RATE_HISTORY - 1)];
+	// window sums must not keep an interval that is about to be overwritten
+	if (ulNewest >= COUNT_RATE_HISTORY) {
+		for (idxWindow=0;idxWindow<iNumWindows;idxWindow++) {
+			if (ulWindowStart[idxWindow] == ulNewest - COUNT_RATE_HISTORY) {
+				AddInterval(&WindowSum[idxWindow], Interval, -1.0);
+				ulWindowStart[idxWindow]++;
+			}
+		}
+	}
+	Interval->dblFast = CounterDelta(Status->FastCount, dblPrevFast, COUNT_ROLLOVER);
+	Interval->dblSlow = CounterDelta(Status->SlowCount, dblPrevSlow, COUNT_ROLLOVER);
+	Interval->dblReal = CounterDelta(Status->RealTime, dblPrevReal, REALTIME_ROLLOVER);
+	Interval->dblLive = CounterDelta(Status->LiveTime, dblPrevLive, REALTIME_ROLLOVER);
+	Interval->dblAccum = CounterDelta(Status->AccumulationTime, dblPrevAccum, ACCUMTIME_ROLLOVER);
+	dblPrevFast = Status->FastCount;
+	dblPrevSlow = Status->SlowCount;
+	dblPrevReal = Status->RealTime;
+	dblPrevLive = Status->LiveTime;
+	dblPrevAccum = Status->AccumulationTime;
+	ulHistoryCount++;
+
+	for (idxWindow=0;idxWindow<iNumWindows;idxWindow++) {
+		AddInterval(&WindowSum[idxWindow], Interval, 1.0);
+		// drop the oldest intervals while the rest still covers the window
+		while ((ulWindowStart[idxWindow] < ulNewest) &&
+			((WindowSum[idxWindow].dblReal - History[ulWindowStart[idxWindow] & (COUNT_RATE_HISTORY - 1)].dblReal) >= dblWindow[idxWindow])) {
+			AddInterval(&WindowSum[idxWindow], &History[ulWindowStart[idxWindow] & (COUNT_RATE_HISTORY - 1)], -1.0);
+			ulWindowStart[idxWindow]++;
+		}
+	}
+	return true;
+}
+
+void CDppCountRate::SumsToRate(const COUNT_RATE_INTERVAL *Sum, long lIntervals, COUNT_RATE *Rate)
+{
+	Rate->lIntervals = lIntervals;
+	Rate->dblRealTime = Sum->dblReal;
+	Rate->dblICR = Sum->dblFast / Sum->dblReal;
+	Rate->dblOCR = Sum->dblSlow / Sum->dblReal;
+	if (Sum->dblFast > 0) {
+		Rate->dblDeadTime = 1.0 - (Sum->dblSlow / Sum->dblFast);
+		if (Rate->dblDeadTime < 0) Rate->dblDeadTime = 0;
+	} else {
+		Rate->dblDeadTime = 0;
+	}
+	if (Sum->dblLive > 0) {
+		Rate->dblLiveDeadTime = 1.0 - (Sum->dblLive / Sum->dblReal);
+	} else {
+		Rate->dblLiveDeadTime = NAN;
+	}
+	if (dblPileUpTime > 0) {
+		// Poisson probability of a second pulse within the resolving time
+		Rate->dblPileUp = 1.0 - exp(-Rate->dblICR * dblPileUpTime);
+	} else {
+		Rate->dblPileUp = NAN;
+	}
+}
+
+bool CDppCountRate::GetRate(int idxWindow, COUNT_RATE *Rate)
+{
+	if ((idxWindow < 0) || (idxWindow >= iNumWindows) || (ulHistoryCount == 0) || (WindowSum[idxWindow].dblReal <= 0)) {
+		return false;
+	}
+	SumsToRate(&WindowSum[idxWindow], (long)(ulHistoryCount - ulWindowStart[idxWindow]), Rate);
+	return true;
+}
+
+bool CDppCountRate::GetLastRate(COUNT_RATE *Rate)
+{
+	if ((ulHistoryCount == 0) || (History[(ulHistoryCount - 1) & (COUNT_RATE_HISTORY - 1)].dblReal <= 0)) {
+		return false;
+	}
+	SumsToRate(&History[(ulHistoryCount - 1) & (COUNT_RATE_HISTORY - 1)], 1, Rate);
+	return true;
+}
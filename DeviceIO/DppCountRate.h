@@ -0,0 +1,78 @@
+/** CDppCountRate CDppCountRate */
+#pragma once
+#include "DP5Status.h"
+
+#define COUNT_RATE_MAX_WINDOWS 4			/// smoothing windows computed together
+#define COUNT_RATE_HISTORY 1024				/// status intervals kept for the windows (power of 2)
+#define COUNT_ROLLOVER 4294967296.0			/// 32 bit counter range
+#define REALTIME_ROLLOVER 4294967.296		/// 32 bit ms real/live time range (s)
+#define ACCUMTIME_ROLLOVER 1677721.6		/// 24 bit 100ms accumulation time range (s)
+
+/// Differences between two consecutive statuses.
+typedef struct _COUNT_RATE_INTERVAL
+{
+	double dblFast;				/// fast channel counts
+	double dblSlow;				/// slow channel counts
+	double dblReal;				/// real time (s)
+	double dblLive;				/// live time (s, MCA8000D)
+	double dblAccum;			/// accumulation time (s)
+} COUNT_RATE_INTERVAL;
+
+/// Rates over one smoothing window.
+typedef struct _COUNT_RATE
+{
+	double dblICR;				/// input count rate (fast counts / real time, cps)
+	double dblOCR;				/// output count rate (slow counts / real time, cps)
+	double dblDeadTime;			/// dead time fraction (1 - OCR/ICR)
+	double dblLiveDeadTime;		/// dead time fraction from live time (1 - live/real), NaN without live time
+	double dblPileUp;			/// estimated piled up fraction of input pulses, NaN without resolving time
+	double dblRealTime;			/// real time covered by the window (s)
+	long lIntervals;			/// status intervals in the window
+} COUNT_RATE;
+
+/** CDppCountRate derives count rates and dead time from consecutive statuses.
+	Counter differences are taken modulo the counter range (rollover), a status with
+	smaller real time restarts the sequence (spectrum cleared). Windows are sliding
+	sums over the last seconds of real time, updated in constant time per status.
+*/
+class CDppCountRate
+{
+public:
+	CDppCountRate(void);
+	~CDppCountRate(void);
+
+	/// Sets the smoothing windows (seconds of real time), window 0 is the default window.
+	void SetWindows(const double dblWindows[], int iWindows);
+	/// Sets the pulse pair resolving time (s) used for the pile-up estimate, 0 disables it.
+	void SetPileUpTime(double dblSeconds);
+	/// Restarts the rate calculation.
+	void Reset();
+
+	/// Adds a status, returns true if a new interval was added.
+	bool Update(const DP4_FORMAT_STATUS *Status);
+	/// Returns the rates over a smoothing window.
+	bool GetRate(int idxWindow, COUNT_RATE *Rate);
+	/// Returns the rates of the last status interval.
+	bool GetLastRate(COUNT_RATE *Rate);
+
+private:
+	/// Fills rates from interval sums.
+	void SumsToRate(const COUNT_RATE_INTERVAL *Sum, long lIntervals, COUNT_RATE *Rate);
+	/// Adds/subtracts an interval from a sum.
+	void AddInterval(COUNT_RATE_INTERVAL *Sum, const COUNT_RATE_INTERVAL *Interval, double dblSign);
+
+	COUNT_RATE_INTERVAL History[COUNT_RATE_HISTORY];
+	unsigned long ulHistoryCount;				/// intervals added since reset
+	COUNT_RATE_INTERVAL WindowSum[COUNT_RATE_MAX_WINDOWS];
+	unsigned long ulWindowStart[COUNT_RATE_MAX_WINDOWS];	/// oldest interval in each window
+	double dblWindow[COUNT_RATE_MAX_WINDOWS];
+	int iNumWindows;
+	double dblPileUpTime;
+
+	bool bHavePrevious;
+	double dblPrevFast;
+	double dblPrevSlow;
+	double dblPrevReal;
+	double dblPrevLive;
+	double dblPrevAccum;
+};
@@ -0,0 +1,347 @@
+#include "DppDiagMonitor.h"
+#include "DppConst.h"
+#include "DppLog.h"
+#include "stringex.h"
+#include <string.h>
+#include <chrono>
+#include <algorithm>
+
+// value names by device family (DP5/DP5X, PX5, other), empty names are not reported
+static const char *DiagValueNames[3][DIAG_VALUE_COUNT] = {
+	{ "TEMP_ADC", "", "PWR", "3.3V", "2.5V", "1.2V", "+5.5V", "-5.5V", "AN_IN", "VREF_IN", "", "",
+	  "PC5_HV", "PC5_DET_TEMP", "PC5_+8.5/5V" },
+	{ "9V", "3.3V", "2.5V", "1.2V", "+5V", "-5V", "+PA", "-PA", "TEC", "ABS(HV)", "DET_TEMP", "TEMP_ADC",
+	  "PC5_HV", "PC5_DET_TEMP", "PC5_+8.5/5V" },
+	{ "", "", "", "", "", "", "", "", "", "", "", "",
+	  "PC5_HV", "PC5_DET_TEMP", "PC5_+8.5/5V" }
+};
+
+static int DiagFamily(int iDeviceType)
+{
+	if ((iDeviceType == dppDP5) || (iDeviceType == dppDP5X)) {
+		return 0;
+	} else if (iDeviceType == dppPX5) {
+		return 1;
+	}
+	return 2;
+}
+
+CDppDiagMonitor::CDppDiagMonitor(void)
+{
+	lPeriod = DIAG_DEFAULT_PERIOD_MS;
+	bRunning = false;
+	bRequestDue = false;
+	llNextRequestNs = 0;
+	bDeferred = false;
+	llLastPollNs = 0;
+	dblPollIntervalMs = 0;
+	dblRequestMs = DIAG_INITIAL_DURATION_MS;
+	Reset();
+}
+
+CDppDiagMonitor::~CDppDiagMonitor(void)
+{
+	Stop();
+}
+
+void CDppDiagMonitor::Reset()
+{
+	int idxValue;
+
+	lock_guard<mutex> Lock(DiagLock);
+	ulNumSamples = 0;
+	memset(&MonitorStatus, 0, sizeof(MonitorStatus));
+	for (idxValue=0;idxValue<DIAG_VALUE_COUNT;idxValue++) {
+		memset(&ValueStats[idxValue], 0, sizeof(DIAG_VALUE_STATS));
+	}
+}
+
+long long CDppDiagMonitor::GetTimeNs()
+{
+	return (long long)chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool CDppDiagMonitor::Start(long lPeriodMs, function<DIAG_REQUEST_RESULT(DiagDataType *Diag, int *iDeviceType)> RequestDiag)
+{
+	Stop();
+	if (! RequestDiag) {
+		return false;
+	}
+	lPeriod = (lPeriodMs > 0) ? lPeriodMs : DIAG_DEFAULT_PERIOD_MS;
+	RequestDiagnostics = RequestDiag;
+	bRequestDue = false;
+	llNextRequestNs = GetTimeNs();
+	bDeferred = false;
+	bRunning = true;
+	MonitorThreadHandle = thread(&CDppDiagMonitor::MonitorThread, this);
+	return true;
+}
+
+void CDppDiagMonitor::Stop()
+{
+	{
+		lock_guard<mutex> Lock(DiagLock);
+		bRunning = false;
+	}
+	StopEvent.notify_all();
+	if (MonitorThreadHandle.joinable()) {
+		MonitorThreadHandle.join();
+	}
+	bRequestDue = false;
+}
+
+void CDppDiagMonitor::NotePoll(long long llTimeNs)
+{
+	long long llLast;
+	double dblInterval;
+
+	llLast = llLastPollNs.exchange(llTimeNs);
+	if (llLast == 0) {
+		return;
+	}
+	dblInterval = (llTimeNs - llLast) * 1.0e-6;
+	if (dblInterval > 0) {
+		if (dblPollIntervalMs == 0) {
+			dblPollIntervalMs = dblInterval;
+		} else {
+			dblPollIntervalMs = dblPollIntervalMs * 0.875 + dblInterval * 0.125;
+		}
+	}
+}
+
+// acquisition is idle before the first poll, and after two average intervals without one
+bool CDppDiagMonitor::IsPolling(long long llNowNs)
+{
+	double dblIntervalMs;
+
+	dblIntervalMs = dblPollIntervalMs;
+	return ((llLastPollNs != 0) && (dblIntervalMs != 0) && ((llNowNs - llLastPollNs) * 1.0e-6 <= 2.0 * dblIntervalMs));
+}
+
+// a request is made when acquisition is idle, or when the gap to the next expected poll is long enough
+bool CDppDiagMonitor::IsQuietPeriod(long long llNowNs)
+{
+	double dblRequest;
+
+	if (! IsPolling(llNowNs)) {
+		return true;
+	}
+	{
+		lock_guard<mutex> Lock(DiagLock);
+		dblRequest = dblRequestMs;
+	}
+	return ((dblPollIntervalMs - (llNowNs - llLastPollNs) * 1.0e-6) > (dblRequest + DIAG_POLL_MARGIN_MS));
+}
+
+void CDppDiagMonitor::NoteDeferred()
+{
+	lock_guard<mutex> Lock(DiagLock);
+	if (! bDeferred) {
+		bDeferred = true;
+		MonitorStatus.ulDeferred++;
+	}
+}
+
+// called by the polling thread after each transfer, costs one atomic load unless a request is due
+void CDppDiagMonitor::ServiceRequest()
+{
+	if (! bRequestDue || ! bRunning) {
+		return;
+	}
+	if (! IsQuietPeriod(GetTimeNs())) {
+		NoteDeferred();
+		return;
+	}
+	if (bRequestDue.exchange(false)) {
+		RunRequest();
+	}
+}
+
+void CDppDiagMonitor::RunRequest()
+{
+	DiagDataType Diag;
+	DIAG_REQUEST_RESULT Result;
+	int iDeviceType;
+	long long llStartNs;
+	double dblMs;
+
+	llStartNs = GetTimeNs();
+	llNextRequestNs = llStartNs + lPeriod * 1000000LL;
+	Result = RequestDiagnostics(&Diag, &iDeviceType);
+	dblMs = (GetTimeNs() - llStartNs) * 1.0e-6;
+	if (Result == drBusy) {
+		NoteDeferred();
+		bRequestDue = true;			// next gap
+		return;
+	}
+	{
+		lock_guard<mutex> Lock(DiagLock);
+		bDeferred = false;
+		if (Result == drDone) {
+			dblRequestMs = dblRequestMs * 0.75 + dblMs * 0.25;
+		} else {
+			MonitorStatus.ulFailed++;
+		}
+	}
+	if (Result == drDone) {
+		AddDiagnostics(&Diag, iDeviceType, dblMs);
+	}
+}
+
+// marks requests due, the polling thread takes them (ServiceRequest), requests are made here only while acquisition is idle
+void CDppDiagMonitor::MonitorThread()
+{
+	long long llWaitNs;
+
+	while (bRunning) {
+		{
+			// wait for the next request, then check for idle acquisition in short steps
+			unique_lock<mutex> Lock(DiagLock);
+			llWaitNs = bRequestDue ? 5000000LL : max(llNextRequestNs - GetTimeNs(), 0LL);
+			StopEvent.wait_for(Lock, chrono::nanoseconds(llWaitNs), [this]{ return ! bRunning; });
+		}
+		if (! bRunning) {
+			break;
+		}
+		if (! bRequestDue) {
+			if (GetTimeNs() < llNextRequestNs) {
+				continue;
+			}
+			bRequestDue = true;
+		}
+		if (! IsPolling(GetTimeNs()) && bRequestDue.exchange(false)) {
+			RunRequest();
+		}
+	}
+}
+
+void CDppDiagMonitor::AddDiagnostics(const DiagDataType *Diag, int iDeviceType, double dblRequestMs)
+{
+	DIAG_SAMPLE *Sample;
+	DIAG_VALUE_STATS *Stats;
+	int iFamily;
+	int idxValue;
+	bool bSramFailed;
+
+	iFamily = DiagFamily(iDeviceType);
+	lock_guard<mutex> Lock(DiagLock);
+	Sample = &History[ulNumSamples & (DIAG_HISTORY_SIZE - 1)];
+	Sample->dblTime = chrono::duration<double>(chrono::system_clock::now().time_since_epoch()).count();
+	Sample->iDeviceType = iDeviceType;
+	Sample->Firmware = Diag->Firmware;
+	Sample->FPGA = Diag->FPGA;
+	Sample->bSramTestPass = Diag->SRAMTestPass;
+	Sample->lSramTestData = Diag->SRAMTestData;
+	Sample->bPc5Present = Diag->PC5_PRESENT;
+	Sample->fRequestMs = (float)dblRequestMs;
+	for (idxValue=0;idxValue<DIAG_VALUE_COUNT;idxValue++) {
+		Sample->fValue[idxValue] = 0;
+		if ((DiagValueNames[iFamily][idxValue][0] == 0) || ((idxValue >= DIAG_ADC_COUNT) && ! Diag->PC5_PRESENT)) {
+			continue;
+		}
+		Sample->fValue[idxValue] = (idxValue < DIAG_ADC_COUNT) ? Diag->ADC_V[idxValue] : Diag->PC5_V[idxValue - DIAG_ADC_COUNT];
+		Stats = &ValueStats[idxValue];
+		if ((Stats->ulCount == 0) || (Sample->fValue[idxValue] < Stats->dblMin)) {
+			Stats->dblMin = Sample->fValue[idxValue];
+		}
+		if ((Stats->ulCount == 0) || (Sample->fValue[idxValue] > Stats->dblMax)) {
+			Stats->dblMax = Sample->fValue[idxValue];
+		}
+		Stats->dblSum += Sample->fValue[idxValue];
+		Stats->dblLast = Sample->fValue[idxValue];
+		Stats->ulCount++;
+	}
+	bSramFailed = ! Diag->SRAMTestPass;
+	if (bSramFailed) {
+		MonitorStatus.ulSramFailures++;
+	}
+	MonitorStatus.ulRequests++;
+	ulNumSamples++;
+	if (bSramFailed) {
+		DPP_LOG_WARN("diag", "SRAM test failed at 0x%06lX", (unsigned long)Diag->SRAMTestData);
+	}
+}
+
+bool CDppDiagMonitor::GetLatest(DIAG_SAMPLE *Sample)
+{
+	lock_guard<mutex> Lock(DiagLock);
+	if (ulNumSamples == 0) {
+		return false;
+	}
+	*Sample = History[(ulNumSamples - 1) & (DIAG_HISTORY_SIZE - 1)];
+	return true;
+}
+
+long CDppDiagMonitor::GetHistory(double dblSince, vector<DIAG_SAMPLE> *vSamples)
+{
+	unsigned long ulFirst;
+	unsigned long idxSample;
+
+	vSamples->clear();
+	lock_guard<mutex> Lock(DiagLock);
+	ulFirst = (ulNumSamples > DIAG_HISTORY_SIZE) ? ulNumSamples - DIAG_HISTORY_SIZE : 0;
+	for (idxSample=ulFirst;idxSample<ulNumSamples;idxSample++) {
+		if (History[idxSample & (DIAG_HISTORY_SIZE - 1)].dblTime > dblSince) {
+			vSamples->push_back(History[idxSample & (DIAG_HISTORY_SIZE - 1)]);
+		}
+	}
+	return (long)vSamples->size();
+}
+
+bool CDppDiagMonitor::GetStats(int idxValue, DIAG_VALUE_STATS *Stats)
+{
+	if ((idxValue < 0) || (idxValue >= DIAG_VALUE_COUNT)) {
+		return false;
+	}
+	lock_guard<mutex> Lock(DiagLock);
+	*Stats = ValueStats[idxValue];
+	return (Stats->ulCount > 0);
+}
+
+void CDppDiagMonitor::GetStatus(DIAG_MONITOR_STATUS *Status)
+{
+	lock_guard<mutex> Lock(DiagLock);
+	*Status = MonitorStatus;
+	Status->dblPollIntervalMs = dblPollIntervalMs;
+	Status->dblRequestMs = dblRequestMs;
+}
+
+string CDppDiagMonitor::ValueName(int iDeviceType, int idxValue)
+{
+	if ((idxValue < 0) || (idxValue >= DIAG_VALUE_COUNT)) {
+		return "";
+	}
+	return DiagValueNames[DiagFamily(iDeviceType)][idxValue];
+}
+
+string CDppDiagMonitor::ToString()
+{
+	DIAG_SAMPLE Sample;
+	DIAG_VALUE_STATS Stats;
+	DIAG_MONITOR_STATUS Status;
+	string strDiag;
+	stringex strfn;
+	int idxValue;
+
+	GetStatus(&Status);
+	strDiag = strfn.Format("Diagnostics: %lu received, %lu deferred, %lu failed, %lu SRAM failures\r\n",
+		Status.ulRequests, Status.ulDeferred, Status.ulFailed, Status.ulSramFailures);
+	strDiag += strfn.Format("Poll interval: %.1fms, request: %.1fms\r\n", Status.dblPollIntervalMs, Status.dblRequestMs);
+	if (! GetLatest(&Sample)) {
+		return strDiag;
+	}
+	strDiag += "SRAM Test: ";
+	if (Sample.bSramTestPass) {
+		strDiag += "PASS\r\n";
+	} else {
+		strDiag += strfn.Format("ERROR @ 0x%06lX\r\n", (unsigned long)Sample.lSramTestData);
+	}
+	for (idxValue=0;idxValue<DIAG_VALUE_COUNT;idxValue++) {
+		if ((ValueName(Sample.iDeviceType, idxValue).length() == 0) || ! GetStats(idxValue, &Stats)) {
+			continue;
+		}
+		strDiag += strfn.Format("%s: %.3f (min %.3f, max %.3f, mean %.3f)\r\n", ValueName(Sample.iDeviceType, idxValue).c_str(),
+			Sample.fValue[idxValue], Stats.dblMin, Stats.dblMax, Stats.dblSum / Stats.ulCount);
+	}
+	return strDiag;
+}
@@ -0,0 +1,134 @@
+/** CDppDiagMonitor CDppDiagMonitor */
+#pragma once
+#include <string>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <functional>
+#include "DP5Status.h"
+using namespace std;
+
+#define DIAG_HISTORY_SIZE 1024			/// diagnostic samples kept (power of 2)
+#define DIAG_ADC_COUNT 12				/// DiagDataType ADC_V values
+#define DIAG_PC5_COUNT 3				/// DiagDataType PC5_V values (HV, detector temp, +8.5/5V)
+#define DIAG_VALUE_COUNT (DIAG_ADC_COUNT + DIAG_PC5_COUNT)
+#define DIAG_DEFAULT_PERIOD_MS 30000	/// default diagnostic request period
+#define DIAG_INITIAL_DURATION_MS 20.0	/// assumed request duration before the first measurement
+#define DIAG_POLL_MARGIN_MS 20.0		/// extra time left before the next expected acquisition poll
+
+/// Result of a diagnostic request attempt.
+typedef enum _DIAG_REQUEST_RESULT
+{
+	drFailed = -1,			/// not connected, not supported or no valid response
+	drBusy = 0,				/// USB in use, try again later
+	drDone = 1				/// diagnostics received
+} DIAG_REQUEST_RESULT;
+
+/// One decoded diagnostic packet.
+typedef struct _DIAG_SAMPLE
+{
+	double dblTime;						/// host time (seconds since 1970)
+	int iDeviceType;					/// DP5_DPP_TYPES
+	unsigned char Firmware;
+	unsigned char FPGA;
+	bool bSramTestPass;
+	long lSramTestData;					/// failing address when the test fails
+	bool bPc5Present;
+	float fValue[DIAG_VALUE_COUNT];		/// ADC_V then PC5_V (V, C or K)
+	float fRequestMs;					/// request round trip
+} DIAG_SAMPLE;
+
+/// Statistics of one diagnostic value since the monitor was reset.
+typedef struct _DIAG_VALUE_STATS
+{
+	double dblMin;
+	double dblMax;
+	double dblSum;
+	double dblLast;
+	unsigned long ulCount;
+} DIAG_VALUE_STATS;
+
+/// Monitor state.
+typedef struct _DIAG_MONITOR_STATUS
+{
+	unsigned long ulRequests;			/// diagnostics received
+	unsigned long ulDeferred;			/// requests postponed at least once by acquisition traffic
+	unsigned long ulFailed;				/// requests without valid response
+	unsigned long ulSramFailures;		/// samples with a failed SRAM test
+	double dblPollIntervalMs;			/// average acquisition poll interval
+	double dblRequestMs;				/// average diagnostic request duration
+} DIAG_MONITOR_STATUS;
+
+/** CDppDiagMonitor periodically requests DPP diagnostic data.
+	While acquisition polls run, a due request is made by the polling thread itself
+	(ServiceRequest after its transfer) in a gap longer than a request takes, so the
+	monitor thread never holds the USB between polls. When acquisition is idle the
+	monitor thread makes the request, and postpones it while the USB is in use.
+	Decoded supply rails, SRAM test results and PC5 values are kept as a history
+	with running statistics.
+*/
+class CDppDiagMonitor
+{
+public:
+	CDppDiagMonitor(void);
+	~CDppDiagMonitor(void);
+
+	/// Starts requesting diagnostics every lPeriodMs, RequestDiag makes one non-blocking attempt.
+	bool Start(long lPeriodMs, function<DIAG_REQUEST_RESULT(DiagDataType *Diag, int *iDeviceType)> RequestDiag);
+	/// Stops the monitor thread.
+	void Stop();
+	/// Notes an acquisition transfer (host monotonic ns), used to find the gaps between polls.
+	void NotePoll(long long llTimeNs);
+	/// Makes a due request on the calling (polling) thread if it fits before the next poll, call without the USB lock.
+	void ServiceRequest();
+	/// Adds decoded diagnostics (monitor requests or packets received elsewhere).
+	void AddDiagnostics(const DiagDataType *Diag, int iDeviceType, double dblRequestMs);
+	/// Clears the history and statistics.
+	void Reset();
+
+	/// Returns the newest sample, false if none yet.
+	bool GetLatest(DIAG_SAMPLE *Sample);
+	/// Copies the samples newer than dblSince (seconds since 1970) oldest first, returns the count.
+	long GetHistory(double dblSince, vector<DIAG_SAMPLE> *vSamples);
+	/// Returns the statistics of one value (0..DIAG_VALUE_COUNT-1).
+	bool GetStats(int idxValue, DIAG_VALUE_STATS *Stats);
+	/// Returns the monitor counters.
+	void GetStatus(DIAG_MONITOR_STATUS *Status);
+	/// Returns the value name for the device type, empty when the device does not report it.
+	string ValueName(int iDeviceType, int idxValue);
+	/// Formats the newest sample and statistics.
+	string ToString();
+
+private:
+	/// Monitor thread.
+	void MonitorThread();
+	/// Returns true while acquisition polls arrive at their average interval.
+	bool IsPolling(long long llNowNs);
+	/// Returns true if a request fits before the next expected acquisition poll.
+	bool IsQuietPeriod(long long llNowNs);
+	/// Makes one request on the calling thread and schedules the next.
+	void RunRequest();
+	/// Counts a postponed request once.
+	void NoteDeferred();
+	/// Host monotonic time (ns).
+	long long GetTimeNs();
+
+	function<DIAG_REQUEST_RESULT(DiagDataType *Diag, int *iDeviceType)> RequestDiagnostics;
+	long lPeriod;
+	atomic<bool> bRunning;
+	atomic<bool> bRequestDue;				/// request waiting for a gap, taken by exactly one thread
+	atomic<long long> llNextRequestNs;		/// time of the next request
+	bool bDeferred;							/// the due request was counted as deferred
+	atomic<long long> llLastPollNs;
+	atomic<double> dblPollIntervalMs;		/// exponential average of the poll intervals
+	double dblRequestMs;					/// exponential average of request durations
+	DIAG_SAMPLE History[DIAG_HISTORY_SIZE];
+	unsigned long ulNumSamples;
+	DIAG_VALUE_STATS ValueStats[DIAG_VALUE_COUNT];
+	DIAG_MONITOR_STATUS MonitorStatus;
+	mutex DiagLock;
+	condition_variable StopEvent;
+	thread MonitorThreadHandle;
+};
@@ -0,0 +1,509 @@
+#include "DppJournal.h"
+#include "DppLog.h"
+#include <string.h>
+#include <stddef.h>
+#include <chrono>
+#ifdef _WIN32
+	#include <io.h>
+#else
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
+
+#define JOURNAL_ALIGN(Size) (((Size) + 7) & ~(size_t)7)
+#define JOURNAL_CRC_START offsetof(JOURNAL_RECORD, uiType)
+
+static unsigned int CrcTable[8][256];
+static once_flag CrcTableOnce;
+
+// CrcTable[0] is the byte table, CrcTable[n] advances a byte by n more zero bytes
+static void MakeCrcTable()
+{
+	unsigned int uiCrc;
+	int idxByte, idxBit, idxTable;
+
+	for (idxByte=0;idxByte<256;idxByte++) {
+		uiCrc = (unsigned int)idxByte;
+		for (idxBit=0;idxBit<8;idxBit++) {
+			uiCrc = (uiCrc & 1) ? (0xEDB88320 ^ (uiCrc >> 1)) : (uiCrc >> 1);
+		}
+		CrcTable[0][idxByte] = uiCrc;
+	}
+	for (idxTable=1;idxTable<8;idxTable++) {
+		for (idxByte=0;idxByte<256;idxByte++) {
+			uiCrc = CrcTable[idxTable - 1][idxByte];
+			CrcTable[idxTable][idxByte] = (uiCrc >> 8) ^ CrcTable[0][uiCrc & 0xFF];
+		}
+	}
+}
+
+static double HostTime()
+{
+	return chrono::duration<double>(chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// CRC of a record header (from uiType) and its payload
+static unsigned int RecordCrc(const JOURNAL_RECORD *Record, const unsigned char *pPayload)
+{
+	unsigned int uiCrc;
+
+	uiCrc = CDppJournal::Crc32(0, (const unsigned char *)Record + JOURNAL_CRC_START, sizeof(JOURNAL_RECORD) - JOURNAL_CRC_START);
+	return CDppJournal::Crc32(uiCrc, pPayload, Record->uiLength);
+}
+
+CDppJournal::CDppJournal(void)
+{
+	bOpen = false;
+	iFile = -1;
+	JournalFile = NULL;
+	llWriteOffset = 0;
+	llAllocated = 0;
+	bGrown = false;
+	iSyncIntervalMs = JOURNAL_DEFAULT_SYNC_MS;
+	iSyncRecordCount = JOURNAL_DEFAULT_SYNC_RECORDS;
+	ullSequence = 0;
+	ullQueuedSequence = 0;
+	lQueuedRecords = 0;
+	bSyncRequest = false;
+	ullSyncRequested = 0;
+	ullSynced = 0;
+	bStopWriter = false;
+	bWriteFailed = false;
+	memset(&Stats, 0, sizeof(Stats));
+}
+
+CDppJournal::~CDppJournal(void)
+{
+	Close();
+}
+
+unsigned int CDppJournal::Crc32(unsigned int uiCrc, const unsigned char *pData, size_t iLength)
+{
+	unsigned int uiLow, uiHigh;
+
+	call_once(CrcTableOnce, MakeCrcTable);
+	uiCrc = ~uiCrc;
+	// eight bytes per step (slicing-by-8), a 4096 channel record takes a few microseconds
+	for (;iLength>=8;iLength-=8,pData+=8) {
+		uiLow = uiCrc ^ (pData[0] | (pData[1] << 8) | (pData[2] << 16) | ((unsigned int)pData[3] << 24));
+		uiHigh = pData[4] | (pData[5] << 8) | (pData[6] << 16) | ((unsigned int)pData[7] << 24);
+		uiCrc = CrcTable[7][uiLow & 0xFF] ^ CrcTable[6][(uiLow >> 8) & 0xFF] ^ CrcTable[5][(uiLow >> 16) & 0xFF] ^ CrcTable[4][uiLow >> 24]
+			^ CrcTable[3][uiHigh & 0xFF] ^ CrcTable[2][(uiHigh >> 8) & 0xFF] ^ CrcTable[1][(uiHigh >> 16) & 0xFF] ^ CrcTable[0][uiHigh >> 24];
+	}
+	for (;iLength>0;iLength--,pData++) {
+		uiCrc = CrcTable[0][(uiCrc ^ *pData) & 0xFF] ^ (uiCrc >> 8);
+	}
+	return ~uiCrc;
+}
+
+bool CDppJournal::Open(string strFilename, unsigned long ulSerialNumber, int iSyncMs, int iSyncRecords)
+{
+	vector<unsigned char> HeaderBytes(JOURNAL_HEADER_SIZE, 0);
+	JOURNAL_HEADER Header;
+
+	Close();
+	memset(&Header, 0, sizeof(Header));
+	Header.uiMagic = JOURNAL_MAGIC;
+	Header.uiVersion = JOURNAL_VERSION;
+	Header.uiHeaderSize = JOURNAL_HEADER_SIZE;
+	Header.uiSerialNumber = (unsigned int)ulSerialNumber;
+	Header.dblCreateTime = HostTime();
+	memcpy(&HeaderBytes[0], &Header, sizeof(Header));
+#ifdef _WIN32
+	if ((JournalFile = fopen(strFilename.c_str(), "w+b")) == NULL) {
+		DPP_LOG_ERROR("journal", "Couldn't create %s", strFilename.c_str());
+		return false;
+	}
+#else
+	if ((iFile = open(strFilename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644)) < 0) {
+		DPP_LOG_ERROR("journal", "Couldn't create %s", strFilename.c_str());
+		return false;
+	}
+#endif
+	llWriteOffset = 0;
+	llAllocated = 0;
+	bGrown = false;
+	if (!WriteBytes(&HeaderBytes[0], HeaderBytes.size()) || !SyncFile()) {
+		DPP_LOG_ERROR("journal", "Couldn't write %s", strFilename.c_str());
+#ifdef _WIN32
+		fclose(JournalFile);
+		JournalFile = NULL;
+#else
+		close(iFile);
+		iFile = -1;
+#endif
+		return false;
+	}
+	iSyncIntervalMs = (iSyncMs > 0) ? iSyncMs : JOURNAL_DEFAULT_SYNC_MS;
+	iSyncRecordCount = (iSyncRecords > 0) ? iSyncRecords : JOURNAL_DEFAULT_SYNC_RECORDS;
+	ullSequence = 0;
+	ullQueuedSequence = 0;
+	Queue.clear();
+	Queue.reserve(JOURNAL_QUEUE_RESERVE);
+	WriteBuffer.reserve(JOURNAL_QUEUE_RESERVE);
+	lQueuedRecords = 0;
+	bSyncRequest = false;
+	ullSyncRequested = 0;
+	ullSynced = 0;
+	bStopWriter = false;
+	bWriteFailed = false;
+	memset(&Stats, 0, sizeof(Stats));
+	bOpen = true;
+	WriterThreadHandle = thread(&CDppJournal::WriterThread, this);
+	return true;
+}
+
+bool CDppJournal::Close()
+{
+	bool bCloseOk;
+
+	if (!bOpen) {
+		return true;
+	}
+	if (WriterThreadHandle.joinable()) {
+		{
+			lock_guard<mutex> lock(QueueLock);
+			bStopWriter = true;
+		}
+		QueueChanged.notify_all();
+		WriterThreadHandle.join();
+	}
+	bOpen = false;
+	bCloseOk = !bWriteFailed;
+	// drop the unused preallocation, a closed journal ends at its last record
+#ifdef _WIN32
+	if (JournalFile != NULL) {
+		bCloseOk = bCloseOk && (_chsize_s(_fileno(JournalFile), llWriteOffset) == 0) && SyncFile();
+		bCloseOk = (fclose(JournalFile) == 0) && bCloseOk;
+		JournalFile = NULL;
+	}
+#else
+	if (iFile >= 0) {
+		bCloseOk = bCloseOk && (ftruncate(iFile, (off_t)llWriteOffset) == 0) && (fsync(iFile) == 0);
+		bCloseOk = (close(iFile) == 0) && bCloseOk;
+		iFile = -1;
+	}
+#endif
+	Queue.clear();
+	Queue.shrink_to_fit();
+	WriteBuffer.clear();
+	WriteBuffer.shrink_to_fit();
+	RecordBuffer.clear();
+	RecordBuffer.shrink_to_fit();
+	return bCloseOk;
+}
+
+unsigned char *CDppJournal::RecordPayload(size_t iLength)
+{
+	size_t iSize;
+
+	iSize = JOURNAL_ALIGN(sizeof(JOURNAL_RECORD) + iLength);
+	RecordBuffer.resize(iSize);
+	memset(&RecordBuffer[iSize - 8], 0, 8);
+	return &RecordBuffer[sizeof(JOURNAL_RECORD)];
+}
+
+bool CDppJournal::QueueRecord(JOURNAL_RECORD_TYPE Type, size_t iLength, long long llRxTimeNs)
+{
+	JOURNAL_RECORD Record;
+
+	{
+		// only appends grow the queue, the space checked here is still free below
+		lock_guard<mutex> lock(QueueLock);
+		if (bWriteFailed || ((Queue.size() + RecordBuffer.size()) > JOURNAL_MAX_QUEUE)) {
+			Stats.ullDropped++;
+			return false;
+		}
+	}
+	// the checksum is taken outside QueueLock so the writer thread isn't held up
+	memset(&Record, 0, sizeof(Record));
+	Record.uiMagic = JOURNAL_RECORD_MAGIC;
+	Record.uiType = (unsigned int)Type;
+	Record.uiLength = (unsigned int)iLength;
+	Record.ullSequence = ++ullSequence;
+	Record.dblHostTime = HostTime();
+	Record.llRxTimeNs = llRxTimeNs;
+	Record.uiCrc = RecordCrc(&Record, &RecordBuffer[sizeof(JOURNAL_RECORD)]);
+	memcpy(&RecordBuffer[0], &Record, sizeof(Record));
+	{
+		lock_guard<mutex> lock(QueueLock);
+		Queue.insert(Queue.end(), RecordBuffer.begin(), RecordBuffer.end());
+		ullQueuedSequence = Record.ullSequence;
+		lQueuedRecords++;
+		if (lQueuedRecords < iSyncRecordCount) {
+			return true;
+		}
+	}
+	QueueChanged.notify_one();
+	return true;
+}
+
+bool CDppJournal::AppendSpectrum(const long lData[], long lChannels, const unsigned char Status[], double dblLiveTime, double dblRealTime, long long llRxTimeNs)
+{
+	lock_guard<mutex> lock(AppendLock);
+	JOURNAL_SPECTRUM *Spectrum;
+	unsigned int *pCounts;
+	long idxChan;
+
+	if (!bOpen || (lData == NULL) || (lChannels <= 0) || (lChannels > JOURNAL_MAX_CHANNELS)) {
+		return false;
+	}
+	Spectrum = (JOURNAL_SPECTRUM *)RecordPayload(sizeof(JOURNAL_SPECTRUM) + lChannels * sizeof(unsigned int));
+	memset(Spectrum, 0, sizeof(JOURNAL_SPECTRUM));
+	Spectrum->uiChannels = (unsigned int)lChannels;
+	Spectrum->dblLiveTime = dblLiveTime;
+	Spectrum->dblRealTime = dblRealTime;
+	if (Status != NULL) {
+		Spectrum->uiFlags |= JOURNAL_FLAG_STATUS;
+		memcpy(Spectrum->Status, Status, JOURNAL_STATUS_SIZE);
+	}
+	pCounts = (unsigned int *)(Spectrum + 1);
+	for (idxChan=0;idxChan<lChannels;idxChan++) {
+		pCounts[idxChan] = (unsigned int)lData[idxChan];
+	}
+	return QueueRecord(jrtSpectrum, sizeof(JOURNAL_SPECTRUM) + lChannels * sizeof(unsigned int), llRxTimeNs);
+}
+
+bool CDppJournal::AppendStatus(const unsigned char Status[], long long llRxTimeNs)
+{
+	lock_guard<mutex> lock(AppendLock);
+
+	if (!bOpen || (Status == NULL)) {
+		return false;
+	}
+	memcpy(RecordPayload(JOURNAL_STATUS_SIZE), Status, JOURNAL_STATUS_SIZE);
+	return QueueRecord(jrtStatus, JOURNAL_STATUS_SIZE, llRxTimeNs);
+}
+
+bool CDppJournal::Sync()
+{
+	unique_lock<mutex> lock(QueueLock);
+
+	if (!bOpen) {
+		return false;
+	}
+	ullSyncRequested = ullQueuedSequence;
+	bSyncRequest = true;
+	QueueChanged.notify_all();
+	QueueChanged.wait(lock, [this] { return (ullSynced >= ullSyncRequested) || bWriteFailed || bStopWriter; });
+	return !bWriteFailed && (ullSynced >= ullSyncRequested);
+}
+
+JOURNAL_STATS CDppJournal::GetStats()
+{
+	lock_guard<mutex> lock(QueueLock);
+	return Stats;
+}
+
+void CDppJournal::WriterThread()
+{
+	unique_lock<mutex> lock(QueueLock);
+	unsigned long long ullBatchSequence;
+	long lBatchRecords;
+	bool bBatchOk;
+	double dblSyncMs;
+
+	while (true) {
+		QueueChanged.wait_for(lock, chrono::milliseconds(iSyncIntervalMs), [this] {
+			return bStopWriter || bSyncRequest || (lQueuedRecords >= iSyncRecordCount);
+		});
+		bSyncRequest = false;
+		if (!Queue.empty() && !bWriteFailed) {
+			// one write and one sync per batch, the poll thread keeps queueing meanwhile
+			WriteBuffer.swap(Queue);
+			Queue.clear();
+			lBatchRecords = lQueuedRecords;
+			lQueuedRecords = 0;
+			ullBatchSequence = ullQueuedSequence;
+			lock.unlock();
+			auto tStart = chrono::steady_clock::now();
+			bBatchOk = WriteBytes(&WriteBuffer[0], WriteBuffer.size()) && SyncFile();
+			dblSyncMs = chrono::duration<double, milli>(chrono::steady_clock::now() - tStart).count();
+			lock.lock();
+			if (bBatchOk) {
+				Stats.ullRecords += lBatchRecords;
+				Stats.ullBytes += WriteBuffer.size();
+				Stats.ullSyncs++;
+				if (dblSyncMs > Stats.dblMaxSyncMs) {
+					Stats.dblMaxSyncMs = dblSyncMs;
+				}
+				ullSynced = ullBatchSequence;
+			} else {
+				DPP_LOG_ERROR("journal", "Journal write failed at %lld, journaling stopped", llWriteOffset);
+				Stats.ullDropped += lBatchRecords;
+				bWriteFailed = true;
+			}
+			WriteBuffer.clear();
+		} else if (Queue.empty()) {
+			ullSynced = ullQueuedSequence;
+		}
+		QueueChanged.notify_all();
+		if (bStopWriter && (Queue.empty() || bWriteFailed)) {
+			break;
+		}
+	}
+}
+
+bool CDppJournal::WriteBytes(const unsigned char *pData, size_t iLength)
+{
+	long long llEnd;
+
+	llEnd = llWriteOffset + (long long)iLength;
+	if (llEnd > llAllocated) {
+		// preallocate in large steps so most syncs don't change the file size
+		llAllocated = ((llEnd + JOURNAL_GROW_SIZE - 1) / JOURNAL_GROW_SIZE) * JOURNAL_GROW_SIZE;
+#ifdef _WIN32
+		if (_chsize_s(_fileno(JournalFile), llAllocated) != 0) {
+			return false;
+		}
+#else
+		if ((posix_fallocate(iFile, 0, (off_t)llAllocated) != 0) && (ftruncate(iFile, (off_t)llAllocated) != 0)) {
+			return false;
+		}
+#endif
+		bGrown = true;
+	}
+#ifdef _WIN32
+	if ((_fseeki64(JournalFile, llWriteOffset, SEEK_SET) != 0) || (fwrite(pData, 1, iLength, JournalFile) != iLength)) {
+		return false;
+	}
+#else
+	size_t iWritten;
+	ssize_t iResult;
+
+	for (iWritten=0;iWritten<iLength;iWritten+=(size_t)iResult) {
+		iResult = pwrite(iFile, pData + iWritten, iLength - iWritten, (off_t)(llWriteOffset + (long long)iWritten));
+		if (iResult <= 0) {
+			return false;
+		}
+	}
+#endif
+	llWriteOffset = llEnd;
+	return true;
+}
+
+bool CDppJournal::SyncFile()
+{
+#ifdef _WIN32
+	if ((fflush(JournalFile) != 0) || (_commit(_fileno(JournalFile)) != 0)) {
+		return false;
+	}
+#elif defined(__linux__)
+	// the size only changes when the file grows, the data sync is enough otherwise
+	if ((bGrown ? fsync(iFile) : fdatasync(iFile)) != 0) {
+		return false;
+	}
+#else
+	if (fsync(iFile) != 0) {
+		return false;
+	}
+#endif
+	bGrown = false;
+	return true;
+}
+
+bool CDppJournal::ReadRecords(string strFilename, JOURNAL_RECOVERY *Recovery, function<void(const JOURNAL_RECORD *, const unsigned char *)> OnRecord)
+{
+	FILE *ReadFile;
+	JOURNAL_HEADER Header;
+	JOURNAL_RECORD Record;
+	JOURNAL_SPECTRUM Spectrum;
+	vector<unsigned char> Payload;
+	size_t iPadding, iMaxLength;
+	const unsigned int *pCounts;
+	unsigned int idxChan;
+	char Padding[8];
+
+	if (Recovery == NULL) {
+		return false;
+	}
+	Recovery->uiSerialNumber = 0;
+	Recovery->lRecords = 0;
+	Recovery->lSpectra = 0;
+	Recovery->ullLastSequence = 0;
+	Recovery->dblLastTime = 0;
+	Recovery->llValidBytes = 0;
+	Recovery->bTornRecord = false;
+	Recovery->vLastSpectrum.clear();
+	Recovery->dblLiveTime = 0;
+	Recovery->dblRealTime = 0;
+	Recovery->bHaveStatus = false;
+	memset(Recovery->LastStatus, 0, sizeof(Recovery->LastStatus));
+	if ((ReadFile = fopen(strFilename.c_str(), "rb")) == NULL) {
+		return false;
+	}
+	setvbuf(ReadFile, NULL, _IOFBF, 1 << 20);
+	if ((fread(&Header, sizeof(Header), 1, ReadFile) != 1) || (Header.uiMagic != JOURNAL_MAGIC)
+		|| (Header.uiVersion != JOURNAL_VERSION) || (Header.uiHeaderSize < sizeof(Header))) {
+		fclose(ReadFile);
+		return false;
+	}
+	Recovery->uiSerialNumber = Header.uiSerialNumber;
+	Recovery->llValidBytes = Header.uiHeaderSize;
+	if (fseek(ReadFile, (long)Header.uiHeaderSize, SEEK_SET) != 0) {
+		fclose(ReadFile);
+		return false;
+	}
+	iMaxLength = sizeof(JOURNAL_SPECTRUM) + JOURNAL_MAX_CHANNELS * sizeof(unsigned int);
+	// records are valid up to the end of the data, a damaged record or a sequence gap
+	while (fread(&Record, sizeof(Record), 1, ReadFile) == 1) {
+		if (Record.uiMagic != JOURNAL_RECORD_MAGIC) {
+			// zeros are the unused preallocation
+			Recovery->bTornRecord = (Record.uiMagic != 0);
+			break;
+		}
+		Recovery->bTornRecord = true;
+		if ((Record.ullSequence != (Recovery->ullLastSequence + 1)) || (Record.uiLength > iMaxLength)) {
+			break;
+		}
+		Payload.resize(Record.uiLength + 1);
+		iPadding = JOURNAL_ALIGN(sizeof(Record) + Record.uiLength) - sizeof(Record) - Record.uiLength;
+		if ((fread(&Payload[0], 1, Record.uiLength, ReadFile) != Record.uiLength)
+			|| (fread(Padding, 1, iPadding, ReadFile) != iPadding)
+			|| (RecordCrc(&Record, &Payload[0]) != Record.uiCrc)) {
+			break;
+		}
+		if (Record.uiType == jrtSpectrum) {
+			if (Record.uiLength < sizeof(Spectrum)) {
+				break;
+			}
+			memcpy(&Spectrum, &Payload[0], sizeof(Spectrum));
+			if ((Spectrum.uiChannels == 0) || (Record.uiLength != (sizeof(Spectrum) + Spectrum.uiChannels * sizeof(unsigned int)))) {
+				break;
+			}
+			pCounts = (const unsigned int *)&Payload[sizeof(Spectrum)];
+			Recovery->vLastSpectrum.resize(Spectrum.uiChannels);
+			for (idxChan=0;idxChan<Spectrum.uiChannels;idxChan++) {
+				Recovery->vLastSpectrum[idxChan] = (long)pCounts[idxChan];
+			}
+			Recovery->dblLiveTime = Spectrum.dblLiveTime;
+			Recovery->dblRealTime = Spectrum.dblRealTime;
+			if (Spectrum.uiFlags & JOURNAL_FLAG_STATUS) {
+				memcpy(Recovery->LastStatus, Spectrum.Status, JOURNAL_STATUS_SIZE);
+				Recovery->bHaveStatus = true;
+			}
+			Recovery->lSpectra++;
+		} else if (Record.uiType == jrtStatus) {
+			if (Record.uiLength != JOURNAL_STATUS_SIZE) {
+				break;
+			}
+			memcpy(Recovery->LastStatus, &Payload[0], JOURNAL_STATUS_SIZE);
+			Recovery->bHaveStatus = true;
+		}
+		Recovery->bTornRecord = false;
+		Recovery->lRecords++;
+		Recovery->ullLastSequence = Record.ullSequence;
+		Recovery->dblLastTime = Record.dblHostTime;
+		Recovery->llValidBytes += (long long)JOURNAL_ALIGN(sizeof(Record) + Record.uiLength);
+		if (OnRecord) {
+			OnRecord(&Record, &Payload[0]);
+		}
+	}
+	fclose(ReadFile);
+	return true;
+}
+
+bool CDppJournal::Recover(string strFilename, JOURNAL_RECOVERY *Recovery)
+{
+	return ReadRecords(strFilename, Recovery, nullptr);
+}
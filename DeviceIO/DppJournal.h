@@ -0,0 +1,165 @@
+/** CDppJournal CDppJournal */
+#pragma once
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <functional>
+#include <condition_variable>
+using namespace std;
+
+#define JOURNAL_MAGIC 0x4A505044			/// "DPPJ" file header
+#define JOURNAL_RECORD_MAGIC 0x52505044		/// "DPPR" record
+#define JOURNAL_VERSION 1
+#define JOURNAL_HEADER_SIZE 4096			/// records start on the second page
+#define JOURNAL_STATUS_SIZE 64				/// raw DPP status packet
+#define JOURNAL_MAX_CHANNELS 16384
+#define JOURNAL_GROW_SIZE (32 << 20)		/// preallocation step
+#define JOURNAL_MAX_QUEUE (16 << 20)		/// queued bytes before records are dropped
+#define JOURNAL_QUEUE_RESERVE (4 << 20)		/// queue capacity allocated by Open
+#define JOURNAL_DEFAULT_SYNC_MS 200			/// default sync interval
+#define JOURNAL_DEFAULT_SYNC_RECORDS 64		/// default records per sync
+
+#define JOURNAL_FLAG_STATUS 0x0001			/// spectrum record holds a raw status
+
+/// Journal record type.
+typedef enum _JOURNAL_RECORD_TYPE
+{
+	jrtSpectrum = 1,		/// JOURNAL_SPECTRUM and counts
+	jrtStatus = 2			/// raw status packet
+} JOURNAL_RECORD_TYPE;
+
+/// File header (first page).
+typedef struct _JOURNAL_HEADER
+{
+	unsigned int uiMagic;
+	unsigned int uiVersion;
+	unsigned int uiHeaderSize;
+	unsigned int uiSerialNumber;
+	double dblCreateTime;				/// seconds since 1970
+} JOURNAL_HEADER;
+
+/// Record header, followed by uiLength payload bytes (records padded to 8 bytes).
+typedef struct _JOURNAL_RECORD
+{
+	unsigned int uiMagic;
+	unsigned int uiCrc;					/// CRC-32 of the header from uiType and the payload
+	unsigned int uiType;				/// JOURNAL_RECORD_TYPE
+	unsigned int uiLength;
+	unsigned long long ullSequence;		/// 1 for the first record
+	double dblHostTime;					/// seconds since 1970
+	long long llRxTimeNs;				/// host monotonic USB completion time (0 if unknown)
+} JOURNAL_RECORD;
+
+/// Spectrum record payload, followed by uiChannels 32 bit counts.
+typedef struct _JOURNAL_SPECTRUM
+{
+	unsigned int uiChannels;
+	unsigned int uiFlags;				/// JOURNAL_FLAG_*
+	double dblLiveTime;					/// accumulation time (s)
+	double dblRealTime;					/// real time (s)
+	unsigned char Status[JOURNAL_STATUS_SIZE];
+} JOURNAL_SPECTRUM;
+
+/// Last consistent state of a journal.
+typedef struct _JOURNAL_RECOVERY
+{
+	unsigned int uiSerialNumber;
+	long lRecords;						/// valid records
+	long lSpectra;
+	unsigned long long ullLastSequence;
+	double dblLastTime;					/// host time of the last record
+	long long llValidBytes;				/// file bytes up to the last valid record
+	bool bTornRecord;					/// a partly written or damaged record follows
+	vector<long> vLastSpectrum;
+	double dblLiveTime;					/// of the last spectrum
+	double dblRealTime;
+	bool bHaveStatus;
+	unsigned char LastStatus[JOURNAL_STATUS_SIZE];
+} JOURNAL_RECOVERY;
+
+/// Journal writer counters.
+typedef struct _JOURNAL_STATS
+{
+	unsigned long long ullRecords;		/// records written
+	unsigned long long ullBytes;
+	unsigned long long ullSyncs;
+	unsigned long long ullDropped;		/// records dropped (queue full or write error)
+	double dblMaxSyncMs;				/// longest sync
+} JOURNAL_STATS;
+
+/** CDppJournal is a write-ahead journal of the acquired spectra and status packets.
+	Records are checksummed and copied to a queue, a writer thread appends them to a
+	preallocated file and syncs it after a time interval or record count, so the poll
+	loop never waits for the disk. Recover returns the last consistent state after a
+	crash: records are valid up to the first bad checksum or sequence number.
+*/
+class CDppJournal
+{
+public:
+	CDppJournal(void);
+	~CDppJournal(void);
+
+	/// Creates the journal and starts the writer thread.
+	bool Open(string strFilename, unsigned long ulSerialNumber, int iSyncMs = JOURNAL_DEFAULT_SYNC_MS, int iSyncRecords = JOURNAL_DEFAULT_SYNC_RECORDS);
+	/// Writes the queued records, syncs and closes the journal.
+	bool Close();
+	/// True while open.
+	bool IsOpen() { return bOpen; }
+	/// Queues a spectrum record, Status is the raw status packet or NULL.
+	bool AppendSpectrum(const long lData[], long lChannels, const unsigned char Status[], double dblLiveTime, double dblRealTime, long long llRxTimeNs);
+	/// Queues a status record.
+	bool AppendStatus(const unsigned char Status[], long long llRxTimeNs);
+	/// Waits until all queued records are written and synced.
+	bool Sync();
+	/// Writer counters.
+	JOURNAL_STATS GetStats();
+
+	/// Calls OnRecord for each valid record, returns the recovery state.
+	static bool ReadRecords(string strFilename, JOURNAL_RECOVERY *Recovery, function<void(const JOURNAL_RECORD *, const unsigned char *)> OnRecord);
+	/// Returns the last consistent state of a journal.
+	static bool Recover(string strFilename, JOURNAL_RECOVERY *Recovery);
+	/// CRC-32 (IEEE 802.3).
+	static unsigned int Crc32(unsigned int uiCrc, const unsigned char *pData, size_t iLength);
+
+private:
+	/// Sizes RecordBuffer for a payload, returns the payload position.
+	unsigned char *RecordPayload(size_t iLength);
+	/// Completes the record in RecordBuffer and copies it to the queue (called with AppendLock held).
+	bool QueueRecord(JOURNAL_RECORD_TYPE Type, size_t iLength, long long llRxTimeNs);
+	/// Writer thread.
+	void WriterThread();
+	/// Writes bytes at the end of the journal, growing the preallocation.
+	bool WriteBytes(const unsigned char *pData, size_t iLength);
+	/// Forces written data to disk.
+	bool SyncFile();
+
+	atomic<bool> bOpen;
+	int iFile;							/// POSIX file descriptor
+	FILE *JournalFile;					/// Windows
+	long long llWriteOffset;
+	long long llAllocated;
+	bool bGrown;						/// size changed since the last sync
+	int iSyncIntervalMs;
+	int iSyncRecordCount;
+
+	mutex AppendLock;					/// RecordBuffer and ullSequence
+	vector<unsigned char> RecordBuffer;	/// record being built
+	unsigned long long ullSequence;		/// last record built
+
+	mutex QueueLock;					/// queue, flags and stats
+	condition_variable QueueChanged;
+	vector<unsigned char> Queue;		/// records waiting for the writer
+	vector<unsigned char> WriteBuffer;	/// records being written
+	long lQueuedRecords;
+	unsigned long long ullQueuedSequence;	/// last record queued
+	bool bSyncRequest;
+	unsigned long long ullSyncRequested;	/// sequence the last Sync waits for
+	unsigned long long ullSynced;		/// last synced sequence
+	bool bStopWriter;
+	bool bWriteFailed;
+	JOURNAL_STATS Stats;
+	thread WriterThreadHandle;
+};
@@ -1,9 +1,12 @@
 #include "DppLibUsb.h"
+#include "DppTrace.h"
 #include <iostream>
+#include <chrono>
 
 CDppLibUsb::CDppLibUsb(void)
 {
-
+	llTxTimeNs = 0;
+	llRxTimeNs = 0;
 }
 CDppLibUsb::~CDppLibUsb(void)
 {
@@ -112,6 +115,7 @@ int CDppLibUsb::SendPacketUSB(libusb_device_handle *devh, unsigned char data_out
 	unsigned int timeout = 5000;
 	int result = 0;
 	int length = 0; 
+	long long llOutDoneNs;
 	
 	if ((data_out[2] == PID1_REQ_SCOPE_MISC_TO) && data_out[3] == PID2_SEND_DIAGNOSTIC_DATA_TO) {
 		timeout = DP5_DIAGDATA_TIMEOUT;
@@ -124,9 +128,18 @@ int CDppLibUsb::SendPacketUSB(libusb_device_handle *devh, unsigned char data_out
 	length += data_out[5];
 	length += 8;
 
+	llTxTimeNs = GetTimeNs();
 	result = libusb_bulk_transfer(devh, BULK_OUT_ENDPOINT, data_out, length, &bytes_transferred, timeout);
+	llOutDoneNs = GetTimeNs();
+	if (DppTrace.IsEnabled()) {
+		DppTrace.AddSpan("bulk_out", llTxTimeNs, llOutDoneNs, (result >= 0) ? length : result);
+	}
 	if (result >= 0) {
 	  	result = libusb_bulk_transfer(devh, BULK_IN_ENDPOINT, data_in, MAX_BULK_IN_TRANSFER_SIZE, &bytes_transferred, timeout);
+		llRxTimeNs = GetTimeNs();		// stamp at completion, before any processing
+		if (DppTrace.IsEnabled()) {
+			DppTrace.AddSpan("bulk_in", llOutDoneNs, llRxTimeNs, (result >= 0) ? bytes_transferred : result);
+		}
 		if (result >= 0) {
 			if (bytes_transferred > 0) {
 				return bytes_transferred;
@@ -139,12 +152,19 @@ int CDppLibUsb::SendPacketUSB(libusb_device_handle *devh, unsigned char data_out
 			return result;
 		}
 	} else {
+		llRxTimeNs = GetTimeNs();
 		// fprintf(stderr, "Error sending data via bulk transfer %d\n", result);
 		return result;
 	}
   	return 0;
  }
 
+// monotonic host clock for packet timestamps
+long long CDppLibUsb::GetTimeNs()
+{
+	return (long long)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
 bool CDppLibUsb::isAmptekDP5Device(libusb_device_descriptor desc)
 {
 	bool isDevice=false;
@@ -49,12 +49,15 @@ public:
 	bool bDeviceReady;
 	char LastLibUsbError[256];
 	bool bDeviceConnected;
+	long long llTxTimeNs;		// host monotonic time when the last request was sent (ns)
+	long long llRxTimeNs;		// host monotonic time when the last transfer completed (ns)
 
 	int InitializeLibusb();
 	void DeinitializeLibusb();
 	libusb_device_handle * FindUSBDevice(int idxAmptekDevice);
 	void CloseUSBDevice(libusb_device_handle * devh);
 	int SendPacketUSB(libusb_device_handle *devh, unsigned char data_out[], unsigned char data_in[]);
+	long long GetTimeNs();
 	bool isAmptekDP5Device(libusb_device_descriptor desc);
 	int CountDP5LibusbDevices();
 	void PrintDevices();
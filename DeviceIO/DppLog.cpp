@@ -0,0 +1,328 @@
+#include "DppLog.h"
+#include <string.h>
+#include <stdarg.h>
+#include <time.h>
+#include <chrono>
+#include <algorithm>
+
+#define LOG_ALIGN(Size) (((Size) + 7) & ~7U)
+
+static const char *LogLevelNames[] = { "trace", "debug", "info", "warn", "error", "off" };
+
+// ring of the calling thread, kept alive by the logger after the thread exits
+static thread_local shared_ptr<LOG_RING> ThreadRing;
+
+CDppLog &GetDppLog()
+{
+	static CDppLog DppLog;
+	return DppLog;
+}
+
+CDppLog::CDppLog(void)
+{
+	iMinLevel = LOG_LEVEL_INFO;
+	OutputFormat = lfPlain;
+	ulDropped = 0;
+	bStopReq = false;
+	bSinkRunning = false;
+	ullNextSequence = 0;
+	uiNextThread = 1;
+	LogFile = NULL;
+}
+
+CDppLog::~CDppLog(void)
+{
+	Stop();
+	if (LogFile != NULL) {
+		fclose(LogFile);
+	}
+}
+
+void CDppLog::SetLevel(int iLevel)
+{
+	iMinLevel = iLevel;
+}
+
+void CDppLog::SetFormat(LOG_FORMAT Format)
+{
+	OutputFormat = Format;
+}
+
+bool CDppLog::SetFile(string strFilename)
+{
+	FILE *NewFile;
+
+	NewFile = NULL;
+	if (strFilename.length() > 0) {
+		if ((NewFile = fopen(strFilename.c_str(), "ab")) == NULL) {
+			return false;
+		}
+	}
+	Flush();
+	lock_guard<mutex> Lock(RingLock);
+	if (LogFile != NULL) {
+		fclose(LogFile);
+	}
+	LogFile = NewFile;
+	return true;
+}
+
+unsigned long CDppLog::Dropped()
+{
+	return ulDropped;
+}
+
+LOG_RING *CDppLog::GetThreadRing()
+{
+	if (! ThreadRing) {
+		ThreadRing = make_shared<LOG_RING>();
+		ThreadRing->ullHead = 0;
+		ThreadRing->ullTail = 0;
+		lock_guard<mutex> Lock(RingLock);
+		ThreadRing->uiThread = uiNextThread++;
+		vRings.push_back(ThreadRing);
+		if (! bSinkRunning && ! bStopReq) {
+			bSinkRunning = true;
+			SinkThreadHandle = thread(&CDppLog::SinkThread, this);
+		}
+	}
+	return ThreadRing.get();
+}
+
+bool CDppLog::Queue(int iLevel, const char *Component, unsigned short usFlags, const LOG_RECORD_HEADER *Fields, const char *Message, int iLength)
+{
+	LOG_RECORD_HEADER *Header;
+	LOG_RING *Ring;
+	unsigned int uiSize;
+	unsigned int uiPos;
+	unsigned int uiContiguous;
+	unsigned long long ullHead;
+
+	Ring = GetThreadRing();
+	uiSize = LOG_ALIGN(sizeof(LOG_RECORD_HEADER) + iLength + 1);
+	ullHead = Ring->ullHead.load(memory_order_relaxed);
+	uiPos = (unsigned int)(ullHead & (LOG_RING_SIZE - 1));
+	uiContiguous = LOG_RING_SIZE - uiPos;
+	// records are contiguous, the end of the ring is skipped when the record does not fit
+	if (((uiContiguous < uiSize) ? uiContiguous + uiSize : uiSize) > LOG_RING_SIZE - (ullHead - Ring->ullTail.load(memory_order_acquire))) {
+		return false;
+	}
+	if (uiContiguous < uiSize) {
+		Header = (LOG_RECORD_HEADER *)&Ring->Data[uiPos];
+		Header->uiSize = uiContiguous;
+		Header->bPadding = 1;
+		ullHead += uiContiguous;
+		uiPos = 0;
+	}
+	Header = (LOG_RECORD_HEADER *)&Ring->Data[uiPos];
+	if (Fields != NULL) {
+		*Header = *Fields;
+	}
+	Header->uiSize = uiSize;
+	Header->bPadding = 0;
+	Header->Level = (unsigned char)iLevel;
+	Header->usFlags = usFlags;
+	Header->llTimeNs = (long long)chrono::duration_cast<chrono::nanoseconds>(chrono::system_clock::now().time_since_epoch()).count();
+	Header->ullSequence = ullNextSequence++;
+	Header->Component = Component;
+	Header->uiThread = Ring->uiThread;
+	memcpy(&Ring->Data[uiPos + sizeof(LOG_RECORD_HEADER)], Message, iLength);
+	Ring->Data[uiPos + sizeof(LOG_RECORD_HEADER) + iLength] = 0;
+	Ring->ullHead.store(ullHead + uiSize, memory_order_release);
+	return true;
+}
+
+void CDppLog::Write(int iLevel, const char *Component, const char *Format, ...)
+{
+	static thread_local char Message[LOG_MAX_MESSAGE];
+	va_list Args;
+	int iLength;
+
+	va_start(Args, Format);
+	iLength = vsnprintf(Message, sizeof(Message), Format, Args);
+	va_end(Args);
+	if (iLength < 0) {
+		return;
+	}
+	if (iLength >= LOG_MAX_MESSAGE) {
+		iLength = LOG_MAX_MESSAGE - 1;
+	}
+	if (! Queue(iLevel, Component, 0, NULL, Message, iLength)) {
+		ulDropped++;
+	}
+}
+
+void CDppLog::WritePacket(int iLevel, const char *Component, int iPacket, unsigned char PID1, unsigned char PID2, long long llLatencyNs, const char *Format, ...)
+{
+	static thread_local char Message[LOG_MAX_MESSAGE];
+	LOG_RECORD_HEADER Fields;
+	va_list Args;
+	int iLength;
+
+	va_start(Args, Format);
+	iLength = vsnprintf(Message, sizeof(Message), Format, Args);
+	va_end(Args);
+	if (iLength < 0) {
+		return;
+	}
+	if (iLength >= LOG_MAX_MESSAGE) {
+		iLength = LOG_MAX_MESSAGE - 1;
+	}
+	memset(&Fields, 0, sizeof(Fields));
+	Fields.iPacket = iPacket;
+	Fields.PID1 = PID1;
+	Fields.PID2 = PID2;
+	Fields.llLatencyNs = llLatencyNs;
+	if (! Queue(iLevel, Component, LOG_FLAG_PACKET, &Fields, Message, iLength)) {
+		ulDropped++;
+	}
+}
+
+// console text is split into LOG_MAX_MESSAGE pieces, a full ring is drained on the calling thread
+void CDppLog::WriteText(const string &strText)
+{
+	size_t lPos;
+	int iLength;
+
+	for (lPos=0;lPos<strText.length();lPos+=iLength) {
+		iLength = (int)min(strText.length() - lPos, (size_t)(LOG_MAX_MESSAGE - 1));
+		if (! Queue(LOG_LEVEL_OFF, NULL, LOG_FLAG_TEXT, NULL, strText.c_str() + lPos, iLength)) {
+			DrainRings();		// the ring is empty afterwards, the piece fits
+			Queue(LOG_LEVEL_OFF, NULL, LOG_FLAG_TEXT, NULL, strText.c_str() + lPos, iLength);
+		}
+	}
+}
+
+void CDppLog::FormatRecord(const LOG_RECORD_HEADER *Header, const char *Message, string *strOut)
+{
+	char TimeText[64];
+	time_t tSeconds;
+	struct tm tmTime;
+	const char *pChar;
+
+	if (Header->usFlags & LOG_FLAG_TEXT) {
+		*strOut += Message;
+		return;
+	}
+	if (OutputFormat == lfPlain) {
+		*strOut += Message;
+		*strOut += "\n";
+		return;
+	}
+	tSeconds = (time_t)(Header->llTimeNs / 1000000000LL);
+#ifdef _WIN32
+	gmtime_s(&tmTime, &tSeconds);
+#else
+	gmtime_r(&tSeconds, &tmTime);
+#endif
+	strftime(TimeText, sizeof(TimeText), "%Y-%m-%dT%H:%M:%S", &tmTime);
+	*strOut += "time=";
+	*strOut += TimeText;
+	snprintf(TimeText, sizeof(TimeText), ".%06ldZ level=%s thread=%u", (long)((Header->llTimeNs / 1000) % 1000000), LogLevelNames[Header->Level < LOG_LEVEL_OFF ? Header->Level : LOG_LEVEL_OFF], Header->uiThread);
+	*strOut += TimeText;
+	if (Header->Component != NULL) {
+		*strOut += " comp=";
+		*strOut += Header->Component;
+	}
+	if (Header->usFlags & LOG_FLAG_PACKET) {
+		snprintf(TimeText, sizeof(TimeText), " pkt=%d pid1=%u pid2=%u latency_us=%.1f", Header->iPacket, (unsigned int)Header->PID1, (unsigned int)Header->PID2, Header->llLatencyNs * 1.0e-3);
+		*strOut += TimeText;
+	}
+	*strOut += " msg=\"";
+	for (pChar=Message;*pChar!=0;pChar++) {
+		switch (*pChar) {
+			case '"': *strOut += "\\\""; break;
+			case '\\': *strOut += "\\\\"; break;
+			case '\n': *strOut += "\\n"; break;
+			case '\r': break;
+			default: *strOut += *pChar; break;
+		}
+	}
+	*strOut += "\"\n";
+}
+
+// records of all rings are written in queue order, console text to stdout and
+// log messages to the log file if one is set
+long CDppLog::DrainRings()
+{
+	const LOG_RECORD_HEADER *Header;
+	LOG_RING *Ring;
+	vector<const LOG_RECORD_HEADER *> vRecords;
+	vector<unsigned long long> vHeads;
+	string strConsole;
+	string strFile;
+	unsigned long long ullTail;
+	size_t idxRing;
+	size_t idxRecord;
+
+	lock_guard<mutex> Lock(RingLock);
+	vHeads.resize(vRings.size());
+	for (idxRing=0;idxRing<vRings.size();idxRing++) {
+		Ring = vRings[idxRing].get();
+		ullTail = Ring->ullTail.load(memory_order_relaxed);
+		vHeads[idxRing] = Ring->ullHead.load(memory_order_acquire);
+		while (ullTail != vHeads[idxRing]) {
+			Header = (const LOG_RECORD_HEADER *)&Ring->Data[ullTail & (LOG_RING_SIZE - 1)];
+			if (! Header->bPadding) {
+				vRecords.push_back(Header);
+			}
+			ullTail += Header->uiSize;
+		}
+	}
+	// each ring is in order already, the sort interleaves the threads
+	sort(vRecords.begin(), vRecords.end(), [](const LOG_RECORD_HEADER *A, const LOG_RECORD_HEADER *B) { return A->ullSequence < B->ullSequence; });
+	for (idxRecord=0;idxRecord<vRecords.size();idxRecord++) {
+		Header = vRecords[idxRecord];
+		FormatRecord(Header, (const char *)(Header + 1), ((LogFile == NULL) || (Header->usFlags & LOG_FLAG_TEXT)) ? &strConsole : &strFile);
+	}
+	for (idxRing=0;idxRing<vHeads.size();idxRing++) {
+		vRings[idxRing]->ullTail.store(vHeads[idxRing], memory_order_release);
+	}
+	// rings of exited threads are released once empty
+	for (idxRing=vRings.size();idxRing>0;idxRing--) {
+		if ((vRings[idxRing - 1].use_count() == 1) && (vRings[idxRing - 1]->ullHead == vRings[idxRing - 1]->ullTail)) {
+			vRings.erase(vRings.begin() + (idxRing - 1));
+		}
+	}
+	if (strFile.length() > 0) {
+		fwrite(strFile.c_str(), 1, strFile.length(), LogFile);
+		fflush(LogFile);
+	}
+	if (strConsole.length() > 0) {
+		fwrite(strConsole.c_str(), 1, strConsole.length(), stdout);
+		fflush(stdout);
+	}
+	return (long)vRecords.size();
+}
+
+void CDppLog::SinkThread()
+{
+	long lRecords;
+
+	for (;;) {
+		lRecords = DrainRings();
+		if (bStopReq) {
+			DrainRings();
+			break;
+		}
+		if (lRecords == 0) {
+			this_thread::sleep_for(chrono::milliseconds(LOG_SINK_POLL_MS));
+		}
+	}
+}
+
+// drains on the calling thread, RingLock keeps the sink thread out (use before writing
+// to stdout directly or reading console input)
+void CDppLog::Flush()
+{
+	DrainRings();
+}
+
+void CDppLog::Stop()
+{
+	bStopReq = true;
+	if (SinkThreadHandle.joinable()) {
+		SinkThreadHandle.join();
+	}
+	bSinkRunning = false;
+}
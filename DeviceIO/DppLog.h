@@ -0,0 +1,181 @@
+/** CDppLog CDppLog */
+#pragma once
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <memory>
+#include <sstream>
+using namespace std;
+
+#define LOG_LEVEL_TRACE 0
+#define LOG_LEVEL_DEBUG 1
+#define LOG_LEVEL_INFO 2
+#define LOG_LEVEL_WARN 3
+#define LOG_LEVEL_ERROR 4
+#define LOG_LEVEL_OFF 5
+
+// messages below DPP_LOG_LEVEL are removed at compile time
+#ifndef DPP_LOG_LEVEL
+	#ifdef _DEBUG
+		#define DPP_LOG_LEVEL LOG_LEVEL_DEBUG
+	#else
+		#define DPP_LOG_LEVEL LOG_LEVEL_INFO
+	#endif
+#endif
+
+#define LOG_RING_SIZE 65536				/// bytes buffered per logging thread (power of 2)
+#define LOG_MAX_MESSAGE 8192			/// longest message, longer messages are truncated
+#define LOG_SINK_POLL_MS 10				/// sink thread idle wait
+
+#define LOG_FLAG_TEXT 0x0001			/// console text, written as is to stdout at any level
+#define LOG_FLAG_PACKET 0x0002			/// record carries the packet fields
+
+/// Log output formats.
+typedef enum _LOG_FORMAT
+{
+	lfPlain,			/// message only (console)
+	lfLogfmt			/// time, level, thread, component, packet fields and quoted message
+} LOG_FORMAT;
+
+/// Record header in the thread ring, followed by the message.
+typedef struct _LOG_RECORD_HEADER
+{
+	unsigned int uiSize;		/// record bytes including header, 8 byte aligned
+	unsigned char bPadding;		/// skip to the ring start
+	unsigned char Level;
+	unsigned short usFlags;		/// LOG_FLAG_*
+	long long llTimeNs;			/// host time (ns since 1970)
+	unsigned long long ullSequence;	/// queue order across threads
+	const char *Component;		/// string literal
+	unsigned int uiThread;		/// logging thread number
+	int iPacket;				/// packet type, request command or parsed packet (LOG_FLAG_PACKET)
+	long long llLatencyNs;		/// request to response time (LOG_FLAG_PACKET)
+	unsigned char PID1;			/// response PID1 (LOG_FLAG_PACKET)
+	unsigned char PID2;			/// response PID2 (LOG_FLAG_PACKET)
+	unsigned short usReserved;
+	unsigned int uiReserved;
+} LOG_RECORD_HEADER;
+
+/// Per thread single producer ring.
+typedef struct _LOG_RING
+{
+	unsigned char Data[LOG_RING_SIZE];
+	atomic<unsigned long long> ullHead;		/// written bytes (logging thread)
+	atomic<unsigned long long> ullTail;		/// read bytes (sink thread)
+	unsigned int uiThread;
+} LOG_RING;
+
+/** CDppLog is an asynchronous leveled logger.
+	Each logging thread formats into its own lock-free ring, a sink thread writes
+	the records to stdout or a file, so logging never waits for console or disk.
+	Console text (WriteText, CDppLogText) goes through the same rings, and the sink
+	writes records in the order they were queued, so no flush is needed between them.
+	Use the DPP_LOG_* macros, levels below DPP_LOG_LEVEL are compiled out.
+*/
+class CDppLog
+{
+public:
+	CDppLog(void);
+	~CDppLog(void);
+
+	/// Sets the runtime level (LOG_LEVEL_*).
+	void SetLevel(int iLevel);
+	/// Returns true if messages of the level are written.
+	bool IsEnabled(int iLevel) { return (iLevel >= iMinLevel); }
+	/// Writes to a file (appends), empty filename writes to stdout.
+	bool SetFile(string strFilename);
+	/// Sets the output format.
+	void SetFormat(LOG_FORMAT Format);
+	/// Queues a printf formatted message.
+	void Write(int iLevel, const char *Component, const char *Format, ...);
+	/// Queues a printf formatted message with packet type, response PIDs and latency fields.
+	void WritePacket(int iLevel, const char *Component, int iPacket, unsigned char PID1, unsigned char PID2, long long llLatencyNs, const char *Format, ...);
+	/// Queues console text for stdout (not level filtered, never dropped).
+	void WriteText(const string &strText);
+	/// Writes all queued messages before returning (call before writing to the console directly).
+	void Flush();
+	/// Messages dropped because a thread ring was full.
+	unsigned long Dropped();
+	/// Writes all queued messages and stops the sink thread.
+	void Stop();
+
+private:
+	/// Returns the ring of the calling thread.
+	LOG_RING *GetThreadRing();
+	/// Copies a record into the ring of the calling thread, false if the ring is full.
+	bool Queue(int iLevel, const char *Component, unsigned short usFlags, const LOG_RECORD_HEADER *Fields, const char *Message, int iLength);
+	/// Sink thread, drains the rings.
+	void SinkThread();
+	/// Moves queued records from all rings to the output, returns the number written.
+	long DrainRings();
+	/// Formats one record.
+	void FormatRecord(const LOG_RECORD_HEADER *Header, const char *Message, string *strOut);
+
+	atomic<int> iMinLevel;
+	atomic<int> OutputFormat;
+	atomic<unsigned long> ulDropped;
+	atomic<bool> bStopReq;
+	atomic<bool> bSinkRunning;
+	atomic<unsigned long long> ullNextSequence;
+	mutex RingLock;					/// ring list, ring tails and output file
+	vector<shared_ptr<LOG_RING> > vRings;
+	unsigned int uiNextThread;
+	FILE *LogFile;
+	thread SinkThreadHandle;
+};
+
+/// Library logger, constructed on first use (outlives static objects that call it in their constructor).
+CDppLog &GetDppLog();
+
+#define DPP_LOG(Level, Component, ...) do { if (GetDppLog().IsEnabled(Level)) GetDppLog().Write(Level, Component, __VA_ARGS__); } while (0)
+#define DPP_LOG_PACKET(Level, Component, Packet, PID1, PID2, LatencyNs, ...) do { if (GetDppLog().IsEnabled(Level)) GetDppLog().WritePacket(Level, Component, Packet, PID1, PID2, LatencyNs, __VA_ARGS__); } while (0)
+
+/** CDppLogText collects one console output statement (ConsoleOut() << ... << endl)
+	and queues it with CDppLog::WriteText when the statement ends.
+*/
+class CDppLogText
+{
+public:
+	CDppLogText(void) {}
+	CDppLogText(CDppLogText &&Other) : Text(std::move(Other.Text)) {}
+	~CDppLogText(void) { GetDppLog().WriteText(Text.str()); }
+
+	template <class Value> CDppLogText &operator<<(const Value &Val) { Text << Val; return *this; }
+	CDppLogText &operator<<(ostream &(*Manip)(ostream &)) { Text << Manip; return *this; }
+
+private:
+	ostringstream Text;
+};
+
+#if DPP_LOG_LEVEL <= LOG_LEVEL_TRACE
+	#define DPP_LOG_TRACE(Component, ...) DPP_LOG(LOG_LEVEL_TRACE, Component, __VA_ARGS__)
+	#define DPP_LOG_PACKET_TRACE(Component, Packet, PID1, PID2, LatencyNs, ...) DPP_LOG_PACKET(LOG_LEVEL_TRACE, Component, Packet, PID1, PID2, LatencyNs, __VA_ARGS__)
+#else
+	#define DPP_LOG_TRACE(Component, ...) ((void)0)
+	#define DPP_LOG_PACKET_TRACE(Component, Packet, PID1, PID2, LatencyNs, ...) ((void)0)
+#endif
+#if DPP_LOG_LEVEL <= LOG_LEVEL_DEBUG
+	#define DPP_LOG_DEBUG(Component, ...) DPP_LOG(LOG_LEVEL_DEBUG, Component, __VA_ARGS__)
+	#define DPP_LOG_PACKET_DEBUG(Component, Packet, PID1, PID2, LatencyNs, ...) DPP_LOG_PACKET(LOG_LEVEL_DEBUG, Component, Packet, PID1, PID2, LatencyNs, __VA_ARGS__)
+#else
+	#define DPP_LOG_DEBUG(Component, ...) ((void)0)
+	#define DPP_LOG_PACKET_DEBUG(Component, Packet, PID1, PID2, LatencyNs, ...) ((void)0)
+#endif
+#if DPP_LOG_LEVEL <= LOG_LEVEL_INFO
+	#define DPP_LOG_INFO(Component, ...) DPP_LOG(LOG_LEVEL_INFO, Component, __VA_ARGS__)
+#else
+	#define DPP_LOG_INFO(Component, ...) ((void)0)
+#endif
+#if DPP_LOG_LEVEL <= LOG_LEVEL_WARN
+	#define DPP_LOG_WARN(Component, ...) DPP_LOG(LOG_LEVEL_WARN, Component, __VA_ARGS__)
+#else
+	#define DPP_LOG_WARN(Component, ...) ((void)0)
+#endif
+#if DPP_LOG_LEVEL <= LOG_LEVEL_ERROR
+	#define DPP_LOG_ERROR(Component, ...) DPP_LOG(LOG_LEVEL_ERROR, Component, __VA_ARGS__)
+#else
+	#define DPP_LOG_ERROR(Component, ...) ((void)0)
+#endif
@@ -0,0 +1,244 @@
+#include "DppMcaConverter.h"
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <algorithm>
+#include <thread>
+#include <chrono>
+#ifdef _WIN32
+	#include <io.h>
+#else
+	#include <dirent.h>
+#endif
+
+CDppMcaConverter::CDppMcaConverter(void)
+{
+	pFiles = NULL;
+	OutFormat = mcfArchive;
+	idxNextFile = 0;
+	iWindow = MCA_CONVERT_WINDOW;
+	idxNextAppend = 0;
+	bArchiveFailed = false;
+	pResult = NULL;
+}
+
+CDppMcaConverter::~CDppMcaConverter(void)
+{
+}
+
+vector<string> CDppMcaConverter::ListMcaFiles(string strDirectory)
+{
+	vector<string> vNames;
+	vector<string> vFiles;
+	string strName;
+	size_t idxFile;
+
+	if ((strDirectory.length() > 0) && (strDirectory[strDirectory.length() - 1] != '/') && (strDirectory[strDirectory.length() - 1] != '\\')) {
+		strDirectory += "/";
+	}
+#ifdef _WIN32
+	struct _finddata_t fdFile;
+	intptr_t hFind;
+	if ((hFind = _findfirst((strDirectory + "*.*").c_str(), &fdFile)) != -1) {
+		do {
+			if ((fdFile.attrib & _A_SUBDIR) == 0) vNames.push_back(fdFile.name);
+		} while (_findnext(hFind, &fdFile) == 0);
+		_findclose(hFind);
+	}
+#else
+	DIR *pDir;
+	struct dirent *pEntry;
+	if ((pDir = opendir(strDirectory.c_str())) != NULL) {
+		while ((pEntry = readdir(pDir)) != NULL) {
+			if (pEntry->d_name[0] != '.') vNames.push_back(pEntry->d_name);
+		}
+		closedir(pDir);
+	}
+#endif
+	sort(vNames.begin(), vNames.end());
+	for (idxFile=0;idxFile<vNames.size();idxFile++) {
+		strName = vNames[idxFile];
+		if ((strName.length() > 4) && (strName[strName.length() - 4] == '.') &&
+			(toupper(strName[strName.length() - 3]) == 'M') && (toupper(strName[strName.length() - 2]) == 'C') && (toupper(strName[strName.length() - 1]) == 'A')) {
+			vFiles.push_back(strDirectory + strName);
+		}
+	}
+	return vFiles;
+}
+
+bool CDppMcaConverter::WriteCsv(string strFilename, const vector<long> &vData)
+{
+	vector<char> Buffer;
+	char *pOut;
+	FILE *out;
+	size_t idxChan;
+	bool bWritten;
+
+	Buffer.resize(32 + vData.size() * 36);
+	pOut = &Buffer[0];
+	memcpy(pOut, "channel,counts\r\n", 16);
+	pOut += 16;
+	for (idxChan=0;idxChan<vData.size();idxChan++) {
+		pOut = CDppMcaWriter::FormatLong((long)idxChan, pOut);
+		*pOut++ = ',';
+		pOut = CDppMcaWriter::FormatLong(vData[idxChan], pOut);
+		*pOut++ = '\r';
+		*pOut++ = '\n';
+	}
+	if ((out = fopen(strFilename.c_str(), "wb")) == NULL) {
+		return false;
+	}
+	bWritten = (fwrite(&Buffer[0], 1, pOut - &Buffer[0], out) == (size_t)(pOut - &Buffer[0]));
+	if (fclose(out) != 0) {
+		bWritten = false;
+	}
+	return bWritten;
+}
+
+bool CDppMcaConverter::ConvertDirectory(string strDirectory, MCA_CONVERT_FORMAT Format, string strOutput, int iThreads, MCA_CONVERT_RESULT *Result)
+{
+	vector<string> vFiles;
+
+	vFiles = ListMcaFiles(strDirectory);
+	return Convert(vFiles, Format, strOutput, iThreads, Result);
+}
+
+bool CDppMcaConverter::Convert(const vector<string> &vFiles, MCA_CONVERT_FORMAT Format, string strOutput, int iThreads, MCA_CONVERT_RESULT *Result)
+{
+	vector<thread> vWorkers;
+	FILE *ArchiveFile;
+	chrono::steady_clock::time_point tpStart;
+	int idxThread;
+
+	if (Result == NULL) {
+		return false;
+	}
+	tpStart = chrono::steady_clock::now();
+	Result->lFiles = (long)vFiles.size();
+	Result->lConverted = 0;
+	Result->lFailed = 0;
+	Result->vErrors.clear();
+	Result->dblSeconds = 0;
+	pFiles = &vFiles;
+	OutFormat = Format;
+	strOut = strOutput;
+	pResult = Result;
+	idxNextFile = 0;
+	idxNextAppend = 0;
+	Slots.clear();
+	bArchiveFailed = false;
+	if (iThreads <= 0) {
+		iThreads = (int)thread::hardware_concurrency();
+	}
+	if (iThreads <= 0) {
+		iThreads = 1;
+	}
+	iWindow = (size_t)iThreads * MCA_CONVERT_WINDOW;
+	// an existing archive is continued, a new one is created from the first file
+	if ((Format == mcfArchive) && ((ArchiveFile = fopen(strOutput.c_str(), "rb")) != NULL)) {
+		fclose(ArchiveFile);
+		if (! Archive.OpenAppend(strOutput)) {
+			Result->vErrors.push_back(strOutput + ": not a spectrum archive");
+			return false;
+		}
+	}
+	for (idxThread=0;idxThread<iThreads;idxThread++) {
+		vWorkers.push_back(thread(&CDppMcaConverter::Worker, this));
+	}
+	for (idxThread=0;idxThread<iThreads;idxThread++) {
+		vWorkers[idxThread].join();
+	}
+	if ((Format == mcfArchive) && Archive.IsWriting() && ! Archive.Close()) {
+		Result->vErrors.push_back(strOutput + ": error writing the archive index");
+		bArchiveFailed = true;
+	}
+	Result->dblSeconds = chrono::duration<double>(chrono::steady_clock::now() - tpStart).count();
+	return ((Result->lFailed == 0) && ! bArchiveFailed);
+}
+
+void CDppMcaConverter::Worker()
+{
+	CDppMcaReader Reader;
+	MCA_FILE_DATA McaData;
+	string strFile;
+	string strCsv;
+	size_t idxFile;
+	size_t iSlash;
+	size_t iDot;
+	bool bParsed;
+
+	for (;;) {
+		idxFile = idxNextFile++;
+		if (idxFile >= pFiles->size()) {
+			break;
+		}
+		strFile = (*pFiles)[idxFile];
+		if (OutFormat == mcfArchive) {
+			// bounds the parsed files held while an earlier file is still being read
+			unique_lock<mutex> Lock(ConvertLock);
+			SlotFreed.wait(Lock, [this, idxFile]{ return idxFile < idxNextAppend + iWindow; });
+		}
+		bParsed = Reader.ReadFile(strFile, &McaData);
+		if (OutFormat == mcfCsv) {
+			if (bParsed) {
+				iSlash = strFile.find_last_of("/\\");
+				strCsv = (iSlash == string::npos) ? strFile : strFile.substr(iSlash + 1);
+				iDot = strCsv.find_last_of('.');
+				strCsv = strOut + "/" + strCsv.substr(0, iDot) + ".csv";
+				bParsed = WriteCsv(strCsv, McaData.vData);
+				lock_guard<mutex> Lock(ConvertLock);
+				if (bParsed) {
+					pResult->lConverted++;
+				} else {
+					AddError("Couldn't write " + strCsv);
+				}
+			} else {
+				lock_guard<mutex> Lock(ConvertLock);
+				AddError(Reader.LastError());
+			}
+			continue;
+		}
+		lock_guard<mutex> Lock(ConvertLock);
+		if (! bParsed) {
+			AddError(Reader.LastError());
+		}
+		Slots[idxFile].bParsed = bParsed;
+		if (bParsed) {
+			Slots[idxFile].McaData = move(McaData);
+		}
+		AppendReady();
+	}
+}
+
+void CDppMcaConverter::AppendReady()
+{
+	map<size_t, MCA_CONVERT_SLOT>::iterator itSlot;
+	MCA_FILE_DATA *McaData;
+	string strFile;
+
+	while ((itSlot = Slots.find(idxNextAppend)) != Slots.end()) {
+		strFile = (*pFiles)[idxNextAppend];
+		McaData = &itSlot->second.McaData;
+		if (! itSlot->second.bParsed) {
+			// error already recorded
+		} else if (bArchiveFailed) {
+			AddError(strFile + ": archive not written");
+		} else if (! Archive.IsWriting() && ! Archive.Create(strOut, McaData->Info.SerialNumber, McaData->Info.strConfig, (long)McaData->vData.size())) {
+			bArchiveFailed = true;
+			AddError(strFile + ": couldn't create " + strOut);
+		} else if (! Archive.Append(McaData->vData.data(), (long)McaData->vData.size(), NULL, McaData->Info.dblLiveTime, McaData->Info.dblRealTime, 0)) {
+			AddError(strFile + ": channel count differs from the archive or write failed");
+		} else {
+			pResult->lConverted++;
+		}
+		Slots.erase(itSlot);
+		idxNextAppend++;
+	}
+	SlotFreed.notify_all();
+}
+
+void CDppMcaConverter::AddError(string strError)
+{
+	pResult->lFailed++;
+	pResult->vErrors.push_back(strError);
+}
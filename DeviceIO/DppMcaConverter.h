@@ -0,0 +1,79 @@
+/** CDppMcaConverter CDppMcaConverter */
+#pragma once
+#include <string>
+#include <vector>
+#include <map>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include "DppMcaReader.h"
+#include "DppSpectrumArchive.h"
+using namespace std;
+
+#define MCA_CONVERT_WINDOW 8			/// parsed files per thread waiting for the archive writer
+
+/// Conversion output.
+typedef enum _MCA_CONVERT_FORMAT
+{
+	mcfArchive,			/// one binary spectrum archive, records in file name order
+	mcfCsv				/// one channel,counts .csv per file
+} MCA_CONVERT_FORMAT;
+
+/// Conversion summary.
+typedef struct _MCA_CONVERT_RESULT
+{
+	long lFiles;				/// files found
+	long lConverted;			/// files written
+	long lFailed;				/// files that could not be read or written
+	vector<string> vErrors;		/// one line per failed file
+	double dblSeconds;			/// conversion time
+} MCA_CONVERT_RESULT;
+
+/// Parsed file waiting to be appended (archive output).
+typedef struct _MCA_CONVERT_SLOT
+{
+	bool bParsed;
+	MCA_FILE_DATA McaData;
+} MCA_CONVERT_SLOT;
+
+/** CDppMcaConverter converts .mca spectrum files in parallel.
+	Worker threads take one file at a time from a shared queue and parse it. CSV files
+	are written by the worker, archive records are appended in file name order by the
+	worker that completes the next file, so the archive matches a sequential conversion.
+*/
+class CDppMcaConverter
+{
+public:
+	CDppMcaConverter(void);
+	~CDppMcaConverter(void);
+
+	/// Returns the .mca files of a directory, sorted by name.
+	static vector<string> ListMcaFiles(string strDirectory);
+	/// Converts files to an archive (strOutput file) or .csv files (strOutput directory), iThreads 0 uses all cores.
+	bool Convert(const vector<string> &vFiles, MCA_CONVERT_FORMAT Format, string strOutput, int iThreads, MCA_CONVERT_RESULT *Result);
+	/// Converts all .mca files of a directory.
+	bool ConvertDirectory(string strDirectory, MCA_CONVERT_FORMAT Format, string strOutput, int iThreads, MCA_CONVERT_RESULT *Result);
+	/// Writes counts as channel,counts lines.
+	static bool WriteCsv(string strFilename, const vector<long> &vData);
+
+private:
+	/// Worker thread, converts files until the queue is empty.
+	void Worker();
+	/// Appends the parsed files that are next in order (called with ConvertLock held).
+	void AppendReady();
+	/// Records a failed file (called with ConvertLock held).
+	void AddError(string strError);
+
+	const vector<string> *pFiles;
+	MCA_CONVERT_FORMAT OutFormat;
+	string strOut;
+	atomic<size_t> idxNextFile;			/// work queue position
+	size_t iWindow;
+	mutex ConvertLock;					/// slots, archive and result
+	condition_variable SlotFreed;
+	map<size_t, MCA_CONVERT_SLOT> Slots;
+	size_t idxNextAppend;
+	CDppSpectrumArchive Archive;
+	bool bArchiveFailed;
+	MCA_CONVERT_RESULT *pResult;
+};
@@ -0,0 +1,244 @@
+#include "DppMcaReader.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+// .mca sections
+typedef enum _MCA_SECTION
+{
+	mcsNone,
+	mcsHeader,
+	mcsData,
+	mcsConfig,
+	mcsStatus,
+	mcsOther
+} MCA_SECTION;
+
+static string TrimField(const char *pStart, const char *pEnd)
+{
+	while ((pStart < pEnd) && ((*pStart == ' ') || (*pStart == '\t'))) {
+		pStart++;
+	}
+	while ((pEnd > pStart) && ((pEnd[-1] == ' ') || (pEnd[-1] == '\t'))) {
+		pEnd--;
+	}
+	return string(pStart, pEnd - pStart);
+}
+
+static bool IsTag(const char *pLine, size_t iLength, const char *strTag)
+{
+	size_t iTag;
+
+	iTag = strlen(strTag);
+	return ((iLength >= iTag) && (memcmp(pLine, strTag, iTag) == 0));
+}
+
+CDppMcaReader::CDppMcaReader(void)
+{
+}
+
+CDppMcaReader::~CDppMcaReader(void)
+{
+}
+
+string CDppMcaReader::FindField(const vector<MCA_FIELD> &vFields, string strName, string strDefault)
+{
+	size_t idxField;
+
+	for (idxField=0;idxField<vFields.size();idxField++) {
+		if (vFields[idxField].strName == strName) {
+			return vFields[idxField].strValue;
+		}
+	}
+	return strDefault;
+}
+
+bool CDppMcaReader::ReadFile(string strFilename, MCA_FILE_DATA *McaData)
+{
+	FILE *McaFile;
+	long lSize;
+	bool bRead;
+
+	if ((McaFile = fopen(strFilename.c_str(), "rb")) == NULL) {
+		strLastError = "Couldn't open " + strFilename + ": " + strerror(errno);
+		return false;
+	}
+	bRead = false;
+	if ((fseek(McaFile, 0, SEEK_END) == 0) && ((lSize = ftell(McaFile)) > 0) && (fseek(McaFile, 0, SEEK_SET) == 0)) {
+		FileBuffer.resize(lSize);
+		bRead = (fread(&FileBuffer[0], 1, lSize, McaFile) == (size_t)lSize);
+	}
+	fclose(McaFile);
+	if (! bRead) {
+		strLastError = "Couldn't read " + strFilename;
+		return false;
+	}
+	if (! Parse(&FileBuffer[0], FileBuffer.size(), McaData)) {
+		strLastError = strFilename + ": " + strLastError;
+		return false;
+	}
+	return true;
+}
+
+bool CDppMcaReader::Parse(const char *pText, size_t iLength, MCA_FILE_DATA *McaData)
+{
+	const char *pLine;
+	const char *pNext;
+	const char *pEnd;
+	const char *pTextEnd;
+	const char *pChar;
+	const char *pSeparator;
+	const char *pItem;
+	MCA_SECTION Section;
+	MCA_FIELD Field;
+	unsigned long ulCount;
+	bool bNegative;
+	bool bDataEnd;
+	long lLine;
+
+	McaData->Info.strTag = "";
+	McaData->Info.strDescription = "";
+	McaData->Info.SerialNumber = 0;
+	McaData->Info.dblLiveTime = 0;
+	McaData->Info.dblRealTime = 0;
+	McaData->Info.strConfig = "";
+	McaData->Info.strStatus = "";
+	McaData->vData.clear();
+	McaData->vHeader.clear();
+	McaData->vConfig.clear();
+	McaData->vStatus.clear();
+	Section = mcsNone;
+	bDataEnd = false;
+	lLine = 0;
+	pTextEnd = pText + iLength;
+	for (pLine=pText;pLine<pTextEnd;pLine=pNext) {
+		lLine++;
+		pEnd = (const char *)memchr(pLine, '\n', pTextEnd - pLine);
+		pNext = (pEnd != NULL) ? pEnd + 1 : pTextEnd;
+		pEnd = (pEnd != NULL) ? pEnd : pTextEnd;
+		if ((pEnd > pLine) && (pEnd[-1] == '\r')) {
+			pEnd--;
+		}
+		if ((pEnd - pLine >= 2) && (pLine[0] == '<') && (pLine[1] == '<')) {
+			if (Section == mcsData) {
+				bDataEnd = IsTag(pLine, pEnd - pLine, "<<END>>");
+				if (! bDataEnd) {
+					strLastError = "<<DATA>> not ended by <<END>>";
+					return false;
+				}
+			}
+			if (IsTag(pLine, pEnd - pLine, "<<PMCA SPECTRUM>>")) {
+				Section = mcsHeader;
+			} else if (Section == mcsNone) {
+				strLastError = "Not a <<PMCA SPECTRUM>> file";
+				return false;
+			} else if (IsTag(pLine, pEnd - pLine, "<<DATA>>")) {
+				Section = mcsData;
+			} else if (IsTag(pLine, pEnd - pLine, "<<DP5 CONFIGURATION END>>") || IsTag(pLine, pEnd - pLine, "<<DPP STATUS END>>")) {
+				Section = mcsOther;
+			} else if (IsTag(pLine, pEnd - pLine, "<<DP5 CONFIGURATION>>")) {
+				Section = mcsConfig;
+			} else if (IsTag(pLine, pEnd - pLine, "<<DPP STATUS>>")) {
+				Section = mcsStatus;
+			} else {
+				Section = mcsOther;			// <<END>>, <<ROI>>, <<CALIBRATION>> ...
+			}
+			continue;
+		}
+		switch (Section) {
+			case mcsNone:
+				if (pEnd > pLine) {
+					strLastError = "Not a <<PMCA SPECTRUM>> file";
+					return false;
+				}
+				break;
+			case mcsHeader:
+				// NAME - value
+				for (pSeparator=pLine;pSeparator+3<=pEnd;pSeparator++) {
+					if ((pSeparator[0] == ' ') && (pSeparator[1] == '-') && (pSeparator[2] == ' ')) {
+						break;
+					}
+				}
+				if (pSeparator + 3 > pEnd) {
+					break;
+				}
+				Field.strName = TrimField(pLine, pSeparator);
+				Field.strValue = TrimField(pSeparator + 3, pEnd);
+				if (Field.strName == "TAG") {
+					McaData->Info.strTag = Field.strValue;
+				} else if (Field.strName == "DESCRIPTION") {
+					McaData->Info.strDescription = Field.strValue;
+				} else if (Field.strName == "LIVE_TIME") {
+					McaData->Info.dblLiveTime = atof(Field.strValue.c_str());
+				} else if (Field.strName == "REAL_TIME") {
+					McaData->Info.dblRealTime = atof(Field.strValue.c_str());
+				} else if (Field.strName == "SERIAL_NUMBER") {
+					McaData->Info.SerialNumber = strtoul(Field.strValue.c_str(), NULL, 10);
+				}
+				McaData->vHeader.push_back(Field);
+				break;
+			case mcsData:
+				pChar = pLine;
+				while ((pChar < pEnd) && (*pChar == ' ')) {
+					pChar++;
+				}
+				bNegative = ((pChar < pEnd) && (*pChar == '-'));
+				if (bNegative) {
+					pChar++;
+				}
+				if ((pChar >= pEnd) || (*pChar < '0') || (*pChar > '9')) {
+					strLastError = "Invalid count at line " + to_string(lLine);
+					return false;
+				}
+				ulCount = 0;
+				while ((pChar < pEnd) && (*pChar >= '0') && (*pChar <= '9')) {
+					ulCount = ulCount * 10 + (unsigned long)(*pChar - '0');
+					pChar++;
+				}
+				McaData->vData.push_back(bNegative ? -(long)ulCount : (long)ulCount);
+				break;
+			case mcsConfig:
+				McaData->Info.strConfig.append(pLine, pNext - pLine);
+				// CMD=value;    description (one or more commands per line)
+				for (pItem=pLine;pItem<pEnd;pItem=pSeparator+1) {
+					pSeparator = (const char *)memchr(pItem, ';', pEnd - pItem);
+					if (pSeparator == NULL) {
+						break;
+					}
+					pChar = (const char *)memchr(pItem, '=', pSeparator - pItem);
+					if (pChar == NULL) {
+						break;
+					}
+					Field.strName = TrimField(pItem, pChar);
+					Field.strValue = TrimField(pChar + 1, pSeparator);
+					if ((Field.strName.length() == 0) || (Field.strName.find(' ') != string::npos)) {
+						break;
+					}
+					McaData->vConfig.push_back(Field);
+				}
+				break;
+			case mcsStatus:
+				McaData->Info.strStatus.append(pLine, pNext - pLine);
+				// Name: value
+				pSeparator = (const char *)memchr(pLine, ':', pEnd - pLine);
+				if (pSeparator != NULL) {
+					Field.strName = TrimField(pLine, pSeparator);
+					Field.strValue = TrimField(pSeparator + 1, pEnd);
+					McaData->vStatus.push_back(Field);
+				}
+				break;
+			case mcsOther:
+				break;
+		}
+	}
+	if (Section == mcsNone) {
+		strLastError = "Not a <<PMCA SPECTRUM>> file";
+		return false;
+	}
+	if (! bDataEnd) {
+		strLastError = "Missing <<DATA>> section or <<END>>";
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,47 @@
+/** CDppMcaReader CDppMcaReader */
+#pragma once
+#include <string>
+#include <vector>
+#include "DppMcaWriter.h"
+using namespace std;
+
+/// Name/value line of a .mca section.
+typedef struct _MCA_FIELD
+{
+	string strName;
+	string strValue;
+} MCA_FIELD;
+
+/// Contents of a .mca spectrum file.
+typedef struct _MCA_FILE_DATA
+{
+	MCA_FILE_INFO Info;				/// tag, description, serial number, times and section texts
+	vector<long> vData;				/// channel counts
+	vector<MCA_FIELD> vHeader;		/// <<PMCA SPECTRUM>> "NAME - value" lines
+	vector<MCA_FIELD> vConfig;		/// <<DP5 CONFIGURATION>> "CMD=value;" commands
+	vector<MCA_FIELD> vStatus;		/// <<DPP STATUS>> "Name: value" lines
+} MCA_FILE_DATA;
+
+/** CDppMcaReader parses Amptek <<PMCA SPECTRUM>> .mca files (as written by CreateMCAData).
+	The file is read in one call and scanned in place, counts are converted without
+	the C library number parsers. Sections not written by this library are skipped.
+*/
+class CDppMcaReader
+{
+public:
+	CDppMcaReader(void);
+	~CDppMcaReader(void);
+
+	/// Reads and parses a .mca file.
+	bool ReadFile(string strFilename, MCA_FILE_DATA *McaData);
+	/// Parses .mca file text.
+	bool Parse(const char *pText, size_t iLength, MCA_FILE_DATA *McaData);
+	/// Description of the last error.
+	string LastError() { return strLastError; }
+	/// Returns the value of a field, strDefault if not found.
+	static string FindField(const vector<MCA_FIELD> &vFields, string strName, string strDefault = "");
+
+private:
+	vector<char> FileBuffer;		/// file text, reused
+	string strLastError;
+};
@@ -0,0 +1,324 @@
+#include "DppMcaWriter.h"
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#ifdef _WIN32
+	#include <io.h>
+#else
+	#include <fcntl.h>
+	#include <unistd.h>
+	#include <sys/uio.h>
+#endif
+
+// two digit groups, halves the divisions of a digit loop
+static const char DigitPairs[] =
+	"00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+	"40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+	"8081828384858687888990919293949596979899";
+
+static const char McaConfigEnd[] = "<<DP5 CONFIGURATION END>>\r\n<<DPP STATUS>>\r\n";
+static const char McaStatusEnd[] = "<<DPP STATUS END>>\r\n";
+
+CDppMcaWriter::CDppMcaWriter(void)
+{
+	SyncPolicy = msNone;
+	bAsync = false;
+	ulErrors = 0;
+	bFlushFailed = false;
+	bWriting = false;
+	bStopWriter = false;
+}
+
+CDppMcaWriter::~CDppMcaWriter(void)
+{
+	SetPolicy((MCA_SYNC_POLICY)(int)SyncPolicy, false);
+}
+
+char *CDppMcaWriter::FormatLong(long lValue, char *pOut)
+{
+	char Digits[24];
+	char *pDigit;
+	unsigned long ulValue;
+	unsigned long ulPair;
+	size_t iLength;
+
+	ulValue = (lValue < 0) ? 0UL - (unsigned long)lValue : (unsigned long)lValue;
+	pDigit = Digits + sizeof(Digits);
+	while (ulValue >= 100) {
+		ulPair = (ulValue % 100) * 2;
+		ulValue /= 100;
+		pDigit -= 2;
+		memcpy(pDigit, &DigitPairs[ulPair], 2);
+	}
+	if (ulValue >= 10) {
+		pDigit -= 2;
+		memcpy(pDigit, &DigitPairs[ulValue * 2], 2);
+	} else {
+		*--pDigit = (char)('0' + ulValue);
+	}
+	if (lValue < 0) {
+		*--pDigit = '-';
+	}
+	iLength = (Digits + sizeof(Digits)) - pDigit;
+	memcpy(pOut, pDigit, iLength);
+	return (pOut + iLength);
+}
+
+size_t CDppMcaWriter::FormatMca(vector<char> *Buffer, const MCA_FILE_INFO *Info, const long lData[], long lChannels)
+{
+	const char *strADC;
+	char *pOut;
+	char *pStart;
+	int iLength;
+	size_t iHeader;
+	size_t iData;
+	long idxChan;
+
+	switch (lChannels) {
+		case 16384: strADC = "6"; break;
+		case 8192: strADC = "5"; break;
+		case 4096: strADC = "4"; break;
+		case 2048: strADC = "3"; break;
+		case 1024: strADC = "2"; break;
+		case 512: strADC = "1"; break;
+		case 256: strADC = "0"; break;
+		default: strADC = ""; break;
+	}
+	// header text, then the channel lines and tags
+	iHeader = MCA_HEADER_RESERVE + Info->strTag.length() + Info->strDescription.length();
+	iData = lChannels * MCA_CHANNEL_TEXT + 32;
+	for (;;) {
+		Buffer->resize(iHeader + iData);
+		pStart = &(*Buffer)[0];
+		iLength = snprintf(pStart, iHeader,
+			"<<PMCA SPECTRUM>>\r\nTAG - %s\r\nDESCRIPTION - %s\r\nGAIN - %s\r\nTHRESHOLD - 0\r\nLIVE_MODE - 0\r\nPRESET_TIME - \r\n"
+			"LIVE_TIME - %lf\r\nREAL_TIME - %lf\r\nSTART_TIME - \r\nSERIAL_NUMBER - %lu\r\n<<DATA>>\r\n",
+			Info->strTag.c_str(), Info->strDescription.c_str(), strADC, Info->dblLiveTime, Info->dblRealTime, Info->SerialNumber);
+		if (iLength < 0) {
+			return 0;
+		}
+		if ((size_t)iLength < iHeader) {
+			break;
+		}
+		iHeader = (size_t)iLength + 1;		// truncated (a huge %lf time), grow and format again
+	}
+	pOut = pStart + iLength;
+	for (idxChan=0;idxChan<lChannels;idxChan++) {
+		pOut = FormatLong(lData[idxChan], pOut);
+		pOut[0] = '\r';
+		pOut[1] = '\n';
+		pOut += 2;
+	}
+	memcpy(pOut, "<<END>>\r\n<<DP5 CONFIGURATION>>\r\n", 32);
+	pOut += 32;
+	return (size_t)(pOut - pStart);
+}
+
+string CDppMcaWriter::FormatToString(const MCA_FILE_INFO *Info, const long lData[], long lChannels)
+{
+	vector<char> Buffer;
+	string strMCA;
+	size_t iLength;
+
+	if ((lChannels < 0) || (lChannels > MCA_MAX_CHANNELS)) {
+		return "";
+	}
+	if ((iLength = FormatMca(&Buffer, Info, lData, lChannels)) == 0) {
+		return "";
+	}
+	strMCA.reserve(iLength + Info->strConfig.length() + Info->strStatus.length() + sizeof(McaConfigEnd) + sizeof(McaStatusEnd));
+	strMCA.assign(&Buffer[0], iLength);
+	strMCA += Info->strConfig;
+	strMCA += McaConfigEnd;
+	strMCA += Info->strStatus;
+	strMCA += McaStatusEnd;
+	return strMCA;
+}
+
+bool CDppMcaWriter::WriteFile(vector<char> *Buffer, string strFilename, const MCA_FILE_INFO *Info, const long lData[], long lChannels)
+{
+	const char *pPart[5];
+	size_t iPart[5];
+	size_t iLength;
+	int idxPart;
+	bool bWritten;
+
+	if ((lChannels < 0) || (lChannels > MCA_MAX_CHANNELS)) {
+		SetError("Invalid channel count writing " + strFilename);
+		return false;
+	}
+	if ((iLength = FormatMca(Buffer, Info, lData, lChannels)) == 0) {
+		SetError("Couldn't format the header writing " + strFilename);
+		return false;
+	}
+	pPart[0] = &(*Buffer)[0];				iPart[0] = iLength;
+	pPart[1] = Info->strConfig.c_str();		iPart[1] = Info->strConfig.length();
+	pPart[2] = McaConfigEnd;				iPart[2] = sizeof(McaConfigEnd) - 1;
+	pPart[3] = Info->strStatus.c_str();		iPart[3] = Info->strStatus.length();
+	pPart[4] = McaStatusEnd;				iPart[4] = sizeof(McaStatusEnd) - 1;
+	bWritten = true;
+#ifdef _WIN32
+	FILE *out;
+	if ((out = fopen(strFilename.c_str(), "wb")) == NULL) {
+		SetError("Couldn't open " + strFilename + " for writing: " + strerror(errno));
+		return false;
+	}
+	for (idxPart=0;idxPart<5;idxPart++) {
+		if ((iPart[idxPart] > 0) && (fwrite(pPart[idxPart], 1, iPart[idxPart], out) != iPart[idxPart])) {
+			bWritten = false;
+		}
+	}
+	if (fflush(out) != 0) {
+		bWritten = false;
+	}
+	if ((SyncPolicy == msFsync) && (_commit(_fileno(out)) != 0)) {
+		bWritten = false;
+	}
+	if (fclose(out) != 0) {
+		bWritten = false;
+	}
+#else
+	struct iovec Parts[5];
+	ssize_t iWritten;
+	int iFile;
+	int idxFirst;
+
+	if ((iFile = open(strFilename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666)) < 0) {
+		SetError("Couldn't open " + strFilename + " for writing: " + strerror(errno));
+		return false;
+	}
+	for (idxPart=0;idxPart<5;idxPart++) {
+		Parts[idxPart].iov_base = (void *)pPart[idxPart];
+		Parts[idxPart].iov_len = iPart[idxPart];
+	}
+	// one writev, continued after a partial write
+	idxFirst = 0;
+	while (idxFirst < 5) {
+		iWritten = writev(iFile, &Parts[idxFirst], 5 - idxFirst);
+		if (iWritten < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			bWritten = false;
+			break;
+		}
+		while ((idxFirst < 5) && ((size_t)iWritten >= Parts[idxFirst].iov_len)) {
+			iWritten -= Parts[idxFirst].iov_len;
+			idxFirst++;
+		}
+		if (idxFirst < 5) {
+			Parts[idxFirst].iov_base = (char *)Parts[idxFirst].iov_base + iWritten;
+			Parts[idxFirst].iov_len -= iWritten;
+		}
+	}
+	if (bWritten && (SyncPolicy == msFsync) && (fsync(iFile) != 0)) {
+		bWritten = false;
+	}
+	if (close(iFile) != 0) {
+		bWritten = false;
+	}
+#endif
+	if (! bWritten) {
+		SetError("Error writing " + strFilename + ": " + strerror(errno));
+	}
+	return bWritten;
+}
+
+void CDppMcaWriter::SetError(string strError)
+{
+	lock_guard<mutex> Lock(QueueLock);
+	strLastError = strError;
+	bFlushFailed = true;
+	ulErrors++;
+}
+
+string CDppMcaWriter::LastError()
+{
+	lock_guard<mutex> Lock(QueueLock);
+	return strLastError;
+}
+
+void CDppMcaWriter::SetPolicy(MCA_SYNC_POLICY Policy, bool bAsyncWrite)
+{
+	SyncPolicy = Policy;
+	if (bAsyncWrite == bAsync) {
+		return;
+	}
+	if (bAsyncWrite) {
+		bStopWriter = false;
+		WriterThreadHandle = thread(&CDppMcaWriter::WriterThread, this);
+		bAsync = true;
+	} else {
+		{
+			lock_guard<mutex> Lock(QueueLock);
+			bStopWriter = true;			// queued spectra are written first
+		}
+		QueueChanged.notify_all();
+		if (WriterThreadHandle.joinable()) {
+			WriterThreadHandle.join();
+		}
+		bAsync = false;
+	}
+}
+
+bool CDppMcaWriter::SaveSpectrum(string strFilename, const MCA_FILE_INFO *Info, const long lData[], long lChannels)
+{
+	if (! bAsync) {
+		lock_guard<mutex> Lock(SyncLock);
+		return WriteFile(&SyncBuffer, strFilename, Info, lData, lChannels);
+	}
+	if ((lChannels < 0) || (lChannels > MCA_MAX_CHANNELS)) {
+		SetError("Invalid channel count writing " + strFilename);
+		return false;
+	}
+	unique_lock<mutex> Lock(QueueLock);
+	QueueChanged.wait(Lock, [this]{ return (Queue.size() < MCA_ASYNC_QUEUE_SIZE) || bStopWriter; });
+	if (bStopWriter) {
+		return false;
+	}
+	Queue.push_back(MCA_WRITE_JOB());
+	Queue.back().strFilename = strFilename;
+	Queue.back().Info = *Info;
+	Queue.back().vData.assign(lData, lData + lChannels);
+	Lock.unlock();
+	QueueChanged.notify_all();
+	return true;
+}
+
+void CDppMcaWriter::WriterThread()
+{
+	MCA_WRITE_JOB Job;
+
+	for (;;) {
+		{
+			unique_lock<mutex> Lock(QueueLock);
+			QueueChanged.wait(Lock, [this]{ return (Queue.size() > 0) || bStopWriter; });
+			if (Queue.size() == 0) {
+				break;
+			}
+			Job = move(Queue.front());
+			Queue.pop_front();
+			bWriting = true;
+		}
+		QueueChanged.notify_all();
+		WriteFile(&AsyncBuffer, Job.strFilename, &Job.Info, Job.vData.size() > 0 ? &Job.vData[0] : NULL, (long)Job.vData.size());
+		{
+			lock_guard<mutex> Lock(QueueLock);
+			bWriting = false;
+		}
+		QueueChanged.notify_all();
+	}
+}
+
+bool CDppMcaWriter::Flush()
+{
+	bool bOk;
+
+	unique_lock<mutex> Lock(QueueLock);
+	if (bAsync) {
+		QueueChanged.wait(Lock, [this]{ return (Queue.size() == 0) && ! bWriting; });
+	}
+	bOk = ! bFlushFailed;
+	bFlushFailed = false;
+	return bOk;
+}
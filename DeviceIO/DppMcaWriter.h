@@ -0,0 +1,96 @@
+/** CDppMcaWriter CDppMcaWriter */
+#pragma once
+#include <string>
+#include <vector>
+#include <deque>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+using namespace std;
+
+#define MCA_MAX_CHANNELS 16384			/// largest spectrum written
+#define MCA_HEADER_RESERVE 512			/// header text besides tag and description (grown if the times need more)
+#define MCA_CHANNEL_TEXT 22				/// longest channel line, 20 characters of a 64 bit long and CR LF
+#define MCA_ASYNC_QUEUE_SIZE 64			/// spectra queued in async mode before SaveSpectrum waits
+
+/// Spectrum file description (.mca header and trailer sections).
+typedef struct _MCA_FILE_INFO
+{
+	string strTag;
+	string strDescription;
+	unsigned long SerialNumber;
+	double dblLiveTime;			/// accumulation time (s)
+	double dblRealTime;			/// real time (s)
+	string strConfig;			/// <<DP5 CONFIGURATION>> section text
+	string strStatus;			/// <<DPP STATUS>> section text
+} MCA_FILE_INFO;
+
+/// When file data is forced to disk.
+typedef enum _MCA_SYNC_POLICY
+{
+	msNone,				/// leave it to the operating system (fastest)
+	msFsync				/// fsync each file before it is closed
+} MCA_SYNC_POLICY;
+
+/// Queued spectrum (async mode).
+typedef struct _MCA_WRITE_JOB
+{
+	string strFilename;
+	MCA_FILE_INFO Info;
+	vector<long> vData;
+} MCA_WRITE_JOB;
+
+/** CDppMcaWriter writes Amptek .mca spectrum files.
+	Channel counts are converted with a table based integer formatter into a reused
+	buffer and the file is written with one writev (header and data, configuration
+	and status sections), without building the file as a string.
+	In async mode spectra are copied to a queue and written by a writer thread.
+*/
+class CDppMcaWriter
+{
+public:
+	CDppMcaWriter(void);
+	~CDppMcaWriter(void);
+
+	/// Sets the sync policy and async mode (waits for queued spectra when leaving async mode).
+	void SetPolicy(MCA_SYNC_POLICY SyncPolicy, bool bAsyncWrite);
+	/// Writes (or queues) a spectrum file, returns false on error (async: queue stopped).
+	bool SaveSpectrum(string strFilename, const MCA_FILE_INFO *Info, const long lData[], long lChannels);
+	/// Waits until all queued spectra are written, returns false if any write failed since the last call.
+	bool Flush();
+	/// Returns the .mca file as a string.
+	string FormatToString(const MCA_FILE_INFO *Info, const long lData[], long lChannels);
+	/// Number of files that could not be written.
+	unsigned long Errors() { return ulErrors; }
+	/// Description of the last write error.
+	string LastError();
+
+	/// Writes the decimal value, returns the end of the text (no terminator).
+	static char *FormatLong(long lValue, char *pOut);
+
+private:
+	/// Formats the header, data and section tags into Buffer, returns the header/data length (0 if formatting fails).
+	size_t FormatMca(vector<char> *Buffer, const MCA_FILE_INFO *Info, const long lData[], long lChannels);
+	/// Formats and writes one file using Buffer.
+	bool WriteFile(vector<char> *Buffer, string strFilename, const MCA_FILE_INFO *Info, const long lData[], long lChannels);
+	/// Writer thread (async mode).
+	void WriterThread();
+	/// Records a failed write.
+	void SetError(string strError);
+
+	atomic<int> SyncPolicy;
+	bool bAsync;
+	atomic<unsigned long> ulErrors;
+	bool bFlushFailed;
+	string strLastError;
+	vector<char> SyncBuffer;		/// caller side buffer
+	vector<char> AsyncBuffer;		/// writer thread buffer
+	mutex SyncLock;					/// SyncBuffer
+	mutex QueueLock;				/// queue, flags and last error
+	condition_variable QueueChanged;
+	deque<MCA_WRITE_JOB> Queue;
+	bool bWriting;					/// writer thread holds a job
+	bool bStopWriter;
+	thread WriterThreadHandle;
+};
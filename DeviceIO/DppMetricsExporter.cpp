@@ -0,0 +1,347 @@
+#include "DppMetricsExporter.h"
+#include "stringex.h"
+#include <string.h>
+#include <math.h>
+#include <chrono>
+#ifndef _WIN32
+	#include <unistd.h>
+	#include <fcntl.h>
+	#include <poll.h>
+	#include <sys/socket.h>
+	#include <sys/un.h>
+	#include <netinet/in.h>
+	#include <arpa/inet.h>
+#endif
+
+#ifdef MSG_NOSIGNAL
+	#define METRICS_SEND_FLAGS MSG_NOSIGNAL
+#else
+	#define METRICS_SEND_FLAGS 0
+#endif
+
+CDppMetricsExporter::CDppMetricsExporter(void)
+{
+	TransportMetrics = NULL;
+	iListenSocket = -1;
+	bRunning = false;
+	bStopReq = false;
+	ullSpectra = 0;
+	ullStatus = 0;
+	ullStatusMX2 = 0;
+	dblDetTemp = NAN;
+	dblBoardTemp = NAN;
+	dblHV = NAN;
+	dblDeadTime = NAN;
+	dblMx2HvMon = NAN;
+	dblMx2IMon = NAN;
+	dblMx2Temp = NAN;
+	dblLastScrapeTime = 0;
+	ullLastSpectra = 0;
+	ullLastStatus = 0;
+}
+
+CDppMetricsExporter::~CDppMetricsExporter(void)
+{
+	Stop();
+}
+
+void CDppMetricsExporter::SetTransportMetrics(CDppTransportMetrics *Metrics)
+{
+	TransportMetrics = Metrics;
+}
+
+void CDppMetricsExporter::RecordStatus(const DP4_FORMAT_STATUS *Status)
+{
+	ullStatus++;
+	dblDetTemp = Status->DET_TEMP;
+	dblBoardTemp = Status->DP5_TEMP;
+	dblHV = Status->HV;
+	if (Status->FastCount > 0) {
+		dblDeadTime = 1.0 - (Status->SlowCount / Status->FastCount);
+	}
+}
+
+void CDppMetricsExporter::RecordStatusMX2(const Stat_MNX *Status)
+{
+	ullStatusMX2++;
+	dblMx2HvMon = Status->HV_MON;
+	dblMx2IMon = Status->I_MON;
+	dblMx2Temp = Status->Temp;
+}
+
+void CDppMetricsExporter::RecordSpectrum()
+{
+	ullSpectra++;
+}
+
+bool CDppMetricsExporter::IsRunning()
+{
+	return bRunning;
+}
+
+#ifdef _WIN32
+
+bool CDppMetricsExporter::Start(int iPort)
+{
+	return false;
+}
+
+bool CDppMetricsExporter::StartUnix(string strSocketPath)
+{
+	return false;
+}
+
+bool CDppMetricsExporter::StartListening(int iSocket)
+{
+	return false;
+}
+
+void CDppMetricsExporter::Stop()
+{
+}
+
+void CDppMetricsExporter::ServerThread()
+{
+}
+
+void CDppMetricsExporter::ServeClient(int iClient)
+{
+}
+
+#else
+
+bool CDppMetricsExporter::Start(int iPort)
+{
+	struct sockaddr_in Addr;
+	int iSocket;
+	int iReuse;
+
+	if (bRunning) {
+		return false;
+	}
+	if ((iSocket = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
+		return false;
+	}
+	iReuse = 1;
+	setsockopt(iSocket, SOL_SOCKET, SO_REUSEADDR, &iReuse, sizeof(iReuse));
+	memset(&Addr, 0, sizeof(Addr));
+	Addr.sin_family = AF_INET;
+	Addr.sin_port = htons((unsigned short)iPort);
+	Addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);		// local scrapes only
+	if (bind(iSocket, (struct sockaddr *)&Addr, sizeof(Addr)) < 0) {
+		close(iSocket);
+		return false;
+	}
+	strUnixPath = "";
+	return StartListening(iSocket);
+}
+
+bool CDppMetricsExporter::StartUnix(string strSocketPath)
+{
+	struct sockaddr_un Addr;
+	int iSocket;
+
+	if (bRunning || (strSocketPath.length() >= sizeof(Addr.sun_path))) {
+		return false;
+	}
+	if ((iSocket = socket(AF_UNIX, SOCK_STREAM, 0)) < 0) {
+		return false;
+	}
+	memset(&Addr, 0, sizeof(Addr));
+	Addr.sun_family = AF_UNIX;
+	strcpy(Addr.sun_path, strSocketPath.c_str());
+	unlink(strSocketPath.c_str());			// stale socket from a previous run
+	if (bind(iSocket, (struct sockaddr *)&Addr, sizeof(Addr)) < 0) {
+		close(iSocket);
+		return false;
+	}
+	strUnixPath = strSocketPath;
+	return StartListening(iSocket);
+}
+
+bool CDppMetricsExporter::StartListening(int iSocket)
+{
+	if ((listen(iSocket, 8) < 0) || (fcntl(iSocket, F_SETFL, fcntl(iSocket, F_GETFL, 0) | O_NONBLOCK) < 0)) {
+		close(iSocket);
+		if (strUnixPath.length() > 0) {
+			unlink(strUnixPath.c_str());
+		}
+		return false;
+	}
+	iListenSocket = iSocket;
+	dblLastScrapeTime = 0;
+	bStopReq = false;
+	bRunning = true;
+	ServerThreadHandle = thread(&CDppMetricsExporter::ServerThread, this);
+	return true;
+}
+
+void CDppMetricsExporter::Stop()
+{
+	if (! bRunning) {
+		return;
+	}
+	bStopReq = true;
+	if (ServerThreadHandle.joinable()) {
+		ServerThreadHandle.join();
+	}
+	close(iListenSocket);
+	iListenSocket = -1;
+	if (strUnixPath.length() > 0) {
+		unlink(strUnixPath.c_str());
+	}
+	bRunning = false;
+}
+
+void CDppMetricsExporter::ServerThread()
+{
+	struct pollfd PollFd;
+	int iClient;
+
+	while (! bStopReq) {
+		PollFd.fd = iListenSocket;
+		PollFd.events = POLLIN;
+		PollFd.revents = 0;
+		if (poll(&PollFd, 1, METRICS_EXPORTER_POLL_MS) <= 0) {
+			continue;
+		}
+		while ((iClient = accept(iListenSocket, NULL, NULL)) >= 0) {
+			ServeClient(iClient);
+			close(iClient);
+		}
+	}
+}
+
+// answers any request with the metrics, the request line and headers are not interpreted
+void CDppMetricsExporter::ServeClient(int iClient)
+{
+	char Request[METRICS_REQUEST_SIZE];
+	struct pollfd PollFd;
+	string strBody;
+	string strResponse;
+	stringex strfn;
+	long lReceived;
+	long lRead;
+	long lSent;
+	long lResult;
+
+	fcntl(iClient, F_SETFL, fcntl(iClient, F_GETFL, 0) | O_NONBLOCK);
+	lReceived = 0;
+	Request[0] = 0;
+	while ((lReceived < METRICS_REQUEST_SIZE - 1) && (strstr(Request, "\r\n\r\n") == NULL) && (strstr(Request, "\n\n") == NULL)) {
+		PollFd.fd = iClient;
+		PollFd.events = POLLIN;
+		PollFd.revents = 0;
+		if (poll(&PollFd, 1, METRICS_REQUEST_TIMEOUT_MS) <= 0) {
+			return;			// slow or idle client
+		}
+		lRead = recv(iClient, Request + lReceived, METRICS_REQUEST_SIZE - 1 - lReceived, 0);
+		if (lRead <= 0) {
+			return;
+		}
+		lReceived += lRead;
+		Request[lReceived] = 0;
+	}
+	strBody = MetricsToText();
+	strResponse = "HTTP/1.0 200 OK\r\n";
+	strResponse += "Content-Type: text/plain; version=0.0.4\r\n";
+	strResponse += strfn.Format("Content-Length: %lu\r\n", (unsigned long)strBody.length());
+	strResponse += "Connection: close\r\n\r\n";
+	strResponse += strBody;
+	lSent = 0;
+	while (lSent < (long)strResponse.length()) {
+		lResult = send(iClient, strResponse.c_str() + lSent, strResponse.length() - lSent, METRICS_SEND_FLAGS);
+		if (lResult > 0) {
+			lSent += lResult;
+			continue;
+		}
+		PollFd.fd = iClient;
+		PollFd.events = POLLOUT;
+		PollFd.revents = 0;
+		if ((lResult < 0) && (poll(&PollFd, 1, METRICS_REQUEST_TIMEOUT_MS) > 0)) {
+			continue;
+		}
+		return;
+	}
+}
+
+#endif
+
+// appends one sample line, missing values are written as NaN
+static void AddMetric(string *strText, string strName, string strHelp, string strType, double dblValue)
+{
+	stringex strfn;
+
+	*strText += "# HELP " + strName + " " + strHelp + "\n";
+	*strText += "# TYPE " + strName + " " + strType + "\n";
+	if (isnan(dblValue)) {
+		*strText += strName + " NaN\n";
+	} else {
+		*strText += strName + strfn.Format(" %.10g\n", dblValue);
+	}
+}
+
+string CDppMetricsExporter::MetricsToText()
+{
+	TRANSPORT_METRICS *Metrics;
+	LATENCY_HISTOGRAM *Latency;
+	string strText;
+	stringex strfn;
+	double dblNow;
+	double dblElapsed;
+	unsigned long long ullSpectraNow;
+	unsigned long long ullStatusNow;
+	double dblSpectraRate;
+	double dblStatusRate;
+	const double Quantiles[] = {0.5, 0.9, 0.99, 0.999};
+	int idxQuantile;
+
+	// rates over the interval since the previous scrape
+	dblNow = chrono::duration<double>(chrono::steady_clock::now().time_since_epoch()).count();
+	ullSpectraNow = ullSpectra;
+	ullStatusNow = ullStatus + ullStatusMX2;
+	dblSpectraRate = NAN;
+	dblStatusRate = NAN;
+	dblElapsed = dblNow - dblLastScrapeTime;
+	if ((dblLastScrapeTime > 0) && (dblElapsed > 0)) {
+		dblSpectraRate = (ullSpectraNow - ullLastSpectra) / dblElapsed;
+		dblStatusRate = (ullStatusNow - ullLastStatus) / dblElapsed;
+	}
+	dblLastScrapeTime = dblNow;
+	ullLastSpectra = ullSpectraNow;
+	ullLastStatus = ullStatusNow;
+
+	AddMetric(&strText, "dpp_spectra_total", "Spectra received.", "counter", (double)ullSpectraNow);
+	AddMetric(&strText, "dpp_spectra_per_second", "Spectra received per second since the previous scrape.", "gauge", dblSpectraRate);
+	AddMetric(&strText, "dpp_status_total", "Status packets received.", "counter", (double)ullStatusNow);
+	AddMetric(&strText, "dpp_status_per_second", "Status packets received per second since the previous scrape.", "gauge", dblStatusRate);
+	AddMetric(&strText, "dpp_dead_time_ratio", "Dead time fraction (1 - slow/fast counts) of the last status.", "gauge", dblDeadTime);
+	AddMetric(&strText, "dpp_detector_temperature_kelvin", "Detector temperature.", "gauge", dblDetTemp);
+	AddMetric(&strText, "dpp_board_temperature_celsius", "Board temperature.", "gauge", dblBoardTemp);
+	AddMetric(&strText, "dpp_high_voltage_volts", "Detector high voltage.", "gauge", dblHV);
+	if (ullStatusMX2 > 0) {
+		AddMetric(&strText, "mx2_high_voltage_monitor", "Mini-X2 HV monitor.", "gauge", dblMx2HvMon);
+		AddMetric(&strText, "mx2_current_monitor", "Mini-X2 current monitor.", "gauge", dblMx2IMon);
+		AddMetric(&strText, "mx2_temperature_celsius", "Mini-X2 temperature.", "gauge", dblMx2Temp);
+	}
+	if (TransportMetrics != NULL) {
+		Metrics = new TRANSPORT_METRICS;
+		TransportMetrics->GetSnapshot(Metrics);
+		Latency = &Metrics->Total.Latency;
+		strText += "# HELP dpp_usb_latency_seconds USB command round trip time.\n";
+		strText += "# TYPE dpp_usb_latency_seconds summary\n";
+		for (idxQuantile=0;idxQuantile<(int)(sizeof(Quantiles)/sizeof(Quantiles[0]));idxQuantile++) {
+			strText += strfn.Format("dpp_usb_latency_seconds{quantile=\"%g\"} %.6f\n", Quantiles[idxQuantile], TransportMetrics->GetPercentile(Latency, Quantiles[idxQuantile] * 100.0) / 1.0e6);
+		}
+		strText += strfn.Format("dpp_usb_latency_seconds_sum %.6f\n", Latency->ullSumUs / 1.0e6);
+		strText += strfn.Format("dpp_usb_latency_seconds_count %llu\n", Latency->ullTotalCount);
+		AddMetric(&strText, "dpp_usb_requests_total", "USB command transfers.", "counter", (double)Metrics->Total.ullRequests);
+		AddMetric(&strText, "dpp_usb_timeouts_total", "USB command transfers timed out.", "counter", (double)Metrics->Total.ullTimeouts);
+		AddMetric(&strText, "dpp_usb_errors_total", "USB command transfer errors.", "counter", (double)Metrics->Total.ullUsbErrors);
+		AddMetric(&strText, "dpp_packet_errors_total", "Response sync, length and checksum errors.", "counter", (double)(Metrics->Total.ullSyncErrors + Metrics->Total.ullLenErrors + Metrics->Total.ullChecksumErrors));
+		AddMetric(&strText, "dpp_usb_bytes_in_total", "Response bytes received.", "counter", (double)Metrics->Total.ullBytesIn);
+		AddMetric(&strText, "dpp_usb_bytes_out_total", "Request bytes sent.", "counter", (double)Metrics->Total.ullBytesOut);
+		delete Metrics;
+	}
+	return strText;
+}
@@ -0,0 +1,75 @@
+/** CDppMetricsExporter CDppMetricsExporter */
+#pragma once
+#include <string>
+#include <atomic>
+#include <thread>
+#include "DP5Status.h"
+#include "DppTransportMetrics.h"
+using namespace std;
+
+#define METRICS_EXPORTER_POLL_MS 200		/// server thread stop check interval
+#define METRICS_REQUEST_TIMEOUT_MS 1000		/// time allowed for a scrape request
+#define METRICS_REQUEST_SIZE 4096			/// request bytes read (headers are ignored)
+
+/** CDppMetricsExporter serves acquisition and device metrics in the Prometheus text format.
+	The acquisition code only updates atomic counters and gauges, the server thread
+	builds the response when scraped. Listens on a localhost TCP port or a Unix socket.
+*/
+class CDppMetricsExporter
+{
+public:
+	CDppMetricsExporter(void);
+	~CDppMetricsExporter(void);
+
+	/// Starts serving on 127.0.0.1:iPort.
+	bool Start(int iPort);
+	/// Starts serving on a Unix socket (not supported on Windows).
+	bool StartUnix(string strSocketPath);
+	/// Stops the server.
+	void Stop();
+	/// Returns true while serving.
+	bool IsRunning();
+	/// USB transfer metrics to export (latency quantiles, errors).
+	void SetTransportMetrics(CDppTransportMetrics *Metrics);
+
+	/// Counts a status and updates the device gauges.
+	void RecordStatus(const DP4_FORMAT_STATUS *Status);
+	/// Counts a Mini-X2 status and updates the Mini-X2 gauges.
+	void RecordStatusMX2(const Stat_MNX *Status);
+	/// Counts a received spectrum.
+	void RecordSpectrum();
+
+	/// Builds the metrics text served on each scrape.
+	string MetricsToText();
+
+private:
+	/// Server thread, accepts and answers scrapes.
+	void ServerThread();
+	/// Reads the request and sends the metrics.
+	void ServeClient(int iClient);
+	/// Puts the listening socket in the server state.
+	bool StartListening(int iSocket);
+
+	CDppTransportMetrics *TransportMetrics;
+	int iListenSocket;
+	string strUnixPath;
+	atomic<bool> bRunning;
+	atomic<bool> bStopReq;
+	thread ServerThreadHandle;
+
+	atomic<unsigned long long> ullSpectra;		/// spectra received
+	atomic<unsigned long long> ullStatus;		/// status packets received
+	atomic<unsigned long long> ullStatusMX2;	/// Mini-X2 status packets received
+	atomic<double> dblDetTemp;
+	atomic<double> dblBoardTemp;
+	atomic<double> dblHV;
+	atomic<double> dblDeadTime;					/// 1 - slow/fast counts of the last status
+	atomic<double> dblMx2HvMon;
+	atomic<double> dblMx2IMon;
+	atomic<double> dblMx2Temp;
+
+	// rates between scrapes (server thread only)
+	double dblLastScrapeTime;
+	unsigned long long ullLastSpectra;
+	unsigned long long ullLastStatus;
+};
@@ -0,0 +1,59 @@
+#include "DppRoiIndex.h"
+#include <stddef.h>
+#include <algorithm>
+using namespace std;
+
+void CDppRoiIndex::Build(const long lData[], long lChannels, unsigned long long ullPrefix[])
+{
+	long idxChan;
+
+	ullPrefix[0] = 0;
+	for (idxChan=0;idxChan<lChannels;idxChan++) {
+		ullPrefix[idxChan + 1] = ullPrefix[idxChan] + (unsigned long long)lData[idxChan];
+	}
+}
+
+unsigned long long CDppRoiIndex::Sum(const unsigned long long ullPrefix[], long lChannels, long lLow, long lHigh)
+{
+	lLow = max(lLow, 0L);
+	lHigh = min(lHigh, lChannels - 1);
+	if (lLow > lHigh) {
+		return 0;
+	}
+	return ullPrefix[lHigh + 1] - ullPrefix[lLow];
+}
+
+bool CDppRoiIndex::Query(const unsigned long long ullPrefix[], long lChannels, const ROI_RANGE Rois[], int iRois, long lBackgroundWidth, ROI_RESULT Results[])
+{
+	ROI_RESULT *Result;
+	long lLow, lHigh, lLeft, lRight;
+	double dblLeft, dblRight;
+	int idxRoi;
+
+	if ((ullPrefix == NULL) || (Rois == NULL) || (Results == NULL) || (iRois < 0) || (lChannels <= 0)) {
+		return false;
+	}
+	for (idxRoi=0;idxRoi<iRois;idxRoi++) {
+		Result = &Results[idxRoi];
+		lLow = max(Rois[idxRoi].lLow, 0L);
+		lHigh = min(Rois[idxRoi].lHigh, lChannels - 1);
+		Result->lChannels = (lLow <= lHigh) ? (lHigh - lLow + 1) : 0;
+		Result->ullGross = Sum(ullPrefix, lChannels, lLow, lHigh);
+		Result->dblBackground = 0;
+		if ((lBackgroundWidth > 0) && (Result->lChannels > 0)) {
+			// line through the mean of the channels on each side, one side only at the spectrum ends
+			lLeft = lLow - max(lLow - lBackgroundWidth, 0L);
+			lRight = min(lHigh + lBackgroundWidth, lChannels - 1) - lHigh;
+			dblLeft = (lLeft > 0) ? ((double)Sum(ullPrefix, lChannels, lLow - lLeft, lLow - 1) / lLeft) : 0;
+			dblRight = (lRight > 0) ? ((double)Sum(ullPrefix, lChannels, lHigh + 1, lHigh + lRight) / lRight) : 0;
+			if (lLeft == 0) {
+				dblLeft = dblRight;
+			} else if (lRight == 0) {
+				dblRight = dblLeft;
+			}
+			Result->dblBackground = (dblLeft + dblRight) * 0.5 * Result->lChannels;
+		}
+		Result->dblNet = (double)Result->ullGross - Result->dblBackground;
+	}
+	return true;
+}
@@ -0,0 +1,34 @@
+/** CDppRoiIndex CDppRoiIndex */
+#pragma once
+
+/// Region of interest (inclusive channels).
+typedef struct _ROI_RANGE
+{
+	long lLow;
+	long lHigh;
+} ROI_RANGE;
+
+/// Counts of a region of interest.
+typedef struct _ROI_RESULT
+{
+	long lChannels;					/// channels in the region (after clipping to the spectrum)
+	unsigned long long ullGross;	/// counts in the region
+	double dblBackground;			/// linear background under the region (0 without background channels)
+	double dblNet;					/// gross minus background
+} ROI_RESULT;
+
+/** CDppRoiIndex answers region of interest counts from a spectrum prefix sum array
+	(ullPrefix[i] is the sum of channels 0 to i-1, lChannels + 1 entries). Each region
+	costs a few subtractions whatever its width, including the linear background taken
+	from the mean of lBackgroundWidth channels on each side of the region.
+*/
+class CDppRoiIndex
+{
+public:
+	/// Fills the prefix sums of a spectrum (lChannels + 1 values).
+	static void Build(const long lData[], long lChannels, unsigned long long ullPrefix[]);
+	/// Counts of channels lLow to lHigh (clipped), 0 if the range is empty.
+	static unsigned long long Sum(const unsigned long long ullPrefix[], long lChannels, long lLow, long lHigh);
+	/// Counts of iRois regions, lBackgroundWidth 0 skips the background.
+	static bool Query(const unsigned long long ullPrefix[], long lChannels, const ROI_RANGE Rois[], int iRois, long lBackgroundWidth, ROI_RESULT Results[]);
+};
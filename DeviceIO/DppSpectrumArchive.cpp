@@ -0,0 +1,428 @@
+#ifndef _WIN32
+	#define _FILE_OFFSET_BITS 64		// 64 bit off_t for fseeko/ftello, ftruncate and fstat on 32 bit builds
+#endif
+#include "DppSpectrumArchive.h"
+#include "DppMcaWriter.h"
+#include "DppMcaReader.h"
+#include "DP5Status.h"
+#include <string.h>
+#include <stdlib.h>
+#include <chrono>
+#ifdef _WIN32
+	#include <io.h>
+#else
+	#include <fcntl.h>
+	#include <unistd.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+#endif
+
+#define ARCHIVE_ALIGN(Size) (((Size) + 7) & ~7ULL)
+
+// 64 bit file positions, archives grow past 2 GB
+#ifdef _WIN32
+	#define ArchiveSeek _fseeki64
+	#define ArchiveTell _ftelli64
+#else
+	#define ArchiveSeek fseeko
+	#define ArchiveTell ftello
+#endif
+
+// header fields the reader relies on: the configuration fits in the header, the counts in the record
+static bool ArchiveHeaderValid(const ARCHIVE_HEADER *Header)
+{
+	return (Header->uiMagic == ARCHIVE_MAGIC) && (Header->uiVersion == ARCHIVE_VERSION) &&
+		(Header->uiChannels > 0) && (Header->uiChannels <= ARCHIVE_MAX_CHANNELS) &&
+		(sizeof(ARCHIVE_HEADER) + (unsigned long long)Header->uiConfigLength <= Header->uiHeaderSize) &&
+		(sizeof(ARCHIVE_RECORD) + (unsigned long long)Header->uiChannels * sizeof(unsigned int) <= Header->uiRecordSize);
+}
+
+CDppSpectrumArchive::CDppSpectrumArchive(void)
+{
+	WriteFile = NULL;
+	pMap = NULL;
+	iMapSize = 0;
+	ReadHeader = NULL;
+	ReadIndex = NULL;
+	lReadRecords = 0;
+}
+
+CDppSpectrumArchive::~CDppSpectrumArchive(void)
+{
+	Close();
+	CloseRead();
+}
+
+unsigned long long CDppSpectrumArchive::ConfigHash(string strConfig)
+{
+	unsigned long long ullHash;
+	size_t idxCh;
+
+	ullHash = 14695981039346656037ULL;
+	for (idxCh=0;idxCh<strConfig.length();idxCh++) {
+		ullHash ^= (unsigned char)strConfig[idxCh];
+		ullHash *= 1099511628211ULL;
+	}
+	return ullHash;
+}
+
+bool CDppSpectrumArchive::Create(string strFilename, unsigned long ulSerialNumber, string strConfig, long lChannels)
+{
+	vector<unsigned char> HeaderBytes;
+
+	Close();
+	if ((lChannels <= 0) || (lChannels > ARCHIVE_MAX_CHANNELS)) {
+		return false;
+	}
+	memset(&WriteHeader, 0, sizeof(WriteHeader));
+	WriteHeader.uiMagic = ARCHIVE_MAGIC;
+	WriteHeader.uiVersion = ARCHIVE_VERSION;
+	WriteHeader.uiConfigLength = (unsigned int)strConfig.length();
+	WriteHeader.uiHeaderSize = (unsigned int)ARCHIVE_ALIGN(sizeof(ARCHIVE_HEADER) + strConfig.length());
+	WriteHeader.uiChannels = (unsigned int)lChannels;
+	WriteHeader.uiRecordSize = (unsigned int)ARCHIVE_ALIGN(sizeof(ARCHIVE_RECORD) + lChannels * sizeof(unsigned int));
+	WriteHeader.uiSerialNumber = (unsigned int)ulSerialNumber;
+	WriteHeader.ullConfigHash = ConfigHash(strConfig);
+	WriteHeader.dblCreateTime = chrono::duration<double>(chrono::system_clock::now().time_since_epoch()).count();
+	HeaderBytes.assign(WriteHeader.uiHeaderSize, 0);
+	memcpy(&HeaderBytes[0], &WriteHeader, sizeof(WriteHeader));
+	memcpy(&HeaderBytes[sizeof(WriteHeader)], strConfig.c_str(), strConfig.length());
+	if ((WriteFile = fopen(strFilename.c_str(), "w+b")) == NULL) {
+		return false;
+	}
+	if (fwrite(&HeaderBytes[0], 1, HeaderBytes.size(), WriteFile) != HeaderBytes.size()) {
+		fclose(WriteFile);
+		WriteFile = NULL;
+		return false;
+	}
+	vIndex.clear();
+	return true;
+}
+
+bool CDppSpectrumArchive::ReadForAppend(FILE *ArchiveFile)
+{
+	ARCHIVE_FOOTER Footer;
+	ARCHIVE_RECORD Record;
+	ARCHIVE_INDEX_ENTRY Entry;
+	long long llSize;
+	long long llRecords;
+	long long idxRecord;
+	long long llEnd;
+
+	if ((fread(&WriteHeader, 1, sizeof(WriteHeader), ArchiveFile) != sizeof(WriteHeader)) || ! ArchiveHeaderValid(&WriteHeader)) {
+		return false;
+	}
+	ArchiveSeek(ArchiveFile, 0, SEEK_END);
+	if ((llSize = (long long)ArchiveTell(ArchiveFile)) < (long long)WriteHeader.uiHeaderSize) {
+		return false;
+	}
+	llRecords = -1;
+	// closed archive: records end where the index starts
+	if (llSize >= (long long)(WriteHeader.uiHeaderSize + sizeof(Footer))) {
+		ArchiveSeek(ArchiveFile, llSize - (long long)sizeof(Footer), SEEK_SET);
+		if ((fread(&Footer, 1, sizeof(Footer), ArchiveFile) == sizeof(Footer)) && (Footer.uiMagic == ARCHIVE_INDEX_MAGIC) &&
+			(Footer.ullIndexOffset == WriteHeader.uiHeaderSize + Footer.ullRecords * WriteHeader.uiRecordSize)) {
+			llRecords = (long long)Footer.ullRecords;
+		}
+	}
+	// archive not closed: complete records by stride
+	if (llRecords < 0) {
+		llRecords = (llSize - WriteHeader.uiHeaderSize) / WriteHeader.uiRecordSize;
+	}
+	vIndex.clear();
+	for (idxRecord=0;idxRecord<llRecords;idxRecord++) {
+		Entry.ullOffset = WriteHeader.uiHeaderSize + idxRecord * WriteHeader.uiRecordSize;
+		ArchiveSeek(ArchiveFile, (long long)Entry.ullOffset, SEEK_SET);
+		if ((fread(&Record, 1, sizeof(Record), ArchiveFile) != sizeof(Record)) || (Record.uiMagic != ARCHIVE_RECORD_MAGIC)) {
+			break;
+		}
+		Entry.dblHostTime = Record.dblHostTime;
+		vIndex.push_back(Entry);
+	}
+	llEnd = WriteHeader.uiHeaderSize + (long long)vIndex.size() * WriteHeader.uiRecordSize;
+	fflush(ArchiveFile);
+#ifdef _WIN32
+	if (_chsize_s(_fileno(ArchiveFile), llEnd) != 0) {
+		return false;
+	}
+#else
+	if (ftruncate(fileno(ArchiveFile), (off_t)llEnd) != 0) {
+		return false;
+	}
+#endif
+	ArchiveSeek(ArchiveFile, llEnd, SEEK_SET);
+	return true;
+}
+
+bool CDppSpectrumArchive::OpenAppend(string strFilename)
+{
+	Close();
+	if ((WriteFile = fopen(strFilename.c_str(), "r+b")) == NULL) {
+		return false;
+	}
+	if (! ReadForAppend(WriteFile)) {
+		fclose(WriteFile);
+		WriteFile = NULL;
+		return false;
+	}
+	return true;
+}
+
+bool CDppSpectrumArchive::Append(const long lData[], long lChannels, const unsigned char Status[], double dblLiveTime, double dblRealTime, long long llRxTimeNs)
+{
+	ARCHIVE_RECORD *Record;
+	ARCHIVE_INDEX_ENTRY Entry;
+	unsigned int *pChannels;
+	long idxChan;
+
+	if ((WriteFile == NULL) || (lChannels != (long)WriteHeader.uiChannels)) {
+		return false;
+	}
+	RecordBuffer.assign(WriteHeader.uiRecordSize, 0);
+	Record = (ARCHIVE_RECORD *)&RecordBuffer[0];
+	Record->uiMagic = ARCHIVE_RECORD_MAGIC;
+	Record->uiSequence = (unsigned int)vIndex.size();
+	Record->dblHostTime = chrono::duration<double>(chrono::system_clock::now().time_since_epoch()).count();
+	Record->llRxTimeNs = llRxTimeNs;
+	Record->dblLiveTime = dblLiveTime;
+	Record->dblRealTime = dblRealTime;
+	if (Status != NULL) {
+		Record->uiFlags |= ARCHIVE_FLAG_STATUS;
+		memcpy(Record->Status, Status, ARCHIVE_STATUS_SIZE);
+	}
+	pChannels = (unsigned int *)&RecordBuffer[sizeof(ARCHIVE_RECORD)];
+	for (idxChan=0;idxChan<lChannels;idxChan++) {
+		pChannels[idxChan] = (unsigned int)lData[idxChan];
+	}
+	Entry.ullOffset = WriteHeader.uiHeaderSize + (unsigned long long)vIndex.size() * WriteHeader.uiRecordSize;
+	Entry.dblHostTime = Record->dblHostTime;
+	if (fwrite(&RecordBuffer[0], 1, RecordBuffer.size(), WriteFile) != RecordBuffer.size()) {
+		return false;
+	}
+	vIndex.push_back(Entry);
+	return true;
+}
+
+bool CDppSpectrumArchive::Flush()
+{
+	return ((WriteFile != NULL) && (fflush(WriteFile) == 0));
+}
+
+bool CDppSpectrumArchive::Close()
+{
+	ARCHIVE_FOOTER Footer;
+	bool bClosed;
+
+	if (WriteFile == NULL) {
+		return false;
+	}
+	memset(&Footer, 0, sizeof(Footer));
+	Footer.uiMagic = ARCHIVE_INDEX_MAGIC;
+	Footer.ullRecords = vIndex.size();
+	Footer.ullIndexOffset = WriteHeader.uiHeaderSize + (unsigned long long)vIndex.size() * WriteHeader.uiRecordSize;
+	bClosed = true;
+	if ((vIndex.size() > 0) && (fwrite(&vIndex[0], sizeof(ARCHIVE_INDEX_ENTRY), vIndex.size(), WriteFile) != vIndex.size())) {
+		bClosed = false;
+	}
+	if (fwrite(&Footer, 1, sizeof(Footer), WriteFile) != sizeof(Footer)) {
+		bClosed = false;
+	}
+	if (fclose(WriteFile) != 0) {
+		bClosed = false;
+	}
+	WriteFile = NULL;
+	vIndex.clear();
+	return bClosed;
+}
+
+bool CDppSpectrumArchive::OpenRead(string strFilename)
+{
+	const ARCHIVE_FOOTER *Footer;
+	size_t iRecordBytes;
+
+	CloseRead();
+#ifdef _WIN32
+	FILE *ArchiveFile;
+	long long llSize;
+	if ((ArchiveFile = fopen(strFilename.c_str(), "rb")) == NULL) {
+		return false;
+	}
+	ArchiveSeek(ArchiveFile, 0, SEEK_END);
+	llSize = (long long)ArchiveTell(ArchiveFile);
+	ArchiveSeek(ArchiveFile, 0, SEEK_SET);
+	ReadBuffer.resize(llSize > 0 ? (size_t)llSize : 0);
+	if ((llSize <= 0) || (fread(&ReadBuffer[0], 1, ReadBuffer.size(), ArchiveFile) != ReadBuffer.size())) {
+		fclose(ArchiveFile);
+		ReadBuffer.clear();
+		return false;
+	}
+	fclose(ArchiveFile);
+	pMap = &ReadBuffer[0];
+	iMapSize = ReadBuffer.size();
+#else
+	struct stat FileStat;
+	void *pView;
+	int iFile;
+	if ((iFile = open(strFilename.c_str(), O_RDONLY)) < 0) {
+		return false;
+	}
+	if ((fstat(iFile, &FileStat) != 0) || (FileStat.st_size <= 0)) {
+		close(iFile);
+		return false;
+	}
+	pView = mmap(NULL, (size_t)FileStat.st_size, PROT_READ, MAP_SHARED, iFile, 0);
+	close(iFile);
+	if (pView == MAP_FAILED) {
+		return false;
+	}
+	pMap = (const unsigned char *)pView;
+	iMapSize = (size_t)FileStat.st_size;
+#endif
+	ReadHeader = (const ARCHIVE_HEADER *)pMap;
+	if ((iMapSize < sizeof(ARCHIVE_HEADER)) || ! ArchiveHeaderValid(ReadHeader) || (ReadHeader->uiHeaderSize > iMapSize)) {
+		CloseRead();
+		return false;
+	}
+	ReadIndex = NULL;
+	lReadRecords = (long)((iMapSize - ReadHeader->uiHeaderSize) / ReadHeader->uiRecordSize);
+	if (iMapSize >= ReadHeader->uiHeaderSize + sizeof(ARCHIVE_FOOTER)) {
+		Footer = (const ARCHIVE_FOOTER *)(pMap + iMapSize - sizeof(ARCHIVE_FOOTER));
+		iRecordBytes = (size_t)Footer->ullRecords * ReadHeader->uiRecordSize;
+		if ((Footer->uiMagic == ARCHIVE_INDEX_MAGIC) && (Footer->ullRecords <= iMapSize / ReadHeader->uiRecordSize) &&
+			(Footer->ullIndexOffset == ReadHeader->uiHeaderSize + iRecordBytes) &&
+			(Footer->ullIndexOffset + Footer->ullRecords * sizeof(ARCHIVE_INDEX_ENTRY) + sizeof(ARCHIVE_FOOTER) == iMapSize)) {
+			ReadIndex = (const ARCHIVE_INDEX_ENTRY *)(pMap + Footer->ullIndexOffset);
+			lReadRecords = (long)Footer->ullRecords;
+		}
+	}
+	// archive not closed: stop at the first incomplete record
+	if (ReadIndex == NULL) {
+		while ((lReadRecords > 0) && (Record(lReadRecords - 1)->uiMagic != ARCHIVE_RECORD_MAGIC)) {
+			lReadRecords--;
+		}
+	}
+	return true;
+}
+
+void CDppSpectrumArchive::CloseRead()
+{
+#ifndef _WIN32
+	if ((pMap != NULL) && (ReadBuffer.size() == 0)) {
+		munmap((void *)pMap, iMapSize);
+	}
+#endif
+	ReadBuffer.clear();
+	pMap = NULL;
+	iMapSize = 0;
+	ReadHeader = NULL;
+	ReadIndex = NULL;
+	lReadRecords = 0;
+}
+
+string CDppSpectrumArchive::Config()
+{
+	if (ReadHeader == NULL) {
+		return "";
+	}
+	return string((const char *)(pMap + sizeof(ARCHIVE_HEADER)), ReadHeader->uiConfigLength);
+}
+
+const ARCHIVE_RECORD *CDppSpectrumArchive::Record(long idxRecord)
+{
+	if ((ReadHeader == NULL) || (idxRecord < 0) || (idxRecord >= lReadRecords)) {
+		return NULL;
+	}
+	return (const ARCHIVE_RECORD *)(pMap + ReadHeader->uiHeaderSize + (size_t)idxRecord * ReadHeader->uiRecordSize);
+}
+
+const unsigned int *CDppSpectrumArchive::Channels(long idxRecord)
+{
+	const ARCHIVE_RECORD *RecordHeader;
+
+	if ((RecordHeader = Record(idxRecord)) == NULL) {
+		return NULL;
+	}
+	return (const unsigned int *)(RecordHeader + 1);
+}
+
+long CDppSpectrumArchive::FindTime(double dblTime)
+{
+	long lLow;
+	long lHigh;
+	long lMid;
+	double dblMid;
+
+	lLow = 0;
+	lHigh = lReadRecords;
+	while (lLow < lHigh) {
+		lMid = (lLow + lHigh) / 2;
+		dblMid = (ReadIndex != NULL) ? ReadIndex[lMid].dblHostTime : Record(lMid)->dblHostTime;
+		if (dblMid < dblTime) {
+			lLow = lMid + 1;
+		} else {
+			lHigh = lMid;
+		}
+	}
+	return (lLow < lReadRecords) ? lLow : -1;
+}
+
+bool CDppSpectrumArchive::RecordToMca(long idxRecord, string strFilename)
+{
+	const ARCHIVE_RECORD *RecordHeader;
+	const unsigned int *pChannels;
+	CDppMcaWriter McaWriter;
+	CDP5Status DP5Stat;
+	DP4_FORMAT_STATUS Status;
+	MCA_FILE_INFO McaInfo;
+	vector<long> vData;
+	unsigned int idxChan;
+
+	if ((RecordHeader = Record(idxRecord)) == NULL) {
+		return false;
+	}
+	pChannels = Channels(idxRecord);
+	vData.resize(ReadHeader->uiChannels);
+	for (idxChan=0;idxChan<ReadHeader->uiChannels;idxChan++) {
+		vData[idxChan] = (long)pChannels[idxChan];
+	}
+	McaInfo.strTag = "";
+	McaInfo.strDescription = "Amptek Spectrum File";
+	McaInfo.SerialNumber = ReadHeader->uiSerialNumber;
+	McaInfo.dblLiveTime = RecordHeader->dblLiveTime;
+	McaInfo.dblRealTime = RecordHeader->dblRealTime;
+	McaInfo.strConfig = Config();
+	McaInfo.strStatus = "";
+	if (RecordHeader->uiFlags & ARCHIVE_FLAG_STATUS) {
+		memset(&Status, 0, sizeof(Status));
+		memcpy(Status.RAW, RecordHeader->Status, sizeof(Status.RAW));
+		DP5Stat.Process_Status(&Status);
+		McaInfo.strStatus = DP5Stat.ShowStatusValueStrings(Status);
+	}
+	return McaWriter.SaveSpectrum(strFilename, &McaInfo, &vData[0], (long)vData.size());
+}
+
+bool CDppSpectrumArchive::McaToArchive(string strMcaFile, string strArchive)
+{
+	CDppSpectrumArchive Archive;
+	CDppMcaReader McaReader;
+	MCA_FILE_DATA McaData;
+	FILE *ArchiveFile;
+
+	if (! McaReader.ReadFile(strMcaFile, &McaData) || (McaData.vData.size() == 0)) {
+		return false;
+	}
+	if ((ArchiveFile = fopen(strArchive.c_str(), "rb")) != NULL) {
+		fclose(ArchiveFile);
+		if (! Archive.OpenAppend(strArchive)) {
+			return false;
+		}
+	} else if (! Archive.Create(strArchive, McaData.Info.SerialNumber, McaData.Info.strConfig, (long)McaData.vData.size())) {
+		return false;
+	}
+	// .mca files keep the status as text only
+	if (! Archive.Append(&McaData.vData[0], (long)McaData.vData.size(), NULL, McaData.Info.dblLiveTime, McaData.Info.dblRealTime, 0)) {
+		Archive.Close();
+		return false;
+	}
+	return Archive.Close();
+}
@@ -0,0 +1,128 @@
+/** CDppSpectrumArchive CDppSpectrumArchive */
+#pragma once
+#include <stdio.h>
+#include <string>
+#include <vector>
+using namespace std;
+
+#define ARCHIVE_MAGIC 0x41535044			/// "DPSA" file header
+#define ARCHIVE_RECORD_MAGIC 0x52535044		/// "DPSR" record
+#define ARCHIVE_INDEX_MAGIC 0x49535044		/// "DPSI" index footer
+#define ARCHIVE_VERSION 1
+#define ARCHIVE_MAX_CHANNELS 16384
+#define ARCHIVE_STATUS_SIZE 64				/// raw DPP status packet
+
+#define ARCHIVE_FLAG_STATUS 0x0001			/// record holds a raw status
+
+/// File header, followed by the configuration text (padded to 8 bytes).
+typedef struct _ARCHIVE_HEADER
+{
+	unsigned int uiMagic;
+	unsigned int uiVersion;
+	unsigned int uiHeaderSize;			/// bytes before the first record
+	unsigned int uiChannels;			/// channels per record
+	unsigned int uiRecordSize;			/// record stride
+	unsigned int uiSerialNumber;		/// device serial number
+	unsigned long long ullConfigHash;	/// FNV-1a hash of the configuration text
+	double dblCreateTime;				/// seconds since 1970
+	unsigned int uiConfigLength;		/// configuration text bytes
+	unsigned int uiReserved[7];
+} ARCHIVE_HEADER;
+
+/// Record header, followed by uiChannels 32 bit counts.
+typedef struct _ARCHIVE_RECORD
+{
+	unsigned int uiMagic;
+	unsigned int uiSequence;			/// record number
+	double dblHostTime;					/// seconds since 1970
+	long long llRxTimeNs;				/// host monotonic USB completion time (0 if unknown)
+	double dblLiveTime;					/// accumulation time (s)
+	double dblRealTime;					/// real time (s)
+	unsigned int uiFlags;				/// ARCHIVE_FLAG_*
+	unsigned int uiReserved;
+	unsigned char Status[ARCHIVE_STATUS_SIZE];	/// raw status (ARCHIVE_FLAG_STATUS)
+} ARCHIVE_RECORD;
+
+/// Index entry (footer).
+typedef struct _ARCHIVE_INDEX_ENTRY
+{
+	unsigned long long ullOffset;
+	double dblHostTime;
+} ARCHIVE_INDEX_ENTRY;
+
+/// Last bytes of a closed archive.
+typedef struct _ARCHIVE_FOOTER
+{
+	unsigned int uiMagic;
+	unsigned int uiReserved;
+	unsigned long long ullRecords;
+	unsigned long long ullIndexOffset;
+} ARCHIVE_FOOTER;
+
+/** CDppSpectrumArchive is an append-only binary spectrum container.
+	A header with the device serial number, configuration hash and text and the channel
+	count is followed by fixed-stride records (times, raw status, 32 bit channel counts)
+	and, once closed, an index footer. Readers map the file and access any record directly.
+	An archive that was not closed is recovered from the record stride.
+*/
+class CDppSpectrumArchive
+{
+public:
+	CDppSpectrumArchive(void);
+	~CDppSpectrumArchive(void);
+
+	/// Creates a new archive for writing.
+	bool Create(string strFilename, unsigned long ulSerialNumber, string strConfig, long lChannels);
+	/// Opens an existing archive to append records.
+	bool OpenAppend(string strFilename);
+	/// Appends a spectrum, Status is the raw status packet or NULL.
+	bool Append(const long lData[], long lChannels, const unsigned char Status[], double dblLiveTime, double dblRealTime, long long llRxTimeNs);
+	/// Writes buffered records to the file.
+	bool Flush();
+	/// Writes the index footer and closes the archive.
+	bool Close();
+	/// True while open for writing.
+	bool IsWriting() { return (WriteFile != NULL); }
+
+	/// Maps an archive for reading.
+	bool OpenRead(string strFilename);
+	/// Unmaps the archive.
+	void CloseRead();
+	/// Records in the mapped archive.
+	long RecordCount() { return lReadRecords; }
+	/// Header of the mapped archive (NULL if none).
+	const ARCHIVE_HEADER *Header() { return ReadHeader; }
+	/// Configuration text of the mapped archive.
+	string Config();
+	/// Record header, NULL if out of range.
+	const ARCHIVE_RECORD *Record(long idxRecord);
+	/// Record channel counts, NULL if out of range.
+	const unsigned int *Channels(long idxRecord);
+	/// Returns the first record at or after dblTime (seconds since 1970), -1 if none.
+	long FindTime(double dblTime);
+	/// Writes one record as a .mca file.
+	bool RecordToMca(long idxRecord, string strFilename);
+
+	/// Appends a .mca file to an archive, the archive is created from the first file.
+	static bool McaToArchive(string strMcaFile, string strArchive);
+	/// FNV-1a hash of a configuration text.
+	static unsigned long long ConfigHash(string strConfig);
+
+private:
+	/// Reads header and record count of an archive file, truncates a partial record or footer.
+	bool ReadForAppend(FILE *ArchiveFile);
+
+	// writing
+	FILE *WriteFile;
+	ARCHIVE_HEADER WriteHeader;
+	vector<ARCHIVE_INDEX_ENTRY> vIndex;
+	vector<unsigned char> RecordBuffer;
+
+	// reading
+	const unsigned char *pMap;
+	size_t iMapSize;
+	vector<unsigned char> ReadBuffer;		/// file copy where mmap is not available
+	const ARCHIVE_HEADER *ReadHeader;
+	const ARCHIVE_INDEX_ENTRY *ReadIndex;	/// NULL for recovered archives
+	long lReadRecords;
+};
@@ -0,0 +1,415 @@
+#include "DppSpectrumCodec.h"
+#include <string.h>
+
+#define CODEC_RANS_SCALE (1u << CODEC_RANS_SCALE_BITS)
+#define CODEC_MAX_STREAM (1u << 26)		// largest varint stream accepted by the decoder
+
+static void PutVarint(vector<unsigned char> *Out, unsigned long long ullValue)
+{
+	while (ullValue >= 0x80) {
+		Out->push_back((unsigned char)(ullValue | 0x80));
+		ullValue >>= 7;
+	}
+	Out->push_back((unsigned char)ullValue);
+}
+
+static bool GetVarint(const unsigned char *pIn, size_t iSize, size_t *pPos, unsigned long long *pValue)
+{
+	unsigned long long ullValue;
+	unsigned char ucByte;
+	int iShift;
+
+	ullValue = 0;
+	for (iShift=0;iShift<64;iShift+=7) {
+		if (*pPos >= iSize) {
+			return false;
+		}
+		ucByte = pIn[(*pPos)++];
+		ullValue |= (unsigned long long)(ucByte & 0x7F) << iShift;
+		if ((ucByte & 0x80) == 0) {
+			*pValue = ullValue;
+			return true;
+		}
+	}
+	return false;
+}
+
+CDppSpectrumCodec::CDppSpectrumCodec(void)
+{
+}
+
+CDppSpectrumCodec::~CDppSpectrumCodec(void)
+{
+}
+
+long CDppSpectrumCodec::Channels(const unsigned char *pIn, size_t iSize)
+{
+	CODEC_HEADER Header;
+
+	if ((pIn == NULL) || (iSize < sizeof(Header))) {
+		return -1;
+	}
+	memcpy(&Header, pIn, sizeof(Header));
+	if ((Header.ucMagic != CODEC_MAGIC) || (Header.uiPayloadSize != iSize - sizeof(Header))) {
+		return -1;
+	}
+	return (long)Header.uiChannels;
+}
+
+bool CDppSpectrumCodec::Encode(const long lData[], long lChannels, const long lPrev[], CODEC_MODE Mode, vector<unsigned char> *Out)
+{
+	CODEC_HEADER Header;
+	long long llDelta;
+	long idxChan;
+	size_t iVarintSize;
+
+	if ((Out == NULL) || (lChannels < 0) || ((lChannels > 0) && (lData == NULL)) || (Mode < cmBitPack) || (Mode > cmVarintRans)) {
+		return false;
+	}
+	vZig.resize(lChannels);
+	for (idxChan=0;idxChan<lChannels;idxChan++) {
+		if (lPrev != NULL) {
+			llDelta = (long long)lData[idxChan] - lPrev[idxChan];
+		} else {
+			llDelta = (long long)lData[idxChan] - ((idxChan > 0) ? lData[idxChan - 1] : 0);
+		}
+		vZig[idxChan] = ((unsigned long long)llDelta << 1) ^ (unsigned long long)(llDelta >> 63);
+	}
+	Out->assign(sizeof(Header), 0);
+	if (Mode == cmBitPack) {
+		if (! PackBlocks(vZig.data(), lChannels, Out)) {
+			return false;
+		}
+	} else {
+		vBytes.clear();
+		for (idxChan=0;idxChan<lChannels;idxChan++) {
+			PutVarint(&vBytes, vZig[idxChan]);
+		}
+		iVarintSize = vBytes.size();
+		if (Mode == cmVarintRans) {
+			RansEncode(vBytes, Out);
+			// keep the varints if the entropy stage does not pay for its table
+			if (Out->size() - sizeof(Header) >= iVarintSize) {
+				Out->resize(sizeof(Header));
+				Mode = cmVarint;
+			}
+		}
+		if (Mode == cmVarint) {
+			Out->insert(Out->end(), vBytes.begin(), vBytes.end());
+		}
+	}
+	Header.ucMagic = CODEC_MAGIC;
+	Header.ucMode = (unsigned char)Mode;
+	Header.ucPredictor = (unsigned char)((lPrev != NULL) ? cpFrame : cpChannel);
+	Header.ucReserved = 0;
+	Header.uiChannels = (unsigned int)lChannels;
+	Header.uiPayloadSize = (unsigned int)(Out->size() - sizeof(Header));
+	memcpy(&(*Out)[0], &Header, sizeof(Header));
+	return true;
+}
+
+long CDppSpectrumCodec::Decode(const unsigned char *pIn, size_t iSize, const long lPrev[], long lData[], long lMaxChannels)
+{
+	CODEC_HEADER Header;
+	const unsigned char *pPayload;
+	const unsigned char *pStream;
+	size_t iStreamSize;
+	size_t iPos;
+	long lChannels;
+	long idxChan;
+	long long llValue;
+
+	if ((lChannels = Channels(pIn, iSize)) < 0) {
+		return -1;
+	}
+	memcpy(&Header, pIn, sizeof(Header));
+	if ((lChannels > lMaxChannels) || ((lChannels > 0) && (lData == NULL)) || (Header.ucMode > cmVarintRans) ||
+		(Header.ucPredictor > cpFrame) || ((Header.ucPredictor == cpFrame) && (lPrev == NULL))) {
+		return -1;
+	}
+	pPayload = pIn + sizeof(Header);
+	vZig.resize(lChannels);
+	if (Header.ucMode == cmBitPack) {
+		if (! UnpackBlocks(pPayload, Header.uiPayloadSize, vZig.data(), lChannels)) {
+			return -1;
+		}
+	} else {
+		pStream = pPayload;
+		iStreamSize = Header.uiPayloadSize;
+		if (Header.ucMode == cmVarintRans) {
+			if (! RansDecode(pPayload, Header.uiPayloadSize, &vBytes)) {
+				return -1;
+			}
+			pStream = vBytes.data();
+			iStreamSize = vBytes.size();
+		}
+		iPos = 0;
+		for (idxChan=0;idxChan<lChannels;idxChan++) {
+			if (! GetVarint(pStream, iStreamSize, &iPos, &vZig[idxChan])) {
+				return -1;
+			}
+		}
+		if (iPos != iStreamSize) {
+			return -1;
+		}
+	}
+	// undo zig-zag and prediction
+	if (Header.ucPredictor == cpFrame) {
+		for (idxChan=0;idxChan<lChannels;idxChan++) {
+			lData[idxChan] = (long)(lPrev[idxChan] + ((long long)(vZig[idxChan] >> 1) ^ -(long long)(vZig[idxChan] & 1)));
+		}
+	} else {
+		llValue = 0;
+		for (idxChan=0;idxChan<lChannels;idxChan++) {
+			llValue += (long long)(vZig[idxChan] >> 1) ^ -(long long)(vZig[idxChan] & 1);
+			lData[idxChan] = (long)llValue;
+		}
+	}
+	return lChannels;
+}
+
+bool CDppSpectrumCodec::PackBlocks(const unsigned long long ullZig[], long lChannels, vector<unsigned char> *Out)
+{
+	unsigned long long ullBits;
+	unsigned long long ullAcc;
+	long idxBlock;
+	long idxChan;
+	long lCount;
+	int iWidth;
+	int iAccBits;
+
+	for (idxBlock=0;idxBlock<lChannels;idxBlock+=CODEC_BLOCK_SIZE) {
+		lCount = ((lChannels - idxBlock) < CODEC_BLOCK_SIZE) ? (lChannels - idxBlock) : CODEC_BLOCK_SIZE;
+		ullBits = 0;
+		for (idxChan=0;idxChan<lCount;idxChan++) {
+			ullBits |= ullZig[idxBlock + idxChan];
+		}
+		iWidth = 0;
+		while ((iWidth < 64) && ((ullBits >> iWidth) != 0)) {
+			iWidth++;
+		}
+		if (iWidth > CODEC_MAX_WIDTH) {
+			return false;
+		}
+		Out->push_back((unsigned char)iWidth);
+		if (iWidth == 0) {
+			continue;
+		}
+		ullAcc = 0;
+		iAccBits = 0;
+		for (idxChan=0;idxChan<lCount;idxChan++) {
+			ullAcc |= ullZig[idxBlock + idxChan] << iAccBits;
+			iAccBits += iWidth;
+			while (iAccBits >= 8) {
+				Out->push_back((unsigned char)ullAcc);
+				ullAcc >>= 8;
+				iAccBits -= 8;
+			}
+		}
+		if (iAccBits > 0) {
+			Out->push_back((unsigned char)ullAcc);
+		}
+	}
+	return true;
+}
+
+bool CDppSpectrumCodec::UnpackBlocks(const unsigned char *pIn, size_t iSize, unsigned long long ullZig[], long lChannels)
+{
+	unsigned char Padded[CODEC_BLOCK_SIZE * CODEC_MAX_WIDTH / 8 + 8];
+	const unsigned char *pBlock;
+	unsigned long long ullMask;
+	unsigned long long ullWord;
+	size_t iPos;
+	size_t iBytes;
+	size_t iBit;
+	long idxBlock;
+	long idxChan;
+	long lCount;
+	int iWidth;
+
+	iPos = 0;
+	for (idxBlock=0;idxBlock<lChannels;idxBlock+=CODEC_BLOCK_SIZE) {
+		lCount = ((lChannels - idxBlock) < CODEC_BLOCK_SIZE) ? (lChannels - idxBlock) : CODEC_BLOCK_SIZE;
+		if (iPos >= iSize) {
+			return false;
+		}
+		iWidth = pIn[iPos++];
+		if (iWidth > CODEC_MAX_WIDTH) {
+			return false;
+		}
+		iBytes = ((size_t)lCount * iWidth + 7) / 8;
+		if (iBytes > iSize - iPos) {
+			return false;
+		}
+		if (iWidth == 0) {
+			memset(&ullZig[idxBlock], 0, lCount * sizeof(ullZig[0]));
+			continue;
+		}
+		// 8 byte loads may read past the block, the last blocks are copied to a padded buffer
+		if (iBytes + 8 <= iSize - iPos) {
+			pBlock = pIn + iPos;
+		} else {
+			memset(Padded, 0, sizeof(Padded));
+			memcpy(Padded, pIn + iPos, iBytes);
+			pBlock = Padded;
+		}
+		ullMask = (1ULL << iWidth) - 1;
+		for (idxChan=0;idxChan<lCount;idxChan++) {
+			iBit = (size_t)idxChan * iWidth;
+			memcpy(&ullWord, pBlock + (iBit >> 3), sizeof(ullWord));
+			ullZig[idxBlock + idxChan] = (ullWord >> (iBit & 7)) & ullMask;
+		}
+		iPos += iBytes;
+	}
+	return (iPos == iSize);
+}
+
+void CDppSpectrumCodec::RansEncode(const vector<unsigned char> &vIn, vector<unsigned char> *Out)
+{
+	unsigned long ulCount[256];
+	unsigned int uiFreq[256];
+	unsigned int uiCum[256];
+	unsigned int uiSum;
+	unsigned int uiState;
+	unsigned int uiStateMax;
+	size_t idxByte;
+	int iSymbols;
+	int idxSym;
+	int idxLargest;
+
+	PutVarint(Out, vIn.size());
+	if (vIn.size() == 0) {
+		return;
+	}
+	// normalize the byte counts to CODEC_RANS_SCALE, every used byte keeps a slot
+	memset(ulCount, 0, sizeof(ulCount));
+	for (idxByte=0;idxByte<vIn.size();idxByte++) {
+		ulCount[vIn[idxByte]]++;
+	}
+	uiSum = 0;
+	iSymbols = 0;
+	idxLargest = 0;
+	for (idxSym=0;idxSym<256;idxSym++) {
+		uiFreq[idxSym] = 0;
+		if (ulCount[idxSym] > 0) {
+			uiFreq[idxSym] = (unsigned int)(((unsigned long long)ulCount[idxSym] * CODEC_RANS_SCALE) / vIn.size());
+			if (uiFreq[idxSym] == 0) {
+				uiFreq[idxSym] = 1;
+			}
+			uiSum += uiFreq[idxSym];
+			iSymbols++;
+			if (ulCount[idxSym] > ulCount[idxLargest]) {
+				idxLargest = idxSym;
+			}
+		}
+	}
+	if (uiSum < CODEC_RANS_SCALE) {
+		uiFreq[idxLargest] += CODEC_RANS_SCALE - uiSum;
+	}
+	while (uiSum > CODEC_RANS_SCALE) {
+		for (idxSym=0;idxSym<256;idxSym++) {
+			if (uiFreq[idxSym] > uiFreq[idxLargest]) {
+				idxLargest = idxSym;
+			}
+		}
+		uiFreq[idxLargest]--;
+		uiSum--;
+	}
+	PutVarint(Out, iSymbols);
+	uiSum = 0;
+	for (idxSym=0;idxSym<256;idxSym++) {
+		uiCum[idxSym] = uiSum;
+		uiSum += uiFreq[idxSym];
+		if (uiFreq[idxSym] > 0) {
+			Out->push_back((unsigned char)idxSym);
+			PutVarint(Out, uiFreq[idxSym]);
+		}
+	}
+	// rANS codes last to first, the output is written backwards
+	vReverse.clear();
+	uiState = CODEC_RANS_LOWER;
+	for (idxByte=vIn.size();idxByte>0;idxByte--) {
+		idxSym = vIn[idxByte - 1];
+		uiStateMax = ((CODEC_RANS_LOWER >> CODEC_RANS_SCALE_BITS) << 8) * uiFreq[idxSym];
+		while (uiState >= uiStateMax) {
+			vReverse.push_back((unsigned char)uiState);
+			uiState >>= 8;
+		}
+		uiState = ((uiState / uiFreq[idxSym]) << CODEC_RANS_SCALE_BITS) + (uiState % uiFreq[idxSym]) + uiCum[idxSym];
+	}
+	vReverse.push_back((unsigned char)(uiState >> 24));
+	vReverse.push_back((unsigned char)(uiState >> 16));
+	vReverse.push_back((unsigned char)(uiState >> 8));
+	vReverse.push_back((unsigned char)uiState);
+	Out->insert(Out->end(), vReverse.rbegin(), vReverse.rend());
+}
+
+bool CDppSpectrumCodec::RansDecode(const unsigned char *pIn, size_t iSize, vector<unsigned char> *Out)
+{
+	unsigned char SlotSymbol[CODEC_RANS_SCALE];
+	unsigned int uiFreq[256];
+	unsigned int uiCum[256];
+	unsigned long long ullLength;
+	unsigned long long ullSymbols;
+	unsigned long long ullFreq;
+	unsigned int uiSum;
+	unsigned int uiState;
+	unsigned int uiSlot;
+	unsigned char ucSymbol;
+	size_t iPos;
+	size_t idxByte;
+	unsigned long long idxSym;
+
+	iPos = 0;
+	Out->clear();
+	if (! GetVarint(pIn, iSize, &iPos, &ullLength) || (ullLength > CODEC_MAX_STREAM)) {
+		return false;
+	}
+	if (ullLength == 0) {
+		return (iPos == iSize);
+	}
+	if (! GetVarint(pIn, iSize, &iPos, &ullSymbols) || (ullSymbols == 0) || (ullSymbols > 256)) {
+		return false;
+	}
+	memset(uiFreq, 0, sizeof(uiFreq));
+	uiSum = 0;
+	for (idxSym=0;idxSym<ullSymbols;idxSym++) {
+		if (iPos >= iSize) {
+			return false;
+		}
+		ucSymbol = pIn[iPos++];
+		if (! GetVarint(pIn, iSize, &iPos, &ullFreq) || (ullFreq == 0) || (ullFreq > CODEC_RANS_SCALE - uiSum) || (uiFreq[ucSymbol] != 0)) {
+			return false;
+		}
+		uiFreq[ucSymbol] = (unsigned int)ullFreq;
+		uiSum += (unsigned int)ullFreq;
+	}
+	if (uiSum != CODEC_RANS_SCALE) {
+		return false;
+	}
+	uiSum = 0;
+	for (idxSym=0;idxSym<256;idxSym++) {
+		uiCum[idxSym] = uiSum;
+		memset(&SlotSymbol[uiSum], (int)idxSym, uiFreq[idxSym]);
+		uiSum += uiFreq[idxSym];
+	}
+	if (iSize - iPos < 4) {
+		return false;
+	}
+	uiState = (unsigned int)pIn[iPos] | ((unsigned int)pIn[iPos + 1] << 8) | ((unsigned int)pIn[iPos + 2] << 16) | ((unsigned int)pIn[iPos + 3] << 24);
+	iPos += 4;
+	Out->resize((size_t)ullLength);
+	for (idxByte=0;idxByte<ullLength;idxByte++) {
+		uiSlot = uiState & (CODEC_RANS_SCALE - 1);
+		ucSymbol = SlotSymbol[uiSlot];
+		(*Out)[idxByte] = ucSymbol;
+		uiState = uiFreq[ucSymbol] * (uiState >> CODEC_RANS_SCALE_BITS) + uiSlot - uiCum[ucSymbol];
+		while (uiState < CODEC_RANS_LOWER) {
+			if (iPos >= iSize) {
+				return false;
+			}
+			uiState = (uiState << 8) | pIn[iPos++];
+		}
+	}
+	return ((uiState == CODEC_RANS_LOWER) && (iPos == iSize));
+}
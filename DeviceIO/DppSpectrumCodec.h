@@ -0,0 +1,73 @@
+/** CDppSpectrumCodec CDppSpectrumCodec */
+#pragma once
+#include <string>
+#include <vector>
+using namespace std;
+
+#define CODEC_MAGIC 0xD5				/// first byte of an encoded spectrum
+#define CODEC_BLOCK_SIZE 128			/// channels per bit packed block
+#define CODEC_MAX_WIDTH 56				/// largest bit packed width (64 bit unpack loads)
+#define CODEC_RANS_SCALE_BITS 12		/// entropy stage probability resolution
+#define CODEC_RANS_LOWER (1u << 23)		/// entropy stage state lower bound
+
+/// Integer stage of the encoded deltas.
+typedef enum _CODEC_MODE
+{
+	cmBitPack = 0,			/// fixed width per CODEC_BLOCK_SIZE channels (fastest decode)
+	cmVarint = 1,			/// LEB128 bytes
+	cmVarintRans = 2		/// LEB128 bytes with an order-0 rANS entropy stage (smallest)
+} CODEC_MODE;
+
+/// Value each channel is predicted from.
+typedef enum _CODEC_PREDICTOR
+{
+	cpChannel = 0,			/// previous channel of the same spectrum
+	cpFrame = 1				/// same channel of the previous spectrum
+} CODEC_PREDICTOR;
+
+/// Encoded spectrum header, followed by uiPayloadSize bytes.
+typedef struct _CODEC_HEADER
+{
+	unsigned char ucMagic;
+	unsigned char ucMode;			/// CODEC_MODE
+	unsigned char ucPredictor;		/// CODEC_PREDICTOR
+	unsigned char ucReserved;
+	unsigned int uiChannels;
+	unsigned int uiPayloadSize;
+} CODEC_HEADER;
+
+/** CDppSpectrumCodec compresses spectra (SPECTRUM.DATA arrays) for archival and transfer.
+	Each channel is coded as the zig-zag delta from the previous channel or from the same
+	channel of the previous spectrum, then bit packed per block or written as varints with
+	an optional rANS entropy stage. Bit packed blocks decode with fixed width 64 bit loads,
+	without data dependent branches, so the compiler can vectorize the unpack loop.
+*/
+class CDppSpectrumCodec
+{
+public:
+	CDppSpectrumCodec(void);
+	~CDppSpectrumCodec(void);
+
+	/// Encodes a spectrum, lPrev is the previous spectrum for cpFrame or NULL for cpChannel.
+	bool Encode(const long lData[], long lChannels, const long lPrev[], CODEC_MODE Mode, vector<unsigned char> *Out);
+	/// Decodes a spectrum, returns the number of channels or -1 if invalid (lPrev as used to encode).
+	long Decode(const unsigned char *pIn, size_t iSize, const long lPrev[], long lData[], long lMaxChannels);
+	/// Returns the channel count of an encoded spectrum, -1 if invalid.
+	static long Channels(const unsigned char *pIn, size_t iSize);
+	/// Size of the same spectrum packed as 24 bit counts (device format).
+	static size_t Raw24Size(long lChannels) { return (size_t)lChannels * 3; }
+
+private:
+	/// Bit packs the zig-zag deltas, returns false if a delta is too wide.
+	bool PackBlocks(const unsigned long long ullZig[], long lChannels, vector<unsigned char> *Out);
+	/// Unpacks the zig-zag deltas, returns false on truncated input.
+	bool UnpackBlocks(const unsigned char *pIn, size_t iSize, unsigned long long ullZig[], long lChannels);
+	/// Order-0 rANS encode of a byte stream.
+	void RansEncode(const vector<unsigned char> &vIn, vector<unsigned char> *Out);
+	/// Order-0 rANS decode, returns false on invalid input.
+	bool RansDecode(const unsigned char *pIn, size_t iSize, vector<unsigned char> *Out);
+
+	vector<unsigned long long> vZig;		/// zig-zag deltas
+	vector<unsigned char> vBytes;			/// varint stream
+	vector<unsigned char> vReverse;			/// rANS output, written backwards
+};
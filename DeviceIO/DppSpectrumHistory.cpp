@@ -0,0 +1,191 @@
+#include "DppSpectrumHistory.h"
+#include <algorithm>
+
+CDppSpectrumHistory::CDppSpectrumHistory(void)
+{
+	bEnabled = false;
+	lCapacity = 0;
+	lWindow = 0;
+	lHistoryChannels = 0;
+	lFrames = 0;
+	idxNewest = 0;
+}
+
+CDppSpectrumHistory::~CDppSpectrumHistory(void)
+{
+	Clear();
+}
+
+bool CDppSpectrumHistory::Start(long lFrameCapacity, long lWindowFrames)
+{
+	lock_guard<mutex> Lock(HistoryLock);
+	if ((lFrameCapacity < 2) || (lFrameCapacity > HISTORY_MAX_FRAMES) || (lWindowFrames < 1)) {
+		bEnabled = false;
+		return false;
+	}
+	lCapacity = lFrameCapacity;
+	lWindow = min(lWindowFrames, lCapacity);
+	lHistoryChannels = 0;
+	lFrames = 0;
+	idxNewest = 0;
+	vSlab.clear();
+	vTime.assign(lCapacity, 0);
+	bEnabled = true;
+	return true;
+}
+
+void CDppSpectrumHistory::Stop()
+{
+	lock_guard<mutex> Lock(HistoryLock);
+	bEnabled = false;
+}
+
+void CDppSpectrumHistory::Clear()
+{
+	lock_guard<mutex> Lock(HistoryLock);
+	bEnabled = false;
+	lHistoryChannels = 0;
+	lFrames = 0;
+	vSlab.clear();
+	vSlab.shrink_to_fit();
+	vTime.clear();
+	vWindowSum.clear();
+	vDelta.clear();
+	vRate.clear();
+}
+
+bool CDppSpectrumHistory::Append(const long lData[], long lChannels, double dblTime)
+{
+	unsigned int *pRow, *pPrev, *pLeaving;
+	double dblPerSecond;
+	long idxChan;
+
+	lock_guard<mutex> Lock(HistoryLock);
+	if (!bEnabled || (lData == NULL) || (lChannels <= 0) || (lChannels > HISTORY_MAX_CHANNELS)) {
+		return false;
+	}
+	if (lChannels != lHistoryChannels) {
+		// the slab is sized once per channel count, later appends don't allocate
+		lHistoryChannels = lChannels;
+		lFrames = 0;
+		idxNewest = lCapacity - 1;
+		vSlab.assign((size_t)lCapacity * lChannels, 0);
+		vWindowSum.assign(lChannels, 0);
+		vDelta.assign(lChannels, 0);
+		vRate.assign(lChannels, 0);
+	}
+	// the frame leaving the window is still in the slab, the new frame may overwrite it
+	pLeaving = (lFrames >= lWindow) ? Row(lWindow - 1) : NULL;
+	pPrev = (lFrames > 0) ? Row(0) : NULL;
+	idxNewest = (idxNewest + 1) % lCapacity;
+	pRow = &vSlab[(size_t)idxNewest * lChannels];
+	if (pLeaving != NULL) {
+		for (idxChan=0;idxChan<lChannels;idxChan++) {
+			vWindowSum[idxChan] -= pLeaving[idxChan];
+		}
+	}
+	for (idxChan=0;idxChan<lChannels;idxChan++) {
+		pRow[idxChan] = (unsigned int)lData[idxChan];
+		vWindowSum[idxChan] += pRow[idxChan];
+	}
+	if (pPrev != NULL) {
+		dblPerSecond = dblTime - vTime[(idxNewest + lCapacity - 1) % lCapacity];
+		dblPerSecond = (dblPerSecond > 0) ? (1.0 / dblPerSecond) : 0;
+		for (idxChan=0;idxChan<lChannels;idxChan++) {
+			vDelta[idxChan] = (long long)pRow[idxChan] - (long long)pPrev[idxChan];
+			vRate[idxChan] = vDelta[idxChan] * dblPerSecond;
+		}
+	}
+	vTime[idxNewest] = dblTime;
+	if (lFrames < lCapacity) {
+		lFrames++;
+	}
+	return true;
+}
+
+bool CDppSpectrumHistory::SetWindow(long lWindowFrames)
+{
+	unsigned int *pRow;
+	long idxAge, idxChan;
+
+	lock_guard<mutex> Lock(HistoryLock);
+	if ((lWindowFrames < 1) || (lWindowFrames > lCapacity)) {
+		return false;
+	}
+	lWindow = lWindowFrames;
+	if (lHistoryChannels == 0) {
+		return true;
+	}
+	vWindowSum.assign(lHistoryChannels, 0);
+	for (idxAge=0;idxAge<min(lWindow, lFrames);idxAge++) {
+		pRow = Row(idxAge);
+		for (idxChan=0;idxChan<lHistoryChannels;idxChan++) {
+			vWindowSum[idxChan] += pRow[idxChan];
+		}
+	}
+	return true;
+}
+
+long CDppSpectrumHistory::Frames()
+{
+	lock_guard<mutex> Lock(HistoryLock);
+	return lFrames;
+}
+
+long CDppSpectrumHistory::Channels()
+{
+	lock_guard<mutex> Lock(HistoryLock);
+	return lHistoryChannels;
+}
+
+long CDppSpectrumHistory::WindowFrames()
+{
+	lock_guard<mutex> Lock(HistoryLock);
+	return min(lWindow, lFrames);
+}
+
+bool CDppSpectrumHistory::GetFrame(long lAge, vector<long> *vOut, double *dblTime)
+{
+	unsigned int *pRow;
+
+	lock_guard<mutex> Lock(HistoryLock);
+	if ((vOut == NULL) || (lAge < 0) || (lAge >= lFrames)) {
+		return false;
+	}
+	pRow = Row(lAge);
+	vOut->assign(pRow, pRow + lHistoryChannels);
+	if (dblTime != NULL) {
+		*dblTime = vTime[(idxNewest + lCapacity - lAge) % lCapacity];
+	}
+	return true;
+}
+
+bool CDppSpectrumHistory::GetWindowSum(vector<unsigned long long> *vOut)
+{
+	lock_guard<mutex> Lock(HistoryLock);
+	if ((vOut == NULL) || (lFrames == 0)) {
+		return false;
+	}
+	*vOut = vWindowSum;
+	return true;
+}
+
+bool CDppSpectrumHistory::GetDelta(vector<long long> *vOut)
+{
+	lock_guard<mutex> Lock(HistoryLock);
+	if ((vOut == NULL) || (lFrames < 2)) {
+		return false;
+	}
+	*vOut = vDelta;
+	return true;
+}
+
+bool CDppSpectrumHistory::GetRate(vector<double> *vOut)
+{
+	lock_guard<mutex> Lock(HistoryLock);
+	if ((vOut == NULL) || (lFrames < 2)) {
+		return false;
+	}
+	*vOut = vRate;
+	return true;
+}
@@ -0,0 +1,68 @@
+/** CDppSpectrumHistory CDppSpectrumHistory */
+#pragma once
+#include <vector>
+#include <mutex>
+#include <atomic>
+using namespace std;
+
+#define HISTORY_DEFAULT_FRAMES 256		/// default ring capacity
+#define HISTORY_MAX_FRAMES 65536
+#define HISTORY_MAX_CHANNELS 16384
+
+/** CDppSpectrumHistory keeps the most recent spectra in a fixed capacity ring.
+	The frames share one contiguous slab (frame major), the oldest frame is overwritten
+	when the ring is full. The sum of the last lWindow frames, the change from the
+	previous frame and the per channel rate (change per second) are updated as each
+	spectrum is added, so reading them doesn't touch the rest of the history.
+*/
+class CDppSpectrumHistory
+{
+public:
+	CDppSpectrumHistory(void);
+	~CDppSpectrumHistory(void);
+
+	/// Clears the history and accepts spectra, the channel count is taken from the first spectrum.
+	bool Start(long lFrameCapacity = HISTORY_DEFAULT_FRAMES, long lWindowFrames = HISTORY_DEFAULT_FRAMES);
+	/// Stops accepting spectra, the history stays available.
+	void Stop();
+	/// Stops and frees the history.
+	void Clear();
+	/// True while spectra are accepted.
+	bool IsEnabled() { return bEnabled; }
+	/// Adds a spectrum, dblTime in seconds. A channel count change restarts the history.
+	bool Append(const long lData[], long lChannels, double dblTime);
+	/// Sets the number of frames in the window sum (1 to capacity), the sum is rebuilt once.
+	bool SetWindow(long lWindowFrames);
+
+	/// Frames held (up to the capacity).
+	long Frames();
+	/// Channels per frame, 0 before the first spectrum.
+	long Channels();
+	/// Frames in the window sum (fewer until the window has filled).
+	long WindowFrames();
+	/// Copies a frame, lAge 0 is the newest.
+	bool GetFrame(long lAge, vector<long> *vOut, double *dblTime = NULL);
+	/// Copies the sum of the last WindowFrames frames.
+	bool GetWindowSum(vector<unsigned long long> *vOut);
+	/// Copies the newest frame minus the previous frame.
+	bool GetDelta(vector<long long> *vOut);
+	/// Copies the delta divided by the time between the two newest frames (counts/s).
+	bool GetRate(vector<double> *vOut);
+
+private:
+	/// Returns the slab row of a frame age.
+	unsigned int *Row(long lAge) { return &vSlab[(size_t)((idxNewest + lCapacity - lAge) % lCapacity) * lHistoryChannels]; }
+
+	mutex HistoryLock;
+	atomic<bool> bEnabled;
+	long lCapacity;
+	long lWindow;
+	long lHistoryChannels;					/// 0 until the first spectrum
+	long lFrames;
+	long idxNewest;							/// slab row of the newest frame
+	vector<unsigned int> vSlab;				/// lCapacity x lHistoryChannels counts
+	vector<double> vTime;					/// time of each slab row
+	vector<unsigned long long> vWindowSum;	/// sum of the last lWindow frames
+	vector<long long> vDelta;				/// newest minus previous frame
+	vector<double> vRate;					/// vDelta per second
+};
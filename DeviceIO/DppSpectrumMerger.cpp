@@ -0,0 +1,262 @@
+#include "DppSpectrumMerger.h"
+#include <math.h>
+#include <algorithm>
+#include <thread>
+
+// energy of a channel position
+static double ChannelEnergy(const MERGE_CALIBRATION &Calibration, double dblChannel)
+{
+	return Calibration.dblOffset + (Calibration.dblGain + Calibration.dblQuadratic * dblChannel) * dblChannel;
+}
+
+// fixed point part of a source channel (dblLow to dblHigh) below grid position dblPos
+static long long Portion(double dblPos, double dblLow, double dblHigh, double dblScale)
+{
+	return (long long)((min(max(dblPos, dblLow), dblHigh) - dblLow) * dblScale + 0.5);
+}
+
+CDppSpectrumMerger::CDppSpectrumMerger(void)
+{
+	bEnabled = false;
+	MergeGrid.dblStart = 0;
+	MergeGrid.dblWidth = 0;
+	MergeGrid.lBins = 0;
+}
+
+CDppSpectrumMerger::~CDppSpectrumMerger(void)
+{
+}
+
+bool CDppSpectrumMerger::BuildMap(const MERGE_GRID &Grid, const MERGE_CALIBRATION &Calibration, long lChannels, MERGE_MAP *Map)
+{
+	vector<long> vLast;
+	double dblLow, dblHigh, dblScale;
+	long long llBelow, llPortion;
+	long idxChan, idxBin, lFirstBin, lLastBin;
+	int iPass;
+
+	if ((Map == NULL) || (lChannels <= 0) || (lChannels > MERGE_MAX_CHANNELS) || (Grid.lBins <= 0) || (Grid.dblWidth <= 0)) {
+		return false;
+	}
+	Map->lChannels = lChannels;
+	Map->vFirst.assign(Grid.lBins, -1);
+	vLast.assign(Grid.lBins, -1);
+	// pass 0 finds the source channels of each bin, pass 1 stores their weights
+	for (iPass=0;iPass<2;iPass++) {
+		if (iPass == 1) {
+			Map->lSpan = 1;
+			for (idxBin=0;idxBin<Grid.lBins;idxBin++) {
+				if (Map->vFirst[idxBin] < 0) {
+					Map->vFirst[idxBin] = 0;
+				} else {
+					Map->lSpan = max(Map->lSpan, vLast[idxBin] - Map->vFirst[idxBin] + 1);
+				}
+			}
+			if (Map->lSpan > MERGE_MAX_SPAN) {
+				return false;
+			}
+			Map->vWeights.assign((size_t)Map->lSpan * Grid.lBins, 0);
+		}
+		for (idxChan=0;idxChan<lChannels;idxChan++) {
+			dblLow = (ChannelEnergy(Calibration, idxChan - 0.5) - Grid.dblStart) / Grid.dblWidth;
+			dblHigh = (ChannelEnergy(Calibration, idxChan + 0.5) - Grid.dblStart) / Grid.dblWidth;
+			if (!(dblHigh > dblLow) || (dblHigh <= 0) || (dblLow >= Grid.lBins)) {
+				continue;		// not increasing, or outside the grid
+			}
+			lFirstBin = max((long)floor(dblLow), 0L);
+			lLastBin = min((long)ceil(dblHigh) - 1, Grid.lBins - 1);
+			if (iPass == 0) {
+				for (idxBin=lFirstBin;idxBin<=lLastBin;idxBin++) {
+					if (Map->vFirst[idxBin] < 0) {
+						Map->vFirst[idxBin] = idxChan;
+					}
+					vLast[idxBin] = idxChan;
+				}
+				continue;
+			}
+			// rounded cumulative portions, the channel's weights inside the grid add up to exactly one
+			dblScale = MERGE_WEIGHT_ONE / (dblHigh - dblLow);
+			llBelow = Portion((double)lFirstBin, dblLow, dblHigh, dblScale);
+			for (idxBin=lFirstBin;idxBin<=lLastBin;idxBin++) {
+				llPortion = Portion(idxBin + 1.0, dblLow, dblHigh, dblScale);
+				Map->vWeights[(size_t)(idxChan - Map->vFirst[idxBin]) * Grid.lBins + idxBin] = (unsigned int)(llPortion - llBelow);
+				llBelow = llPortion;
+			}
+		}
+	}
+	return true;
+}
+
+void CDppSpectrumMerger::Accumulate(const MERGE_MAP &Map, long lBins, const unsigned int *pSource, long lStart, long lEnd, unsigned long long ullSum[])
+{
+	const unsigned int *pWeights;
+	const long *pFirst;
+	long idxSpan, idxBin;
+
+	// fixed span without branches, the padding makes First + span - 1 readable for every bin
+	pFirst = &Map.vFirst[0];
+	for (idxSpan=0;idxSpan<Map.lSpan;idxSpan++) {
+		pWeights = &Map.vWeights[(size_t)idxSpan * lBins];
+		for (idxBin=lStart;idxBin<lEnd;idxBin++) {
+			ullSum[idxBin] += (unsigned long long)pWeights[idxBin] * pSource[pFirst[idxBin] + idxSpan];
+		}
+	}
+}
+
+bool CDppSpectrumMerger::SetGrid(double dblStart, double dblWidth, long lBins)
+{
+	map<unsigned long, MERGE_DETECTOR>::iterator itDetector;
+
+	lock_guard<mutex> Lock(MergerLock);
+	if ((dblWidth <= 0) || (lBins <= 0) || (lBins > MERGE_MAX_BINS)) {
+		return false;
+	}
+	MergeGrid.dblStart = dblStart;
+	MergeGrid.dblWidth = dblWidth;
+	MergeGrid.lBins = lBins;
+	vMerged.assign(lBins, 0);
+	for (itDetector=Detectors.begin();itDetector!=Detectors.end();itDetector++) {
+		itDetector->second.Map.lChannels = 0;		// rebuilt by the next spectrum
+		itDetector->second.vRebinned.clear();
+	}
+	return true;
+}
+
+bool CDppSpectrumMerger::SetCalibration(unsigned long ulDetector, const MERGE_CALIBRATION &Calibration)
+{
+	MERGE_DETECTOR *Detector;
+	long idxBin;
+
+	lock_guard<mutex> Lock(MergerLock);
+	if (!(Calibration.dblGain > 0)) {
+		return false;
+	}
+	Detector = &Detectors[ulDetector];
+	for (idxBin=0;idxBin<(long)Detector->vRebinned.size();idxBin++) {
+		vMerged[idxBin] -= Detector->vRebinned[idxBin];
+	}
+	Detector->Calibration = Calibration;
+	Detector->Map.lChannels = 0;
+	Detector->vRebinned.clear();
+	return true;
+}
+
+bool CDppSpectrumMerger::Update(unsigned long ulDetector, const long lData[], long lChannels)
+{
+	map<unsigned long, MERGE_DETECTOR>::iterator itDetector;
+	MERGE_DETECTOR *Detector;
+	long idxChan, idxBin;
+
+	lock_guard<mutex> Lock(MergerLock);
+	if ((lData == NULL) || (MergeGrid.lBins == 0) || ((itDetector = Detectors.find(ulDetector)) == Detectors.end())) {
+		return false;
+	}
+	Detector = &itDetector->second;
+	if (Detector->Map.lChannels != lChannels) {
+		for (idxBin=0;idxBin<(long)Detector->vRebinned.size();idxBin++) {
+			vMerged[idxBin] -= Detector->vRebinned[idxBin];
+		}
+		Detector->vRebinned.clear();
+		if (!BuildMap(MergeGrid, Detector->Calibration, lChannels, &Detector->Map)) {
+			Detector->Map.lChannels = 0;
+			return false;
+		}
+		Detector->vSource.assign(lChannels + Detector->Map.lSpan, 0);
+		Detector->vRebinned.assign(MergeGrid.lBins, 0);
+	}
+	for (idxChan=0;idxChan<lChannels;idxChan++) {
+		Detector->vSource[idxChan] = (unsigned int)lData[idxChan];
+	}
+	vRebin.assign(MergeGrid.lBins, 0);
+	Accumulate(Detector->Map, MergeGrid.lBins, &Detector->vSource[0], 0, MergeGrid.lBins, &vRebin[0]);
+	// integer sums, replacing the previous spectrum is exact
+	for (idxBin=0;idxBin<MergeGrid.lBins;idxBin++) {
+		vMerged[idxBin] += vRebin[idxBin] - Detector->vRebinned[idxBin];
+	}
+	Detector->vRebinned.swap(vRebin);
+	return true;
+}
+
+void CDppSpectrumMerger::ClearSums()
+{
+	map<unsigned long, MERGE_DETECTOR>::iterator itDetector;
+
+	lock_guard<mutex> Lock(MergerLock);
+	vMerged.assign(MergeGrid.lBins, 0);
+	for (itDetector=Detectors.begin();itDetector!=Detectors.end();itDetector++) {
+		itDetector->second.vRebinned.assign(itDetector->second.vRebinned.size(), 0);
+	}
+}
+
+bool CDppSpectrumMerger::GetMergedFixed(vector<unsigned long long> *vOut)
+{
+	lock_guard<mutex> Lock(MergerLock);
+	if (vOut == NULL) {
+		return false;
+	}
+	*vOut = vMerged;
+	return true;
+}
+
+bool CDppSpectrumMerger::Merge(const MERGE_GRID &Grid, const vector<MERGE_INPUT> &vInputs, int iThreads, vector<unsigned long long> *vOut)
+{
+	vector<MERGE_MAP> vMaps(vInputs.size());
+	vector<vector<unsigned int> > vSources(vInputs.size());
+	vector<thread> vWorkers;
+	atomic<bool> bMapsOk;
+	size_t idxInput, idxWorker;
+	long lBlock, lStart;
+	int idxThread;
+
+	if ((vOut == NULL) || (Grid.lBins <= 0) || (Grid.lBins > MERGE_MAX_BINS)) {
+		return false;
+	}
+	for (idxInput=0;idxInput<vInputs.size();idxInput++) {
+		if ((vInputs[idxInput].pData == NULL) || !(vInputs[idxInput].Calibration.dblGain > 0)) {
+			return false;
+		}
+	}
+	if (iThreads <= 0) {
+		iThreads = max((int)thread::hardware_concurrency(), 1);
+	}
+	// maps and padded counts, one detector at a time per thread
+	bMapsOk = true;
+	for (idxThread=0;idxThread<min(iThreads, (int)vInputs.size());idxThread++) {
+		vWorkers.push_back(thread([&, idxThread]() {
+			size_t idxDetector;
+			long idxChan;
+			for (idxDetector=idxThread;idxDetector<vInputs.size();idxDetector+=iThreads) {
+				if (!BuildMap(Grid, vInputs[idxDetector].Calibration, vInputs[idxDetector].lChannels, &vMaps[idxDetector])) {
+					bMapsOk = false;
+					continue;
+				}
+				vSources[idxDetector].assign(vInputs[idxDetector].lChannels + vMaps[idxDetector].lSpan, 0);
+				for (idxChan=0;idxChan<vInputs[idxDetector].lChannels;idxChan++) {
+					vSources[idxDetector][idxChan] = (unsigned int)vInputs[idxDetector].pData[idxChan];
+				}
+			}
+		}));
+	}
+	for (idxWorker=0;idxWorker<vWorkers.size();idxWorker++) {
+		vWorkers[idxWorker].join();
+	}
+	vWorkers.clear();
+	if (!bMapsOk) {
+		return false;
+	}
+	// each thread sums every detector over its own block of bins, no shared sums
+	vOut->assign(Grid.lBins, 0);
+	lBlock = max((Grid.lBins + iThreads - 1) / iThreads, (long)MERGE_MIN_BLOCK);
+	for (lStart=0;lStart<Grid.lBins;lStart+=lBlock) {
+		vWorkers.push_back(thread([&, lStart]() {
+			size_t idxDetector;
+			for (idxDetector=0;idxDetector<vMaps.size();idxDetector++) {
+				Accumulate(vMaps[idxDetector], Grid.lBins, &vSources[idxDetector][0], lStart, min(lStart + lBlock, Grid.lBins), &(*vOut)[0]);
+			}
+		}));
+	}
+	for (idxWorker=0;idxWorker<vWorkers.size();idxWorker++) {
+		vWorkers[idxWorker].join();
+	}
+	return true;
+}
@@ -0,0 +1,102 @@
+/** CDppSpectrumMerger CDppSpectrumMerger */
+#pragma once
+#include <vector>
+#include <map>
+#include <mutex>
+#include <atomic>
+using namespace std;
+
+#define MERGE_WEIGHT_BITS 20				/// fixed point fraction bits of the merged sums
+#define MERGE_WEIGHT_ONE (1 << MERGE_WEIGHT_BITS)
+#define MERGE_MAX_SPAN 64					/// source channels per grid bin
+#define MERGE_MAX_CHANNELS 16384
+#define MERGE_MAX_BINS 65536
+#define MERGE_MIN_BLOCK 2048				/// grid bins per thread
+
+/// Energy calibration, channel c spans c - 0.5 to c + 0.5, E(x) = offset + gain * x + quadratic * x * x.
+typedef struct _MERGE_CALIBRATION
+{
+	double dblOffset;
+	double dblGain;
+	double dblQuadratic;
+} MERGE_CALIBRATION;
+
+/// Common energy grid, bin j spans start + j * width to start + (j + 1) * width.
+typedef struct _MERGE_GRID
+{
+	double dblStart;
+	double dblWidth;
+	long lBins;
+} MERGE_GRID;
+
+/// Rebin map of one calibration: grid bin j gets Weights[k * lBins + j] of source channel First[j] + k.
+typedef struct _MERGE_MAP
+{
+	long lChannels;							/// source channels
+	long lSpan;								/// source channels per grid bin (k range)
+	vector<long> vFirst;
+	vector<unsigned int> vWeights;			/// MERGE_WEIGHT_ONE fixed point, each channel's weights sum to one inside the grid
+} MERGE_MAP;
+
+/// Detector state of the running merge.
+typedef struct _MERGE_DETECTOR
+{
+	MERGE_CALIBRATION Calibration;
+	MERGE_MAP Map;
+	vector<unsigned int> vSource;			/// counts, padded by lSpan zeros
+	vector<unsigned long long> vRebinned;	/// contribution to the merged sums
+} MERGE_DETECTOR;
+
+/// Spectrum and calibration of one detector (batch merge).
+typedef struct _MERGE_INPUT
+{
+	const long *pData;
+	long lChannels;
+	MERGE_CALIBRATION Calibration;
+} MERGE_INPUT;
+
+/** CDppSpectrumMerger sums spectra of several detectors on a common energy grid.
+	Each detector's counts are split over the grid bins in proportion to the energy
+	overlap of its channels (from its calibration) with fixed point weights, and added
+	in 64 bit integers, so the sum is exact and doesn't depend on the order of detectors
+	or threads. The running merge replaces a detector's previous spectrum as each new one
+	arrives; Merge rebins a set of spectra with the grid split over worker threads.
+*/
+class CDppSpectrumMerger
+{
+public:
+	CDppSpectrumMerger(void);
+	~CDppSpectrumMerger(void);
+
+	/// Sets the grid and clears the running merge.
+	bool SetGrid(double dblStart, double dblWidth, long lBins);
+	/// Sets the calibration of a detector (by serial number), its previous contribution is removed.
+	bool SetCalibration(unsigned long ulDetector, const MERGE_CALIBRATION &Calibration);
+	/// Starts merging received spectra.
+	void Start() { bEnabled = true; }
+	/// Stops merging, the merged spectrum stays available.
+	void Stop() { bEnabled = false; }
+	/// True while received spectra are merged.
+	bool IsEnabled() { return bEnabled; }
+	/// Replaces the contribution of a calibrated detector with a new spectrum.
+	bool Update(unsigned long ulDetector, const long lData[], long lChannels);
+	/// Removes all detector contributions, calibrations are kept.
+	void ClearSums();
+	/// Copies the merged sums in MERGE_WEIGHT_ONE fixed point.
+	bool GetMergedFixed(vector<unsigned long long> *vOut);
+
+	/// Rebins and sums a set of spectra, iThreads 0 uses all cores, vOut in MERGE_WEIGHT_ONE fixed point.
+	static bool Merge(const MERGE_GRID &Grid, const vector<MERGE_INPUT> &vInputs, int iThreads, vector<unsigned long long> *vOut);
+	/// Builds the rebin map of a calibration.
+	static bool BuildMap(const MERGE_GRID &Grid, const MERGE_CALIBRATION &Calibration, long lChannels, MERGE_MAP *Map);
+	/// Adds the rebinned counts of grid bins lStart to lEnd - 1 to ullSum (pSource padded by the map span).
+	static void Accumulate(const MERGE_MAP &Map, long lBins, const unsigned int *pSource, long lStart, long lEnd, unsigned long long ullSum[]);
+
+private:
+	mutex MergerLock;
+	atomic<bool> bEnabled;
+	MERGE_GRID MergeGrid;
+	map<unsigned long, MERGE_DETECTOR> Detectors;
+	vector<unsigned long long> vMerged;		/// MERGE_WEIGHT_ONE fixed point
+	vector<unsigned long long> vRebin;		/// detector rebin buffer
+};
@@ -0,0 +1,160 @@
+#include "DppSpectrumPyramid.h"
+#include <algorithm>
+
+CDppSpectrumPyramid::CDppSpectrumPyramid(void)
+{
+	lPyramidChannels = 0;
+}
+
+CDppSpectrumPyramid::~CDppSpectrumPyramid(void)
+{
+}
+
+void CDppSpectrumPyramid::Clear()
+{
+	lock_guard<mutex> Lock(PyramidLock);
+	lPyramidChannels = 0;
+	Levels.clear();
+}
+
+long CDppSpectrumPyramid::Channels()
+{
+	lock_guard<mutex> Lock(PyramidLock);
+	return lPyramidChannels;
+}
+
+bool CDppSpectrumPyramid::Rebuild(int iLevel, long idxBin)
+{
+	PYRAMID_LEVEL *Level, *Below;
+	long idxChild, lMin, lMax;
+	unsigned long long ullSum;
+
+	Level = &Levels[iLevel];
+	Below = &Levels[iLevel - 1];
+	idxChild = idxBin * 2;
+	lMin = Below->vMin[idxChild];
+	lMax = Below->vMax[idxChild];
+	ullSum = Below->vSum[idxChild];
+	if ((idxChild + 1) < Below->lBins) {
+		lMin = min(lMin, Below->vMin[idxChild + 1]);
+		lMax = max(lMax, Below->vMax[idxChild + 1]);
+		ullSum += Below->vSum[idxChild + 1];
+	}
+	if ((Level->vMin[idxBin] == lMin) && (Level->vMax[idxBin] == lMax) && (Level->vSum[idxBin] == ullSum)) {
+		return false;
+	}
+	Level->vMin[idxBin] = lMin;
+	Level->vMax[idxBin] = lMax;
+	Level->vSum[idxBin] = ullSum;
+	return true;
+}
+
+long CDppSpectrumPyramid::Update(const long lData[], long lChannels)
+{
+	PYRAMID_LEVEL *Level;
+	long idxChan, idxBin, lBins, lChanged;
+	size_t idxDirty;
+	int idxLevel;
+
+	lock_guard<mutex> Lock(PyramidLock);
+	if ((lData == NULL) || (lChannels <= 0) || (lChannels > PYRAMID_MAX_CHANNELS)) {
+		return 0;
+	}
+	if (lChannels != lPyramidChannels) {
+		// new channel count, size the levels and build every bin
+		lPyramidChannels = lChannels;
+		Levels.clear();
+		for (lBins=lChannels;;lBins=(lBins + 1) / 2) {
+			Levels.push_back(PYRAMID_LEVEL());
+			Level = &Levels.back();
+			Level->lBins = lBins;
+			Level->vMin.assign(lBins, 0);
+			Level->vMax.assign(lBins, 0);
+			Level->vSum.assign(lBins, 0);
+			if (lBins == 1) {
+				break;
+			}
+		}
+		for (idxChan=0;idxChan<lChannels;idxChan++) {
+			Levels[0].vMin[idxChan] = lData[idxChan];
+			Levels[0].vMax[idxChan] = lData[idxChan];
+			Levels[0].vSum[idxChan] = (unsigned long long)lData[idxChan];
+		}
+		for (idxLevel=1;idxLevel<(int)Levels.size();idxLevel++) {
+			for (idxBin=0;idxBin<Levels[idxLevel].lBins;idxBin++) {
+				Rebuild(idxLevel, idxBin);
+			}
+		}
+		return lChannels;
+	}
+	// changed channels mark their parent bins, changed bins mark theirs
+	Level = &Levels[0];
+	vDirty.clear();
+	lChanged = 0;
+	for (idxChan=0;idxChan<lChannels;idxChan++) {
+		if (Level->vMin[idxChan] != lData[idxChan]) {
+			Level->vMin[idxChan] = lData[idxChan];
+			Level->vMax[idxChan] = lData[idxChan];
+			Level->vSum[idxChan] = (unsigned long long)lData[idxChan];
+			if (vDirty.empty() || (vDirty.back() != (idxChan >> 1))) {
+				vDirty.push_back(idxChan >> 1);
+			}
+			lChanged++;
+		}
+	}
+	for (idxLevel=1;(idxLevel<(int)Levels.size()) && !vDirty.empty();idxLevel++) {
+		vNextDirty.clear();
+		for (idxDirty=0;idxDirty<vDirty.size();idxDirty++) {
+			idxBin = vDirty[idxDirty];
+			if (Rebuild(idxLevel, idxBin) && (vNextDirty.empty() || (vNextDirty.back() != (idxBin >> 1)))) {
+				vNextDirty.push_back(idxBin >> 1);
+			}
+		}
+		vDirty.swap(vNextDirty);
+	}
+	return lChanged;
+}
+
+void CDppSpectrumPyramid::RangePoint(long lStart, long lEnd, PYRAMID_POINT *Point)
+{
+	const PYRAMID_LEVEL *Level;
+	long idxChan, idxBin;
+	int iLevel;
+
+	Point->lStart = lStart;
+	Point->lEnd = lEnd - 1;
+	Point->lMin = Levels[0].vMin[lStart];
+	Point->lMax = Levels[0].vMax[lStart];
+	Point->ullSum = 0;
+	iLevel = 0;
+	// largest aligned bin that fits at each step, at most two bins per level
+	for (idxChan=lStart;idxChan<lEnd;idxChan+=(1L << iLevel)) {
+		iLevel = 0;
+		while (((iLevel + 1) < (int)Levels.size()) && ((idxChan & ((2L << iLevel) - 1)) == 0) && ((idxChan + (2L << iLevel)) <= lEnd)) {
+			iLevel++;
+		}
+		Level = &Levels[iLevel];
+		idxBin = idxChan >> iLevel;
+		Point->lMin = min(Point->lMin, Level->vMin[idxBin]);
+		Point->lMax = max(Point->lMax, Level->vMax[idxBin]);
+		Point->ullSum += Level->vSum[idxBin];
+	}
+}
+
+bool CDppSpectrumPyramid::Query(long lChanStart, long lChans, long lPixels, vector<PYRAMID_POINT> *vPoints)
+{
+	long idxPixel, lStart, lEnd;
+
+	lock_guard<mutex> Lock(PyramidLock);
+	if ((vPoints == NULL) || (lPixels <= 0) || (lChans <= 0) || (lChanStart < 0) || ((lChanStart + lChans) > lPyramidChannels)) {
+		return false;
+	}
+	lPixels = min(lPixels, lChans);
+	vPoints->resize(lPixels);
+	for (idxPixel=0;idxPixel<lPixels;idxPixel++) {
+		lStart = lChanStart + (long)(((long long)idxPixel * lChans) / lPixels);
+		lEnd = lChanStart + (long)(((long long)(idxPixel + 1) * lChans) / lPixels);
+		RangePoint(lStart, lEnd, &(*vPoints)[idxPixel]);
+	}
+	return true;
+}
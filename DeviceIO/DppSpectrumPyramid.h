@@ -0,0 +1,60 @@
+/** CDppSpectrumPyramid CDppSpectrumPyramid */
+#pragma once
+#include <vector>
+#include <mutex>
+using namespace std;
+
+#define PYRAMID_MAX_CHANNELS 16384
+
+/// One decimation level, bin j covers channels j << level to ((j + 1) << level) - 1.
+typedef struct _PYRAMID_LEVEL
+{
+	long lBins;
+	vector<long> vMin;
+	vector<long> vMax;
+	vector<unsigned long long> vSum;
+} PYRAMID_LEVEL;
+
+/// Plot point, the min, max and sum of a channel range.
+typedef struct _PYRAMID_POINT
+{
+	long lStart;					/// first channel
+	long lEnd;						/// last channel
+	long lMin;
+	long lMax;
+	unsigned long long ullSum;
+} PYRAMID_POINT;
+
+/** CDppSpectrumPyramid keeps min/max/sum decimation levels of a spectrum, each level
+	halving the previous one. Updates compare the new spectrum with the stored one and
+	only recompute the bins above changed channels. Query returns one point per pixel
+	for a channel window, each built from at most two bins per level, so the cost
+	depends on the pixel width and not on the channel count.
+*/
+class CDppSpectrumPyramid
+{
+public:
+	CDppSpectrumPyramid(void);
+	~CDppSpectrumPyramid(void);
+
+	/// Updates the levels from a spectrum, returns the number of changed channels (all on a channel count change).
+	long Update(const long lData[], long lChannels);
+	/// Removes the spectrum.
+	void Clear();
+	/// Channels of the spectrum, 0 if none.
+	long Channels();
+	/// Points for lPixels columns over lChans channels from lChanStart (one per channel if lPixels >= lChans).
+	bool Query(long lChanStart, long lChans, long lPixels, vector<PYRAMID_POINT> *vPoints);
+
+private:
+	/// Recomputes bin idxBin of level iLevel from the level below, true if it changed.
+	bool Rebuild(int iLevel, long idxBin);
+	/// Combines the bins covering channels lStart to lEnd - 1 into Point.
+	void RangePoint(long lStart, long lEnd, PYRAMID_POINT *Point);
+
+	mutex PyramidLock;
+	long lPyramidChannels;
+	vector<PYRAMID_LEVEL> Levels;		/// level 0 is the spectrum
+	vector<long> vDirty;				/// bins to rebuild on the current level
+	vector<long> vNextDirty;
+};
@@ -0,0 +1,514 @@
+#include "DppSpectrumStore.h"
+#include "DppLog.h"
+#include <string.h>
+#include <algorithm>
+
+static bool SeekFile(FILE *File, long long llOffset, int iOrigin)
+{
+#ifdef _WIN32
+	return (_fseeki64(File, llOffset, iOrigin) == 0);
+#else
+	return (fseeko(File, (off_t)llOffset, iOrigin) == 0);
+#endif
+}
+
+static long long TellFile(FILE *File)
+{
+#ifdef _WIN32
+	return _ftelli64(File);
+#else
+	return (long long)ftello(File);
+#endif
+}
+
+CDppSpectrumStore::CDppSpectrumStore(void)
+{
+	bEnabled = false;
+	lStoreChannels = 0;
+	SpillFile = NULL;
+}
+
+CDppSpectrumStore::~CDppSpectrumStore(void)
+{
+	Clear();
+}
+
+bool CDppSpectrumStore::Start(string strSpillFile)
+{
+	lock_guard<mutex> Lock(StoreLock);
+	Levels.clear();
+	lStoreChannels = 0;
+	if (SpillFile != NULL) {
+		fclose(SpillFile);
+		SpillFile = NULL;
+	}
+	if ((strSpillFile.length() > 0) && ((SpillFile = fopen(strSpillFile.c_str(), "w+b")) == NULL)) {
+		DPP_LOG_ERROR("store", "Couldn't create spill file %s", strSpillFile.c_str());
+		bEnabled = false;
+		return false;
+	}
+	bEnabled = true;
+	return true;
+}
+
+void CDppSpectrumStore::Stop()
+{
+	lock_guard<mutex> Lock(StoreLock);
+	bEnabled = false;
+}
+
+void CDppSpectrumStore::Clear()
+{
+	lock_guard<mutex> Lock(StoreLock);
+	bEnabled = false;
+	Levels.clear();
+	lStoreChannels = 0;
+	if (SpillFile != NULL) {
+		fclose(SpillFile);
+		SpillFile = NULL;
+	}
+}
+
+bool CDppSpectrumStore::SetRois(const vector<STORE_ROI> &vRois)
+{
+	size_t idxRoi;
+
+	lock_guard<mutex> Lock(StoreLock);
+	if ((lStoreChannels != 0) || (vRois.size() > STORE_MAX_ROIS)) {
+		return false;
+	}
+	for (idxRoi=0;idxRoi<vRois.size();idxRoi++) {
+		if ((vRois[idxRoi].lStart < 0) || (vRois[idxRoi].lEnd < vRois[idxRoi].lStart)) {
+			return false;
+		}
+	}
+	vRoiSettings = vRois;
+	return true;
+}
+
+void CDppSpectrumStore::InitLevels(long lChannels)
+{
+	STORE_LEVEL *Level;
+	size_t idxRoi;
+	int idxLevel;
+	long lFactor;
+
+	lStoreChannels = lChannels;
+	// a ROI starting beyond the last channel keeps its slot with an empty range (zero total)
+	vStoreRois = vRoiSettings;
+	for (idxRoi=0;idxRoi<vStoreRois.size();idxRoi++) {
+		vStoreRois[idxRoi].lStart = min(vStoreRois[idxRoi].lStart, lChannels);
+		vStoreRois[idxRoi].lEnd = min(vStoreRois[idxRoi].lEnd, lChannels - 1);
+	}
+	Levels.resize(STORE_MAX_LEVELS);
+	lFactor = 1;
+	for (idxLevel=0;idxLevel<STORE_MAX_LEVELS;idxLevel++) {
+		Level = &Levels[idxLevel];
+		Level->lFactor = lFactor;
+		Level->lChannels = (lChannels + lFactor - 1) / lFactor;
+		Level->lChunkCols = (Level->lChannels + STORE_CHUNK_CHANNELS - 1) / STORE_CHUNK_CHANNELS;
+		Level->lFrames = 0;
+		Level->vTime.clear();
+		Level->Chunks.clear();
+		Level->vPartial.assign(Level->lChannels, 0);
+		Level->vPartialRoi.assign(vStoreRois.size() * Levels[0].lChunkCols, 0);
+		Level->lPartialFrames = 0;
+		Level->dblPartialTime = 0;
+		lFactor *= STORE_LEVEL_FACTOR;
+	}
+	vFrame.assign(lChannels, 0);
+	vRoiPart.assign(vStoreRois.size() * Levels[0].lChunkCols, 0);
+}
+
+bool CDppSpectrumStore::Append(const long lData[], long lChannels, double dblTime)
+{
+	size_t idxRoi;
+	long idxChan;
+	long lCols;
+
+	lock_guard<mutex> Lock(StoreLock);
+	if (! bEnabled || (lChannels <= 0) || (lChannels > STORE_MAX_CHANNELS)) {
+		return false;
+	}
+	if (lStoreChannels == 0) {
+		InitLevels(lChannels);
+	}
+	if (lChannels != lStoreChannels) {
+		return false;
+	}
+	for (idxChan=0;idxChan<lChannels;idxChan++) {
+		vFrame[idxChan] = (lData[idxChan] > 0) ? (unsigned long long)lData[idxChan] : 0;
+	}
+	// ROI counts split by chunk column, summed into the chunk statistics of every level
+	lCols = Levels[0].lChunkCols;
+	fill(vRoiPart.begin(), vRoiPart.end(), 0);
+	for (idxRoi=0;idxRoi<vStoreRois.size();idxRoi++) {
+		for (idxChan=vStoreRois[idxRoi].lStart;idxChan<=vStoreRois[idxRoi].lEnd;idxChan++) {
+			vRoiPart[idxRoi * lCols + idxChan / STORE_CHUNK_CHANNELS] += vFrame[idxChan];
+		}
+	}
+	AddFrame(0, vFrame.data(), vRoiPart.data(), dblTime);
+	return true;
+}
+
+void CDppSpectrumStore::AddFrame(int iLevel, const unsigned long long ullFrame[], const unsigned long long ullRoiPart[], double dblTime)
+{
+	STORE_LEVEL *Level;
+	STORE_LEVEL *Next;
+	STORE_CHUNK *Chunk;
+	unsigned long long ullValue;
+	size_t idxRoi;
+	size_t idxPart;
+	long idxRow;
+	long idxFrame;
+	long idxCol;
+	long idxCol0;
+	long lCols0;
+	long lFirstChan;
+	long lChans;
+	long idxChan;
+
+	Level = &Levels[iLevel];
+	idxRow = Level->lFrames / STORE_CHUNK_FRAMES;
+	idxFrame = Level->lFrames % STORE_CHUNK_FRAMES;
+	if (idxFrame == 0) {
+		for (idxCol=0;idxCol<Level->lChunkCols;idxCol++) {
+			Level->Chunks.push_back(STORE_CHUNK());
+			Chunk = &Level->Chunks.back();
+			memset(&Chunk->Stats, 0, sizeof(Chunk->Stats));
+			if (iLevel == 0) {
+				Chunk->vCells32.assign(STORE_CHUNK_CHANNELS * STORE_CHUNK_FRAMES, 0);
+			} else {
+				Chunk->vCells64.assign(STORE_CHUNK_CHANNELS * STORE_CHUNK_FRAMES, 0);
+			}
+			Chunk->llSpillOffset = -1;
+		}
+	}
+	lCols0 = Levels[0].lChunkCols;
+	for (idxCol=0;idxCol<Level->lChunkCols;idxCol++) {
+		Chunk = &Level->Chunks[idxRow * Level->lChunkCols + idxCol];
+		lFirstChan = idxCol * STORE_CHUNK_CHANNELS;
+		lChans = min((long)STORE_CHUNK_CHANNELS, Level->lChannels - lFirstChan);
+		for (idxChan=0;idxChan<lChans;idxChan++) {
+			ullValue = ullFrame[lFirstChan + idxChan];
+			if (iLevel == 0) {
+				Chunk->vCells32[idxChan * STORE_CHUNK_FRAMES + idxFrame] = (unsigned int)ullValue;
+			} else {
+				Chunk->vCells64[idxChan * STORE_CHUNK_FRAMES + idxFrame] = ullValue;
+			}
+			Chunk->Stats.ullSum += ullValue;
+			if (ullValue > Chunk->Stats.ullMax) {
+				Chunk->Stats.ullMax = ullValue;
+			}
+		}
+		// a level chunk column covers lFactor level 0 chunk columns
+		for (idxRoi=0;idxRoi<vStoreRois.size();idxRoi++) {
+			for (idxCol0=idxCol*Level->lFactor;(idxCol0<(idxCol+1)*Level->lFactor) && (idxCol0<lCols0);idxCol0++) {
+				Chunk->Stats.ullRoi[idxRoi] += ullRoiPart[idxRoi * lCols0 + idxCol0];
+			}
+		}
+		Chunk->Stats.lFrames = idxFrame + 1;
+	}
+	Level->vTime.push_back(dblTime);
+	Level->lFrames++;
+	if ((iLevel == 0) && (idxFrame == STORE_CHUNK_FRAMES - 1) && (SpillFile != NULL)) {
+		SpillRow(idxRow);
+	}
+	if (iLevel + 1 >= (int)Levels.size()) {
+		return;
+	}
+	Next = &Levels[iLevel + 1];
+	if (Next->lPartialFrames == 0) {
+		Next->dblPartialTime = dblTime;
+	}
+	for (idxChan=0;idxChan<Level->lChannels;idxChan++) {
+		Next->vPartial[idxChan / STORE_LEVEL_FACTOR] += ullFrame[idxChan];
+	}
+	for (idxPart=0;idxPart<Next->vPartialRoi.size();idxPart++) {
+		Next->vPartialRoi[idxPart] += ullRoiPart[idxPart];
+	}
+	if (++Next->lPartialFrames == STORE_LEVEL_FACTOR) {
+		AddFrame(iLevel + 1, Next->vPartial.data(), Next->vPartialRoi.data(), Next->dblPartialTime);
+		fill(Next->vPartial.begin(), Next->vPartial.end(), 0);
+		fill(Next->vPartialRoi.begin(), Next->vPartialRoi.end(), 0);
+		Next->lPartialFrames = 0;
+	}
+}
+
+void CDppSpectrumStore::SpillRow(long idxRow)
+{
+	STORE_CHUNK *Chunk;
+	long long llOffset;
+	long idxCol;
+
+	for (idxCol=0;idxCol<Levels[0].lChunkCols;idxCol++) {
+		Chunk = &Levels[0].Chunks[idxRow * Levels[0].lChunkCols + idxCol];
+		if (! SeekFile(SpillFile, 0, SEEK_END) || ((llOffset = TellFile(SpillFile)) < 0) ||
+			(fwrite(Chunk->vCells32.data(), sizeof(unsigned int), Chunk->vCells32.size(), SpillFile) != Chunk->vCells32.size())) {
+			// the chunk stays in memory
+			DPP_LOG_WARN("store", "Spill file write failed, keeping chunk row %ld in memory", idxRow);
+			return;
+		}
+		Chunk->llSpillOffset = llOffset;
+		vector<unsigned int>().swap(Chunk->vCells32);
+	}
+}
+
+const unsigned int *CDppSpectrumStore::Cells32(const STORE_CHUNK &Chunk)
+{
+	if (Chunk.llSpillOffset < 0) {
+		return Chunk.vCells32.data();
+	}
+	ChunkBuffer.resize(STORE_CHUNK_CHANNELS * STORE_CHUNK_FRAMES);
+	if (! SeekFile(SpillFile, Chunk.llSpillOffset, SEEK_SET) ||
+		(fread(ChunkBuffer.data(), sizeof(unsigned int), ChunkBuffer.size(), SpillFile) != ChunkBuffer.size())) {
+		DPP_LOG_ERROR("store", "Spill file read failed at %lld", Chunk.llSpillOffset);
+		fill(ChunkBuffer.begin(), ChunkBuffer.end(), 0);
+	}
+	return ChunkBuffer.data();
+}
+
+unsigned long long CDppSpectrumStore::Cell(int iLevel, const STORE_CHUNK &Chunk, const unsigned int *pCells32, long lChan, long lFrame)
+{
+	if (iLevel == 0) {
+		return pCells32[lChan * STORE_CHUNK_FRAMES + lFrame];
+	}
+	return Chunk.vCells64[lChan * STORE_CHUNK_FRAMES + lFrame];
+}
+
+long CDppSpectrumStore::Frames(int iLevel)
+{
+	lock_guard<mutex> Lock(StoreLock);
+	if ((iLevel < 0) || (iLevel >= (int)Levels.size())) {
+		return 0;
+	}
+	return Levels[iLevel].lFrames;
+}
+
+long CDppSpectrumStore::Channels(int iLevel)
+{
+	lock_guard<mutex> Lock(StoreLock);
+	if ((iLevel < 0) || (iLevel >= (int)Levels.size())) {
+		return 0;
+	}
+	return Levels[iLevel].lChannels;
+}
+
+int CDppSpectrumStore::LevelFor(long lFrames, long lMaxFrames)
+{
+	int idxLevel;
+	long lFactor;
+
+	lFactor = 1;
+	for (idxLevel=0;idxLevel<STORE_MAX_LEVELS-1;idxLevel++) {
+		if (lFrames / lFactor <= lMaxFrames) {
+			break;
+		}
+		lFactor *= STORE_LEVEL_FACTOR;
+	}
+	return idxLevel;
+}
+
+double CDppSpectrumStore::FrameTime(int iLevel, long idxFrame)
+{
+	lock_guard<mutex> Lock(StoreLock);
+	if ((iLevel < 0) || (iLevel >= (int)Levels.size()) || (idxFrame < 0) || (idxFrame >= Levels[iLevel].lFrames)) {
+		return 0;
+	}
+	return Levels[iLevel].vTime[idxFrame];
+}
+
+long CDppSpectrumStore::FindFrame(int iLevel, double dblTime)
+{
+	vector<double>::iterator itTime;
+
+	lock_guard<mutex> Lock(StoreLock);
+	if ((iLevel < 0) || (iLevel >= (int)Levels.size())) {
+		return -1;
+	}
+	itTime = lower_bound(Levels[iLevel].vTime.begin(), Levels[iLevel].vTime.end(), dblTime);
+	if (itTime == Levels[iLevel].vTime.end()) {
+		return -1;
+	}
+	return (long)(itTime - Levels[iLevel].vTime.begin());
+}
+
+bool CDppSpectrumStore::QueryRange(int iLevel, long lFrameStart, long lFrames, long lChanStart, long lChans, vector<unsigned long long> *vOut)
+{
+	STORE_LEVEL *Level;
+	const STORE_CHUNK *Chunk;
+	const unsigned int *pCells32;
+	long idxRow;
+	long idxCol;
+	long idxFrame;
+	long idxChan;
+	long lFrameEnd;
+	long lChanEnd;
+
+	lock_guard<mutex> Lock(StoreLock);
+	if ((vOut == NULL) || (iLevel < 0) || (iLevel >= (int)Levels.size())) {
+		return false;
+	}
+	Level = &Levels[iLevel];
+	lFrameEnd = lFrameStart + lFrames;
+	lChanEnd = lChanStart + lChans;
+	if ((lFrameStart < 0) || (lFrames <= 0) || (lFrameEnd > Level->lFrames) || (lChanStart < 0) || (lChans <= 0) || (lChanEnd > Level->lChannels)) {
+		return false;
+	}
+	vOut->assign((size_t)lFrames * lChans, 0);
+	for (idxRow=lFrameStart/STORE_CHUNK_FRAMES;idxRow<=(lFrameEnd-1)/STORE_CHUNK_FRAMES;idxRow++) {
+		for (idxCol=lChanStart/STORE_CHUNK_CHANNELS;idxCol<=(lChanEnd-1)/STORE_CHUNK_CHANNELS;idxCol++) {
+			Chunk = &Level->Chunks[idxRow * Level->lChunkCols + idxCol];
+			pCells32 = (iLevel == 0) ? Cells32(*Chunk) : NULL;
+			for (idxChan=max(lChanStart, idxCol*STORE_CHUNK_CHANNELS);idxChan<min(lChanEnd, (idxCol+1)*STORE_CHUNK_CHANNELS);idxChan++) {
+				for (idxFrame=max(lFrameStart, idxRow*STORE_CHUNK_FRAMES);idxFrame<min(lFrameEnd, (idxRow+1)*STORE_CHUNK_FRAMES);idxFrame++) {
+					(*vOut)[(size_t)(idxFrame - lFrameStart) * lChans + (idxChan - lChanStart)] =
+						Cell(iLevel, *Chunk, pCells32, idxChan - idxCol * STORE_CHUNK_CHANNELS, idxFrame - idxRow * STORE_CHUNK_FRAMES);
+				}
+			}
+		}
+	}
+	return true;
+}
+
+bool CDppSpectrumStore::SumFrames(long lFrameStart, long lFrames, vector<unsigned long long> *vOut)
+{
+	STORE_LEVEL *Level;
+	const STORE_CHUNK *Chunk;
+	const unsigned int *pCells32;
+	const unsigned int *pColumn;
+	unsigned long long ullSum;
+	long idxRow;
+	long idxCol;
+	long idxFrame;
+	long idxChan;
+	long lFirst;
+	long lLast;
+	long lChans;
+
+	lock_guard<mutex> Lock(StoreLock);
+	if ((vOut == NULL) || (Levels.size() == 0) || (lFrameStart < 0) || (lFrames <= 0) || (lFrameStart + lFrames > Levels[0].lFrames)) {
+		return false;
+	}
+	Level = &Levels[0];
+	vOut->assign(Level->lChannels, 0);
+	for (idxRow=lFrameStart/STORE_CHUNK_FRAMES;idxRow<=(lFrameStart+lFrames-1)/STORE_CHUNK_FRAMES;idxRow++) {
+		lFirst = max(lFrameStart, idxRow * STORE_CHUNK_FRAMES) - idxRow * STORE_CHUNK_FRAMES;
+		lLast = min(lFrameStart + lFrames, (idxRow + 1) * STORE_CHUNK_FRAMES) - idxRow * STORE_CHUNK_FRAMES;
+		for (idxCol=0;idxCol<Level->lChunkCols;idxCol++) {
+			Chunk = &Level->Chunks[idxRow * Level->lChunkCols + idxCol];
+			pCells32 = Cells32(*Chunk);
+			lChans = min((long)STORE_CHUNK_CHANNELS, Level->lChannels - idxCol * STORE_CHUNK_CHANNELS);
+			// channel columns are contiguous in time
+			for (idxChan=0;idxChan<lChans;idxChan++) {
+				pColumn = pCells32 + idxChan * STORE_CHUNK_FRAMES;
+				ullSum = 0;
+				for (idxFrame=lFirst;idxFrame<lLast;idxFrame++) {
+					ullSum += pColumn[idxFrame];
+				}
+				(*vOut)[idxCol * STORE_CHUNK_CHANNELS + idxChan] += ullSum;
+			}
+		}
+	}
+	return true;
+}
+
+bool CDppSpectrumStore::RoiTotals(long lFrameStart, long lFrames, vector<unsigned long long> *vOut)
+{
+	STORE_LEVEL *Level;
+	const STORE_CHUNK *Chunk;
+	const unsigned int *pCells32;
+	size_t idxRoi;
+	long lPos;
+	long lEnd;
+	long lSpan;
+	long idxRow;
+	long idxCol;
+	long idxChan;
+	long idxFrame;
+	long lRowEnd;
+	int idxLevel;
+
+	lock_guard<mutex> Lock(StoreLock);
+	if ((vOut == NULL) || (Levels.size() == 0) || (lFrameStart < 0) || (lFrames <= 0) || (lFrameStart + lFrames > Levels[0].lFrames)) {
+		return false;
+	}
+	vOut->assign(vStoreRois.size(), 0);
+	lPos = lFrameStart;
+	lEnd = lFrameStart + lFrames;
+	while (lPos < lEnd) {
+		// largest complete chunk row that starts here and fits the range
+		for (idxLevel=(int)Levels.size()-1;idxLevel>=0;idxLevel--) {
+			Level = &Levels[idxLevel];
+			lSpan = STORE_CHUNK_FRAMES * Level->lFactor;
+			idxRow = lPos / lSpan;
+			if (((lPos % lSpan) == 0) && (lPos + lSpan <= lEnd) && (Level->lFrames >= (idxRow + 1) * STORE_CHUNK_FRAMES)) {
+				for (idxCol=0;idxCol<Level->lChunkCols;idxCol++) {
+					Chunk = &Level->Chunks[idxRow * Level->lChunkCols + idxCol];
+					for (idxRoi=0;idxRoi<vStoreRois.size();idxRoi++) {
+						(*vOut)[idxRoi] += Chunk->Stats.ullRoi[idxRoi];
+					}
+				}
+				lPos += lSpan;
+				break;
+			}
+		}
+		if (idxLevel >= 0) {
+			continue;
+		}
+		// partial level 0 chunk row from the cells
+		Level = &Levels[0];
+		idxRow = lPos / STORE_CHUNK_FRAMES;
+		lRowEnd = min(lEnd, (idxRow + 1) * STORE_CHUNK_FRAMES);
+		for (idxCol=0;idxCol<Level->lChunkCols;idxCol++) {
+			Chunk = &Level->Chunks[idxRow * Level->lChunkCols + idxCol];
+			pCells32 = NULL;
+			for (idxRoi=0;idxRoi<vStoreRois.size();idxRoi++) {
+				for (idxChan=max(vStoreRois[idxRoi].lStart, idxCol*STORE_CHUNK_CHANNELS);idxChan<=min(vStoreRois[idxRoi].lEnd, (idxCol+1)*STORE_CHUNK_CHANNELS-1);idxChan++) {
+					if (pCells32 == NULL) {
+						pCells32 = Cells32(*Chunk);
+					}
+					for (idxFrame=lPos;idxFrame<lRowEnd;idxFrame++) {
+						(*vOut)[idxRoi] += pCells32[(idxChan - idxCol * STORE_CHUNK_CHANNELS) * STORE_CHUNK_FRAMES + idxFrame - idxRow * STORE_CHUNK_FRAMES];
+					}
+				}
+			}
+		}
+		lPos = lRowEnd;
+	}
+	return true;
+}
+
+long CDppSpectrumStore::ChunkRows(int iLevel)
+{
+	lock_guard<mutex> Lock(StoreLock);
+	if ((iLevel < 0) || (iLevel >= (int)Levels.size())) {
+		return 0;
+	}
+	return (long)(Levels[iLevel].Chunks.size() / Levels[iLevel].lChunkCols);
+}
+
+long CDppSpectrumStore::ChunkCols(int iLevel)
+{
+	lock_guard<mutex> Lock(StoreLock);
+	if ((iLevel < 0) || (iLevel >= (int)Levels.size())) {
+		return 0;
+	}
+	return Levels[iLevel].lChunkCols;
+}
+
+bool CDppSpectrumStore::GetChunkStats(int iLevel, long idxRow, long idxCol, STORE_CHUNK_STATS *Stats)
+{
+	STORE_LEVEL *Level;
+
+	lock_guard<mutex> Lock(StoreLock);
+	if ((Stats == NULL) || (iLevel < 0) || (iLevel >= (int)Levels.size())) {
+		return false;
+	}
+	Level = &Levels[iLevel];
+	if ((idxCol < 0) || (idxCol >= Level->lChunkCols) || (idxRow < 0) || ((size_t)(idxRow + 1) * Level->lChunkCols > Level->Chunks.size())) {
+		return false;
+	}
+	*Stats = Level->Chunks[idxRow * Level->lChunkCols + idxCol].Stats;
+	return true;
+}
@@ -0,0 +1,127 @@
+/** CDppSpectrumStore CDppSpectrumStore */
+#pragma once
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <atomic>
+using namespace std;
+
+#define STORE_CHUNK_FRAMES 64			/// frames per chunk
+#define STORE_CHUNK_CHANNELS 256		/// channels per chunk
+#define STORE_LEVEL_FACTOR 4			/// frames and channels summed per level step
+#define STORE_MAX_LEVELS 6				/// level 0 (spectra) and 5 summary levels
+#define STORE_MAX_ROIS 16
+#define STORE_MAX_CHANNELS 16384
+
+/// Region of interest (inclusive level 0 channels).
+typedef struct _STORE_ROI
+{
+	long lStart;
+	long lEnd;
+} STORE_ROI;
+
+/// Statistics of one chunk.
+typedef struct _STORE_CHUNK_STATS
+{
+	long lFrames;							/// frames filled
+	unsigned long long ullSum;				/// counts in the chunk
+	unsigned long long ullMax;				/// largest cell
+	unsigned long long ullRoi[STORE_MAX_ROIS];	/// ROI counts within the chunk channels (exact at every level)
+} STORE_CHUNK_STATS;
+
+/// Chunk of STORE_CHUNK_CHANNELS x STORE_CHUNK_FRAMES cells, each channel column stored contiguously.
+typedef struct _STORE_CHUNK
+{
+	STORE_CHUNK_STATS Stats;
+	vector<unsigned int> vCells32;				/// level 0 cells (empty when spilled)
+	vector<unsigned long long> vCells64;		/// summary level cells
+	long long llSpillOffset;					/// spill file position, -1 if in memory
+} STORE_CHUNK;
+
+/// One resolution level, frame and channel bins of lFactor level 0 frames and channels.
+typedef struct _STORE_LEVEL
+{
+	long lFactor;
+	long lChannels;
+	long lChunkCols;
+	long lFrames;								/// complete frames
+	vector<double> vTime;						/// time of the first spectrum of each frame
+	vector<STORE_CHUNK> Chunks;					/// chunk rows (time) of lChunkCols chunks (channels)
+	vector<unsigned long long> vPartial;		/// next frame, summed from the level below
+	vector<unsigned long long> vPartialRoi;		/// next frame ROI parts
+	long lPartialFrames;
+	double dblPartialTime;
+} STORE_LEVEL;
+
+/** CDppSpectrumStore keeps a run of spectra as a time x channel array in fixed size chunks.
+	Chunk statistics (sum, max, ROI counts) and summary levels that sum STORE_LEVEL_FACTOR
+	frames and channels per step are updated as spectra are appended, so overviews and
+	ROI totals of long runs are read from a few chunks instead of every spectrum.
+	Completed level 0 chunk rows can be moved to a spill file to bound memory.
+*/
+class CDppSpectrumStore
+{
+public:
+	CDppSpectrumStore(void);
+	~CDppSpectrumStore(void);
+
+	/// Clears the store and accepts spectra, the channel count is taken from the first spectrum.
+	bool Start(string strSpillFile = "");
+	/// Stops accepting spectra, the data stays available.
+	void Stop();
+	/// Stops and discards all data.
+	void Clear();
+	/// True while spectra are accepted.
+	bool IsEnabled() { return bEnabled; }
+	/// Sets the regions of interest (before the first spectrum).
+	bool SetRois(const vector<STORE_ROI> &vRois);
+	/// Appends a spectrum, dblTime in seconds.
+	bool Append(const long lData[], long lChannels, double dblTime);
+
+	/// Complete frames of a level.
+	long Frames(int iLevel);
+	/// Channels of a level.
+	long Channels(int iLevel);
+	/// Finest level that shows lFrames level 0 frames in at most lMaxFrames frames.
+	int LevelFor(long lFrames, long lMaxFrames);
+	/// Time of a frame (seconds), 0 if out of range.
+	double FrameTime(int iLevel, long idxFrame);
+	/// First frame at or after dblTime, -1 if none.
+	long FindFrame(int iLevel, double dblTime);
+	/// Copies a frame x channel range of a level (frame major), false if the range is outside the data.
+	bool QueryRange(int iLevel, long lFrameStart, long lFrames, long lChanStart, long lChans, vector<unsigned long long> *vOut);
+	/// Sums level 0 frames into one spectrum.
+	bool SumFrames(long lFrameStart, long lFrames, vector<unsigned long long> *vOut);
+	/// ROI counts of level 0 frames, whole chunks are taken from the coarsest level statistics.
+	bool RoiTotals(long lFrameStart, long lFrames, vector<unsigned long long> *vOut);
+	/// Chunk rows of a level.
+	long ChunkRows(int iLevel);
+	/// Chunk columns of a level.
+	long ChunkCols(int iLevel);
+	/// Copies the statistics of a chunk.
+	bool GetChunkStats(int iLevel, long idxRow, long idxCol, STORE_CHUNK_STATS *Stats);
+
+private:
+	/// Creates the levels for the channel count.
+	void InitLevels(long lChannels);
+	/// Adds a complete frame to a level and sums it into the next level.
+	void AddFrame(int iLevel, const unsigned long long ullFrame[], const unsigned long long ullRoiPart[], double dblTime);
+	/// Moves a complete level 0 chunk row to the spill file.
+	void SpillRow(long idxRow);
+	/// Returns the cells of a chunk, reading spilled chunks into ChunkBuffer.
+	const unsigned int *Cells32(const STORE_CHUNK &Chunk);
+	/// Returns the cell value of a chunk column and frame.
+	unsigned long long Cell(int iLevel, const STORE_CHUNK &Chunk, const unsigned int *pCells32, long lChan, long lFrame);
+
+	mutex StoreLock;
+	atomic<bool> bEnabled;
+	long lStoreChannels;						/// 0 until the first spectrum
+	vector<STORE_ROI> vRoiSettings;				/// ROIs as set
+	vector<STORE_ROI> vStoreRois;				/// ROIs limited to the channels of the run
+	vector<STORE_LEVEL> Levels;
+	vector<unsigned long long> vFrame;			/// level 0 frame being added
+	vector<unsigned long long> vRoiPart;		/// ROI counts per level 0 chunk column
+	FILE *SpillFile;
+	vector<unsigned int> ChunkBuffer;			/// spilled chunk read back
+};
@@ -0,0 +1,175 @@
+#include "DppStatusDecoder.h"
+#include <string.h>
+
+#define DEV_BIT(DppType) (1 << (DppType))
+
+// DP4 format status value table (see CDP5Status::Process_Status), flags are packed separately
+//	{ Offset, Width, Format, Mask, MinFirmware, DeviceMask, Dest, Scale }
+static const DPP_STATUS_FIELD DppStatusFields[] = {
+	{  0, 4, 0, 0xFF, 0, 0, svFastCount, 1.0 },
+	{  4, 4, 0, 0xFF, 0, 0, svSlowCount, 1.0 },
+	{  8, 4, 0, 0xFF, 0, 0, svGpCounter, 1.0 },
+	{ 12, 1, 0, 0xFF, 0, 0, svAccumulationTime, 0.001 },		// ms
+	{ 13, 3, 0, 0xFF, 0, 0, svAccumulationTime, 0.1 },			// 100ms
+	{ 16, 4, 0, 0xFF, 0x67, DEV_BIT(dppMCA8000D), svLiveTime, 0.001 },	// MCA8000D FW6.07
+	{ 20, 4, 0, 0xFF, 0, 0, svRealTime, 0.001 },
+	{ 24, 1, 0, 0xFF, 0, 0, svFirmware, 1.0 },
+	{ 25, 1, 0, 0xFF, 0, 0, svFPGA, 1.0 },
+	{ 26, 4, 0, 0xFF, 0, 0, svSerialNumber, 1.0 },
+	{ 30, 2, sffBigEndian | sffSigned, 0xFF, 0, 0, svHV, 0.5 },			// 0.5V/count
+	{ 32, 2, sffBigEndian, 0x0F, 0, 0, svDetTemp, 0.1 },				// 0.1K/count
+	{ 34, 1, sffSigned, 0xFF, 0, 0, svDp5Temp, 1.0 },
+	{ 37, 1, 0, 0x0F, 0x66, 0, svBuild, 1.0 },						// FW6.06
+	{ 39, 1, 0, 0xFF, 0, 0, svDeviceId, 1.0 },
+	{ 40, 2, sffBigEndian | sffDivide, 0x0F, 0, 0, svTecVoltage, 758.5 },
+	{ 42, 1, 0, 0x0F, 0, 0, svDppOptions, 1.0 },
+	{ 49, 1, 0, 0xFF, 0, 0, svDppEco, 1.0 }
+};
+
+CDppStatusDecoder::CDppStatusDecoder(void)
+{
+}
+
+CDppStatusDecoder::~CDppStatusDecoder(void)
+{
+}
+
+void CDppStatusDecoder::DecodeStatus(const unsigned char pData[], DPP_STATUS_DECODED *StatusOut)
+{
+	const DPP_STATUS_FIELD *pField;
+	const DPP_STATUS_FIELD *pFieldEnd;
+	unsigned char Firmware;
+	unsigned char DeviceBit;
+	unsigned long ulRaw;
+	long lValue;
+	const unsigned char *pByte;
+
+	memset(StatusOut->Value, 0, sizeof(StatusOut->Value));
+	Firmware = pData[24];
+	DeviceBit = (pData[39] < 8) ? (unsigned char)DEV_BIT(pData[39]) : 0;
+	pFieldEnd = DppStatusFields + (sizeof(DppStatusFields) / sizeof(DppStatusFields[0]));
+	for (pField=DppStatusFields;pField<pFieldEnd;pField++) {
+		if ((pField->MinFirmware != 0) && (Firmware < pField->MinFirmware)) continue;
+		if ((pField->DeviceMask != 0) && ((pField->DeviceMask & DeviceBit) == 0)) continue;
+		pByte = pData + pField->Offset;
+		if (pField->Format & sffBigEndian) {
+			switch (pField->Width) {
+				case 1: ulRaw = pByte[0] & pField->Mask; break;
+				case 2: ulRaw = ((unsigned long)(pByte[0] & pField->Mask) << 8) | pByte[1]; break;
+				case 3: ulRaw = ((unsigned long)(pByte[0] & pField->Mask) << 16) | ((unsigned long)pByte[1] << 8) | pByte[2]; break;
+				default: ulRaw = ((unsigned long)(pByte[0] & pField->Mask) << 24) | ((unsigned long)pByte[1] << 16) | ((unsigned long)pByte[2] << 8) | pByte[3]; break;
+			}
+		} else {
+			switch (pField->Width) {
+				case 1: ulRaw = pByte[0] & pField->Mask; break;
+				case 2: ulRaw = pByte[0] | ((unsigned long)(pByte[1] & pField->Mask) << 8); break;
+				case 3: ulRaw = pByte[0] | ((unsigned long)pByte[1] << 8) | ((unsigned long)(pByte[2] & pField->Mask) << 16); break;
+				default: ulRaw = pByte[0] | ((unsigned long)pByte[1] << 8) | ((unsigned long)pByte[2] << 16) | ((unsigned long)(pByte[3] & pField->Mask) << 24); break;
+			}
+		}
+		if ((pField->Format & sffSigned) && (ulRaw & (1UL << (8 * pField->Width - 1)))) {
+			lValue = (long)ulRaw - (long)(1UL << (8 * pField->Width));
+			StatusOut->Value[pField->Dest] += (pField->Format & sffDivide) ? (double)lValue / pField->Scale : (double)lValue * pField->Scale;
+		} else {
+			StatusOut->Value[pField->Dest] += (pField->Format & sffDivide) ? (double)ulRaw / pField->Scale : (double)ulRaw * pField->Scale;
+		}
+	}
+	if (pData[29] >= 128) {			// serial number not set
+		StatusOut->Value[svSerialNumber] = -1;
+	}
+	StatusOut->Flags = (unsigned long)pData[35] | ((unsigned long)pData[36] << 8) | ((unsigned long)pData[38] << 16) | ((unsigned long)pData[42] << 24);
+	if (Firmware < 0x65) {			// reboot flag added FW6.05
+		StatusOut->Flags &= ~(1UL << sfReBoot);
+	}
+}
+
+long CDppStatusDecoder::DecodeStatusRecords(const unsigned char pRecords[], long lCount, long lStride, DPP_STATUS_DECODED StatusOut[])
+{
+	long idxRecord;
+
+	if (lStride < DPP_STATUS_SIZE) {
+		return 0;
+	}
+	for (idxRecord=0;idxRecord<lCount;idxRecord++) {
+		DecodeStatus(pRecords + idxRecord * lStride, &StatusOut[idxRecord]);
+	}
+	return lCount;
+}
+
+bool CDppStatusDecoder::IsFlagSet(const DPP_STATUS_DECODED *Status, DPP_STATUS_FLAG Flag)
+{
+	return ((Status->Flags & (1UL << Flag)) != 0);
+}
+
+void CDppStatusDecoder::ToDP4Status(const DPP_STATUS_DECODED *Status, DP4_FORMAT_STATUS *m_DP5_Status)
+{
+	bool bDMCA_LiveTime;
+	unsigned int uiFwBuild;
+
+	m_DP5_Status->DEVICE_ID = (unsigned char)Status->Value[svDeviceId];
+	m_DP5_Status->FastCount = Status->Value[svFastCount];
+	m_DP5_Status->SlowCount = Status->Value[svSlowCount];
+	m_DP5_Status->GP_COUNTER = Status->Value[svGpCounter];
+	m_DP5_Status->AccumulationTime = Status->Value[svAccumulationTime];
+	m_DP5_Status->RealTime = Status->Value[svRealTime];
+	m_DP5_Status->Firmware = (unsigned char)Status->Value[svFirmware];
+	m_DP5_Status->FPGA = (unsigned char)Status->Value[svFPGA];
+	m_DP5_Status->Build = (unsigned char)Status->Value[svBuild];
+	m_DP5_Status->LiveTime = Status->Value[svLiveTime];
+	bDMCA_LiveTime = ((m_DP5_Status->DEVICE_ID == dppMCA8000D) && (m_DP5_Status->Firmware >= 0x67));
+	if (Status->Value[svSerialNumber] < 0) {
+		m_DP5_Status->SerialNumber = (unsigned long)-1;
+	} else {
+		m_DP5_Status->SerialNumber = (unsigned long)Status->Value[svSerialNumber];
+	}
+	m_DP5_Status->HV = Status->Value[svHV];
+	m_DP5_Status->DET_TEMP = Status->Value[svDetTemp];
+	m_DP5_Status->DP5_TEMP = Status->Value[svDp5Temp];
+
+	m_DP5_Status->PresetRtDone = IsFlagSet(Status, sfPresetRtDone);
+	// status byte 35 bit 6 is Preset LiveTime Done for MCA8000D, FAST Thresh locked for other devices
+	m_DP5_Status->PresetLtDone = bDMCA_LiveTime && IsFlagSet(Status, sfPresetLtDone_AfastLocked);
+	m_DP5_Status->AFAST_LOCKED = !bDMCA_LiveTime && IsFlagSet(Status, sfPresetLtDone_AfastLocked);
+	m_DP5_Status->MCA_EN = IsFlagSet(Status, sfMcaEn);
+	m_DP5_Status->PRECNT_REACHED = IsFlagSet(Status, sfPrecntReached);
+	m_DP5_Status->SCOPE_DR = IsFlagSet(Status, sfScopeDr);
+	m_DP5_Status->DP5_CONFIGURED = IsFlagSet(Status, sfDp5Configured);
+	m_DP5_Status->AOFFSET_LOCKED = !IsFlagSet(Status, sfAoffsetSearching);	// 0=locked, 1=searching
+	m_DP5_Status->MCS_DONE = IsFlagSet(Status, sfMcsDone);
+	m_DP5_Status->b80MHzMode = IsFlagSet(Status, sf80MHzMode);
+	m_DP5_Status->bFPGAAutoClock = IsFlagSet(Status, sfFPGAAutoClock);
+	m_DP5_Status->PC5_PRESENT = IsFlagSet(Status, sfPc5Present);
+	m_DP5_Status->PC5_HV_POL = m_DP5_Status->PC5_PRESENT && IsFlagSet(Status, sfPc5HvPol);
+	m_DP5_Status->PC5_8_5V = m_DP5_Status->PC5_PRESENT && IsFlagSet(Status, sfPc5_8_5V);
+	m_DP5_Status->ReBootFlag = IsFlagSet(Status, sfReBoot);
+
+	m_DP5_Status->TEC_Voltage = Status->Value[svTecVoltage];
+	m_DP5_Status->DPP_ECO = (unsigned char)Status->Value[svDppEco];
+	m_DP5_Status->DPP_options = (unsigned char)Status->Value[svDppOptions];
+	m_DP5_Status->bScintHas80MHzOption = false;
+	m_DP5_Status->HPGe_HV_INH = false;
+	m_DP5_Status->HPGe_HV_INH_POL = false;
+	m_DP5_Status->AU34_2 = false;
+	m_DP5_Status->isAscInstalled = false;
+	m_DP5_Status->isDP5_RevDxGains = false;
+	if (m_DP5_Status->DEVICE_ID == dppPX5) {
+		if (m_DP5_Status->DPP_options == PX5_OPTION_HPGe_HVPS) {
+			m_DP5_Status->HPGe_HV_INH = IsFlagSet(Status, sfHpgeHvInh);
+			m_DP5_Status->HPGe_HV_INH_POL = IsFlagSet(Status, sfHpgeHvInhPol);
+			if (m_DP5_Status->DPP_ECO == 1) {
+				m_DP5_Status->isAscInstalled = true;
+				m_DP5_Status->AU34_2 = IsFlagSet(Status, sfAu34_2);
+			}
+		}
+	} else if ((m_DP5_Status->DEVICE_ID == dppDP5G) || (m_DP5_Status->DEVICE_ID == dppTB5)) {
+		if ((m_DP5_Status->DPP_ECO == 1) || (m_DP5_Status->DPP_ECO == 2)) {
+			m_DP5_Status->bScintHas80MHzOption = true;		// DPP_ECO == 2 80MHz option added 20150409
+		}
+	} else if (m_DP5_Status->DEVICE_ID == dppDP5) {
+		uiFwBuild = ((unsigned int)m_DP5_Status->Firmware << 8) + m_DP5_Status->Build;
+		// DPP_ECO 0xFF indicates old Analog Gain Count of 16, values < 0xFF new gain count of 24
+		if ((uiFwBuild >= 0x686) && (m_DP5_Status->DPP_ECO < 0xFF)) {
+			m_DP5_Status->isDP5_RevDxGains = true;
+		}
+	}
+}
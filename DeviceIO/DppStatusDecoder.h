@@ -0,0 +1,74 @@
+/** CDppStatusDecoder CDppStatusDecoder */
+#pragma once
+#include <stddef.h>
+#include "DppConst.h"
+#include "DP5Protocol.h"
+#include "DP5Status.h"
+
+#define DPP_STATUS_SIZE 64			/// DP4 format status packet size
+
+/// Numeric status values decoded by the field table.
+typedef enum _DPP_STATUS_VALUE
+{
+	svFastCount, svSlowCount, svGpCounter, svAccumulationTime,
+	svRealTime, svLiveTime, svSerialNumber, svHV,
+	svDetTemp, svDp5Temp, svTecVoltage, svFirmware,
+	svFPGA, svBuild, svDeviceId, svDppEco,
+	svDppOptions,
+	svCOUNT
+} DPP_STATUS_VALUE;
+
+/// Status flag bits, status bytes 35,36,38,42 are packed into DPP_STATUS_DECODED::Flags (byte*8+bit).
+typedef enum _DPP_STATUS_FLAG
+{
+	sfDp5Configured = 1, sfScopeDr = 2, sfPrecntReached = 4, sfMcaEn = 5,
+	sfPresetLtDone_AfastLocked = 6, sfPresetRtDone = 7,
+	sfFPGAAutoClock = 8, sf80MHzMode = 9, sfReBoot = 13, sfMcsDone = 14, sfAoffsetSearching = 15,
+	sfPc5_8_5V = 21, sfPc5HvPol = 22, sfPc5Present = 23,
+	sfHpgeHvInhPol = 28, sfHpgeHvInh = 29, sfAu34_2 = 30
+} DPP_STATUS_FLAG;
+
+/// Status field format bits.
+#define sffBigEndian	0x01		/// most significant byte first
+#define sffSigned		0x02		/// two's complement value
+#define sffDivide		0x04		/// divide by Scale instead of multiplying
+
+/// Status field descriptor, one entry per decoded field.
+typedef struct _DPP_STATUS_FIELD
+{
+	unsigned char Offset;			/// first status byte
+	unsigned char Width;			/// field width in bytes (1-4)
+	unsigned char Format;			/// sff format bits
+	unsigned char Mask;				/// mask for the most significant byte
+	unsigned char MinFirmware;		/// firmware gate (0=all firmware)
+	unsigned char DeviceMask;		/// device gate, bit per DEVICE_ID (0=all devices)
+	unsigned char Dest;				/// DPP_STATUS_VALUE
+	double Scale;					/// value scale, values with the same Dest are summed
+} DPP_STATUS_FIELD;
+
+/// Decoded status, cache line aligned for batch decoding.
+typedef struct alignas(64) _DPP_STATUS_DECODED
+{
+	double Value[svCOUNT];			/// numeric values (DPP_STATUS_VALUE)
+	unsigned long Flags;			/// status flag bytes (DPP_STATUS_FLAG)
+} DPP_STATUS_DECODED;
+
+/** CDppStatusDecoder decodes DP4 format status packets with a constant field table.
+	Decoding reads straight from the packet data and does not allocate,
+	DecodeStatusRecords decodes archived status records in bulk.
+*/
+class CDppStatusDecoder
+{
+public:
+	CDppStatusDecoder(void);
+	~CDppStatusDecoder(void);
+
+	/// Decodes a 64 byte status from packet data.
+	void DecodeStatus(const unsigned char pData[], DPP_STATUS_DECODED *StatusOut);
+	/// Decodes lCount status records lStride bytes apart, returns the number decoded.
+	long DecodeStatusRecords(const unsigned char pRecords[], long lCount, long lStride, DPP_STATUS_DECODED StatusOut[]);
+	/// Returns true if the status flag is set.
+	bool IsFlagSet(const DPP_STATUS_DECODED *Status, DPP_STATUS_FLAG Flag);
+	/// Fills the DP4_FORMAT_STATUS values set by CDP5Status::Process_Status.
+	void ToDP4Status(const DPP_STATUS_DECODED *Status, DP4_FORMAT_STATUS *m_DP5_Status);
+};
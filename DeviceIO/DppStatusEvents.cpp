@@ -0,0 +1,326 @@
+#include "DppStatusEvents.h"
+#include "stringex.h"
+#include <stddef.h>
+#include <chrono>
+
+typedef enum _STATUS_FIELD_KIND { sfkFlag, sfkState, sfkAnalog } STATUS_FIELD_KIND;
+typedef enum _STATUS_FIELD_TYPE { sftBool, sftByte, sftDouble, sftFloat } STATUS_FIELD_TYPE;
+
+/// Watched status field, one entry per STATUS_EVENT_SOURCE in source order.
+typedef struct _STATUS_EVENT_FIELD
+{
+	STATUS_EVENT_SOURCE Source;
+	STATUS_FIELD_KIND Kind;
+	STATUS_FIELD_TYPE Type;
+	size_t Offset;				/// offset in DP4_FORMAT_STATUS or Stat_MNX
+	const char *Name;
+} STATUS_EVENT_FIELD;
+
+static const STATUS_EVENT_FIELD StatusEventFields[esCOUNT] = {
+	{ esMcaEn, sfkFlag, sftBool, offsetof(DP4_FORMAT_STATUS, MCA_EN), "MCA_EN" },
+	{ esPresetRtDone, sfkFlag, sftBool, offsetof(DP4_FORMAT_STATUS, PresetRtDone), "PresetRtDone" },
+	{ esPresetLtDone, sfkFlag, sftBool, offsetof(DP4_FORMAT_STATUS, PresetLtDone), "PresetLtDone" },
+	{ esPrecntReached, sfkFlag, sftBool, offsetof(DP4_FORMAT_STATUS, PRECNT_REACHED), "PRECNT_REACHED" },
+	{ esReBoot, sfkFlag, sftBool, offsetof(DP4_FORMAT_STATUS, ReBootFlag), "ReBootFlag" },
+	{ esAoffsetLocked, sfkFlag, sftBool, offsetof(DP4_FORMAT_STATUS, AOFFSET_LOCKED), "AOFFSET_LOCKED" },
+	{ esAfastLocked, sfkFlag, sftBool, offsetof(DP4_FORMAT_STATUS, AFAST_LOCKED), "AFAST_LOCKED" },
+	{ esDp5Configured, sfkFlag, sftBool, offsetof(DP4_FORMAT_STATUS, DP5_CONFIGURED), "DP5_CONFIGURED" },
+	{ esMcsDone, sfkFlag, sftBool, offsetof(DP4_FORMAT_STATUS, MCS_DONE), "MCS_DONE" },
+	{ esScopeDr, sfkFlag, sftBool, offsetof(DP4_FORMAT_STATUS, SCOPE_DR), "SCOPE_DR" },
+	{ esHpgeHvInh, sfkFlag, sftBool, offsetof(DP4_FORMAT_STATUS, HPGe_HV_INH), "HPGe_HV_INH" },
+	{ esDetTemp, sfkAnalog, sftDouble, offsetof(DP4_FORMAT_STATUS, DET_TEMP), "DET_TEMP" },
+	{ esBoardTemp, sfkAnalog, sftDouble, offsetof(DP4_FORMAT_STATUS, DP5_TEMP), "DP5_TEMP" },
+	{ esHV, sfkAnalog, sftDouble, offsetof(DP4_FORMAT_STATUS, HV), "HV" },
+	{ esTecVoltage, sfkAnalog, sftDouble, offsetof(DP4_FORMAT_STATUS, TEC_Voltage), "TEC_Voltage" },
+	{ esMx2HvEn, sfkFlag, sftBool, offsetof(Stat_MNX, HV_EN), "MX2 HV_EN" },
+	{ esMx2XrayOn, sfkFlag, sftBool, offsetof(Stat_MNX, PWR_XRAY_FLAG), "MX2 PWR_XRAY_FLAG" },
+	{ esMx2UsbError, sfkFlag, sftBool, offsetof(Stat_MNX, bUSBError), "MX2 USB_ERROR" },
+	{ esMx2InterlockState, sfkState, sftByte, offsetof(Stat_MNX, INTERLOCK_STATE), "MX2 INTERLOCK_STATE" },
+	{ esMx2LastFault, sfkState, sftByte, offsetof(Stat_MNX, LAST_FAULT), "MX2 LAST_FAULT" },
+	{ esMx2WarmupStep, sfkState, sftByte, offsetof(Stat_MNX, WARMUP_STEP), "MX2 WARMUP_STEP" },
+	{ esMx2HvMon, sfkAnalog, sftFloat, offsetof(Stat_MNX, HV_MON), "MX2 HV_MON" },
+	{ esMx2IMon, sfkAnalog, sftFloat, offsetof(Stat_MNX, I_MON), "MX2 I_MON" },
+	{ esMx2Temp, sfkAnalog, sftFloat, offsetof(Stat_MNX, Temp), "MX2 Temp" }
+};
+
+// reads a watched field from a status structure
+static double ReadStatusField(const unsigned char *pStatus, const STATUS_EVENT_FIELD *Field)
+{
+	switch (Field->Type) {
+		case sftBool:
+			return *(const bool *)(pStatus + Field->Offset) ? 1.0 : 0.0;
+		case sftByte:
+			return *(const unsigned char *)(pStatus + Field->Offset);
+		case sftFloat:
+			return *(const float *)(pStatus + Field->Offset);
+		default:
+			return *(const double *)(pStatus + Field->Offset);
+	}
+}
+
+CDppStatusEvents::CDppStatusEvents(void)
+{
+	iNextId = 1;
+	ulSequence = 0;
+	Reset();
+}
+
+CDppStatusEvents::~CDppStatusEvents(void)
+{
+}
+
+void CDppStatusEvents::Reset()
+{
+	int idxThreshold;
+
+	lock_guard<mutex> Lock(EventLock);
+	bHaveStatus = false;
+	bHaveStatusMX2 = false;
+	for (idxThreshold=0;idxThreshold<(int)vThresholds.size();idxThreshold++) {
+		vThresholds[idxThreshold].iState = -1;
+	}
+}
+
+void CDppStatusEvents::ProcessStatus(const DP4_FORMAT_STATUS *Status)
+{
+	double dblNew[esCOUNT];
+	int idxField;
+
+	for (idxField=esMcaEn;idxField<=esTecVoltage;idxField++) {
+		dblNew[idxField] = ReadStatusField((const unsigned char *)Status, &StatusEventFields[idxField]);
+	}
+	CompareValues(dblNew, bHaveStatus, esMcaEn, esTecVoltage);
+	bHaveStatus = true;
+}
+
+void CDppStatusEvents::ProcessStatusMX2(const Stat_MNX *Status)
+{
+	double dblNew[esCOUNT];
+	int idxField;
+
+	for (idxField=esMx2HvEn;idxField<=esMx2Temp;idxField++) {
+		dblNew[idxField] = ReadStatusField((const unsigned char *)Status, &StatusEventFields[idxField]);
+	}
+	CompareValues(dblNew, bHaveStatusMX2, esMx2HvEn, esMx2Temp);
+	bHaveStatusMX2 = true;
+}
+
+void CDppStatusEvents::CompareValues(const double dblNew[], bool bHavePrevious, int iFirst, int iLast)
+{
+	STATUS_THRESHOLD *Threshold;
+	int idxField;
+	int idxThreshold;
+	bool bPublished;
+
+	bPublished = false;
+	{
+		lock_guard<mutex> Lock(EventLock);
+		if (bHavePrevious) {
+			for (idxField=iFirst;idxField<=iLast;idxField++) {
+				if ((StatusEventFields[idxField].Kind == sfkAnalog) || (dblNew[idxField] == dblPrevious[idxField])) {
+					continue;
+				}
+				if (StatusEventFields[idxField].Kind == sfkFlag) {
+					Publish((dblNew[idxField] != 0) ? etRising : etFalling, (STATUS_EVENT_SOURCE)idxField, dblNew[idxField], dblPrevious[idxField], 0);
+				} else {
+					Publish(etChanged, (STATUS_EVENT_SOURCE)idxField, dblNew[idxField], dblPrevious[idxField], 0);
+				}
+				bPublished = true;
+			}
+		}
+		for (idxThreshold=0;idxThreshold<(int)vThresholds.size();idxThreshold++) {
+			Threshold = &vThresholds[idxThreshold];
+			if ((Threshold->Source < iFirst) || (Threshold->Source > iLast)) {
+				continue;
+			}
+			idxField = Threshold->Source;
+			if (Threshold->iState == -1) {			// first value sets the state
+				Threshold->iState = (dblNew[idxField] >= Threshold->dblLevel) ? 1 : 0;
+			} else if ((Threshold->iState == 0) && (dblNew[idxField] >= Threshold->dblLevel)) {
+				Threshold->iState = 1;
+				Publish(etAbove, Threshold->Source, dblNew[idxField], dblPrevious[idxField], Threshold->dblLevel);
+				bPublished = true;
+			} else if ((Threshold->iState == 1) && (dblNew[idxField] < (Threshold->dblLevel - Threshold->dblHysteresis))) {
+				Threshold->iState = 0;
+				Publish(etBelow, Threshold->Source, dblNew[idxField], dblPrevious[idxField], Threshold->dblLevel);
+				bPublished = true;
+			}
+		}
+		for (idxField=iFirst;idxField<=iLast;idxField++) {
+			dblPrevious[idxField] = dblNew[idxField];
+		}
+	}
+	if (bPublished) {
+		EventReady.notify_all();
+	}
+}
+
+// called with EventLock held
+void CDppStatusEvents::Publish(STATUS_EVENT_TYPE Type, STATUS_EVENT_SOURCE Source, double dblValue, double dblPrevious, double dblLevel)
+{
+	STATUS_SUBSCRIBER *Subscriber;
+	STATUS_EVENT Event;
+	int idxSubscriber;
+
+	Event.Type = Type;
+	Event.Source = Source;
+	Event.dblValue = dblValue;
+	Event.dblPrevious = dblPrevious;
+	Event.dblLevel = dblLevel;
+	Event.dblTime = chrono::duration<double>(chrono::system_clock::now().time_since_epoch()).count();
+	Event.ulSequence = ulSequence++;
+	for (idxSubscriber=0;idxSubscriber<(int)vSubscribers.size();idxSubscriber++) {
+		Subscriber = &vSubscribers[idxSubscriber];
+		if ((Subscriber->ullSourceMask & (1ULL << Source)) == 0) {
+			continue;
+		}
+		if (Subscriber->ulCount == STATUS_EVENT_QUEUE_SIZE) {		// drop oldest
+			Subscriber->ulHead++;
+			Subscriber->ulCount--;
+			Subscriber->ulDropped++;
+		}
+		Subscriber->Events[(Subscriber->ulHead + Subscriber->ulCount) % STATUS_EVENT_QUEUE_SIZE] = Event;
+		Subscriber->ulCount++;
+	}
+}
+
+bool CDppStatusEvents::AddThreshold(STATUS_EVENT_SOURCE Source, double dblLevel, double dblHysteresis)
+{
+	STATUS_THRESHOLD Threshold;
+
+	if ((Source < 0) || (Source >= esCOUNT) || (StatusEventFields[Source].Kind != sfkAnalog)) {
+		return false;
+	}
+	Threshold.Source = Source;
+	Threshold.dblLevel = dblLevel;
+	Threshold.dblHysteresis = (dblHysteresis > 0) ? dblHysteresis : 0;
+	Threshold.iState = -1;
+	lock_guard<mutex> Lock(EventLock);
+	vThresholds.push_back(Threshold);
+	return true;
+}
+
+void CDppStatusEvents::ClearThresholds()
+{
+	lock_guard<mutex> Lock(EventLock);
+	vThresholds.clear();
+}
+
+int CDppStatusEvents::Subscribe(unsigned long long ullSourceMask)
+{
+	STATUS_SUBSCRIBER Subscriber;
+
+	Subscriber.ullSourceMask = (ullSourceMask == 0) ? ~0ULL : ullSourceMask;
+	Subscriber.Events.resize(STATUS_EVENT_QUEUE_SIZE);
+	Subscriber.ulHead = 0;
+	Subscriber.ulCount = 0;
+	Subscriber.ulDropped = 0;
+	lock_guard<mutex> Lock(EventLock);
+	Subscriber.iId = iNextId++;
+	vSubscribers.push_back(Subscriber);
+	return Subscriber.iId;
+}
+
+void CDppStatusEvents::Unsubscribe(int iId)
+{
+	int idxSubscriber;
+
+	{
+		lock_guard<mutex> Lock(EventLock);
+		for (idxSubscriber=0;idxSubscriber<(int)vSubscribers.size();idxSubscriber++) {
+			if (vSubscribers[idxSubscriber].iId == iId) {
+				vSubscribers.erase(vSubscribers.begin() + idxSubscriber);
+				break;
+			}
+		}
+	}
+	EventReady.notify_all();		// release waiting readers
+}
+
+// called with EventLock held
+STATUS_SUBSCRIBER *CDppStatusEvents::FindSubscriber(int iId)
+{
+	int idxSubscriber;
+
+	for (idxSubscriber=0;idxSubscriber<(int)vSubscribers.size();idxSubscriber++) {
+		if (vSubscribers[idxSubscriber].iId == iId) {
+			return &vSubscribers[idxSubscriber];
+		}
+	}
+	return NULL;
+}
+
+bool CDppStatusEvents::GetEvent(int iId, STATUS_EVENT *Event, long lTimeoutMs)
+{
+	STATUS_SUBSCRIBER *Subscriber;
+
+	unique_lock<mutex> Lock(EventLock);
+	Subscriber = FindSubscriber(iId);
+	if ((Subscriber != NULL) && (Subscriber->ulCount == 0) && (lTimeoutMs > 0)) {
+		EventReady.wait_for(Lock, chrono::milliseconds(lTimeoutMs), [this, iId] {
+			STATUS_SUBSCRIBER *Waiting = FindSubscriber(iId);
+			return ((Waiting == NULL) || (Waiting->ulCount > 0));
+		});
+		Subscriber = FindSubscriber(iId);
+	}
+	if ((Subscriber == NULL) || (Subscriber->ulCount == 0)) {
+		return false;
+	}
+	*Event = Subscriber->Events[Subscriber->ulHead % STATUS_EVENT_QUEUE_SIZE];
+	Subscriber->ulHead++;
+	Subscriber->ulCount--;
+	return true;
+}
+
+long CDppStatusEvents::GetEvents(int iId, vector<STATUS_EVENT> *vEvents)
+{
+	STATUS_SUBSCRIBER *Subscriber;
+	long lNumEvents;
+
+	vEvents->clear();
+	lock_guard<mutex> Lock(EventLock);
+	Subscriber = FindSubscriber(iId);
+	if (Subscriber == NULL) {
+		return 0;
+	}
+	for (lNumEvents=0;Subscriber->ulCount>0;lNumEvents++) {
+		vEvents->push_back(Subscriber->Events[Subscriber->ulHead % STATUS_EVENT_QUEUE_SIZE]);
+		Subscriber->ulHead++;
+		Subscriber->ulCount--;
+	}
+	return lNumEvents;
+}
+
+string CDppStatusEvents::SourceToString(STATUS_EVENT_SOURCE Source)
+{
+	if ((Source < 0) || (Source >= esCOUNT)) {
+		return "";
+	}
+	return StatusEventFields[Source].Name;
+}
+
+string CDppStatusEvents::EventToString(const STATUS_EVENT *Event)
+{
+	stringex strfn;
+	string strEvent;
+
+	strEvent = SourceToString(Event->Source);
+	switch (Event->Type) {
+		case etRising:
+			strEvent += " set";
+			break;
+		case etFalling:
+			strEvent += " cleared";
+			break;
+		case etChanged:
+			strEvent += strfn.Format(" changed %g -> %g", Event->dblPrevious, Event->dblValue);
+			break;
+		case etAbove:
+			strEvent += strfn.Format(" above %g (%g)", Event->dblLevel, Event->dblValue);
+			break;
+		case etBelow:
+			strEvent += strfn.Format(" below %g (%g)", Event->dblLevel, Event->dblValue);
+			break;
+	}
+	return strEvent;
+}
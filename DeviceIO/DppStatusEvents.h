@@ -0,0 +1,124 @@
+/** CDppStatusEvents CDppStatusEvents */
+#pragma once
+#include <string>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include "DP5Status.h"
+using namespace std;
+
+#define STATUS_EVENT_QUEUE_SIZE 256		/// events held per subscriber, oldest dropped when full
+
+/// Status values watched for changes.
+typedef enum _STATUS_EVENT_SOURCE
+{
+	// DPP status flags (rising/falling edges)
+	esMcaEn, esPresetRtDone, esPresetLtDone, esPrecntReached, esReBoot,
+	esAoffsetLocked, esAfastLocked, esDp5Configured, esMcsDone, esScopeDr, esHpgeHvInh,
+	// DPP analog values (threshold crossings)
+	esDetTemp, esBoardTemp, esHV, esTecVoltage,
+	// Mini-X2 flags (rising/falling edges)
+	esMx2HvEn, esMx2XrayOn, esMx2UsbError,
+	// Mini-X2 states (value changes)
+	esMx2InterlockState, esMx2LastFault, esMx2WarmupStep,
+	// Mini-X2 analog values (threshold crossings)
+	esMx2HvMon, esMx2IMon, esMx2Temp,
+	esCOUNT
+} STATUS_EVENT_SOURCE;
+
+/// Status event types.
+typedef enum _STATUS_EVENT_TYPE
+{
+	etRising,				/// flag set
+	etFalling,				/// flag cleared
+	etChanged,				/// state value changed
+	etAbove,				/// value reached a threshold
+	etBelow					/// value fell below a threshold (less hysteresis)
+} STATUS_EVENT_TYPE;
+
+/// One status change.
+typedef struct _STATUS_EVENT
+{
+	STATUS_EVENT_TYPE Type;
+	STATUS_EVENT_SOURCE Source;
+	double dblValue;		/// new value
+	double dblPrevious;		/// previous value
+	double dblLevel;		/// threshold level (threshold events)
+	double dblTime;			/// host time (seconds since 1970)
+	unsigned long ulSequence;	/// event number, gaps show dropped events
+} STATUS_EVENT;
+
+/// Threshold on an analog status value.
+typedef struct _STATUS_THRESHOLD
+{
+	STATUS_EVENT_SOURCE Source;
+	double dblLevel;
+	double dblHysteresis;
+	int iState;				/// -1 unknown, 0 below, 1 above
+} STATUS_THRESHOLD;
+
+/// Subscriber event queue.
+typedef struct _STATUS_SUBSCRIBER
+{
+	int iId;
+	unsigned long long ullSourceMask;	/// bit per STATUS_EVENT_SOURCE
+	vector<STATUS_EVENT> Events;		/// ring of STATUS_EVENT_QUEUE_SIZE
+	unsigned long ulHead;				/// next event read
+	unsigned long ulCount;				/// events queued
+	unsigned long ulDropped;			/// events dropped (queue full)
+} STATUS_SUBSCRIBER;
+
+/** CDppStatusEvents compares each status with the previous one and publishes typed change events.
+	Flags produce edge events, state values change events and analog values threshold
+	events (with hysteresis). Each subscriber has its own bounded queue filtered by source.
+*/
+class CDppStatusEvents
+{
+public:
+	CDppStatusEvents(void);
+	~CDppStatusEvents(void);
+
+	/// Compares a DPP status with the previous DPP status.
+	void ProcessStatus(const DP4_FORMAT_STATUS *Status);
+	/// Compares a Mini-X2 status with the previous Mini-X2 status.
+	void ProcessStatusMX2(const Stat_MNX *Status);
+	/// Forgets the previous statuses (next status produces no events).
+	void Reset();
+
+	/// Adds a threshold on an analog value, returns false for non analog sources.
+	bool AddThreshold(STATUS_EVENT_SOURCE Source, double dblLevel, double dblHysteresis);
+	/// Removes all thresholds.
+	void ClearThresholds();
+
+	/// Subscribes to events of the sources in the mask (0=all), returns the subscriber id.
+	int Subscribe(unsigned long long ullSourceMask);
+	/// Removes a subscriber.
+	void Unsubscribe(int iId);
+	/// Returns the next event, waits up to lTimeoutMs (0=no wait).
+	bool GetEvent(int iId, STATUS_EVENT *Event, long lTimeoutMs);
+	/// Moves all queued events to vEvents, returns the number of events.
+	long GetEvents(int iId, vector<STATUS_EVENT> *vEvents);
+
+	/// Returns the source name.
+	string SourceToString(STATUS_EVENT_SOURCE Source);
+	/// Formats an event as one line.
+	string EventToString(const STATUS_EVENT *Event);
+
+private:
+	/// Compares the values of one status type.
+	void CompareValues(const double dblNew[], bool bHavePrevious, int iFirst, int iLast);
+	/// Queues an event for the subscribers of its source.
+	void Publish(STATUS_EVENT_TYPE Type, STATUS_EVENT_SOURCE Source, double dblValue, double dblPrevious, double dblLevel);
+	/// Returns the subscriber, NULL if unknown.
+	STATUS_SUBSCRIBER *FindSubscriber(int iId);
+
+	double dblPrevious[esCOUNT];
+	bool bHaveStatus;
+	bool bHaveStatusMX2;
+	vector<STATUS_THRESHOLD> vThresholds;
+	vector<STATUS_SUBSCRIBER> vSubscribers;
+	int iNextId;
+	unsigned long ulSequence;
+	mutex EventLock;
+	condition_variable EventReady;
+};
@@ -0,0 +1,401 @@
+#ifndef _WIN32
+	#define _FILE_OFFSET_BITS 64		// 64 bit off_t for fseeko/ftello on 32 bit builds
+#endif
+#include "DppTelemetry.h"
+#include <string.h>
+#include <math.h>
+#include <chrono>
+
+#define TELEMETRY_VERSION 1
+
+// 64 bit file positions, telemetry files grow past 2 GB
+#ifdef _WIN32
+	#define TelemetrySeek _fseeki64
+	#define TelemetryTell _ftelli64
+#else
+	#define TelemetrySeek fseeko
+	#define TelemetryTell ftello
+#endif
+#define TELEMETRY_WRITER_POLL_MS 100
+
+// channels stored as unsigned 32 bit counts, all others are stored as float
+static bool IsCountChannel(int Channel)
+{
+	return ((Channel == tcFastCount) || (Channel == tcSlowCount));
+}
+
+CDppTelemetry::CDppTelemetry(void)
+{
+	ulHead = 0;
+	ulTail = 0;
+	ulDropped = 0;
+	bRecording = false;
+	bStopReq = false;
+	ulFlushReq = 0;
+	ulFlushDone = 0;
+	TelemetryFile = NULL;
+}
+
+CDppTelemetry::~CDppTelemetry(void)
+{
+	Stop();
+}
+
+double CDppTelemetry::GetHostTime()
+{
+	return chrono::duration<double>(chrono::system_clock::now().time_since_epoch()).count();
+}
+
+bool CDppTelemetry::Start(string strFilename)
+{
+	if (bRecording) {
+		return false;
+	}
+	if ((TelemetryFile = fopen(strFilename.c_str(), "ab")) == NULL) {
+		return false;
+	}
+	ulHead = 0;
+	ulTail = 0;
+	ulDropped = 0;
+	ulFlushReq = 0;
+	ulFlushDone = 0;
+	bStopReq = false;
+	vBlock.clear();
+	vBlock.reserve(TELEMETRY_BLOCK_SAMPLES);
+	bRecording = true;
+	WriterThreadHandle = thread(&CDppTelemetry::WriterThread, this);
+	return true;
+}
+
+void CDppTelemetry::Stop()
+{
+	if (! bRecording) {
+		return;
+	}
+	bStopReq = true;
+	if (WriterThreadHandle.joinable()) {
+		WriterThreadHandle.join();
+	}
+	fclose(TelemetryFile);
+	TelemetryFile = NULL;
+	bRecording = false;
+}
+
+bool CDppTelemetry::IsRecording()
+{
+	return bRecording;
+}
+
+void CDppTelemetry::Flush()
+{
+	unsigned long ulRequest;
+
+	if (! bRecording) {
+		return;
+	}
+	ulRequest = ++ulFlushReq;
+	while (bRecording && (ulFlushDone < ulRequest)) {
+		this_thread::sleep_for(chrono::milliseconds(1));
+	}
+}
+
+unsigned long CDppTelemetry::DroppedSamples()
+{
+	return ulDropped;
+}
+
+void CDppTelemetry::RecordStatus(const DP4_FORMAT_STATUS *Status)
+{
+	TELEMETRY_SAMPLE Sample;
+
+	if (! bRecording) {
+		return;
+	}
+	Sample.dblTime = GetHostTime();
+	Sample.dblValue[tcDetTemp] = Status->DET_TEMP;
+	Sample.dblValue[tcDp5Temp] = Status->DP5_TEMP;
+	Sample.dblValue[tcHV] = Status->HV;
+	Sample.dblValue[tcTecVoltage] = Status->TEC_Voltage;
+	Sample.dblValue[tcFastCount] = Status->FastCount;
+	Sample.dblValue[tcSlowCount] = Status->SlowCount;
+	Sample.dblValue[tcMx2HvMon] = NAN;
+	Sample.dblValue[tcMx2IMon] = NAN;
+	Sample.dblValue[tcMx2Temp] = NAN;
+	RecordSample(&Sample);
+}
+
+void CDppTelemetry::RecordStatusMX2(const Stat_MNX *Status)
+{
+	TELEMETRY_SAMPLE Sample;
+	int idxChannel;
+
+	if (! bRecording) {
+		return;
+	}
+	Sample.dblTime = GetHostTime();
+	for (idxChannel=0;idxChannel<tcCOUNT;idxChannel++) {
+		Sample.dblValue[idxChannel] = NAN;
+	}
+	Sample.dblValue[tcMx2HvMon] = Status->HV_MON;
+	Sample.dblValue[tcMx2IMon] = Status->I_MON;
+	Sample.dblValue[tcMx2Temp] = Status->Temp;
+	RecordSample(&Sample);
+}
+
+// single producer: only the communications thread records samples
+bool CDppTelemetry::RecordSample(const TELEMETRY_SAMPLE *Sample)
+{
+	unsigned long ulWrite;
+
+	ulWrite = ulHead.load(memory_order_relaxed);
+	if ((ulWrite - ulTail.load(memory_order_acquire)) >= TELEMETRY_RING_SIZE) {
+		ulDropped++;
+		return false;
+	}
+	Ring[ulWrite & (TELEMETRY_RING_SIZE - 1)] = *Sample;
+	ulHead.store(ulWrite + 1, memory_order_release);
+	return true;
+}
+
+void CDppTelemetry::WriterThread()
+{
+	unsigned long ulRead;
+	unsigned long ulWrite;
+	unsigned long ulFlush;
+	double dblLastWrite;
+	bool bStop;
+
+	dblLastWrite = GetHostTime();
+	for (;;) {
+		bStop = bStopReq;
+		ulFlush = ulFlushReq;
+		ulRead = ulTail.load(memory_order_relaxed);
+		ulWrite = ulHead.load(memory_order_acquire);
+		while (ulRead != ulWrite) {
+			vBlock.push_back(Ring[ulRead & (TELEMETRY_RING_SIZE - 1)]);
+			ulRead++;
+			ulTail.store(ulRead, memory_order_release);
+			if (vBlock.size() >= TELEMETRY_BLOCK_SAMPLES) {
+				WriteBlock();
+				dblLastWrite = GetHostTime();
+			}
+		}
+		if ((vBlock.size() > 0) && (bStop || (ulFlush != ulFlushDone) || ((GetHostTime() - dblLastWrite) * 1000.0 >= TELEMETRY_FLUSH_MS))) {
+			WriteBlock();
+			dblLastWrite = GetHostTime();
+		}
+		ulFlushDone = ulFlush;
+		if (bStop) {
+			break;
+		}
+		if (ulFlush == ulFlushReq) {
+			this_thread::sleep_for(chrono::milliseconds(TELEMETRY_WRITER_POLL_MS));
+		}
+	}
+}
+
+// block layout: header, time column (double), channel columns (float or unsigned 32 bit)
+void CDppTelemetry::WriteBlock()
+{
+	TELEMETRY_BLOCK_HEADER Header;
+	vector<unsigned char> vData;
+	unsigned char *pData;
+	unsigned int uiNumSamples;
+	unsigned int idxSample;
+	int idxChannel;
+	double dblValue;
+	float fValue;
+	unsigned int uiValue;
+
+	uiNumSamples = (unsigned int)vBlock.size();
+	if ((uiNumSamples == 0) || (TelemetryFile == NULL)) {
+		return;
+	}
+	memset(&Header, 0, sizeof(Header));
+	memcpy(Header.Magic, "DPTB", 4);
+	Header.uiVersion = TELEMETRY_VERSION;
+	Header.uiNumSamples = uiNumSamples;
+	Header.uiNumChannels = tcCOUNT;
+	Header.dblTimeStart = vBlock[0].dblTime;
+	Header.dblTimeEnd = vBlock[uiNumSamples - 1].dblTime;
+	vData.resize(sizeof(Header) + uiNumSamples * sizeof(double) + uiNumSamples * tcCOUNT * 4);
+	pData = &vData[sizeof(Header)];
+	for (idxSample=0;idxSample<uiNumSamples;idxSample++) {
+		memcpy(pData, &vBlock[idxSample].dblTime, sizeof(double));
+		pData += sizeof(double);
+	}
+	for (idxChannel=0;idxChannel<tcCOUNT;idxChannel++) {
+		Header.Stats[idxChannel].dblMin = INFINITY;
+		Header.Stats[idxChannel].dblMax = -INFINITY;
+		for (idxSample=0;idxSample<uiNumSamples;idxSample++) {
+			dblValue = vBlock[idxSample].dblValue[idxChannel];
+			if (IsCountChannel(idxChannel)) {
+				uiValue = isnan(dblValue) ? TELEMETRY_MISSING_COUNT : (unsigned int)dblValue;
+				memcpy(pData, &uiValue, 4);
+			} else {
+				fValue = (float)dblValue;
+				memcpy(pData, &fValue, 4);
+			}
+			pData += 4;
+			if (! isnan(dblValue)) {
+				if (dblValue < Header.Stats[idxChannel].dblMin) Header.Stats[idxChannel].dblMin = dblValue;
+				if (dblValue > Header.Stats[idxChannel].dblMax) Header.Stats[idxChannel].dblMax = dblValue;
+				Header.Stats[idxChannel].dblSum += dblValue;
+				Header.Stats[idxChannel].uiCount++;
+			}
+		}
+	}
+	memcpy(&vData[0], &Header, sizeof(Header));
+	fwrite(&vData[0], 1, vData.size(), TelemetryFile);		// one write per block
+	fflush(TelemetryFile);
+	vBlock.clear();
+}
+
+// reads the time column and one channel column of a block, samples without a value are skipped
+bool CDppTelemetry::ReadBlockColumn(FILE *txtFile, const TELEMETRY_BLOCK_HEADER *Header, long long llBlockStart, TELEMETRY_CHANNEL Channel, vector<double> *vTime, vector<double> *vValue)
+{
+	vector<double> vBlockTime;
+	vector<unsigned char> vColumn;
+	unsigned int idxSample;
+	unsigned int uiValue;
+	float fValue;
+
+	vTime->clear();
+	vValue->clear();
+	vBlockTime.resize(Header->uiNumSamples);
+	vColumn.resize(Header->uiNumSamples * 4);
+	TelemetrySeek(txtFile, llBlockStart, SEEK_SET);
+	if (fread(&vBlockTime[0], sizeof(double), Header->uiNumSamples, txtFile) != Header->uiNumSamples) {
+		return false;
+	}
+	TelemetrySeek(txtFile, llBlockStart + (long long)Header->uiNumSamples * (long long)(sizeof(double) + Channel * 4), SEEK_SET);
+	if (fread(&vColumn[0], 4, Header->uiNumSamples, txtFile) != Header->uiNumSamples) {
+		return false;
+	}
+	for (idxSample=0;idxSample<Header->uiNumSamples;idxSample++) {
+		if (IsCountChannel(Channel)) {
+			memcpy(&uiValue, &vColumn[idxSample * 4], 4);
+			if (uiValue == TELEMETRY_MISSING_COUNT) continue;
+			vValue->push_back(uiValue);
+		} else {
+			memcpy(&fValue, &vColumn[idxSample * 4], 4);
+			if (isnan(fValue)) continue;
+			vValue->push_back(fValue);
+		}
+		vTime->push_back(vBlockTime[idxSample]);
+	}
+	return true;
+}
+
+long CDppTelemetry::QueryRange(string strFilename, TELEMETRY_CHANNEL Channel, double dblStart, double dblEnd, vector<double> *vTime, vector<double> *vValue)
+{
+	FILE *txtFile;
+	TELEMETRY_BLOCK_HEADER Header;
+	vector<double> vBlockTime;
+	vector<double> vBlockValue;
+	long long llBlockStart;
+	size_t idxSample;
+
+	vTime->clear();
+	vValue->clear();
+	if ((txtFile = fopen(strFilename.c_str(), "rb")) == NULL) {
+		return 0;
+	}
+	while (fread(&Header, sizeof(Header), 1, txtFile) == 1) {
+		if ((memcmp(Header.Magic, "DPTB", 4) != 0) || (Header.uiNumChannels != tcCOUNT)) {
+			break;
+		}
+		llBlockStart = (long long)TelemetryTell(txtFile);
+		if ((Header.dblTimeEnd >= dblStart) && (Header.dblTimeStart <= dblEnd) && (Header.Stats[Channel].uiCount > 0)) {
+			if (! ReadBlockColumn(txtFile, &Header, llBlockStart, Channel, &vBlockTime, &vBlockValue)) {
+				break;			// truncated block
+			}
+			for (idxSample=0;idxSample<vBlockTime.size();idxSample++) {
+				if ((vBlockTime[idxSample] >= dblStart) && (vBlockTime[idxSample] <= dblEnd)) {
+					vTime->push_back(vBlockTime[idxSample]);
+					vValue->push_back(vBlockValue[idxSample]);
+				}
+			}
+		}
+		TelemetrySeek(txtFile, llBlockStart + (long long)Header.uiNumSamples * (long long)(sizeof(double) + Header.uiNumChannels * 4), SEEK_SET);
+	}
+	fclose(txtFile);
+	return (long)vTime->size();
+}
+
+void CDppTelemetry::AddToBucket(TELEMETRY_BUCKET *Bucket, double dblValue)
+{
+	if ((Bucket->ulCount == 0) || (dblValue < Bucket->dblMin)) Bucket->dblMin = dblValue;
+	if ((Bucket->ulCount == 0) || (dblValue > Bucket->dblMax)) Bucket->dblMax = dblValue;
+	Bucket->dblMean += dblValue;		// sum until finished
+	Bucket->ulCount++;
+}
+
+// blocks that fall inside one bucket are merged from their header statistics,
+// only blocks spanning a bucket boundary are read
+long CDppTelemetry::QueryDownsampled(string strFilename, TELEMETRY_CHANNEL Channel, double dblStart, double dblEnd, long lBuckets, vector<TELEMETRY_BUCKET> *vBuckets)
+{
+	FILE *txtFile;
+	TELEMETRY_BLOCK_HEADER Header;
+	TELEMETRY_BUCKET *Bucket;
+	vector<double> vBlockTime;
+	vector<double> vBlockValue;
+	double dblWidth;
+	long long llBlockStart;
+	long idxBucket;
+	long idxLast;
+	size_t idxSample;
+	long lSamples;
+
+	vBuckets->clear();
+	if ((lBuckets <= 0) || (dblEnd <= dblStart)) {
+		return 0;
+	}
+	dblWidth = (dblEnd - dblStart) / lBuckets;
+	vBuckets->resize(lBuckets);
+	for (idxBucket=0;idxBucket<lBuckets;idxBucket++) {
+		memset(&(*vBuckets)[idxBucket], 0, sizeof(TELEMETRY_BUCKET));
+		(*vBuckets)[idxBucket].dblTimeStart = dblStart + idxBucket * dblWidth;
+	}
+	if ((txtFile = fopen(strFilename.c_str(), "rb")) == NULL) {
+		return 0;
+	}
+	lSamples = 0;
+	while (fread(&Header, sizeof(Header), 1, txtFile) == 1) {
+		if ((memcmp(Header.Magic, "DPTB", 4) != 0) || (Header.uiNumChannels != tcCOUNT)) {
+			break;
+		}
+		llBlockStart = (long long)TelemetryTell(txtFile);
+		if ((Header.dblTimeEnd >= dblStart) && (Header.dblTimeStart <= dblEnd) && (Header.Stats[Channel].uiCount > 0)) {
+			idxBucket = (long)((Header.dblTimeStart - dblStart) / dblWidth);
+			idxLast = (long)((Header.dblTimeEnd - dblStart) / dblWidth);
+			if ((Header.dblTimeStart >= dblStart) && (Header.dblTimeEnd <= dblEnd) && (idxBucket == idxLast) && (idxBucket < lBuckets)) {
+				Bucket = &(*vBuckets)[idxBucket];
+				if ((Bucket->ulCount == 0) || (Header.Stats[Channel].dblMin < Bucket->dblMin)) Bucket->dblMin = Header.Stats[Channel].dblMin;
+				if ((Bucket->ulCount == 0) || (Header.Stats[Channel].dblMax > Bucket->dblMax)) Bucket->dblMax = Header.Stats[Channel].dblMax;
+				Bucket->dblMean += Header.Stats[Channel].dblSum;
+				Bucket->ulCount += Header.Stats[Channel].uiCount;
+				lSamples += Header.Stats[Channel].uiCount;
+			} else {
+				if (! ReadBlockColumn(txtFile, &Header, llBlockStart, Channel, &vBlockTime, &vBlockValue)) {
+					break;			// truncated block
+				}
+				for (idxSample=0;idxSample<vBlockTime.size();idxSample++) {
+					if ((vBlockTime[idxSample] < dblStart) || (vBlockTime[idxSample] > dblEnd)) continue;
+					idxBucket = (long)((vBlockTime[idxSample] - dblStart) / dblWidth);
+					if (idxBucket >= lBuckets) idxBucket = lBuckets - 1;
+					AddToBucket(&(*vBuckets)[idxBucket], vBlockValue[idxSample]);
+					lSamples++;
+				}
+			}
+		}
+		TelemetrySeek(txtFile, llBlockStart + (long long)Header.uiNumSamples * (long long)(sizeof(double) + Header.uiNumChannels * 4), SEEK_SET);
+	}
+	fclose(txtFile);
+	for (idxBucket=0;idxBucket<lBuckets;idxBucket++) {
+		if ((*vBuckets)[idxBucket].ulCount > 0) {
+			(*vBuckets)[idxBucket].dblMean /= (*vBuckets)[idxBucket].ulCount;
+		}
+	}
+	return lSamples;
+}
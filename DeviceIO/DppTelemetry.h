@@ -0,0 +1,128 @@
+/** CDppTelemetry CDppTelemetry */
+#pragma once
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include "DP5Status.h"
+using namespace std;
+
+#define TELEMETRY_RING_SIZE 4096			/// status samples buffered between producer and writer (power of 2)
+#define TELEMETRY_BLOCK_SAMPLES 1024		/// samples per columnar block on disk
+#define TELEMETRY_FLUSH_MS 10000			/// partial blocks are written after this interval
+#define TELEMETRY_MISSING_COUNT 0xFFFFFFFF	/// count column value for samples without counts
+
+/// Telemetry channels, one column per channel in each block.
+typedef enum _TELEMETRY_CHANNEL
+{
+	tcDetTemp,			/// detector temperature (K)
+	tcDp5Temp,			/// board temperature (C)
+	tcHV,				/// high voltage (V)
+	tcTecVoltage,		/// TEC voltage (V)
+	tcFastCount,		/// fast channel counter
+	tcSlowCount,		/// slow channel counter
+	tcMx2HvMon,			/// Mini-X2 HV monitor (V)
+	tcMx2IMon,			/// Mini-X2 current monitor (V)
+	tcMx2Temp,			/// Mini-X2 temperature (C)
+	tcCOUNT
+} TELEMETRY_CHANNEL;
+
+/// One recorded status sample, channels not in the status are NaN.
+typedef struct _TELEMETRY_SAMPLE
+{
+	double dblTime;					/// host time (seconds since 1970)
+	double dblValue[tcCOUNT];		/// channel values
+} TELEMETRY_SAMPLE;
+
+/// Per channel block statistics, used for downsampled views without reading samples.
+typedef struct _TELEMETRY_STATS
+{
+	double dblMin;
+	double dblMax;
+	double dblSum;
+	unsigned int uiCount;			/// samples with a value
+	unsigned int uiReserved;
+} TELEMETRY_STATS;
+
+/// Block header, followed by the time column (double) and one column per channel
+/// (float, counts as unsigned 32 bit).
+typedef struct _TELEMETRY_BLOCK_HEADER
+{
+	char Magic[4];					/// "DPTB"
+	unsigned int uiVersion;			/// block format version
+	unsigned int uiNumSamples;		/// samples in this block
+	unsigned int uiNumChannels;		/// channels in this block (tcCOUNT)
+	double dblTimeStart;			/// first sample time
+	double dblTimeEnd;				/// last sample time
+	TELEMETRY_STATS Stats[tcCOUNT];	/// per channel statistics
+} TELEMETRY_BLOCK_HEADER;
+
+/// Downsampled view bucket.
+typedef struct _TELEMETRY_BUCKET
+{
+	double dblTimeStart;			/// bucket start time
+	double dblMin;
+	double dblMax;
+	double dblMean;
+	unsigned long ulCount;			/// samples in bucket (0=no data)
+} TELEMETRY_BUCKET;
+
+/** CDppTelemetry records status values into a telemetry file.
+	Record* calls append to a lock-free single producer ring (the communications thread),
+	a background writer drains the ring into columnar blocks and appends them to the file.
+	Queries read only the block headers, the time column and the requested channel.
+*/
+class CDppTelemetry
+{
+public:
+	CDppTelemetry(void);
+	~CDppTelemetry(void);
+
+	/// Starts recording to a telemetry file (appends to an existing file).
+	bool Start(string strFilename);
+	/// Writes all buffered samples and stops the writer.
+	void Stop();
+	/// Returns true while recording.
+	bool IsRecording();
+	/// Requests the writer to write all buffered samples and waits until written.
+	void Flush();
+
+	/// Records the telemetry values of a DPP status.
+	void RecordStatus(const DP4_FORMAT_STATUS *Status);
+	/// Records the telemetry values of a Mini-X2 status.
+	void RecordStatusMX2(const Stat_MNX *Status);
+	/// Records a prepared sample, returns false if the ring is full.
+	bool RecordSample(const TELEMETRY_SAMPLE *Sample);
+	/// Samples dropped because the ring was full.
+	unsigned long DroppedSamples();
+
+	/// Reads the samples of a channel in a time range, returns the number of samples.
+	long QueryRange(string strFilename, TELEMETRY_CHANNEL Channel, double dblStart, double dblEnd, vector<double> *vTime, vector<double> *vValue);
+	/// Reads a channel in a time range reduced to lBuckets min/max/mean buckets.
+	long QueryDownsampled(string strFilename, TELEMETRY_CHANNEL Channel, double dblStart, double dblEnd, long lBuckets, vector<TELEMETRY_BUCKET> *vBuckets);
+	/// Returns the host time in seconds since 1970.
+	double GetHostTime();
+
+private:
+	/// Writer thread, drains the ring and writes blocks.
+	void WriterThread();
+	/// Appends the current block to the file.
+	void WriteBlock();
+	/// Reads the time column and one channel column of a block.
+	bool ReadBlockColumn(FILE *txtFile, const TELEMETRY_BLOCK_HEADER *Header, long long llBlockStart, TELEMETRY_CHANNEL Channel, vector<double> *vTime, vector<double> *vValue);
+	/// Adds a value to a downsample bucket.
+	void AddToBucket(TELEMETRY_BUCKET *Bucket, double dblValue);
+
+	TELEMETRY_SAMPLE Ring[TELEMETRY_RING_SIZE];
+	atomic<unsigned long> ulHead;		/// next write index (producer)
+	atomic<unsigned long> ulTail;		/// next read index (writer)
+	atomic<unsigned long> ulDropped;
+	atomic<bool> bRecording;
+	atomic<bool> bStopReq;
+	atomic<unsigned long> ulFlushReq;	/// flush requests
+	atomic<unsigned long> ulFlushDone;	/// flush requests completed
+	thread WriterThreadHandle;
+	FILE *TelemetryFile;
+	vector<TELEMETRY_SAMPLE> vBlock;	/// samples of the block being built (writer only)
+};
@@ -0,0 +1,165 @@
+#include "DppTrace.h"
+#include <stdio.h>
+#include <chrono>
+#include <algorithm>
+
+CDppTrace DppTrace;
+
+// ring of the calling thread, kept by the tracer after the thread exits
+static thread_local shared_ptr<TRACE_RING> ThreadTraceRing;
+
+CDppTrace::CDppTrace(void)
+{
+	bEnabled = true;
+	llClearedNs = 0;
+	uiNextThread = 1;
+}
+
+CDppTrace::~CDppTrace(void)
+{
+}
+
+long long CDppTrace::GetTimeNs()
+{
+	return (long long)chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+TRACE_RING *CDppTrace::GetThreadRing()
+{
+	if (! ThreadTraceRing) {
+		ThreadTraceRing = make_shared<TRACE_RING>();
+		ThreadTraceRing->ullHead = 0;
+		ThreadTraceRing->ullCleared = 0;
+		lock_guard<mutex> Lock(RingLock);
+		ThreadTraceRing->uiThread = uiNextThread++;
+		vRings.push_back(ThreadTraceRing);
+	}
+	return ThreadTraceRing.get();
+}
+
+void CDppTrace::AddSpan(const char *Name, long long llStartNs, long long llEndNs, long lArg)
+{
+	TRACE_RING *Ring;
+	TRACE_SPAN *Span;
+	unsigned long long ullHead;
+
+	Ring = GetThreadRing();
+	ullHead = Ring->ullHead.load(memory_order_relaxed);
+	Span = &Ring->Spans[ullHead & (TRACE_RING_SIZE - 1)];
+	Span->Name = Name;
+	Span->llStartNs = llStartNs;
+	Span->llDurationNs = llEndNs - llStartNs;
+	Span->lArg = lArg;
+	Ring->ullHead.store(ullHead + 1, memory_order_release);
+}
+
+// only the owning thread writes ullHead, the clear moves the read start instead; a span
+// being written during the clear lands after ullCleared and is dropped by its start time
+void CDppTrace::Clear()
+{
+	lock_guard<mutex> Lock(RingLock);
+	llClearedNs = GetTimeNs();
+	for (size_t idxRing=0;idxRing<vRings.size();idxRing++) {
+		vRings[idxRing]->ullCleared = vRings[idxRing]->ullHead.load(memory_order_acquire);
+	}
+}
+
+long CDppTrace::GetSpans(vector<TRACE_SPAN> *vSpans, vector<unsigned int> *vThreads)
+{
+	TRACE_RING *Ring;
+	unsigned long long ullHead;
+	unsigned long long ullFirst;
+	unsigned long long ullLast;
+	unsigned long long idxSpan;
+	size_t idxRing;
+	size_t iRingStart;
+	long long llClearNs;
+
+	vSpans->clear();
+	vThreads->clear();
+	lock_guard<mutex> Lock(RingLock);
+	llClearNs = llClearedNs;
+	for (idxRing=0;idxRing<vRings.size();idxRing++) {
+		Ring = vRings[idxRing].get();
+		ullHead = Ring->ullHead.load(memory_order_acquire);
+		ullFirst = (ullHead > TRACE_RING_SIZE) ? ullHead - TRACE_RING_SIZE : 0;
+		ullFirst = max(ullFirst, Ring->ullCleared.load());
+		iRingStart = vSpans->size();
+		for (idxSpan=ullFirst;idxSpan<ullHead;idxSpan++) {
+			vSpans->push_back(Ring->Spans[idxSpan & (TRACE_RING_SIZE - 1)]);
+		}
+		// spans overwritten by the owning thread while copying are dropped
+		ullLast = Ring->ullHead.load(memory_order_acquire);
+		if (ullLast > ullFirst + TRACE_RING_SIZE) {
+			idxSpan = ullLast - (ullFirst + TRACE_RING_SIZE);
+			if (idxSpan > ullHead - ullFirst) {
+				idxSpan = ullHead - ullFirst;
+			}
+			vSpans->erase(vSpans->begin() + iRingStart, vSpans->begin() + iRingStart + (size_t)idxSpan);
+		}
+		// spans that started before the last clear
+		vSpans->erase(remove_if(vSpans->begin() + iRingStart, vSpans->end(),
+			[llClearNs](const TRACE_SPAN &Span) { return Span.llStartNs < llClearNs; }), vSpans->end());
+		vThreads->resize(vSpans->size(), Ring->uiThread);
+	}
+	return (long)vSpans->size();
+}
+
+string CDppTrace::ToChromeJson()
+{
+	vector<TRACE_SPAN> vSpans;
+	vector<unsigned int> vThreads;
+	vector<unsigned int> vNamed;
+	string strJson;
+	char Event[256];
+	size_t idxSpan;
+	size_t idxName;
+	bool bNamed;
+
+	GetSpans(&vSpans, &vThreads);
+	strJson.reserve(vSpans.size() * 100 + 64);
+	strJson = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+	for (idxSpan=0;idxSpan<vSpans.size();idxSpan++) {
+		bNamed = false;
+		for (idxName=0;idxName<vNamed.size();idxName++) {
+			if (vNamed[idxName] == vThreads[idxSpan]) {
+				bNamed = true;
+				break;
+			}
+		}
+		if (! bNamed) {
+			vNamed.push_back(vThreads[idxSpan]);
+			snprintf(Event, sizeof(Event), "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"dpp-%u\"}},\n",
+				vThreads[idxSpan], vThreads[idxSpan]);
+			strJson += Event;
+		}
+		// complete events, times in microseconds
+		snprintf(Event, sizeof(Event), "{\"name\":\"%s\",\"cat\":\"dpp\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f",
+			vSpans[idxSpan].Name, vThreads[idxSpan], vSpans[idxSpan].llStartNs * 1.0e-3, vSpans[idxSpan].llDurationNs * 1.0e-3);
+		strJson += Event;
+		if (vSpans[idxSpan].lArg != -1) {
+			snprintf(Event, sizeof(Event), ",\"args\":{\"arg\":%ld}", vSpans[idxSpan].lArg);
+			strJson += Event;
+		}
+		strJson += (idxSpan + 1 < vSpans.size()) ? "},\n" : "}\n";
+	}
+	strJson += "]}\n";
+	return strJson;
+}
+
+bool CDppTrace::ExportChromeTrace(string strFilename)
+{
+	FILE *TraceFile;
+	string strJson;
+	bool bWritten;
+
+	strJson = ToChromeJson();
+	if ((TraceFile = fopen(strFilename.c_str(), "wb")) == NULL) {
+		return false;
+	}
+	bWritten = (fwrite(strJson.c_str(), 1, strJson.length(), TraceFile) == strJson.length());
+	if (fclose(TraceFile) != 0) {
+		bWritten = false;
+	}
+	return bWritten;
+}
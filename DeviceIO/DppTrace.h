@@ -0,0 +1,103 @@
+/** CDppTrace CDppTrace */
+#pragma once
+#include <string>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <memory>
+using namespace std;
+
+#define TRACE_RING_SIZE 16384			/// spans kept per thread, oldest overwritten (power of 2)
+
+/// One completed span.
+typedef struct _TRACE_SPAN
+{
+	const char *Name;				/// string literal
+	long long llStartNs;			/// host monotonic time (ns)
+	long long llDurationNs;
+	long lArg;						/// span argument (command, bytes, result), -1 for none
+} TRACE_SPAN;
+
+/// Per thread span ring, written only by its thread.
+typedef struct _TRACE_RING
+{
+	TRACE_SPAN Spans[TRACE_RING_SIZE];
+	atomic<unsigned long long> ullHead;		/// spans written (owning thread only)
+	atomic<unsigned long long> ullCleared;	/// spans before this one were discarded by Clear
+	unsigned int uiThread;					/// trace thread number
+} TRACE_RING;
+
+/** CDppTrace records timing spans of the acquisition stages for latency analysis.
+	Each thread writes completed spans into its own ring without locking, the rings
+	keep the most recent spans and are exported as Chrome trace event JSON
+	(chrome://tracing, Perfetto). Use DPP_TRACE_SPAN, it is removed with DPP_NO_TRACE.
+*/
+class CDppTrace
+{
+public:
+	CDppTrace(void);
+	~CDppTrace(void);
+
+	/// Enables or disables recording (enabled by default).
+	void Enable(bool bEnable) { bEnabled = bEnable; }
+	/// Returns true if spans are recorded.
+	bool IsEnabled() { return bEnabled; }
+	/// Records a completed span.
+	void AddSpan(const char *Name, long long llStartNs, long long llEndNs, long lArg);
+	/// Discards all recorded spans, spans still open during the clear are discarded when they complete.
+	void Clear();
+	/// Copies the recorded spans with their thread numbers, returns the number of spans.
+	long GetSpans(vector<TRACE_SPAN> *vSpans, vector<unsigned int> *vThreads);
+	/// Returns the recorded spans as Chrome trace event JSON.
+	string ToChromeJson();
+	/// Writes the Chrome trace event JSON to a file.
+	bool ExportChromeTrace(string strFilename);
+	/// Host monotonic time (ns), same clock as the USB packet timestamps.
+	static long long GetTimeNs();
+
+private:
+	/// Returns the ring of the calling thread.
+	TRACE_RING *GetThreadRing();
+
+	atomic<bool> bEnabled;
+	atomic<long long> llClearedNs;			/// spans starting before this time are discarded
+	mutex RingLock;
+	vector<shared_ptr<TRACE_RING> > vRings;
+	unsigned int uiNextThread;
+};
+
+/// Library tracer.
+extern CDppTrace DppTrace;
+
+/** CDppTraceSpan records the time from construction to destruction as one span. */
+class CDppTraceSpan
+{
+public:
+	CDppTraceSpan(const char *SpanName, long lSpanArg = -1)
+	{
+		Name = SpanName;
+		lArg = lSpanArg;
+		llStartNs = DppTrace.IsEnabled() ? CDppTrace::GetTimeNs() : 0;
+	}
+	~CDppTraceSpan()
+	{
+		if (llStartNs != 0) {
+			DppTrace.AddSpan(Name, llStartNs, CDppTrace::GetTimeNs(), lArg);
+		}
+	}
+	/// Sets the span argument (e.g. a result known at the end).
+	void SetArg(long lSpanArg) { lArg = lSpanArg; }
+
+private:
+	const char *Name;
+	long long llStartNs;
+	long lArg;
+};
+
+#ifndef DPP_NO_TRACE
+	#define DPP_TRACE_CONCAT2(a, b) a##b
+	#define DPP_TRACE_CONCAT(a, b) DPP_TRACE_CONCAT2(a, b)
+	#define DPP_TRACE_SPAN(...) CDppTraceSpan DPP_TRACE_CONCAT(TraceSpan, __LINE__)(__VA_ARGS__)
+#else
+	#define DPP_TRACE_SPAN(...) ((void)0)
+#endif
@@ -0,0 +1,264 @@
+#include "DppTransportMetrics.h"
+#include "ParsePacket.h"
+#include "stringex.h"
+#include <string.h>
+#include <chrono>
+#include <iostream>
+
+#define LATENCY_SUB_BUCKETS (1 << LATENCY_SUB_BUCKET_BITS)
+#define METRICS_DUMP_POLL_MS 100
+
+CDppTransportMetrics::CDppTransportMetrics(void)
+{
+	Metrics = new TRANSPORT_METRICS;
+	bDumping = false;
+	bStopDump = false;
+	lDumpIntervalMs = 0;
+	Reset();
+}
+
+CDppTransportMetrics::~CDppTransportMetrics(void)
+{
+	StopDump();
+	delete Metrics;
+}
+
+unsigned long long CDppTransportMetrics::GetTimeUs()
+{
+	return (unsigned long long)chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void CDppTransportMetrics::Reset()
+{
+	int idxCmd;
+
+	lock_guard<mutex> Lock(MetricsLock);
+	memset(Metrics, 0, sizeof(TRANSPORT_METRICS));
+	Metrics->Total.Latency.ullMinUs = ~0ULL;
+	for (idxCmd=0;idxCmd<XMTPT_COUNT;idxCmd++) {
+		Metrics->Command[idxCmd].Latency.ullMinUs = ~0ULL;
+	}
+	ullTimeStartUs = GetTimeUs();
+}
+
+// log-linear buckets: values below 16 have their own bucket, each power of 2 above
+// is split into 16 buckets
+int CDppTransportMetrics::LatencyToBucket(unsigned long long ullLatencyUs)
+{
+	int iShift;
+
+	if (ullLatencyUs < LATENCY_SUB_BUCKETS) {
+		return (int)ullLatencyUs;
+	}
+	iShift = 0;
+	while ((ullLatencyUs >> iShift) >= (2 * LATENCY_SUB_BUCKETS)) {
+		iShift++;
+	}
+	if (iShift >= LATENCY_MAGNITUDES) {
+		return LATENCY_BUCKETS - 1;
+	}
+	return ((iShift + 1) << LATENCY_SUB_BUCKET_BITS) + (int)(ullLatencyUs >> iShift) - LATENCY_SUB_BUCKETS;
+}
+
+unsigned long long CDppTransportMetrics::BucketToLatency(int idxBucket)
+{
+	int iShift;
+
+	if (idxBucket < LATENCY_SUB_BUCKETS) {
+		return idxBucket;
+	}
+	iShift = (idxBucket >> LATENCY_SUB_BUCKET_BITS) - 1;
+	return (unsigned long long)((idxBucket & (LATENCY_SUB_BUCKETS - 1)) + LATENCY_SUB_BUCKETS) << iShift;
+}
+
+void CDppTransportMetrics::RecordTransfer(TRANSMIT_PACKET_TYPE XmtCmd, long lBytesOut, int iResult, unsigned long long ullLatencyUs)
+{
+	COMMAND_METRICS *Counters[2];
+	LATENCY_HISTOGRAM *Histogram;
+	int idxBucket;
+	int idxCounter;
+
+	if ((XmtCmd < 0) || (XmtCmd >= XMTPT_COUNT)) {
+		return;
+	}
+	idxBucket = LatencyToBucket(ullLatencyUs);
+	lock_guard<mutex> Lock(MetricsLock);
+	Counters[0] = &Metrics->Command[XmtCmd];
+	Counters[1] = &Metrics->Total;
+	for (idxCounter=0;idxCounter<2;idxCounter++) {
+		Counters[idxCounter]->ullRequests++;
+		Counters[idxCounter]->ullBytesOut += lBytesOut;
+		if (iResult > 0) {
+			Counters[idxCounter]->ullBytesIn += iResult;
+			Histogram = &Counters[idxCounter]->Latency;
+			Histogram->Counts[idxBucket]++;
+			Histogram->ullTotalCount++;
+			Histogram->ullSumUs += ullLatencyUs;
+			if (ullLatencyUs < Histogram->ullMinUs) Histogram->ullMinUs = ullLatencyUs;
+			if (ullLatencyUs > Histogram->ullMaxUs) Histogram->ullMaxUs = ullLatencyUs;
+		} else if (iResult == LIBUSB_TIMEOUT_RESULT) {
+			Counters[idxCounter]->ullTimeouts++;
+		} else {
+			Counters[idxCounter]->ullUsbErrors++;
+		}
+	}
+}
+
+void CDppTransportMetrics::RecordResponse(TRANSMIT_PACKET_TYPE XmtCmd, long ReqProcess, const Packet_In *PIN)
+{
+	COMMAND_METRICS *Counters[2];
+	int idxCounter;
+
+	if ((XmtCmd < 0) || (XmtCmd >= XMTPT_COUNT)) {
+		return;
+	}
+	lock_guard<mutex> Lock(MetricsLock);
+	Counters[0] = &Metrics->Command[XmtCmd];
+	Counters[1] = &Metrics->Total;
+	for (idxCounter=0;idxCounter<2;idxCounter++) {
+		if (ReqProcess == preqProcessAck) {
+			if (PIN->PID2 < PID2_ACK_COUNT) {
+				Counters[idxCounter]->Acks[PIN->PID2]++;
+			}
+		} else if (ReqProcess == preqProcessError) {
+			switch (PIN->STATUS) {
+				case PID2_ACK_SYNC_ERROR:
+					Counters[idxCounter]->ullSyncErrors++;
+					break;
+				case PID2_ACK_LEN_ERROR:
+					Counters[idxCounter]->ullLenErrors++;
+					break;
+				case PID2_ACK_CHECKSUM_ERROR:
+					Counters[idxCounter]->ullChecksumErrors++;
+					break;
+				default:
+					Counters[idxCounter]->ullPidErrors++;
+					break;
+			}
+		}
+	}
+}
+
+void CDppTransportMetrics::GetSnapshot(TRANSPORT_METRICS *Snapshot)
+{
+	lock_guard<mutex> Lock(MetricsLock);
+	memcpy(Snapshot, Metrics, sizeof(TRANSPORT_METRICS));
+	Snapshot->dblElapsed = (GetTimeUs() - ullTimeStartUs) / 1.0e6;
+}
+
+unsigned long long CDppTransportMetrics::GetPercentile(const LATENCY_HISTOGRAM *Histogram, double dblPercent)
+{
+	unsigned long long ullTarget;
+	unsigned long long ullCount;
+	int idxBucket;
+
+	if (Histogram->ullTotalCount == 0) {
+		return 0;
+	}
+	ullTarget = (unsigned long long)((dblPercent / 100.0) * Histogram->ullTotalCount + 0.5);
+	if (ullTarget < 1) ullTarget = 1;
+	ullCount = 0;
+	for (idxBucket=0;idxBucket<LATENCY_BUCKETS;idxBucket++) {
+		ullCount += Histogram->Counts[idxBucket];
+		if (ullCount >= ullTarget) {
+			// clamp to the measured range, the bucket floor can be below the minimum
+			if (BucketToLatency(idxBucket) < Histogram->ullMinUs) return Histogram->ullMinUs;
+			if (BucketToLatency(idxBucket) > Histogram->ullMaxUs) return Histogram->ullMaxUs;
+			return BucketToLatency(idxBucket);
+		}
+	}
+	return Histogram->ullMaxUs;
+}
+
+string CDppTransportMetrics::CommandMetricsToString(string strName, const COMMAND_METRICS *Command)
+{
+	stringex strfn;
+	string strLine;
+	unsigned long long ullNaks;
+	int idxAck;
+
+	ullNaks = 0;
+	for (idxAck=0;idxAck<PID2_ACK_COUNT;idxAck++) {
+		if ((idxAck != PID2_ACK_OK) && (idxAck != PID2_ACK_OK_ETHERNET_SHARE_REQ) && (idxAck != PID2_ACK_OK_FPGA_UPLOAD_ADDR)) {
+			ullNaks += Command->Acks[idxAck];
+		}
+	}
+	strLine = strName;
+	strLine += strfn.Format(" req=%llu out=%llu in=%llu timeout=%llu usberr=%llu", Command->ullRequests, Command->ullBytesOut, Command->ullBytesIn, Command->ullTimeouts, Command->ullUsbErrors);
+	strLine += strfn.Format(" sync=%llu len=%llu csum=%llu pid=%llu ack=%llu nak=%llu", Command->ullSyncErrors, Command->ullLenErrors, Command->ullChecksumErrors, Command->ullPidErrors, Command->Acks[PID2_ACK_OK], ullNaks);
+	if (Command->Latency.ullTotalCount > 0) {
+		strLine += strfn.Format(" us(min/p50/p99/max)=%llu/%llu/%llu/%llu", Command->Latency.ullMinUs, GetPercentile(&Command->Latency, 50.0), GetPercentile(&Command->Latency, 99.0), Command->Latency.ullMaxUs);
+	}
+	for (idxAck=0;idxAck<PID2_ACK_COUNT;idxAck++) {
+		if ((idxAck != PID2_ACK_OK) && (Command->Acks[idxAck] > 0)) {
+			strLine += strfn.Format(" ack%02X=%llu", idxAck, Command->Acks[idxAck]);
+		}
+	}
+	strLine += "\r\n";
+	return strLine;
+}
+
+string CDppTransportMetrics::MetricsToString(const TRANSPORT_METRICS *Snapshot)
+{
+	stringex strfn;
+	string strMetrics;
+	int idxCmd;
+
+	strMetrics = strfn.Format("Transport metrics (%0.1fs)\r\n", Snapshot->dblElapsed);
+	strMetrics += CommandMetricsToString("total", &Snapshot->Total);
+	for (idxCmd=0;idxCmd<XMTPT_COUNT;idxCmd++) {
+		if (Snapshot->Command[idxCmd].ullRequests > 0) {
+			strMetrics += CommandMetricsToString(strfn.Format("xmtpt%d", idxCmd), &Snapshot->Command[idxCmd]);
+		}
+	}
+	return strMetrics;
+}
+
+bool CDppTransportMetrics::StartDump(string strFilename, long lIntervalMs)
+{
+	if (bDumping || (lIntervalMs <= 0)) {
+		return false;
+	}
+	strDumpFilename = strFilename;
+	lDumpIntervalMs = lIntervalMs;
+	bStopDump = false;
+	bDumping = true;
+	DumpThreadHandle = thread(&CDppTransportMetrics::DumpThread, this);
+	return true;
+}
+
+void CDppTransportMetrics::StopDump()
+{
+	if (! bDumping) {
+		return;
+	}
+	bStopDump = true;
+	if (DumpThreadHandle.joinable()) {
+		DumpThreadHandle.join();
+	}
+	bDumping = false;
+}
+
+void CDppTransportMetrics::DumpThread()
+{
+	TRANSPORT_METRICS *Snapshot;
+	string strMetrics;
+	FILE *txtFile;
+	long lWaitMs;
+
+	Snapshot = new TRANSPORT_METRICS;
+	while (! bStopDump) {
+		for (lWaitMs=0;(lWaitMs<lDumpIntervalMs) && !bStopDump;lWaitMs+=METRICS_DUMP_POLL_MS) {
+			this_thread::sleep_for(chrono::milliseconds(METRICS_DUMP_POLL_MS));
+		}
+		GetSnapshot(Snapshot);
+		strMetrics = MetricsToString(Snapshot);
+		if (strDumpFilename.length() == 0) {
+			cout << strMetrics;
+		} else if ((txtFile = fopen(strDumpFilename.c_str(), "ab")) != NULL) {
+			fwrite(strMetrics.c_str(), 1, strMetrics.length(), txtFile);
+			fclose(txtFile);
+		}
+	}
+	delete Snapshot;
+}
@@ -0,0 +1,105 @@
+/** CDppTransportMetrics CDppTransportMetrics */
+#pragma once
+#include <stdio.h>
+#include <string>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include "DP5Protocol.h"
+using namespace std;
+
+#define XMTPT_COUNT (XMTPT_KEEP_ALIVE_LOCK + 1)					/// number of TRANSMIT_PACKET_TYPE values
+#define PID2_ACK_COUNT (PID2_ACK_CAL_DATA_NOT_PRESENT + 1)		/// number of PID2_ACK_TYPE values
+
+#define LATENCY_SUB_BUCKET_BITS 4		/// 16 sub buckets per power of 2 (6% resolution)
+#define LATENCY_MAGNITUDES 24			/// powers of 2 above the linear range (up to 260s)
+#define LATENCY_BUCKETS ((LATENCY_MAGNITUDES + 1) << LATENCY_SUB_BUCKET_BITS)
+
+#define LIBUSB_TIMEOUT_RESULT (-7)		/// LIBUSB_ERROR_TIMEOUT returned by SendPacketUSB
+
+/// Round trip latency histogram (microseconds), log-linear buckets.
+typedef struct _LATENCY_HISTOGRAM
+{
+	unsigned long long Counts[LATENCY_BUCKETS];
+	unsigned long long ullTotalCount;
+	unsigned long long ullMinUs;
+	unsigned long long ullMaxUs;
+	unsigned long long ullSumUs;
+} LATENCY_HISTOGRAM;
+
+/// Transport counters for one command type.
+typedef struct _COMMAND_METRICS
+{
+	unsigned long long ullRequests;			/// transfers attempted
+	unsigned long long ullBytesOut;			/// request bytes sent
+	unsigned long long ullBytesIn;			/// response bytes received
+	unsigned long long ullTimeouts;			/// transfers timed out
+	unsigned long long ullUsbErrors;		/// other transfer errors
+	unsigned long long ullSyncErrors;		/// response sync errors (ParsePacketStatus)
+	unsigned long long ullLenErrors;		/// response length errors (ParsePacketStatus)
+	unsigned long long ullChecksumErrors;	/// response checksum errors (ParsePacketStatus)
+	unsigned long long ullPidErrors;		/// unknown response PIDs
+	unsigned long long Acks[PID2_ACK_COUNT];	/// acknowledge packets by PID2_ACK_TYPE (PID2_ACK_OK or NAK)
+	LATENCY_HISTOGRAM Latency;				/// completed transfer round trip times
+} COMMAND_METRICS;
+
+/// Snapshot of all transport counters.
+typedef struct _TRANSPORT_METRICS
+{
+	double dblElapsed;						/// seconds since start or last reset
+	COMMAND_METRICS Total;					/// all commands
+	COMMAND_METRICS Command[XMTPT_COUNT];	/// by TRANSMIT_PACKET_TYPE
+} TRANSPORT_METRICS;
+
+/** CDppTransportMetrics counts USB transfers by command type.
+	The communications code records every transfer and parsed response,
+	snapshots can be taken from any thread, an optional dump thread writes
+	the counters periodically.
+*/
+class CDppTransportMetrics
+{
+public:
+	CDppTransportMetrics(void);
+	~CDppTransportMetrics(void);
+
+	/// Records a transfer, iResult is the SendPacketUSB result (bytes in or error).
+	void RecordTransfer(TRANSMIT_PACKET_TYPE XmtCmd, long lBytesOut, int iResult, unsigned long long ullLatencyUs);
+	/// Records a parsed response (ParsePacket result and packet status).
+	void RecordResponse(TRANSMIT_PACKET_TYPE XmtCmd, long ReqProcess, const Packet_In *PIN);
+	/// Copies all counters.
+	void GetSnapshot(TRANSPORT_METRICS *Snapshot);
+	/// Clears all counters.
+	void Reset();
+
+	/// Returns the latency (us) at a percentile (0-100).
+	unsigned long long GetPercentile(const LATENCY_HISTOGRAM *Histogram, double dblPercent);
+	/// Formats the commands that have transfers, one line each.
+	string MetricsToString(const TRANSPORT_METRICS *Snapshot);
+
+	/// Starts writing the metrics every lIntervalMs to a file (appends), empty filename writes to cout.
+	bool StartDump(string strFilename, long lIntervalMs);
+	/// Stops the periodic dump.
+	void StopDump();
+
+	/// Returns a steady clock time in microseconds for latency measurement.
+	unsigned long long GetTimeUs();
+
+private:
+	/// Returns the histogram bucket of a latency.
+	int LatencyToBucket(unsigned long long ullLatencyUs);
+	/// Returns the lowest latency of a histogram bucket.
+	unsigned long long BucketToLatency(int idxBucket);
+	/// Formats one command line.
+	string CommandMetricsToString(string strName, const COMMAND_METRICS *Command);
+	/// Dump thread.
+	void DumpThread();
+
+	mutex MetricsLock;
+	TRANSPORT_METRICS *Metrics;		/// counters (large, heap allocated)
+	unsigned long long ullTimeStartUs;
+	string strDumpFilename;
+	long lDumpIntervalMs;
+	atomic<bool> bDumping;
+	atomic<bool> bStopDump;
+	thread DumpThreadHandle;
+};
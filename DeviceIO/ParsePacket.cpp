@@ -1,4 +1,5 @@
 #include "ParsePacket.h"
+#include "DppTrace.h"
 
 CParsePacket::CParsePacket(void)
 {
@@ -132,6 +133,7 @@ string CParsePacket::PID2_TextToString(string strPacketSource, unsigned char PID
 
 long CParsePacket::ParsePacket(unsigned char P[], Packet_In *PIN)
 {
+	DPP_TRACE_SPAN("frame_validate");
 	long ParsePkt;
     ParsePkt = preqProcessNone;
     ParsePacketStatus (P, PIN);
@@ -1,5 +1,6 @@
 #include "SendCommand.h"
 #include "stringex.h"
+#include "DppTrace.h"
 
 CSendCommand::CSendCommand(void)
 {
@@ -41,6 +42,7 @@ bool CSendCommand::TestPacketCkSumOK(unsigned char Data[])
 
 bool CSendCommand::DP5_CMD(unsigned char Buffer[], TRANSMIT_PACKET_TYPE XmtCmd)
 {
+	DPP_TRACE_SPAN("cmd_build", XmtCmd);
     bool bCmdFound;
     string D;
     Packet_Out POUT; 
@@ -326,6 +328,7 @@ bool CSendCommand::DP5_CMD(unsigned char Buffer[], TRANSMIT_PACKET_TYPE XmtCmd)
 //		XMTPT_READ_CONFIG_PACKET_EX
 bool CSendCommand::DP5_CMD_Config(unsigned char Buffer[], TRANSMIT_PACKET_TYPE XmtCmd, CONFIG_OPTIONS CfgOptions)
 {
+	DPP_TRACE_SPAN("cmd_build", XmtCmd);
     bool bCmdFound;
     string D;
     Packet_Out POUT; 
@@ -333,6 +336,7 @@ bool CSendCommand::DP5_CMD_Config(unsigned char Buffer[], TRANSMIT_PACKET_TYPE X
     POUT.LEN = 0;
 	string strCfg;
 	long lLen;
+	DppCmdMask LegalCmds;
 
 	switch (XmtCmd) {
 		case XMTPT_TEXT_CONFIGURATION_MX2:           // bypass any filters
@@ -358,13 +362,14 @@ bool CSendCommand::DP5_CMD_Config(unsigned char Buffer[], TRANSMIT_PACKET_TYPE X
 			strCfg = "";
 			strCfg = CfgOptions.HwCfgDP5Out;
 
+			// gain selection and device type filters are applied in one pass
+			LegalCmds = AsciiCmdUtil.GetDeviceCmdMask(CfgOptions.PC5_PRESENT, CfgOptions.DppType, CfgOptions.isDP5_RevDxGains, CfgOptions.DPP_ECO);
 			if (CfgOptions.SendCoarseFineGain) {
-				strCfg = AsciiCmdUtil.RemoveCmd("GAIN",strCfg);
+				LegalCmds &= ~DPP_CMD_BIT(fcGAIN);
 			} else {
-				strCfg = AsciiCmdUtil.RemoveCmd("GAIA",strCfg);
-				strCfg = AsciiCmdUtil.RemoveCmd("GAIF",strCfg);
+				LegalCmds &= ~(DPP_CMD_BIT(fcGAIA) | DPP_CMD_BIT(fcGAIF));
 			}
-			strCfg = AsciiCmdUtil.RemoveCmdByDeviceType(strCfg, CfgOptions.PC5_PRESENT, CfgOptions.DppType, CfgOptions.isDP5_RevDxGains, CfgOptions.DPP_ECO);
+			strCfg = AsciiCmdUtil.FilterCmdsByMask(strCfg, LegalCmds);
 			lLen = (long)strCfg.length();
 			if (lLen > 0) {
 				strCfg = AsciiCmdUtil.MakeUpper(strCfg);
@@ -471,6 +476,7 @@ bool CSendCommand::DP5_CMD_Config(unsigned char Buffer[], TRANSMIT_PACKET_TYPE X
 //move send packet to separate function
 bool CSendCommand::DP5_CMD_Data(unsigned char Buffer[], TRANSMIT_PACKET_TYPE XmtCmd, unsigned char DataOut[])
 {
+	DPP_TRACE_SPAN("cmd_build", XmtCmd);
     bool bCmdFound;
     short idxMiscData;
     Packet_Out POUT; 
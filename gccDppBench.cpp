@@ -0,0 +1,328 @@
+/** gccDppBench.cpp */
+
+// gccDppBench.cpp : Timing harness for the host-side processing paths (no device needed).
+#include <iostream>
+#include <string.h>
+#include <chrono>
+#include <vector>
+#include <random>
+using namespace std;
+#include "AsciiCmdUtilities.h"
+#include "DP5Status.h"
+#include "DppStatusDecoder.h"
+#include "DppUtilities.h"
+
+// seconds per call of a function, repeated until at least dblMinSeconds have passed
+template <class Function> static double TimeCall(Function Call, double dblMinSeconds)
+{
+	chrono::steady_clock::time_point tStart;
+	double dblSeconds;
+	long lCalls;
+
+	lCalls = 0;
+	tStart = chrono::steady_clock::now();
+	do {
+		Call();
+		lCalls++;
+		dblSeconds = chrono::duration<double>(chrono::steady_clock::now() - tStart).count();
+	} while (dblSeconds < dblMinSeconds);
+	return dblSeconds / lCalls;
+}
+
+// ReplaceCmdText as it was before the rewriter (substr concatenation per match)
+static string BaselineReplaceCmdText(string strInTextIn, string strFrom, string strTo)
+{
+	string strInText;
+	string strOutText;
+	int lFromLen;
+	int lMatchPos;
+
+	strInText = strInTextIn;
+	strOutText = "";
+	lFromLen = (int)strFrom.length();
+	while (strInText.length()>0) {
+		lMatchPos = (1+(int)strInText.find(strFrom));
+		if (lMatchPos==0) {
+			strOutText = strOutText+strInText;
+			strInText = "";
+		} else {
+			strOutText = strOutText+strInText.substr(0,lMatchPos-1)+strTo;
+			strInText = std::string(strInText).substr(lMatchPos+lFromLen-1);
+		}
+	}
+	return strOutText;
+}
+
+// SCA-heavy configuration of about lBytes, with every shortening rule and chained matches
+static string MakeScaConfig(long lBytes)
+{
+	string strCfg;
+	char Cmd[128];
+	int idxSca;
+
+	strCfg = "RESC=Y;TPEA=25.6US;TFLA=0.2US;PURE=OFF;RTDE=OFF;GATE=OFF;";
+	while ((long)strCfg.length() < lBytes) {
+		for (idxSca=1;idxSca<=16;idxSca++) {
+			snprintf(Cmd, sizeof(Cmd), "SCAI=%d;SCAL=%d;SCAH=%d;SCAO=OFF;SCAW=100US;SCOE=RISING;GPED=FALLING;AUO1=OFFUS;", idxSca, idxSca * 100, idxSca * 100 + 50);
+			strCfg += Cmd;
+		}
+	}
+	return strCfg;
+}
+
+// four ReplaceCmdText passes (baseline and current) against the one pass RewriteCmdText
+static bool BenchCfgRewrite(long lBytes)
+{
+	static const CFG_REWRITE_RULE Rules[] = {
+		{ "US;", ";" },
+		{ "OFF;", "OF;" },
+		{ "RISING;", "RI;" },
+		{ "FALLING;", "FA;" }
+	};
+	const int iNumRules = (int)(sizeof(Rules) / sizeof(Rules[0]));
+	CAsciiCmdUtilities AsciiCmdUtil;
+	string strCfg;
+	string strBaseline;
+	string strReplace;
+	string strRewrite;
+	double dblBaseline;
+	double dblReplace;
+	double dblRewrite;
+	int idxRule;
+
+	strCfg = MakeScaConfig(lBytes);
+	dblBaseline = TimeCall([&]() {
+		strBaseline = strCfg;
+		for (idxRule=0;idxRule<iNumRules;idxRule++) {
+			strBaseline = BaselineReplaceCmdText(strBaseline, Rules[idxRule].strFrom, Rules[idxRule].strTo);
+		}
+	}, 0.5);
+	dblReplace = TimeCall([&]() {
+		strReplace = strCfg;
+		for (idxRule=0;idxRule<iNumRules;idxRule++) {
+			strReplace = AsciiCmdUtil.ReplaceCmdText(strReplace, Rules[idxRule].strFrom, Rules[idxRule].strTo);
+		}
+	}, 0.5);
+	dblRewrite = TimeCall([&]() { strRewrite = AsciiCmdUtil.RewriteCmdText(strCfg, Rules, iNumRules); }, 0.5);
+	cout << "cfg rewrite, " << strCfg.length() << " bytes -> " << strRewrite.length() << endl;
+	cout << "  baseline ReplaceCmdText x" << iNumRules << ": " << dblBaseline * 1.0e3 << " ms" << endl;
+	cout << "  ReplaceCmdText x" << iNumRules << ":          " << dblReplace * 1.0e3 << " ms" << endl;
+	cout << "  RewriteCmdText:             " << dblRewrite * 1.0e3 << " ms" << endl;
+	if ((strRewrite != strBaseline) || (strReplace != strBaseline)) {
+		cout << "  MISMATCH with the sequential replacement" << endl;
+		return false;
+	}
+	return true;
+}
+
+// CDP5Status::Process_Status as it was before the status decoder (per field byte arithmetic)
+static void BaselineProcessStatus(DP4_FORMAT_STATUS *m_DP5_Status)
+{
+	CDppUtilities DppUtil;
+	bool bDMCA_LiveTime = false;
+	unsigned int uiFwBuild = 0;
+
+	m_DP5_Status->DEVICE_ID = m_DP5_Status->RAW[39];
+	m_DP5_Status->FastCount = DppUtil.LongWordToDouble(0, m_DP5_Status->RAW);
+	m_DP5_Status->SlowCount = DppUtil.LongWordToDouble(4, m_DP5_Status->RAW);
+	m_DP5_Status->GP_COUNTER = DppUtil.LongWordToDouble(8, m_DP5_Status->RAW);
+	m_DP5_Status->AccumulationTime = (float)m_DP5_Status->RAW[12] * 0.001 + (float)(m_DP5_Status->RAW[13] + (float)m_DP5_Status->RAW[14] * 256.0 + (float)m_DP5_Status->RAW[15] * 65536.0) * 0.1;
+	m_DP5_Status->RealTime = ((double)m_DP5_Status->RAW[20] + ((double)m_DP5_Status->RAW[21] * 256.0) + ((double)m_DP5_Status->RAW[22] * 65536.0) + ((double)m_DP5_Status->RAW[23] * 16777216.0)) * 0.001;
+	m_DP5_Status->Firmware = m_DP5_Status->RAW[24];
+	m_DP5_Status->FPGA = m_DP5_Status->RAW[25];
+	if (m_DP5_Status->Firmware > 0x65) {
+		m_DP5_Status->Build = m_DP5_Status->RAW[37] & 0xF;
+	} else {
+		m_DP5_Status->Build = 0;
+	}
+	if (m_DP5_Status->DEVICE_ID == dppMCA8000D) {
+		if (m_DP5_Status->Firmware >= 0x67) {
+			bDMCA_LiveTime = true;
+		}
+	}
+	if (bDMCA_LiveTime) {
+		m_DP5_Status->LiveTime = ((double)m_DP5_Status->RAW[16] + ((double)m_DP5_Status->RAW[17] * 256.0) + ((double)m_DP5_Status->RAW[18] * 65536.0) + ((double)m_DP5_Status->RAW[19] * 16777216.0)) * 0.001;
+	} else {
+		m_DP5_Status->LiveTime = 0;
+	}
+	if (m_DP5_Status->RAW[29] < 128) {
+		m_DP5_Status->SerialNumber = (unsigned long)DppUtil.LongWordToDouble(26, m_DP5_Status->RAW);
+	} else {
+		m_DP5_Status->SerialNumber = -1;
+	}
+	if (m_DP5_Status->RAW[30] < 128)  {
+		m_DP5_Status->HV = ((double)m_DP5_Status->RAW[31] + ((double)m_DP5_Status->RAW[30] * 256.0)) * 0.5;
+	} else {
+		m_DP5_Status->HV = (((double)m_DP5_Status->RAW[31] + ((double)m_DP5_Status->RAW[30] * 256)) - 65536.0) * 0.5;
+	}
+	m_DP5_Status->DET_TEMP = (double)((m_DP5_Status->RAW[33]) + (m_DP5_Status->RAW[32] & 15) * 256) * 0.1;
+	m_DP5_Status->DP5_TEMP = m_DP5_Status->RAW[34] - ((m_DP5_Status->RAW[34] & 128) * 2);
+	m_DP5_Status->PresetRtDone = ((m_DP5_Status->RAW[35] & 128) == 128);
+	m_DP5_Status->PresetLtDone = false;
+	m_DP5_Status->AFAST_LOCKED = false;
+	if (bDMCA_LiveTime) {
+		m_DP5_Status->PresetLtDone = ((m_DP5_Status->RAW[35] & 64) == 64);
+	} else {
+		m_DP5_Status->AFAST_LOCKED = ((m_DP5_Status->RAW[35] & 64) == 64);
+	}
+	m_DP5_Status->MCA_EN = ((m_DP5_Status->RAW[35] & 32) == 32);
+	m_DP5_Status->PRECNT_REACHED = ((m_DP5_Status->RAW[35] & 16) == 16);
+	m_DP5_Status->SCOPE_DR = ((m_DP5_Status->RAW[35] & 4) == 4);
+	m_DP5_Status->DP5_CONFIGURED = ((m_DP5_Status->RAW[35] & 2) == 2);
+	m_DP5_Status->AOFFSET_LOCKED = ((m_DP5_Status->RAW[36] & 128) == 0);
+	m_DP5_Status->MCS_DONE = ((m_DP5_Status->RAW[36] & 64) == 64);
+	m_DP5_Status->b80MHzMode = ((m_DP5_Status->RAW[36] & 2) == 2);
+	m_DP5_Status->bFPGAAutoClock = ((m_DP5_Status->RAW[36] & 1) == 1);
+	m_DP5_Status->PC5_PRESENT = ((m_DP5_Status->RAW[38] & 128) == 128);
+	if  (m_DP5_Status->PC5_PRESENT) {
+		m_DP5_Status->PC5_HV_POL = ((m_DP5_Status->RAW[38] & 64) == 64);
+		m_DP5_Status->PC5_8_5V = ((m_DP5_Status->RAW[38] & 32) == 32);
+	} else {
+		m_DP5_Status->PC5_HV_POL = false;
+		m_DP5_Status->PC5_8_5V = false;
+	}
+	m_DP5_Status->ReBootFlag = (m_DP5_Status->Firmware >= 0x65) && ((m_DP5_Status->RAW[36] & 32) == 32);
+	m_DP5_Status->TEC_Voltage = (((double)(m_DP5_Status->RAW[40] & 15) * 256.0) + (double)(m_DP5_Status->RAW[41])) / 758.5;
+	m_DP5_Status->DPP_ECO = m_DP5_Status->RAW[49];
+	m_DP5_Status->bScintHas80MHzOption = false;
+	m_DP5_Status->DPP_options = (m_DP5_Status->RAW[42] & 15);
+	m_DP5_Status->HPGe_HV_INH = false;
+	m_DP5_Status->HPGe_HV_INH_POL = false;
+	m_DP5_Status->AU34_2 = false;
+	m_DP5_Status->isAscInstalled = false;
+	m_DP5_Status->isDP5_RevDxGains = false;
+	if (m_DP5_Status->DEVICE_ID == dppPX5) {
+		if (m_DP5_Status->DPP_options == PX5_OPTION_HPGe_HVPS) {
+			m_DP5_Status->HPGe_HV_INH = ((m_DP5_Status->RAW[42] & 32) == 32);
+			m_DP5_Status->HPGe_HV_INH_POL = ((m_DP5_Status->RAW[42] & 16) == 16);
+			if (m_DP5_Status->DPP_ECO == 1) {
+				m_DP5_Status->isAscInstalled = true;
+				m_DP5_Status->AU34_2 = ((m_DP5_Status->RAW[42] & 64) == 64);
+			}
+		}
+	} else if ((m_DP5_Status->DEVICE_ID == dppDP5G) || (m_DP5_Status->DEVICE_ID == dppTB5)) {
+		if ((m_DP5_Status->DPP_ECO == 1) || (m_DP5_Status->DPP_ECO == 2)) {
+			m_DP5_Status->bScintHas80MHzOption = true;
+		}
+	} else if (m_DP5_Status->DEVICE_ID == dppDP5) {
+		uiFwBuild = m_DP5_Status->Firmware;
+		uiFwBuild = uiFwBuild << 8;
+		uiFwBuild = uiFwBuild + m_DP5_Status->Build;
+		if ((uiFwBuild >= 0x686) && (m_DP5_Status->DPP_ECO < 0xFF)) {
+			m_DP5_Status->isDP5_RevDxGains = true;
+		}
+	}
+}
+
+// true if every value set by Process_Status is the same
+static bool SameStatus(const DP4_FORMAT_STATUS &A, const DP4_FORMAT_STATUS &B)
+{
+	return (A.DEVICE_ID == B.DEVICE_ID) && (A.FastCount == B.FastCount) && (A.SlowCount == B.SlowCount) &&
+		(A.GP_COUNTER == B.GP_COUNTER) && (A.AccumulationTime == B.AccumulationTime) && (A.RealTime == B.RealTime) &&
+		(A.Firmware == B.Firmware) && (A.FPGA == B.FPGA) && (A.Build == B.Build) && (A.LiveTime == B.LiveTime) &&
+		(A.SerialNumber == B.SerialNumber) && (A.HV == B.HV) && (A.DET_TEMP == B.DET_TEMP) && (A.DP5_TEMP == B.DP5_TEMP) &&
+		(A.PresetRtDone == B.PresetRtDone) && (A.PresetLtDone == B.PresetLtDone) && (A.AFAST_LOCKED == B.AFAST_LOCKED) &&
+		(A.MCA_EN == B.MCA_EN) && (A.PRECNT_REACHED == B.PRECNT_REACHED) && (A.SCOPE_DR == B.SCOPE_DR) &&
+		(A.DP5_CONFIGURED == B.DP5_CONFIGURED) && (A.AOFFSET_LOCKED == B.AOFFSET_LOCKED) && (A.MCS_DONE == B.MCS_DONE) &&
+		(A.b80MHzMode == B.b80MHzMode) && (A.bFPGAAutoClock == B.bFPGAAutoClock) && (A.PC5_PRESENT == B.PC5_PRESENT) &&
+		(A.PC5_HV_POL == B.PC5_HV_POL) && (A.PC5_8_5V == B.PC5_8_5V) && (A.ReBootFlag == B.ReBootFlag) &&
+		(A.TEC_Voltage == B.TEC_Voltage) && (A.DPP_ECO == B.DPP_ECO) && (A.bScintHas80MHzOption == B.bScintHas80MHzOption) &&
+		(A.DPP_options == B.DPP_options) && (A.HPGe_HV_INH == B.HPGe_HV_INH) && (A.HPGe_HV_INH_POL == B.HPGe_HV_INH_POL) &&
+		(A.AU34_2 == B.AU34_2) && (A.isAscInstalled == B.isAscInstalled) && (A.isDP5_RevDxGains == B.isDP5_RevDxGains);
+}
+
+// baseline and current Process_Status against the decoder, per status and on archived records
+static bool BenchStatusDecode(long lRecords)
+{
+	CDP5Status DP5Stat;
+	CDppStatusDecoder StatusDecoder;
+	vector<unsigned char> vRecords(lRecords * DPP_STATUS_SIZE);
+	vector<DPP_STATUS_DECODED> vDecoded(lRecords);
+	DP4_FORMAT_STATUS BaselineStatus;
+	DP4_FORMAT_STATUS CurrentStatus;
+	mt19937 Random(31);
+	double dblBaseline;
+	double dblCurrent;
+	double dblDecode;
+	double dblRecords;
+	long idxRecord;
+	long lMismatch;
+	int idxByte;
+
+	// random statuses across device types and the firmware gates
+	for (idxRecord=0;idxRecord<lRecords;idxRecord++) {
+		for (idxByte=0;idxByte<DPP_STATUS_SIZE;idxByte++) {
+			vRecords[idxRecord * DPP_STATUS_SIZE + idxByte] = (unsigned char)Random();
+		}
+		vRecords[idxRecord * DPP_STATUS_SIZE + 24] = (unsigned char)(0x60 + Random() % 0x30);
+		vRecords[idxRecord * DPP_STATUS_SIZE + 39] = (unsigned char)(Random() % 6);
+	}
+	lMismatch = 0;
+	memset(&BaselineStatus, 0, sizeof(BaselineStatus));
+	memset(&CurrentStatus, 0, sizeof(CurrentStatus));
+	for (idxRecord=0;idxRecord<lRecords;idxRecord++) {
+		memcpy(BaselineStatus.RAW, &vRecords[idxRecord * DPP_STATUS_SIZE], DPP_STATUS_SIZE);
+		memcpy(CurrentStatus.RAW, &vRecords[idxRecord * DPP_STATUS_SIZE], DPP_STATUS_SIZE);
+		BaselineProcessStatus(&BaselineStatus);
+		DP5Stat.Process_Status(&CurrentStatus);
+		lMismatch += ! SameStatus(BaselineStatus, CurrentStatus);
+	}
+	dblBaseline = TimeCall([&]() {
+		for (idxRecord=0;idxRecord<lRecords;idxRecord++) {
+			memcpy(BaselineStatus.RAW, &vRecords[idxRecord * DPP_STATUS_SIZE], DPP_STATUS_SIZE);
+			BaselineProcessStatus(&BaselineStatus);
+		}
+	}, 0.5);
+	dblCurrent = TimeCall([&]() {
+		for (idxRecord=0;idxRecord<lRecords;idxRecord++) {
+			memcpy(CurrentStatus.RAW, &vRecords[idxRecord * DPP_STATUS_SIZE], DPP_STATUS_SIZE);
+			DP5Stat.Process_Status(&CurrentStatus);
+		}
+	}, 0.5);
+	dblDecode = TimeCall([&]() {
+		for (idxRecord=0;idxRecord<lRecords;idxRecord++) {
+			StatusDecoder.DecodeStatus(&vRecords[idxRecord * DPP_STATUS_SIZE], &vDecoded[0]);
+		}
+	}, 0.5);
+	dblRecords = TimeCall([&]() { StatusDecoder.DecodeStatusRecords(&vRecords[0], lRecords, DPP_STATUS_SIZE, &vDecoded[0]); }, 0.5);
+	cout << "status decode, " << lRecords << " records" << endl;
+	cout << "  baseline Process_Status: " << lRecords / dblBaseline * 1.0e-6 << " M/s" << endl;
+	cout << "  Process_Status:          " << lRecords / dblCurrent * 1.0e-6 << " M/s" << endl;
+	cout << "  DecodeStatus:            " << lRecords / dblDecode * 1.0e-6 << " M/s" << endl;
+	cout << "  DecodeStatusRecords:     " << lRecords / dblRecords * 1.0e-6 << " M/s" << endl;
+	if (lMismatch > 0) {
+		cout << "  MISMATCH with the baseline Process_Status: " << lMismatch << " records" << endl;
+		return false;
+	}
+	return true;
+}
+
+static void ShowUsage()
+{
+	cout << "Usage: gccDppBench [cfg|status]" << endl;
+	cout << "  cfg     configuration value rewriter on SCA-heavy configurations" << endl;
+	cout << "  status  status decoding on random DP4 format status records" << endl;
+	cout << "  (no argument runs every benchmark)" << endl;
+}
+
+int main(int argc, char* argv[])
+{
+	bool bAll;
+	bool bPassed;
+
+	if ((argc > 2) || ((argc == 2) && (strcmp(argv[1], "cfg") != 0) && (strcmp(argv[1], "status") != 0))) {
+		ShowUsage();
+		return 2;
+	}
+	bAll = (argc == 1);
+	bPassed = true;
+	if (bAll || (strcmp(argv[1], "cfg") == 0)) {
+		bPassed = BenchCfgRewrite(16 * 1024) && bPassed;
+		bPassed = BenchCfgRewrite(128 * 1024) && bPassed;
+	}
+	if (bAll || (strcmp(argv[1], "status") == 0)) {
+		bPassed = BenchStatusDecode(1000) && bPassed;
+		bPassed = BenchStatusDecode(100000) && bPassed;
+	}
+	return (bPassed ? 0 : 1);
+}
@@ -0,0 +1,97 @@
+# Makefile - gccDppBench (time with CFG=Release)
+
+ifndef CFG
+CFG=Debug
+endif
+CC=gcc
+CFLAGS=-m32 
+CXX=g++
+CXXFLAGS=$(CFLAGS)
+ifeq "$(CFG)" "Debug"
+CFLAGS+=  -W -I./ -O0 -fexceptions -I../gccDppConsoleLinux/DeviceIO/ -I../gccDppConsoleLinux/ -g -fno-inline -D_DEBUG -D_CONSOLE 
+LD=$(CXX) $(CXXFLAGS)
+LDFLAGS=
+LDFLAGS+= 
+LIBS+= -pthread
+ifndef TARGET
+TARGET=gccDppBench
+endif
+endif
+ifeq "$(CFG)" "Release"
+CFLAGS+=  -W -I./ -O2 -fexceptions -I../gccDppConsoleLinux/DeviceIO/ -I../gccDppConsoleLinux/ -g  -fno-inline   -DNDEBUG -D_CONSOLE 
+LD=$(CXX) $(CXXFLAGS)
+LDFLAGS=
+LDFLAGS+= 
+LIBS+= -pthread
+ifndef TARGET
+TARGET=gccDppBench
+endif
+endif
+ifndef TARGET
+TARGET=gccDppBench
+endif
+.PHONY: all
+all: $(TARGET)
+
+%.o: %.c
+	$(CC) $(CFLAGS) $(CPPFLAGS) -o $@ -c $<
+
+%.o: %.cc
+	$(CXX) $(CXXFLAGS) $(CPPFLAGS) -c $<
+
+%.o: %.cpp
+	$(CXX) $(CXXFLAGS) $(CPPFLAGS) -c $<
+
+%.o: %.cxx
+	$(CXX) $(CXXFLAGS) $(CPPFLAGS) -c $<
+
+%.res: %.rc
+	$(RC) $(CPPFLAGS) -o $@ -i $<
+
+SOURCE_FILES= \
+	./DeviceIO/AsciiCmdUtilities.cpp \
+	./DeviceIO/DP5Status.cpp \
+	./DeviceIO/DppStatusDecoder.cpp \
+	./DeviceIO/DppTrace.cpp \
+	./DeviceIO/DppUtilities.cpp \
+	./stringex.cpp \
+	./gccDppBench.cpp
+
+HEADER_FILES= \
+	./DeviceIO/AsciiCmdUtilities.h \
+	./DeviceIO/DP5Status.h \
+	./DeviceIO/DppStatusDecoder.h \
+	./DeviceIO/DppTrace.h \
+	./DeviceIO/DppUtilities.h \
+	./DeviceIO/DP5Protocol.h \
+	./DeviceIO/DppConst.h \
+	./stringex.h
+
+OBJ_FILES= \
+	./AsciiCmdUtilities.o \
+	./DP5Status.o \
+	./DppStatusDecoder.o \
+	./DppTrace.o \
+	./DppUtilities.o \
+	./stringex.o \
+	./gccDppBench.o 
+
+RESOURCE_FILES= \
+
+SRCS=$(SOURCE_FILES) $(HEADER_FILES) $(RESOURCE_FILES) 
+
+OBJS=$(patsubst %.rc,%.res,$(patsubst %.cxx,%.o,$(patsubst %.cpp,%.o,$(patsubst %.cc,%.o,$(patsubst %.c,%.o,$(filter %.c %.cc %.cpp %.cxx %.rc,$(SRCS)))))))
+
+$(TARGET): $(OBJS)
+	$(LD) $(LDFLAGS) -o $@ $(OBJ_FILES) $(LIBS)
+
+.PHONY: clean
+clean:
+	-rm -f -v $(OBJS) $(TARGET) gccDppBench.dep
+
+.PHONY: depends
+depends:
+	-$(CXX) $(CXXFLAGS) $(CPPFLAGS) -MM $(filter %.c %.cc %.cpp %.cxx,$(SRCS)) > gccDppBench.dep
+
+-include gccDppBench.dep
+
@@ -4,6 +4,9 @@
 #include <iostream>
 using namespace std; 
 #include "ConsoleHelper.h"
+#include "DppCfgValidator.h"
+#include "DppSpectrumCodec.h"
+#include "DppMcaConverter.h"
 #include "stringex.h"
 
 #ifdef _WIN32
@@ -19,12 +22,19 @@ using namespace std;
 
 
 CConsoleHelper chdpp;					// DPP communications functions
+CDppCfgValidator CfgValidator;			// offline configuration validator
 bool bRunSpectrumTest = false;			// run spectrum test
 bool bRunConfigurationTest = false;		// run configuration test
 bool bHaveStatusResponse = false;		// have status response
 bool bHaveConfigFromHW = false;			// have configuration from hardware
 bool bTubeOn = false;
 
+// console text of the exports, queued to the log sink, which keeps its order with the log messages
+static CDppLogText ConsoleOut()
+{
+	return CDppLogText();
+}
+
 
 extern "C" {
 	// Counts the number of DPP devices - Only run this if no devices are connected.
@@ -41,7 +51,7 @@ extern "C" {
 		if (chdpp.LibUsb_Connect_Specific_DPP(NumDevice)) {
 			return true;
 		} else {
-			cout << "\t\tNo LibUsb DPP device present." << endl;
+			ConsoleOut() << "\t\tNo LibUsb DPP device present." << endl;
 			return false;
 		}
 	}
@@ -53,11 +63,11 @@ extern "C" {
 		if (chdpp.LibUsb_isConnected) {
 			if (chdpp.LibUsb_SendCommand(XMTPT_SEND_STATUS)) {
 				iDeviceType = chdpp.iDeviceType;
-				cout << "Device: " << iDeviceType << endl;
+				ConsoleOut() << "Device: " << iDeviceType << endl;
 				return iDeviceType;
 			} 
 		} 
-		cout << "Can't find Device Type" << endl;
+		ConsoleOut() << "Can't find Device Type" << endl;
 		return iDeviceType;
 	}
 
@@ -68,10 +78,10 @@ extern "C" {
 			if (chdpp.LibUsb_SendCommand(XMTPT_SEND_STATUS)) {	// request status
 				return true;
 			} else {
-				cout << "Error sending status." << endl;
+				ConsoleOut() << "Error sending status." << endl;
 			}
 		} else {
-			cout << "Device Not Connected." << endl;
+			ConsoleOut() << "Device Not Connected." << endl;
 		}
 
 		return false;
@@ -91,10 +101,10 @@ extern "C" {
 				return statusStringCopy.c_str();
 
 			} else {
-				cout << "Error sending status." << endl;
+				ConsoleOut() << "Error sending status." << endl;
 			}
 		} else {
-			cout << "Device Not Connected." << endl;
+			ConsoleOut() << "Device Not Connected." << endl;
 		}
 
 		return "";
@@ -104,14 +114,14 @@ extern "C" {
 	void ReadDppConfigurationFromHardware()
 	{	
 		bool bDisplayCfg=true;
-		cout << "ReadDppConfigFromHdwre" <<endl;
+		DPP_LOG_INFO("cfg", "ReadDppConfigFromHdwre");
 		CONFIG_OPTIONS CfgOptions;
 		
 		//test configuration functions
 		// Set options for XMTPT_FULL_READ_CONFIG_PACKET
 		chdpp.CreateConfigOptions(&CfgOptions, "", chdpp.DP5Stat, false);
-		cout << endl;
-		cout << "\tRequesting Full Configuration..." << endl;
+		DPP_LOG_INFO("cfg", "");
+		DPP_LOG_INFO("cfg", "\tRequesting Full Configuration...");
 		chdpp.ClearConfigReadFormatFlags();	// clear all flags, set flags only for specific readback properties
 		//chdpp.DisplayCfg = false;	// DisplayCfg format overrides general readback format
 		// chdpp.CfgReadBack = true;	// requesting general readback format
@@ -120,14 +130,14 @@ extern "C" {
 				if (chdpp.HwCfgReady) {		// config is ready
 					bHaveConfigFromHW = true;
 					if (bDisplayCfg) {
-						cout << "\t\t\tConfiguration Length: " << (unsigned int)chdpp.HwCfgDP5.length() << endl;
-						cout << "\t================================================================" << endl;
-						cout << chdpp.HwCfgDP5 << endl;
-						cout << "\t================================================================" << endl;
-						cout << "\t\t\tScroll up to see configuration settings." << endl;
-						cout << "\t================================================================" << endl;
+						DPP_LOG_INFO("cfg", "\t\t\tConfiguration Length: %u", (unsigned int)chdpp.HwCfgDP5.length());
+						DPP_LOG_INFO("cfg", "\t================================================================");
+						DPP_LOG_INFO("cfg", "%s", chdpp.HwCfgDP5.c_str());
+						DPP_LOG_INFO("cfg", "\t================================================================");
+						DPP_LOG_INFO("cfg", "\t\t\tScroll up to see configuration settings.");
+						DPP_LOG_INFO("cfg", "\t================================================================");
 					} else {
-						cout << "\t\tFull configuration received." << endl;
+						DPP_LOG_INFO("cfg", "\t\tFull configuration received.");
 					}
 				}
 			}
@@ -142,8 +152,8 @@ extern "C" {
 	void DisplayPresets()
 	{
 		if (bHaveConfigFromHW) {
-			cout << "\t\t\tPreset Mode: " << chdpp.strPresetCmd << endl;
-			cout << "\t\t\tPreset Settings: " << chdpp.strPresetVal << endl;
+			ConsoleOut() << "\t\t\tPreset Mode: " << chdpp.strPresetCmd << endl;
+			ConsoleOut() << "\t\t\tPreset Settings: " << chdpp.strPresetVal << endl;
 		}
 	}
 
@@ -155,7 +165,7 @@ extern "C" {
 	void SendPresetAcquisitionTime(string strPRET)
 	{
 		CONFIG_OPTIONS CfgOptions;
-		cout << "\tSetting Preset Acquisition Time..." << strPRET << endl;
+		ConsoleOut() << "\tSetting Preset Acquisition Time..." << strPRET << endl;
 		chdpp.CreateConfigOptions(&CfgOptions, "", chdpp.DP5Stat, false);
 		CfgOptions.HwCfgDP5Out = strPRET;
 		// send PresetAcquisitionTime string, bypass any filters, read back the mode and settings
@@ -163,7 +173,7 @@ extern "C" {
 			ReadDppConfigurationFromHardware();	// read setting back
 			DisplayPresets();							// display new presets
 		} else {
-			cout << "\t\tPreset Acquisition Time NOT SET" << strPRET << endl;
+			ConsoleOut() << "\t\tPreset Acquisition Time NOT SET" << strPRET << endl;
 		}
 	}
 
@@ -177,13 +187,13 @@ extern "C" {
 
 	bool ResetDevice()
 	{
-		cout << "\t\tDisabling MCA for spectrum data/status clear." << endl;
+		ConsoleOut() << "\t\tDisabling MCA for spectrum data/status clear." << endl;
 		chdpp.LibUsb_SendCommand(XMTPT_DISABLE_MCA_MCS);
 		Sleep(1000);
-		cout << "\t\tClearing spectrum data/status." << endl;
+		ConsoleOut() << "\t\tClearing spectrum data/status." << endl;
 		chdpp.LibUsb_SendCommand(XMTPT_SEND_CLEAR_SPECTRUM_STATUS);
 		Sleep(1000);
-		cout << "\t\tEnabling MCA for spectrum data acquisition with status ." << endl;
+		ConsoleOut() << "\t\tEnabling MCA for spectrum data acquisition with status ." << endl;
 		chdpp.LibUsb_SendCommand(XMTPT_ENABLE_MCA_MCS);
 		Sleep(1000);
 		return true;
@@ -191,7 +201,7 @@ extern "C" {
 
 	bool DisableDevice()
 	{
-		cout << "\t\tDisabling MCA for spectrum data/status clear." << endl;
+		ConsoleOut() << "\t\tDisabling MCA for spectrum data/status clear." << endl;
 		if (chdpp.LibUsb_SendCommand(XMTPT_DISABLE_MCA_MCS)) {
 			return true;
 			}
@@ -202,7 +212,7 @@ extern "C" {
 
 	bool ClearDevice()
 	{
-		cout << "\t\tClearing spectrum data/status." << endl;
+		ConsoleOut() << "\t\tClearing spectrum data/status." << endl;
 		if (chdpp.LibUsb_SendCommand(XMTPT_SEND_CLEAR_SPECTRUM_STATUS)) {
 			return true;
 		}
@@ -212,7 +222,7 @@ extern "C" {
 
 	bool EnableDevice()
 	{
-		cout << "\t\tEnabling MCA for spectrum data acquisition with status ." << endl;
+		ConsoleOut() << "\t\tEnabling MCA for spectrum data acquisition with status ." << endl;
 		if (chdpp.LibUsb_SendCommand(XMTPT_ENABLE_MCA_MCS)) {
 			return true;
 		}
@@ -223,7 +233,7 @@ extern "C" {
 
 	bool DisableMCA()
 	{
-		cout << "\t\tSpectrum acquisition with status done. Disabling MCA." << endl;
+		ConsoleOut() << "\t\tSpectrum acquisition with status done. Disabling MCA." << endl;
 		chdpp.LibUsb_SendCommand(XMTPT_DISABLE_MCA_MCS);
 		return true;
 	} 
@@ -246,7 +256,7 @@ extern "C" {
 					memcpy(TEMP_DATA, chdpp.DP5Proto.SPECTRUM.DATA, sizeof(long) * chdpp.DP5Proto.SPECTRUM.CHANNELS);
 				}
 			} else {
-				cout << "\t\tProblem acquiring spectrum." << endl;
+				ConsoleOut() << "\t\tProblem acquiring spectrum." << endl;
 			}
 
 		return TEMP_DATA;
@@ -257,14 +267,14 @@ extern "C" {
 	{
 		int MaxMCA = 2;
 		bool bDisableMCA;
-		cout << "\tRunning spectrum test..." << endl;
-		cout << "\t\tDisabling MCA for spectrum data/status clear." << endl;
+		ConsoleOut() << "\tRunning spectrum test..." << endl;
+		ConsoleOut() << "\t\tDisabling MCA for spectrum data/status clear." << endl;
 		chdpp.LibUsb_SendCommand(XMTPT_DISABLE_MCA_MCS);
 		Sleep(1000);
-		cout << "\t\tClearing spectrum data/status." << endl;
+		ConsoleOut() << "\t\tClearing spectrum data/status." << endl;
 		chdpp.LibUsb_SendCommand(XMTPT_SEND_CLEAR_SPECTRUM_STATUS);
 		Sleep(1000);
-		cout << "\t\tEnabling MCA for spectrum data acquisition with status ." << endl;
+		ConsoleOut() << "\t\tEnabling MCA for spectrum data acquisition with status ." << endl;
 		chdpp.LibUsb_SendCommand(XMTPT_ENABLE_MCA_MCS);
 		Sleep(1000);
 		for(int idxSpectrum=0;idxSpectrum<MaxMCA;idxSpectrum++) {
@@ -278,7 +288,7 @@ extern "C" {
 					Sleep(2000);
 				}
 			} else {
-				cout << "\t\tProblem acquiring spectrum." << endl;
+				ConsoleOut() << "\t\tProblem acquiring spectrum." << endl;
 				break;
 			}
 		}
@@ -296,10 +306,10 @@ extern "C" {
 	{
 		std::string strCfg;
 		strCfg = chdpp.SndCmd.AsciiCmdUtil.GetDP5CfgStr("PX5_Console_Test.txt");
-		cout << "\t\t\tConfiguration Length: " << (unsigned int)strCfg.length() << endl;
-		cout << "\t================================================================" << endl;
-		cout << strCfg << endl;
-		cout << "\t================================================================" << endl;
+		ConsoleOut() << "\t\t\tConfiguration Length: " << (unsigned int)strCfg.length() << endl;
+		ConsoleOut() << "\t================================================================" << endl;
+		ConsoleOut() << strCfg << endl;
+		ConsoleOut() << "\t================================================================" << endl;
 	}
 
 	//Following is an example of loading a configuration from file 
@@ -315,22 +325,43 @@ extern "C" {
 		if (chdpp.LibUsb_SendCommand_Config(XMTPT_SEND_CONFIG_PACKET_EX, CfgOptions)) {
 			// command sent
 		} else {
-			cout << "\t\tASCII Command String NOT SENT" << strCMD << endl;
+			ConsoleOut() << "\t\tASCII Command String NOT SENT" << strCMD << endl;
 			return false;
 		}
 		return true;
 	}
 
+	// Sends a configuration string and verifies it with one readback of the commands sent.
+	// Returns the number of commands not accepted, -1 if the configuration was not sent or read back.
+	int ApplyConfigVerified(const char* strCfgPy) {
+		CFG_APPLY_RESULT CfgResult;
+		string strCfg(strCfgPy);
+
+		chdpp.LibUsb_ApplyConfig(strCfg, &CfgResult, 0.01);
+		if (! CfgResult.bSent) {
+			ConsoleOut() << "\t\tConfiguration NOT SENT, ACK: " << chdpp.ParsePkt.PID2_TextToString("ACK", CfgResult.AckPID2) << endl;
+			return -1;
+		}
+		if (! CfgResult.bReadBack) {
+			ConsoleOut() << "\t\tConfiguration readback failed" << endl;
+			return -1;
+		}
+		for (size_t idxItem=0;idxItem<CfgResult.Items.size();idxItem++) {
+			if (! CfgResult.Items[idxItem].bMatch) {
+				ConsoleOut() << "\t\t" << CfgResult.Items[idxItem].strCmd << " sent " << CfgResult.Items[idxItem].strSent;
+				ConsoleOut() << " read " << CfgResult.Items[idxItem].strRead << endl;
+			}
+		}
+		return CfgResult.iMismatches;
+	}
+
 	std::string ShortenCfgCmds(std::string strCfgIn) {
 		std::string strCfg("");
 		strCfg = strCfgIn;
 		long lCfgLen=0;						//ASCII Configuration Command String Length
 		lCfgLen = (long)strCfg.length();
 		if (lCfgLen > 0) {		
-			strCfg = chdpp.SndCmd.AsciiCmdUtil.ReplaceCmdText(strCfg, "US;", ";");
-			strCfg = chdpp.SndCmd.AsciiCmdUtil.ReplaceCmdText(strCfg, "OFF;", "OF;");
-			strCfg = chdpp.SndCmd.AsciiCmdUtil.ReplaceCmdText(strCfg, "RISING;", "RI;");
-			strCfg = chdpp.SndCmd.AsciiCmdUtil.ReplaceCmdText(strCfg, "FALLING;", "FA;");
+			strCfg = chdpp.SndCmd.AsciiCmdUtil.ShortenCmdValues(strCfg);
 		}
 		return strCfg;
 	}
@@ -348,6 +379,7 @@ extern "C" {
 		std::string strSplitCfg("");		//Configuration split string second buffer
 		bool isDP5_RevDxGains;
 		unsigned char DPP_ECO;
+		vector<CFG_ERROR> vCfgErrors;		// configuration errors and warnings, checked before sending
 
 		isPC5Present = chdpp.DP5Stat.m_DP5_Status.PC5_PRESENT;
 		// cout << "isPC5Present" << isPC5Present <<endl;
@@ -359,23 +391,32 @@ extern "C" {
 		// cout << DPP_ECO <<endl;
 		strCfg = chdpp.SndCmd.AsciiCmdUtil.GetDP5CfgStr(strFilename);
 		strCfg = chdpp.SndCmd.AsciiCmdUtil.RemoveCmdByDeviceType(strCfg,isPC5Present,DppType,isDP5_RevDxGains,DPP_ECO);
+		if (! CfgValidator.ValidateCfg(strCfg,isPC5Present,DppType,isDP5_RevDxGains,DPP_ECO,&vCfgErrors)) {
+			ConsoleOut() << "\t\t\tConfiguration Errors (" << (vCfgErrors.size() - CfgValidator.CountWarnings(vCfgErrors)) << "), Configuration NOT SENT" << endl;
+			ConsoleOut() << CfgValidator.CfgErrorsToString(vCfgErrors);
+			return false;
+		}
+		if (vCfgErrors.size() > 0) {		// host-side value limits only, the DPP decides
+			ConsoleOut() << "\t\t\tConfiguration Warnings (" << vCfgErrors.size() << ")" << endl;
+			ConsoleOut() << CfgValidator.CfgErrorsToString(vCfgErrors);
+		}
 		lCfgLen = (long)strCfg.length();
 		if ((lCfgLen > 0) && (lCfgLen <= 512)) {		// command length ok
-			cout << "\t\t\tConfiguration Length: " << lCfgLen << endl;
+			ConsoleOut() << "\t\t\tConfiguration Length: " << lCfgLen << endl;
 		} else if (lCfgLen > 512) {	// configuration too large, needs fix
-			cout << "\t\t\tConfiguration Length (Will Shorten): " << lCfgLen << endl;
+			ConsoleOut() << "\t\t\tConfiguration Length (Will Shorten): " << lCfgLen << endl;
 			strCfg = ShortenCfgCmds(strCfg);
 			lCfgLen = (long)strCfg.length();
 			if (lCfgLen > 512) {	// configuration still too large, split config
-				cout << "\t\t\tConfiguration Length (Will Split): " << lCfgLen << endl;
+				ConsoleOut() << "\t\t\tConfiguration Length (Will Split): " << lCfgLen << endl;
 				bSplitCfg = true;
 				idxSplitCfg = chdpp.SndCmd.AsciiCmdUtil.GetCmdChunk(strCfg);
-				cout << "\t\t\tConfiguration Split at: " << idxSplitCfg << endl;
+				ConsoleOut() << "\t\t\tConfiguration Split at: " << idxSplitCfg << endl;
 				strSplitCfg = strCfg.substr(idxSplitCfg);
 				strCfg = strCfg.substr(0, idxSplitCfg);
 			}
 		} else {
-			cout << "\t\t\tConfiguration Length Error: " << lCfgLen << endl;
+			ConsoleOut() << "\t\t\tConfiguration Length Error: " << lCfgLen << endl;
 			return false;
 		}
 		bCommandSent = SendCommandString(strCfg);
@@ -386,12 +427,261 @@ extern "C" {
 		return bCommandSent;
 	}
 
+	// Validates a configuration file against a device profile, prints every error and warning, returns the error count (warnings excluded).
+	int ValidateConfigFile(const char* strFilenamePy, bool PC5_PRESENT, int DppType, bool isDP5_RevDxGains, unsigned char DPP_ECO)
+	{
+		vector<CFG_ERROR> vCfgErrors;
+		string strFilename(strFilenamePy);
+
+		long lWarnings;
+
+		CfgValidator.ValidateCfgFile(strFilename, PC5_PRESENT, DppType, isDP5_RevDxGains, DPP_ECO, &vCfgErrors);
+		lWarnings = CfgValidator.CountWarnings(vCfgErrors);
+		ConsoleOut() << CfgValidator.CfgErrorsToString(vCfgErrors);
+		ConsoleOut() << strFilename << ": " << (vCfgErrors.size() - lWarnings) << " error(s), " << lWarnings << " warning(s)" << endl;
+		return (int)(vCfgErrors.size() - lWarnings);
+	}
+
+	// Validates every configuration file (.txt,.cfg) in a recipe directory, returns the error count (warnings excluded).
+	int ValidateConfigDirectory(const char* strDirectoryPy, bool PC5_PRESENT, int DppType, bool isDP5_RevDxGains, unsigned char DPP_ECO)
+	{
+		vector<CFG_ERROR> vCfgErrors;
+		string strDirectory(strDirectoryPy);
+		long lNumFiles;
+		long lWarnings;
+
+		lNumFiles = CfgValidator.ValidateCfgDirectory(strDirectory, PC5_PRESENT, DppType, isDP5_RevDxGains, DPP_ECO, &vCfgErrors);
+		lWarnings = CfgValidator.CountWarnings(vCfgErrors);
+		ConsoleOut() << CfgValidator.CfgErrorsToString(vCfgErrors);
+		ConsoleOut() << strDirectory << ": " << lNumFiles << " file(s), " << (vCfgErrors.size() - lWarnings) << " error(s), " << lWarnings << " warning(s)" << endl;
+		return (int)(vCfgErrors.size() - lWarnings);
+	}
+
+	// Starts recording status telemetry (temperatures, HV, counts) to a telemetry file.
+	bool StartTelemetry(const char* strFilenamePy)
+	{
+		string strFilename(strFilenamePy);
+
+		if (! chdpp.Telemetry.Start(strFilename)) {
+			ConsoleOut() << "Could not start telemetry: " << strFilename << endl;
+			return false;
+		}
+		return true;
+	}
+
+	// Writes all buffered telemetry and stops recording.
+	void StopTelemetry()
+	{
+		chdpp.Telemetry.Stop();
+		if (chdpp.Telemetry.DroppedSamples() > 0) {
+			ConsoleOut() << "Telemetry samples dropped: " << chdpp.Telemetry.DroppedSamples() << endl;
+		}
+	}
+
+	// Prints the USB transfer metrics (latency, bytes, timeouts, packet errors, NAKs by command).
+	void PrintTransportMetrics()
+	{
+		TRANSPORT_METRICS *Metrics;
+
+		Metrics = new TRANSPORT_METRICS;
+		chdpp.TransportMetrics.GetSnapshot(Metrics);
+		ConsoleOut() << chdpp.TransportMetrics.MetricsToString(Metrics);
+		delete Metrics;
+	}
+
+	// Writes the USB transfer metrics every iIntervalSec to a file (empty filename prints), 0 stops.
+	bool DumpTransportMetrics(const char* strFilenamePy, int iIntervalSec)
+	{
+		string strFilename(strFilenamePy);
+
+		chdpp.TransportMetrics.StopDump();
+		if (iIntervalSec <= 0) {
+			return true;
+		}
+		return chdpp.TransportMetrics.StartDump(strFilename, iIntervalSec * 1000L);
+	}
+
+	// Serves metrics in the Prometheus text format on 127.0.0.1:iPort, 0 stops.
+	bool StartMetricsExporter(int iPort)
+	{
+		chdpp.MetricsExporter.Stop();
+		if (iPort <= 0) {
+			return true;
+		}
+		if (! chdpp.MetricsExporter.Start(iPort)) {
+			ConsoleOut() << "Could not start metrics exporter on port " << iPort << endl;
+			return false;
+		}
+		return true;
+	}
+
+	// Serves metrics in the Prometheus text format on a Unix socket.
+	bool StartMetricsExporterUnix(const char* strSocketPathPy)
+	{
+		string strSocketPath(strSocketPathPy);
+
+		chdpp.MetricsExporter.Stop();
+		if (! chdpp.MetricsExporter.StartUnix(strSocketPath)) {
+			ConsoleOut() << "Could not start metrics exporter on " << strSocketPath << endl;
+			return false;
+		}
+		return true;
+	}
+
+	// Sets the count rate smoothing windows (seconds of real time).
+	void SetCountRateWindows(const double* dblWindows, int iNumWindows)
+	{
+		chdpp.CountRate.SetWindows(dblWindows, iNumWindows);
+	}
+
+	// Returns the input/output count rates (cps) and dead time fraction over a smoothing window.
+	bool GetCountRate(int idxWindow, double* dblICR, double* dblOCR, double* dblDeadTime)
+	{
+		COUNT_RATE Rate;
+
+		if (! chdpp.CountRate.GetRate(idxWindow, &Rate)) {
+			return false;
+		}
+		*dblICR = Rate.dblICR;
+		*dblOCR = Rate.dblOCR;
+		*dblDeadTime = Rate.dblDeadTime;
+		return true;
+	}
+
+	// Subscribes to status change events (mask bit per STATUS_EVENT_SOURCE, 0=all), returns the subscriber id.
+	int SubscribeStatusEvents(unsigned long long ullSourceMask)
+	{
+		return chdpp.StatusEvents.Subscribe(ullSourceMask);
+	}
+
+	// Removes a status event subscriber.
+	void UnsubscribeStatusEvents(int iId)
+	{
+		chdpp.StatusEvents.Unsubscribe(iId);
+	}
+
+	// Adds a threshold event on an analog status value (STATUS_EVENT_SOURCE).
+	bool AddStatusThreshold(int iSource, double dblLevel, double dblHysteresis)
+	{
+		return chdpp.StatusEvents.AddThreshold((STATUS_EVENT_SOURCE)iSource, dblLevel, dblHysteresis);
+	}
+
+	// Waits up to iTimeoutMs for the next status event, copies the event text to strEventOut.
+	bool GetStatusEvent(int iId, int iTimeoutMs, char* strEventOut, int iMaxLen)
+	{
+		STATUS_EVENT Event;
+		string strEvent;
+
+		if ((iMaxLen <= 0) || ! chdpp.StatusEvents.GetEvent(iId, &Event, iTimeoutMs)) {
+			return false;
+		}
+		strEvent = chdpp.StatusEvents.EventToString(&Event);
+		strncpy(strEventOut, strEvent.c_str(), iMaxLen - 1);
+		strEventOut[iMaxLen - 1] = 0;
+		return true;
+	}
+
+	// Host monotonic time (s) of the USB transfer that returned the last spectrum.
+	double GetSpectrumHostTime()
+	{
+		return chdpp.DP5Proto.SPECTRUM.RxTimeNs * 1.0e-9;
+	}
+
+	// Host monotonic time (s) of the USB transfer that returned the last status.
+	double GetStatusHostTime()
+	{
+		return chdpp.StatusRxTimeNs * 1.0e-9;
+	}
+
+	// Returns the device real time / host clock fit: drift (ppm) and rms residual (s).
+	bool GetClockSync(double* dblDriftPpm, double* dblRms)
+	{
+		CLOCK_SYNC_FIT Fit;
+
+		if (! chdpp.ClockSync.GetFit(&Fit)) {
+			return false;
+		}
+		*dblDriftPpm = Fit.dblDriftPpm;
+		*dblRms = Fit.dblRms;
+		return true;
+	}
+
+	// Converts a device real time (s) to host monotonic time (s) with the current clock fit.
+	double DeviceTimeToHostTime(double dblDeviceTime)
+	{
+		return chdpp.ClockSync.DeviceToHost(dblDeviceTime);
+	}
+
+	// Sets the log level (0=trace,1=debug,2=info,3=warn,4=error,5=off).
+	void SetLogLevel(int iLevel)
+	{
+		GetDppLog().SetLevel(iLevel);
+	}
+
+	// Writes the log to a file in logfmt (NULL or "" returns to the console).
+	bool SetLogFile(const char* cFilename)
+	{
+		string strFilename;
+
+		strFilename = (cFilename != NULL) ? cFilename : "";
+		GetDppLog().SetFormat((strFilename.length() > 0) ? lfLogfmt : lfPlain);
+		return GetDppLog().SetFile(strFilename);
+	}
+
+	// Enables or disables acquisition stage tracing (enabled by default).
+	void EnableTrace(bool bEnable)
+	{
+		DppTrace.Enable(bEnable);
+	}
+
+	// Discards the recorded trace spans.
+	void ClearTrace()
+	{
+		DppTrace.Clear();
+	}
+
+	// Writes the recorded trace spans as Chrome trace event JSON (chrome://tracing, Perfetto).
+	bool ExportTrace(const char* cFilename)
+	{
+		if (cFilename == NULL) {
+			return false;
+		}
+		return DppTrace.ExportChromeTrace(cFilename);
+	}
+
+	// Starts requesting diagnostic data in the background every iPeriodSec.
+	bool StartDiagMonitor(int iPeriodSec)
+	{
+		return chdpp.StartDiagMonitor(iPeriodSec * 1000L);
+	}
+
+	// Stops the diagnostics monitor.
+	void StopDiagMonitor()
+	{
+		chdpp.DiagMonitor.Stop();
+	}
+
+	// Copies the latest diagnostics and supply statistics, false if none received yet.
+	bool GetDiagnostics(char* strDiagOut, int iMaxLen)
+	{
+		DIAG_SAMPLE Sample;
+		string strDiag;
+
+		if ((iMaxLen <= 0) || ! chdpp.DiagMonitor.GetLatest(&Sample)) {
+			return false;
+		}
+		strDiag = chdpp.DiagMonitor.ToString();
+		strncpy(strDiagOut, strDiag.c_str(), iMaxLen - 1);
+		strDiagOut[iMaxLen - 1] = 0;
+		return true;
+	}
+
 	// Close Connection
 	void CloseConnection()
 	{
 		if (chdpp.LibUsb_isConnected) { // send and receive status
 			if (chdpp.LibUsb_Close_Connection()) {
-				cout << "DP5 device connection closed." << endl;
+				ConsoleOut() << "DP5 device connection closed." << endl;
 			}
 		}
 	}
@@ -408,20 +698,436 @@ extern "C" {
 	// Saving spectrum file
 	void SaveSpectrumFile(const char* strFilenamePy)
 	{
-		string strSpectrum;	
 		string strFilename(strFilenamePy);
 		
-												// holds final spectrum file
 		chdpp.sfInfo.strSpectrumStatus = chdpp.DppStatusString;		// save last status after acquisition
 		chdpp.sfInfo.m_iNumChan = chdpp.mcaCH;						// number channels in spectrum
 		chdpp.sfInfo.SerialNumber = chdpp.DP5Stat.m_DP5_Status.SerialNumber;	// dpp serial number
 		chdpp.sfInfo.strDescription = "Amptek Spectrum File";					// description
 		chdpp.sfInfo.strTag = "TestTag";										// tag
-		// create spectrum file, save file to string
-		strSpectrum = chdpp.CreateMCAData(chdpp.DP5Proto.SPECTRUM.DATA,chdpp.sfInfo,chdpp.DP5Stat.m_DP5_Status);
-		
-		cout << "StrFilename: " << strFilename << endl;
-		// chdpp.SaveSpectrumStringToFile(strSpectrum, strFilename);	// save spectrum file string to file
+		// format and write the spectrum file without building it as a string
+		ConsoleOut() << "StrFilename: " << strFilename << endl;
+		chdpp.SaveMCAFile(chdpp.DP5Proto.SPECTRUM.DATA,chdpp.sfInfo,chdpp.DP5Stat.m_DP5_Status,strFilename);
+	}
+
+	// Sets how spectrum files are written (iSyncPolicy 0=no sync, 1=fsync each file; bAsync writes from a background thread).
+	void SetSpectrumFilePolicy(int iSyncPolicy, bool bAsync)
+	{
+		chdpp.McaWriter.SetPolicy((iSyncPolicy == 1) ? msFsync : msNone, bAsync);
+	}
+
+	// Waits until queued spectrum files are written, false if any write failed.
+	bool FlushSpectrumFiles()
+	{
+		return chdpp.McaWriter.Flush();
+	}
+
+	// Opens a binary spectrum archive, received spectra are appended until it is closed.
+	// An existing archive is continued, a new one takes the serial number, configuration and channel count.
+	bool OpenSpectrumArchive(const char* strArchivePy)
+	{
+		string strArchive(strArchivePy);
+		FILE *ArchiveFile;
+
+		chdpp.SpectrumArchive.Close();
+		if ((ArchiveFile = fopen(strArchive.c_str(), "rb")) != NULL) {
+			fclose(ArchiveFile);
+			return chdpp.SpectrumArchive.OpenAppend(strArchive);
+		}
+		return chdpp.SpectrumArchive.Create(strArchive, chdpp.DP5Stat.m_DP5_Status.SerialNumber, chdpp.sfInfo.strSpectrumConfig, chdpp.mcaCH);
+	}
+
+	// Writes the archive index and closes the spectrum archive.
+	bool CloseSpectrumArchive()
+	{
+		return chdpp.SpectrumArchive.Close();
+	}
+
+	// Writes one archived spectrum as a .mca file.
+	bool ArchiveRecordToMca(const char* strArchivePy, long idxRecord, const char* strMcaPy)
+	{
+		CDppSpectrumArchive Archive;
+
+		if (! Archive.OpenRead(strArchivePy)) {
+			return false;
+		}
+		return Archive.RecordToMca(idxRecord, strMcaPy);
+	}
+
+	// Appends a .mca file to a spectrum archive.
+	bool ConvertMcaToArchive(const char* strMcaPy, const char* strArchivePy)
+	{
+		return CDppSpectrumArchive::McaToArchive(strMcaPy, strArchivePy);
+	}
+
+	// Converts all .mca files of a directory in parallel (iFormat 0=one archive, 1=one .csv per file in strOutputPy).
+	// iThreads 0 uses all cores. Returns the number of files converted, failures are logged.
+	int ConvertMcaDirectory(const char* strDirectoryPy, const char* strOutputPy, int iFormat, int iThreads)
+	{
+		CDppMcaConverter Converter;
+		MCA_CONVERT_RESULT Result;
+		size_t idxError;
+
+		Converter.ConvertDirectory(strDirectoryPy, (iFormat == 1) ? mcfCsv : mcfArchive, strOutputPy, iThreads, &Result);
+		for (idxError=0;idxError<Result.vErrors.size();idxError++) {
+			DPP_LOG_WARN("file", "%s", Result.vErrors[idxError].c_str());
+		}
+		return (int)Result.lConverted;
+	}
+
+	// Starts the time x channel spectrum store, strSpillFilePy "" keeps all spectra in memory.
+	// lRoiStart/lRoiEnd (inclusive channels, iRois up to 16) give the ROI counts kept per chunk.
+	bool StartSpectrumStore(const char* strSpillFilePy, const long* lRoiStart, const long* lRoiEnd, int iRois)
+	{
+		vector<STORE_ROI> vRois;
+		STORE_ROI Roi;
+		int idxRoi;
+
+		chdpp.SpectrumStore.Clear();
+		for (idxRoi=0;idxRoi<iRois;idxRoi++) {
+			Roi.lStart = lRoiStart[idxRoi];
+			Roi.lEnd = lRoiEnd[idxRoi];
+			vRois.push_back(Roi);
+		}
+		if (! chdpp.SpectrumStore.SetRois(vRois)) {
+			return false;
+		}
+		return chdpp.SpectrumStore.Start((strSpillFilePy != NULL) ? strSpillFilePy : "");
+	}
+
+	// Stops adding spectra to the store, the stored data stays available.
+	void StopSpectrumStore()
+	{
+		chdpp.SpectrumStore.Stop();
+	}
+
+	// Frames and channels of a store level (level 0 = spectra, each level sums 4 frames and 4 channels).
+	long GetSpectrumStoreFrames(int iLevel)
+	{
+		return chdpp.SpectrumStore.Frames(iLevel);
+	}
+
+	long GetSpectrumStoreChannels(int iLevel)
+	{
+		return chdpp.SpectrumStore.Channels(iLevel);
+	}
+
+	// Finest level that shows lFrames spectra in at most lMaxFrames rows.
+	int GetSpectrumStoreLevel(long lFrames, long lMaxFrames)
+	{
+		return chdpp.SpectrumStore.LevelFor(lFrames, lMaxFrames);
+	}
+
+	// Copies a frame x channel range of a level into Out (frame major), returns the number of values or -1.
+	long QuerySpectrumStore(int iLevel, long lFrameStart, long lFrames, long lChanStart, long lChans, unsigned long long* Out, long lMaxOut)
+	{
+		vector<unsigned long long> vRange;
+
+		if (! chdpp.SpectrumStore.QueryRange(iLevel, lFrameStart, lFrames, lChanStart, lChans, &vRange) || ((long)vRange.size() > lMaxOut)) {
+			return -1;
+		}
+		memcpy(Out, vRange.data(), vRange.size() * sizeof(unsigned long long));
+		return (long)vRange.size();
+	}
+
+	// ROI counts of lFrames spectra from lFrameStart, returns the number of ROIs or -1.
+	int GetSpectrumStoreRoiTotals(long lFrameStart, long lFrames, unsigned long long* Out, int iMaxRois)
+	{
+		vector<unsigned long long> vTotals;
+
+		if (! chdpp.SpectrumStore.RoiTotals(lFrameStart, lFrames, &vTotals) || ((int)vTotals.size() > iMaxRois)) {
+			return -1;
+		}
+		if (vTotals.size() > 0) {
+			memcpy(Out, vTotals.data(), vTotals.size() * sizeof(unsigned long long));
+		}
+		return (int)vTotals.size();
+	}
+
+	// Starts keeping the last iCapacity spectra, GetSpectrumHistoryWindowSum sums the last iWindow of them.
+	bool StartSpectrumHistory(int iCapacity, int iWindow)
+	{
+		return chdpp.SpectrumHistory.Start(iCapacity, iWindow);
+	}
+
+	// Stops adding spectra to the history, the history stays readable.
+	void StopSpectrumHistory()
+	{
+		chdpp.SpectrumHistory.Stop();
+	}
+
+	// Changes the number of spectra in the window sum.
+	bool SetSpectrumHistoryWindow(int iWindow)
+	{
+		return chdpp.SpectrumHistory.SetWindow(iWindow);
+	}
+
+	// Number of spectra in the history.
+	long GetSpectrumHistoryFrames()
+	{
+		return chdpp.SpectrumHistory.Frames();
+	}
+
+	// Copies a spectrum of the history (iAge 0 is the newest) into Out, returns the channels or -1.
+	long GetSpectrumHistoryFrame(int iAge, long* Out, long lMaxOut)
+	{
+		vector<long> vFrame;
+
+		if (! chdpp.SpectrumHistory.GetFrame(iAge, &vFrame) || ((long)vFrame.size() > lMaxOut)) {
+			return -1;
+		}
+		memcpy(Out, vFrame.data(), vFrame.size() * sizeof(long));
+		return (long)vFrame.size();
+	}
+
+	// Copies the sum of the last window spectra into Out, returns the channels or -1.
+	long GetSpectrumHistoryWindowSum(unsigned long long* Out, long lMaxOut)
+	{
+		vector<unsigned long long> vSum;
+
+		if (! chdpp.SpectrumHistory.GetWindowSum(&vSum) || ((long)vSum.size() > lMaxOut)) {
+			return -1;
+		}
+		memcpy(Out, vSum.data(), vSum.size() * sizeof(unsigned long long));
+		return (long)vSum.size();
+	}
+
+	// Copies the newest spectrum minus the previous one into Out, returns the channels or -1.
+	long GetSpectrumHistoryDelta(long long* Out, long lMaxOut)
+	{
+		vector<long long> vDelta;
+
+		if (! chdpp.SpectrumHistory.GetDelta(&vDelta) || ((long)vDelta.size() > lMaxOut)) {
+			return -1;
+		}
+		memcpy(Out, vDelta.data(), vDelta.size() * sizeof(long long));
+		return (long)vDelta.size();
+	}
+
+	// Copies the per channel rate (delta per second of host receive time) into Out, returns the channels or -1.
+	long GetSpectrumHistoryRate(double* Out, long lMaxOut)
+	{
+		vector<double> vRate;
+
+		if (! chdpp.SpectrumHistory.GetRate(&vRate) || ((long)vRate.size() > lMaxOut)) {
+			return -1;
+		}
+		memcpy(Out, vRate.data(), vRate.size() * sizeof(double));
+		return (long)vRate.size();
+	}
+
+	// Counts of iRois inclusive channel ranges [lLow, lHigh] of the last received spectrum in one call.
+	// iBackgroundWidth > 0 subtracts a linear background from the mean of that many channels on each side.
+	// GrossOut and NetOut (iRois values each) may be NULL. Returns iRois or -1.
+	int QueryRois(const long* lLow, const long* lHigh, int iRois, int iBackgroundWidth, unsigned long long* GrossOut, double* NetOut)
+	{
+		vector<ROI_RANGE> vRois(iRois > 0 ? iRois : 0);
+		vector<ROI_RESULT> vResults(vRois.size());
+		int idxRoi;
+
+		if ((iRois <= 0) || (lLow == NULL) || (lHigh == NULL)) {
+			return -1;
+		}
+		for (idxRoi=0;idxRoi<iRois;idxRoi++) {
+			vRois[idxRoi].lLow = lLow[idxRoi];
+			vRois[idxRoi].lHigh = lHigh[idxRoi];
+		}
+		if (! CDppRoiIndex::Query(chdpp.DP5Proto.SPECTRUM.PREFIX, chdpp.DP5Proto.SPECTRUM.CHANNELS, vRois.data(), iRois, iBackgroundWidth, vResults.data())) {
+			return -1;
+		}
+		for (idxRoi=0;idxRoi<iRois;idxRoi++) {
+			if (GrossOut != NULL) GrossOut[idxRoi] = vResults[idxRoi].ullGross;
+			if (NetOut != NULL) NetOut[idxRoi] = vResults[idxRoi].dblNet;
+		}
+		return iRois;
+	}
+
+	// Fills one plot point per pixel for iChans channels from iChanStart of the last received spectrum,
+	// returns the number of points (up to iPixels, one per channel when zoomed in) or -1.
+	// Any output may be NULL: first channel, min, max and sum of each point.
+	int QuerySpectrumPyramid(int iChanStart, int iChans, int iPixels, long* StartOut, long* MinOut, long* MaxOut, unsigned long long* SumOut)
+	{
+		vector<PYRAMID_POINT> vPoints;
+		size_t idxPoint;
+
+		if (! chdpp.SpectrumPyramid.Query(iChanStart, iChans, iPixels, &vPoints)) {
+			return -1;
+		}
+		for (idxPoint=0;idxPoint<vPoints.size();idxPoint++) {
+			if (StartOut != NULL) StartOut[idxPoint] = vPoints[idxPoint].lStart;
+			if (MinOut != NULL) MinOut[idxPoint] = vPoints[idxPoint].lMin;
+			if (MaxOut != NULL) MaxOut[idxPoint] = vPoints[idxPoint].lMax;
+			if (SumOut != NULL) SumOut[idxPoint] = vPoints[idxPoint].ullSum;
+		}
+		return (int)vPoints.size();
+	}
+
+	// Sets the common energy grid of the merged spectrum (bin j from dblStart + j * dblWidth), clears the merged sums.
+	bool SetMergeGrid(double dblStart, double dblWidth, long lBins)
+	{
+		return chdpp.SpectrumMerger.SetGrid(dblStart, dblWidth, lBins);
+	}
+
+	// Sets the calibration of a detector by serial number, E = offset + gain * channel + quadratic * channel^2.
+	bool SetMergeCalibration(unsigned long ulSerialNumber, double dblOffset, double dblGain, double dblQuadratic)
+	{
+		MERGE_CALIBRATION Calibration;
+
+		Calibration.dblOffset = dblOffset;
+		Calibration.dblGain = dblGain;
+		Calibration.dblQuadratic = dblQuadratic;
+		return chdpp.SpectrumMerger.SetCalibration(ulSerialNumber, Calibration);
+	}
+
+	// Starts adding received spectra of calibrated detectors to the merged spectrum,
+	// each detector's latest spectrum replaces its previous one.
+	void StartSpectrumMerge()
+	{
+		chdpp.SpectrumMerger.Start();
+	}
+
+	// Stops merging received spectra, the merged spectrum stays readable.
+	void StopSpectrumMerge()
+	{
+		chdpp.SpectrumMerger.Stop();
+	}
+
+	// Copies the merged spectrum (counts per grid bin) into Out, returns the number of bins or -1.
+	long GetMergedSpectrum(double* Out, long lMaxOut)
+	{
+		vector<unsigned long long> vFixed;
+		size_t idxBin;
+
+		if (! chdpp.SpectrumMerger.GetMergedFixed(&vFixed) || ((long)vFixed.size() > lMaxOut)) {
+			return -1;
+		}
+		for (idxBin=0;idxBin<vFixed.size();idxBin++) {
+			Out[idxBin] = (double)vFixed[idxBin] / MERGE_WEIGHT_ONE;
+		}
+		return (long)vFixed.size();
+	}
+
+	// Rebins and sums iDetectors spectra onto a common energy grid, iThreads 0 uses all cores.
+	// lData holds the spectra back to back (lChannels[i] each), dblCalibration offset, gain, quadratic per detector.
+	// Out receives lBins counts. Returns false on a bad calibration or grid.
+	bool MergeSpectra(const long* lData, const long* lChannels, const double* dblCalibration, int iDetectors,
+		double dblStart, double dblWidth, long lBins, int iThreads, double* Out)
+	{
+		vector<MERGE_INPUT> vInputs(iDetectors > 0 ? iDetectors : 0);
+		vector<unsigned long long> vFixed;
+		MERGE_GRID Grid;
+		long lOffset, idxBin;
+		int idxDetector;
+
+		lOffset = 0;
+		for (idxDetector=0;idxDetector<iDetectors;idxDetector++) {
+			vInputs[idxDetector].pData = &lData[lOffset];
+			vInputs[idxDetector].lChannels = lChannels[idxDetector];
+			vInputs[idxDetector].Calibration.dblOffset = dblCalibration[idxDetector * 3];
+			vInputs[idxDetector].Calibration.dblGain = dblCalibration[idxDetector * 3 + 1];
+			vInputs[idxDetector].Calibration.dblQuadratic = dblCalibration[idxDetector * 3 + 2];
+			lOffset += lChannels[idxDetector];
+		}
+		Grid.dblStart = dblStart;
+		Grid.dblWidth = dblWidth;
+		Grid.lBins = lBins;
+		if (! CDppSpectrumMerger::Merge(Grid, vInputs, iThreads, &vFixed)) {
+			return false;
+		}
+		for (idxBin=0;idxBin<lBins;idxBin++) {
+			Out[idxBin] = (double)vFixed[idxBin] / MERGE_WEIGHT_ONE;
+		}
+		return true;
+	}
+
+	// Starts journaling received spectra and status to strJournalPy (created new).
+	// Records are synced every iSyncIntervalMs (0 = default) or 64 records, whichever comes first.
+	bool StartJournal(const char* strJournalPy, int iSyncIntervalMs)
+	{
+		return chdpp.Journal.Open(strJournalPy, chdpp.DP5Stat.m_DP5_Status.SerialNumber, iSyncIntervalMs);
+	}
+
+	// Writes the queued records, syncs and closes the journal.
+	bool StopJournal()
+	{
+		return chdpp.Journal.Close();
+	}
+
+	// Restores the last journaled spectrum and status after a crash, returns the number of spectra or -1.
+	// strArchivePy (NULL or "" to skip) is created from all journaled spectra.
+	long RecoverJournal(const char* strJournalPy, const char* strArchivePy)
+	{
+		JOURNAL_RECOVERY Recovery;
+		CDppSpectrumArchive Archive;
+		JOURNAL_SPECTRUM Spectrum;
+		vector<long> vData;
+		size_t idxChan;
+		long lArchiveFailed;
+		bool bArchive;
+
+		bArchive = (strArchivePy != NULL) && (strArchivePy[0] != 0);
+		lArchiveFailed = 0;
+		if (! CDppJournal::ReadRecords(strJournalPy, &Recovery, [&](const JOURNAL_RECORD *Record, const unsigned char *pPayload) {
+			if (! bArchive || (Record->uiType != jrtSpectrum)) {
+				return;
+			}
+			memcpy(&Spectrum, pPayload, sizeof(Spectrum));
+			vData.resize(Spectrum.uiChannels);
+			for (idxChan=0;idxChan<vData.size();idxChan++) {
+				vData[idxChan] = (long)((const unsigned int *)(pPayload + sizeof(Spectrum)))[idxChan];
+			}
+			if (! Archive.IsWriting() && ! Archive.Create(strArchivePy, Recovery.uiSerialNumber, chdpp.sfInfo.strSpectrumConfig, (long)vData.size())) {
+				bArchive = false;
+				return;
+			}
+			if (! Archive.Append(vData.data(), (long)vData.size(), (Spectrum.uiFlags & JOURNAL_FLAG_STATUS) ? Spectrum.Status : NULL,
+				Spectrum.dblLiveTime, Spectrum.dblRealTime, Record->llRxTimeNs)) {
+				lArchiveFailed++;
+			}
+		})) {
+			return -1;
+		}
+		if (Archive.IsWriting() && ! Archive.Close()) {
+			lArchiveFailed++;
+		}
+		if (Recovery.bTornRecord) {
+			DPP_LOG_WARN("journal", "%s: damaged record after sequence %llu (byte %lld)", strJournalPy, Recovery.ullLastSequence, Recovery.llValidBytes);
+		}
+		if (lArchiveFailed > 0) {
+			DPP_LOG_WARN("journal", "%ld journaled spectra not archived", lArchiveFailed);
+		}
+		if ((Recovery.vLastSpectrum.size() > 0) && (Recovery.vLastSpectrum.size() <= MAX_BUFFER_DATA)) {
+			memcpy(chdpp.DP5Proto.SPECTRUM.DATA, Recovery.vLastSpectrum.data(), Recovery.vLastSpectrum.size() * sizeof(long));
+			chdpp.DP5Proto.SPECTRUM.CHANNELS = (short)Recovery.vLastSpectrum.size();
+			CDppRoiIndex::Build(chdpp.DP5Proto.SPECTRUM.DATA, chdpp.DP5Proto.SPECTRUM.CHANNELS, chdpp.DP5Proto.SPECTRUM.PREFIX);
+		}
+		if (Recovery.bHaveStatus) {
+			memcpy(chdpp.DP5Stat.m_DP5_Status.RAW, Recovery.LastStatus, sizeof(chdpp.DP5Stat.m_DP5_Status.RAW));
+			chdpp.DP5Stat.Process_Status(&chdpp.DP5Stat.m_DP5_Status);
+		}
+		return Recovery.lSpectra;
+	}
+
+	// Compresses a spectrum into Out (iMode 0=bit packed, 1=varint, 2=varint+rANS), returns the size or -1.
+	// lPrev is the previous spectrum (delta per channel over time) or NULL (delta to the previous channel).
+	int EncodeSpectrum(const long* lData, int iChannels, const long* lPrev, int iMode, unsigned char* Out, int iMaxLen)
+	{
+		CDppSpectrumCodec Codec;
+		vector<unsigned char> vEncoded;
+
+		if (! Codec.Encode(lData, iChannels, lPrev, (CODEC_MODE)iMode, &vEncoded) || (vEncoded.size() > (size_t)iMaxLen)) {
+			return -1;
+		}
+		memcpy(Out, vEncoded.data(), vEncoded.size());
+		return (int)vEncoded.size();
+	}
+
+	// Decompresses a spectrum (lPrev as used to compress), returns the number of channels or -1.
+	int DecodeSpectrum(const unsigned char* In, int iLen, const long* lPrev, long* lData, int iMaxChannels)
+	{
+		CDppSpectrumCodec Codec;
+
+		return (int)Codec.Decode(In, iLen, lPrev, lData, iMaxChannels);
 	}
 
 		
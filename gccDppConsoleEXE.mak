@@ -12,7 +12,7 @@ CFLAGS+=  -W -I./ -I/usr/include/libusb-1.0 -O0 -fexceptions -I../gccDppConsoleL
 LD=$(CXX) $(CXXFLAGS)
 LDFLAGS=
 LDFLAGS+= 
-LIBS+= -L/usr/local/lib -lusb-1.0
+LIBS+= -L/usr/local/lib -lusb-1.0 -pthread
 ifndef TARGET
 TARGET=gccDppConsole
 endif
@@ -21,7 +21,7 @@ CFLAGS+=  -W -I./ -I/usr/include/libusb-1.0 -O2 -fexceptions -I../gccDppConsoleL
 LD=$(CXX) $(CXXFLAGS)
 LDFLAGS=
 LDFLAGS+= 
-LIBS+= -L/usr/local/lib -lusb-1.0
+LIBS+= -L/usr/local/lib -lusb-1.0 -pthread
 ifndef TARGET
 TARGET=gccDppConsole
 endif
@@ -51,6 +51,28 @@ all: $(TARGET)
 SOURCE_FILES= \
 	./ConsoleHelper.cpp \
 	./DeviceIO/AsciiCmdUtilities.cpp \
+	./DeviceIO/DppCfgValidator.cpp \
+	./DeviceIO/DppStatusDecoder.cpp \
+	./DeviceIO/DppTelemetry.cpp \
+	./DeviceIO/DppTransportMetrics.cpp \
+	./DeviceIO/DppMetricsExporter.cpp \
+	./DeviceIO/DppCountRate.cpp \
+	./DeviceIO/DppStatusEvents.cpp \
+	./DeviceIO/DppClockSync.cpp \
+	./DeviceIO/DppLog.cpp \
+	./DeviceIO/DppDiagMonitor.cpp \
+	./DeviceIO/DppTrace.cpp \
+	./DeviceIO/DppMcaWriter.cpp \
+	./DeviceIO/DppMcaReader.cpp \
+	./DeviceIO/DppSpectrumArchive.cpp \
+	./DeviceIO/DppSpectrumCodec.cpp \
+	./DeviceIO/DppSpectrumStore.cpp \
+	./DeviceIO/DppJournal.cpp \
+	./DeviceIO/DppSpectrumHistory.cpp \
+	./DeviceIO/DppSpectrumPyramid.cpp \
+	./DeviceIO/DppRoiIndex.cpp \
+	./DeviceIO/DppSpectrumMerger.cpp \
+	./DeviceIO/DppMcaConverter.cpp \
 	./DeviceIO/DP5Protocol.cpp \
 	./DeviceIO/DP5Status.cpp \
 	./DeviceIO/DppUtilities.cpp \
@@ -63,6 +85,28 @@ SOURCE_FILES= \
 HEADER_FILES= \
 	./ConsoleHelper.h \
 	./DeviceIO/AsciiCmdUtilities.h \
+	./DeviceIO/DppCfgValidator.h \
+	./DeviceIO/DppStatusDecoder.h \
+	./DeviceIO/DppTelemetry.h \
+	./DeviceIO/DppTransportMetrics.h \
+	./DeviceIO/DppMetricsExporter.h \
+	./DeviceIO/DppCountRate.h \
+	./DeviceIO/DppStatusEvents.h \
+	./DeviceIO/DppClockSync.h \
+	./DeviceIO/DppLog.h \
+	./DeviceIO/DppDiagMonitor.h \
+	./DeviceIO/DppTrace.h \
+	./DeviceIO/DppMcaWriter.h \
+	./DeviceIO/DppMcaReader.h \
+	./DeviceIO/DppSpectrumArchive.h \
+	./DeviceIO/DppSpectrumCodec.h \
+	./DeviceIO/DppSpectrumStore.h \
+	./DeviceIO/DppJournal.h \
+	./DeviceIO/DppSpectrumHistory.h \
+	./DeviceIO/DppSpectrumPyramid.h \
+	./DeviceIO/DppRoiIndex.h \
+	./DeviceIO/DppSpectrumMerger.h \
+	./DeviceIO/DppMcaConverter.h \
 	./DeviceIO/DP5Protocol.h \
 	./DeviceIO/DP5Status.h \
 	./DeviceIO/DppConst.h \
@@ -77,6 +121,28 @@ HEADER_FILES= \
 OBJ_FILES= \
 	./ConsoleHelper.o \
 	./AsciiCmdUtilities.o \
+	./DppCfgValidator.o \
+	./DppStatusDecoder.o \
+	./DppTelemetry.o \
+	./DppTransportMetrics.o \
+	./DppMetricsExporter.o \
+	./DppCountRate.o \
+	./DppStatusEvents.o \
+	./DppClockSync.o \
+	./DppLog.o \
+	./DppDiagMonitor.o \
+	./DppTrace.o \
+	./DppMcaWriter.o \
+	./DppMcaReader.o \
+	./DppSpectrumArchive.o \
+	./DppSpectrumCodec.o \
+	./DppSpectrumStore.o \
+	./DppJournal.o \
+	./DppSpectrumHistory.o \
+	./DppSpectrumPyramid.o \
+	./DppRoiIndex.o \
+	./DppSpectrumMerger.o \
+	./DppMcaConverter.o \
 	./DP5Protocol.o \
 	./DP5Status.o \
 	./DppUtilities.o \
@@ -26,6 +26,12 @@ bool bHaveStatusResponse = false;		// have status response
 bool bHaveConfigFromHW = false;			// have configuration from hardware
 bool bTubeOn = false;
 
+// console text of the exports, queued to the log sink, which keeps its order with the log messages
+static CDppLogText ConsoleOut()
+{
+	return CDppLogText();
+}
+
 
 
 extern "C" {
@@ -35,7 +41,7 @@ extern "C" {
 		if (chdpp.LibUsb_Connect_Specific_DPP(NumDevice)) {
 			return true;
 		} else {
-			cout << "\t\tNo LibUsb DPP device present." << endl;
+			ConsoleOut() << "\t\tNo LibUsb DPP device present." << endl;
 			return false;
 		}
 	}
@@ -47,11 +53,11 @@ extern "C" {
 		if (chdpp.LibUsb_isConnected) { // send and receive status
 			if (chdpp.LibUsb_SendCommand(XMTPT_SEND_STATUS_MX2)) {	// request status
 				iDeviceType = chdpp.iDeviceType;
-				cout << "Device: " << iDeviceType << endl;
+				ConsoleOut() << "Device: " << iDeviceType << endl;
 				return iDeviceType;
 			} 
 		} 
-		cout << "Can't find Device Type" << endl;
+		ConsoleOut() << "Can't find Device Type" << endl;
 		return iDeviceType;
 	}
 
@@ -60,7 +66,7 @@ extern "C" {
 	{
 		if (chdpp.LibUsb_isConnected) { // send and receive status
 			if (chdpp.LibUsb_Close_Connection()) {
-				cout << "MX2 device connection closed." << endl;
+				ConsoleOut() << "MX2 device connection closed." << endl;
 			}
 		}
 	}
@@ -71,10 +77,10 @@ extern "C" {
 			if (chdpp.LibUsb_SendCommand(XMTPT_SEND_STATUS_MX2)) {	// request status
 				return true;
 			} else {
-				cout << "\t\tError sending status." << endl;
+				ConsoleOut() << "\t\tError sending status." << endl;
 			}
 		} else {
-			cout << "Device Not Connected" << endl;
+			ConsoleOut() << "Device Not Connected" << endl;
 		}
 		return false;
 	}
@@ -86,10 +92,10 @@ extern "C" {
 			if (chdpp.LibUsb_SendCommand(XMTPT_SEND_STATUS_MX2)) {	// request status
 				return chdpp.DppStatusString.c_str();
 			} else {
-				cout << "Error sending status." << endl;
+				ConsoleOut() << "Error sending status." << endl;
 			}
 		} else {
-			cout << "Device Not Connected." << endl;
+			ConsoleOut() << "Device Not Connected." << endl;
 		}
 
 		return "";
@@ -98,15 +104,15 @@ extern "C" {
 	void GetInterlockStatus()
 	{
 		if (chdpp.LibUsb_isConnected) { // send and receive status
-			cout << endl;
-			cout << "\tRequesting Interlock Status..." << endl;
+			ConsoleOut() << endl;
+			ConsoleOut() << "\tRequesting Interlock Status..." << endl;
 			if (chdpp.LibUsb_SendCommand(XMTPT_SEND_TUBE_ILOCK_TABLE_MX2)) {	// request status
-				cout << "\t\tInterlock Status sent." << endl;
+				ConsoleOut() << "\t\tInterlock Status sent." << endl;
 			} else {
-				cout << "\t\tError sending status." << endl;
+				ConsoleOut() << "\t\tError sending status." << endl;
 			}
 		} else {
-			cout << "Device Not Connected" << endl;
+			ConsoleOut() << "Device Not Connected" << endl;
 		}
 	}
 
@@ -114,14 +120,14 @@ extern "C" {
 	void FaultRecord()
 	{
 		if (chdpp.LibUsb_isConnected) {
-			cout << "\tRequesting Fault Record ..." << endl;
+			ConsoleOut() << "\tRequesting Fault Record ..." << endl;
 			if (chdpp.LibUsb_SendCommand(XMTPT_SEND_FAULT_RECORD_MX2)) {
-				cout << "Sent Fault Record Request..." << endl;
+				ConsoleOut() << "Sent Fault Record Request..." << endl;
 			} else {
-				cout << "Failed to send Fault Record Request" << endl;
+				ConsoleOut() << "Failed to send Fault Record Request" << endl;
 			}
 		} else {
-			cout << "Device Not Connected" << endl;
+			ConsoleOut() << "Device Not Connected" << endl;
 		}
 	}
 
@@ -129,20 +135,20 @@ extern "C" {
 	{
 		if (chdpp.LibUsb_isConnected) {
 			string strCmd;
-			cout << "\tRequesting HV and I Configuration..." << endl;
+			ConsoleOut() << "\tRequesting HV and I Configuration..." << endl;
 			strCmd = "HVSE=?;CUSE=?;";
 			chdpp.SendCommandDataMX2(XMTPT_READ_TEXT_CONFIGURATION_MX2, strCmd);
 			//Sleep(1000);
 			//cout << "\t\t\tkV: " << chdpp.strHV << endl;
 			//cout << "\t\t\tuA: " << chdpp.strI << endl;
 		} else {
-			cout << "Device Not Connected" << endl;
+			ConsoleOut() << "Device Not Connected" << endl;
 		}
 	}
 
 	void TurnHVOn()
 	{
-		cout << "\t\t\tTurning Tube ON Now" << endl;
+		DPP_LOG_INFO("mx2", "\t\t\tTurning Tube ON Now");
 		
 		string stringHV;
 		string stringI;
@@ -155,13 +161,13 @@ extern "C" {
 			chdpp.SendMX2_HVandI(stringHV, stringI);
 			bTubeOn = true;
 		} else {
-		cout << "Device not connected" << endl;
+		DPP_LOG_WARN("mx2", "Device not connected");
 		}
 	}
 
 	void TurnHVOff()
 	{
-		cout << "\t\t\tTurning Tube OFF Now" << endl;
+		DPP_LOG_INFO("mx2", "\t\t\tTurning Tube OFF Now");
 		
 		string stringHV;
 		string stringI;
@@ -173,7 +179,7 @@ extern "C" {
 			chdpp.SendMX2_HVandI(stringHV, stringI);
 			bTubeOn = false;
 		} else {
-		cout << "Device not connected" << endl;
+		DPP_LOG_WARN("mx2", "Device not connected");
 		}
 	}
 
@@ -262,7 +268,7 @@ extern "C" {
 
 	bool TurnVolumeOn()
 	{
-		cout << "\t\t\tTurning Volume ON Now" << endl;
+		DPP_LOG_INFO("mx2", "\t\t\tTurning Volume ON Now");
 		string strVol;
 
 		strVol= "ON";
@@ -273,7 +279,7 @@ extern "C" {
 			return 1;
 
 		} else {
-			cout << "Device not connected" << endl;
+			DPP_LOG_WARN("mx2", "Device not connected");
 		}
 		return 0;
 		
@@ -282,7 +288,7 @@ extern "C" {
 
 	bool TurnVolumeOff()
 	{
-		cout << "\t\t\tTurning Volume OFF Now" << endl;
+		DPP_LOG_INFO("mx2", "\t\t\tTurning Volume OFF Now");
 		string strVol;
 
 		strVol= "OFF";
@@ -293,12 +299,205 @@ extern "C" {
 			return 1;
 
 		} else {
-			cout << "Device not connected" << endl;
+			DPP_LOG_WARN("mx2", "Device not connected");
 		}
 		return 0;
 	}
 
 
+	// Starts recording status telemetry (temperatures, HV, counts) to a telemetry file.
+	bool StartTelemetry(const char* strFilenamePy)
+	{
+		string strFilename(strFilenamePy);
+
+		if (! chdpp.Telemetry.Start(strFilename)) {
+			ConsoleOut() << "Could not start telemetry: " << strFilename << endl;
+			return false;
+		}
+		return true;
+	}
+
+	// Writes all buffered telemetry and stops recording.
+	void StopTelemetry()
+	{
+		chdpp.Telemetry.Stop();
+		if (chdpp.Telemetry.DroppedSamples() > 0) {
+			ConsoleOut() << "Telemetry samples dropped: " << chdpp.Telemetry.DroppedSamples() << endl;
+		}
+	}
+
+	// Prints the USB transfer metrics (latency, bytes, timeouts, packet errors, NAKs by command).
+	void PrintTransportMetrics()
+	{
+		TRANSPORT_METRICS *Metrics;
+
+		Metrics = new TRANSPORT_METRICS;
+		chdpp.TransportMetrics.GetSnapshot(Metrics);
+		ConsoleOut() << chdpp.TransportMetrics.MetricsToString(Metrics);
+		delete Metrics;
+	}
+
+	// Writes the USB transfer metrics every iIntervalSec to a file (empty filename prints), 0 stops.
+	bool DumpTransportMetrics(const char* strFilenamePy, int iIntervalSec)
+	{
+		string strFilename(strFilenamePy);
+
+		chdpp.TransportMetrics.StopDump();
+		if (iIntervalSec <= 0) {
+			return true;
+		}
+		return chdpp.TransportMetrics.StartDump(strFilename, iIntervalSec * 1000L);
+	}
+
+	// Serves metrics in the Prometheus text format on 127.0.0.1:iPort, 0 stops.
+	bool StartMetricsExporter(int iPort)
+	{
+		chdpp.MetricsExporter.Stop();
+		if (iPort <= 0) {
+			return true;
+		}
+		if (! chdpp.MetricsExporter.Start(iPort)) {
+			ConsoleOut() << "Could not start metrics exporter on port " << iPort << endl;
+			return false;
+		}
+		return true;
+	}
+
+	// Serves metrics in the Prometheus text format on a Unix socket.
+	bool StartMetricsExporterUnix(const char* strSocketPathPy)
+	{
+		string strSocketPath(strSocketPathPy);
+
+		chdpp.MetricsExporter.Stop();
+		if (! chdpp.MetricsExporter.StartUnix(strSocketPath)) {
+			ConsoleOut() << "Could not start metrics exporter on " << strSocketPath << endl;
+			return false;
+		}
+		return true;
+	}
+
+	// Sets the count rate smoothing windows (seconds of real time).
+	void SetCountRateWindows(const double* dblWindows, int iNumWindows)
+	{
+		chdpp.CountRate.SetWindows(dblWindows, iNumWindows);
+	}
+
+	// Returns the input/output count rates (cps) and dead time fraction over a smoothing window.
+	bool GetCountRate(int idxWindow, double* dblICR, double* dblOCR, double* dblDeadTime)
+	{
+		COUNT_RATE Rate;
+
+		if (! chdpp.CountRate.GetRate(idxWindow, &Rate)) {
+			return false;
+		}
+		*dblICR = Rate.dblICR;
+		*dblOCR = Rate.dblOCR;
+		*dblDeadTime = Rate.dblDeadTime;
+		return true;
+	}
+
+	// Subscribes to status change events (mask bit per STATUS_EVENT_SOURCE, 0=all), returns the subscriber id.
+	int SubscribeStatusEvents(unsigned long long ullSourceMask)
+	{
+		return chdpp.StatusEvents.Subscribe(ullSourceMask);
+	}
+
+	// Removes a status event subscriber.
+	void UnsubscribeStatusEvents(int iId)
+	{
+		chdpp.StatusEvents.Unsubscribe(iId);
+	}
+
+	// Adds a threshold event on an analog status value (STATUS_EVENT_SOURCE).
+	bool AddStatusThreshold(int iSource, double dblLevel, double dblHysteresis)
+	{
+		return chdpp.StatusEvents.AddThreshold((STATUS_EVENT_SOURCE)iSource, dblLevel, dblHysteresis);
+	}
+
+	// Waits up to iTimeoutMs for the next status event, copies the event text to strEventOut.
+	bool GetStatusEvent(int iId, int iTimeoutMs, char* strEventOut, int iMaxLen)
+	{
+		STATUS_EVENT Event;
+		string strEvent;
+
+		if ((iMaxLen <= 0) || ! chdpp.StatusEvents.GetEvent(iId, &Event, iTimeoutMs)) {
+			return false;
+		}
+		strEvent = chdpp.StatusEvents.EventToString(&Event);
+		strncpy(strEventOut, strEvent.c_str(), iMaxLen - 1);
+		strEventOut[iMaxLen - 1] = 0;
+		return true;
+	}
+
+	// Host monotonic time (s) of the USB transfer that returned the last spectrum.
+	double GetSpectrumHostTime()
+	{
+		return chdpp.DP5Proto.SPECTRUM.RxTimeNs * 1.0e-9;
+	}
+
+	// Host monotonic time (s) of the USB transfer that returned the last status.
+	double GetStatusHostTime()
+	{
+		return chdpp.StatusRxTimeNs * 1.0e-9;
+	}
+
+	// Returns the device real time / host clock fit: drift (ppm) and rms residual (s).
+	bool GetClockSync(double* dblDriftPpm, double* dblRms)
+	{
+		CLOCK_SYNC_FIT Fit;
+
+		if (! chdpp.ClockSync.GetFit(&Fit)) {
+			return false;
+		}
+		*dblDriftPpm = Fit.dblDriftPpm;
+		*dblRms = Fit.dblRms;
+		return true;
+	}
+
+	// Converts a device real time (s) to host monotonic time (s) with the current clock fit.
+	double DeviceTimeToHostTime(double dblDeviceTime)
+	{
+		return chdpp.ClockSync.DeviceToHost(dblDeviceTime);
+	}
+
+	// Sets the log level (0=trace,1=debug,2=info,3=warn,4=error,5=off).
+	void SetLogLevel(int iLevel)
+	{
+		GetDppLog().SetLevel(iLevel);
+	}
+
+	// Writes the log to a file in logfmt (NULL or "" returns to the console).
+	bool SetLogFile(const char* cFilename)
+	{
+		string strFilename;
+
+		strFilename = (cFilename != NULL) ? cFilename : "";
+		GetDppLog().SetFormat((strFilename.length() > 0) ? lfLogfmt : lfPlain);
+		return GetDppLog().SetFile(strFilename);
+	}
+
+	// Enables or disables acquisition stage tracing (enabled by default).
+	void EnableTrace(bool bEnable)
+	{
+		DppTrace.Enable(bEnable);
+	}
+
+	// Discards the recorded trace spans.
+	void ClearTrace()
+	{
+		DppTrace.Clear();
+	}
+
+	// Writes the recorded trace spans as Chrome trace event JSON (chrome://tracing, Perfetto).
+	bool ExportTrace(const char* cFilename)
+	{
+		if (cFilename == NULL) {
+			return false;
+		}
+		return DppTrace.ExportChromeTrace(cFilename);
+	}
+
+
 	// void Warmup()
 	// {
 	// 	cout << "Running Daily Warmup" << endl;
@@ -0,0 +1,56 @@
+/** gccDppMcaConvert.cpp */
+
+// gccDppMcaConvert.cpp : Converts directories of .mca spectrum files to a spectrum archive or .csv files.
+#include <iostream>
+#include <stdlib.h>
+#include <string.h>
+using namespace std;
+#include "DppMcaConverter.h"
+
+static void ShowUsage()
+{
+	cout << "Usage: gccDppMcaConvert [-j threads] [-csv] <mca directory> <archive file | csv directory>" << endl;
+	cout << "  -j threads  worker threads (default: all cores)" << endl;
+	cout << "  -csv        write one channel,counts .csv per file instead of one archive" << endl;
+}
+
+int main(int argc, char* argv[])
+{
+	CDppMcaConverter Converter;
+	MCA_CONVERT_RESULT Result;
+	MCA_CONVERT_FORMAT Format;
+	vector<string> vArgs;
+	size_t idxError;
+	int iThreads;
+	int idxArg;
+	bool bConverted;
+
+	Format = mcfArchive;
+	iThreads = 0;
+	for (idxArg=1;idxArg<argc;idxArg++) {
+		if ((strcmp(argv[idxArg], "-j") == 0) && (idxArg + 1 < argc)) {
+			iThreads = atoi(argv[++idxArg]);
+		} else if (strcmp(argv[idxArg], "-csv") == 0) {
+			Format = mcfCsv;
+		} else if (argv[idxArg][0] == '-') {
+			ShowUsage();
+			return 2;
+		} else {
+			vArgs.push_back(argv[idxArg]);
+		}
+	}
+	if (vArgs.size() != 2) {
+		ShowUsage();
+		return 2;
+	}
+	bConverted = Converter.ConvertDirectory(vArgs[0], Format, vArgs[1], iThreads, &Result);
+	for (idxError=0;idxError<Result.vErrors.size();idxError++) {
+		cerr << Result.vErrors[idxError] << endl;
+	}
+	cout << Result.lConverted << " of " << Result.lFiles << " files converted in " << Result.dblSeconds << " s";
+	if (Result.lFailed > 0) {
+		cout << ", " << Result.lFailed << " failed";
+	}
+	cout << endl;
+	return (bConverted ? 0 : 1);
+}
@@ -0,0 +1,664 @@
+/** gccDppSelfCheck.cpp */
+
+// gccDppSelfCheck.cpp : Checks the spectrum processing modules against brute-force references (no device needed).
+#include <iostream>
+#include <string.h>
+#include <stdio.h>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <math.h>
+using namespace std;
+#include "DppSpectrumStore.h"
+#include "DppSpectrumHistory.h"
+#include "DppSpectrumPyramid.h"
+#include "DppRoiIndex.h"
+#include "DppSpectrumMerger.h"
+
+#define SELFCHECK_SPILL_FILE "gccDppSelfCheck.spill"
+
+// prints the first failures of a check, returns false once anything failed
+static bool CheckValue(const char *Check, const char *What, long long llIndex, long long llGot, long long llWant, long *lFailures)
+{
+	if (llGot == llWant) {
+		return true;
+	}
+	if (*lFailures < 10) {
+		cout << "  " << Check << ": " << What << " [" << llIndex << "] is " << llGot << ", expected " << llWant << endl;
+	}
+	(*lFailures)++;
+	return false;
+}
+
+// same as CheckValue for computed rates, within a relative tolerance
+static bool CheckNear(const char *Check, const char *What, long long llIndex, double dblGot, double dblWant, long *lFailures)
+{
+	if (fabs(dblGot - dblWant) <= 1e-9 * max(1.0, fabs(dblWant))) {
+		return true;
+	}
+	if (*lFailures < 10) {
+		cout << "  " << Check << ": " << What << " [" << llIndex << "] is " << dblGot << ", expected " << dblWant << endl;
+	}
+	(*lFailures)++;
+	return false;
+}
+
+// one random run appended to the store and kept in full as the reference
+static long CheckStoreRun(const char *SpillFile, long lChannels, long lFrames, mt19937 *Random)
+{
+	CDppSpectrumStore Store;
+	vector<STORE_ROI> vRois;
+	vector<long> vSpectrum(lChannels);
+	vector<unsigned long long> vCells((size_t)lFrames * lChannels);
+	vector<unsigned long long> vOut;
+	vector<unsigned long long> vWant;
+	STORE_ROI Roi;
+	unsigned long long ullSum;
+	long lFailures;
+	long lFactor;
+	long lLevelFrames;
+	long lLevelChannels;
+	long lFrameStart;
+	long lCount;
+	long lChanStart;
+	long lChans;
+	long idxFrame;
+	long idxChan;
+	long idxCell;
+	long idxTry;
+	size_t idxRoi;
+	int idxLevel;
+
+	lFailures = 0;
+	// ROIs across chunk columns, at the edges, and one starting beyond the last channel
+	Roi.lStart = 0; Roi.lEnd = 0; vRois.push_back(Roi);
+	Roi.lStart = STORE_CHUNK_CHANNELS - 3; Roi.lEnd = STORE_CHUNK_CHANNELS + 5; vRois.push_back(Roi);
+	Roi.lStart = lChannels / 3; Roi.lEnd = lChannels - 1; vRois.push_back(Roi);
+	Roi.lStart = lChannels - 10; Roi.lEnd = lChannels + 100; vRois.push_back(Roi);
+	Roi.lStart = lChannels + 5; Roi.lEnd = lChannels + 50; vRois.push_back(Roi);
+	if (! Store.Start(SpillFile) || ! Store.SetRois(vRois)) {
+		cout << "  store: Start/SetRois failed" << endl;
+		return 1;
+	}
+	for (idxFrame=0;idxFrame<lFrames;idxFrame++) {
+		for (idxChan=0;idxChan<lChannels;idxChan++) {
+			vSpectrum[idxChan] = (long)((*Random)() % 1000);
+			vCells[(size_t)idxFrame * lChannels + idxChan] = vSpectrum[idxChan];
+		}
+		if (! Store.Append(&vSpectrum[0], lChannels, idxFrame * 0.5)) {
+			cout << "  store: Append failed at frame " << idxFrame << endl;
+			return 1;
+		}
+	}
+	// every level against sums of the level 0 cells it covers
+	lFactor = 1;
+	for (idxLevel=0;idxLevel<STORE_MAX_LEVELS;idxLevel++) {
+		lLevelFrames = lFrames / lFactor;
+		lLevelChannels = (lChannels + lFactor - 1) / lFactor;
+		CheckValue("store", "level frames", idxLevel, Store.Frames(idxLevel), lLevelFrames, &lFailures);
+		CheckValue("store", "level channels", idxLevel, Store.Channels(idxLevel), lLevelChannels, &lFailures);
+		for (idxTry=0;(idxTry<20)&&(lLevelFrames>0);idxTry++) {
+			lFrameStart = (long)((*Random)() % lLevelFrames);
+			lCount = 1 + (long)((*Random)() % (lLevelFrames - lFrameStart));
+			lChanStart = (long)((*Random)() % lLevelChannels);
+			lChans = 1 + (long)((*Random)() % (lLevelChannels - lChanStart));
+			if (! Store.QueryRange(idxLevel, lFrameStart, lCount, lChanStart, lChans, &vOut)) {
+				CheckValue("store", "QueryRange accepted", idxLevel, 0, 1, &lFailures);
+				continue;
+			}
+			for (idxFrame=0;idxFrame<lCount;idxFrame++) {
+				for (idxChan=0;idxChan<lChans;idxChan++) {
+					ullSum = 0;
+					for (idxCell=0;idxCell<lFactor*lFactor;idxCell++) {
+						if ((lChanStart + idxChan) * lFactor + idxCell % lFactor < lChannels) {
+							ullSum += vCells[(size_t)((lFrameStart + idxFrame) * lFactor + idxCell / lFactor) * lChannels + (lChanStart + idxChan) * lFactor + idxCell % lFactor];
+						}
+					}
+					CheckValue("store", "QueryRange cell", idxFrame * lChans + idxChan, vOut[(size_t)idxFrame * lChans + idxChan], ullSum, &lFailures);
+				}
+			}
+		}
+		lFactor *= STORE_LEVEL_FACTOR;
+	}
+	// frame sums and ROI totals over random level 0 ranges
+	for (idxTry=0;idxTry<50;idxTry++) {
+		lFrameStart = (long)((*Random)() % lFrames);
+		lCount = 1 + (long)((*Random)() % (lFrames - lFrameStart));
+		if (idxTry == 0) {
+			lFrameStart = 0;
+			lCount = lFrames;
+		}
+		vWant.assign(lChannels, 0);
+		for (idxFrame=lFrameStart;idxFrame<lFrameStart+lCount;idxFrame++) {
+			for (idxChan=0;idxChan<lChannels;idxChan++) {
+				vWant[idxChan] += vCells[(size_t)idxFrame * lChannels + idxChan];
+			}
+		}
+		if (! Store.SumFrames(lFrameStart, lCount, &vOut) || (vOut.size() != vWant.size())) {
+			CheckValue("store", "SumFrames accepted", lFrameStart, 0, 1, &lFailures);
+		} else {
+			for (idxChan=0;idxChan<lChannels;idxChan++) {
+				CheckValue("store", "SumFrames channel", idxChan, vOut[idxChan], vWant[idxChan], &lFailures);
+			}
+		}
+		if (! Store.RoiTotals(lFrameStart, lCount, &vOut) || (vOut.size() != vRois.size())) {
+			CheckValue("store", "RoiTotals accepted", lFrameStart, 0, 1, &lFailures);
+			continue;
+		}
+		for (idxRoi=0;idxRoi<vRois.size();idxRoi++) {
+			ullSum = 0;
+			for (idxChan=vRois[idxRoi].lStart;(idxChan<=vRois[idxRoi].lEnd)&&(idxChan<lChannels);idxChan++) {
+				ullSum += vWant[idxChan];
+			}
+			CheckValue("store", "RoiTotals ROI", (long long)idxRoi, vOut[idxRoi], ullSum, &lFailures);
+		}
+	}
+	Store.Clear();
+	return lFailures;
+}
+
+// CDppSpectrumStore levels, frame sums and ROI totals, in memory and spilled
+static bool CheckSpectrumStore()
+{
+	mt19937 Random(45);
+	long lFailures;
+
+	lFailures = CheckStoreRun("", 600, 700, &Random);
+	lFailures += CheckStoreRun(SELFCHECK_SPILL_FILE, 1000, 300, &Random);
+	lFailures += CheckStoreRun("", 256, 64, &Random);
+	remove(SELFCHECK_SPILL_FILE);
+	cout << "store: " << ((lFailures == 0) ? "OK" : "FAILED") << endl;
+	return (lFailures == 0);
+}
+
+// compares the history with every frame appended since the last channel count change
+static long CompareHistory(CDppSpectrumHistory *History, const vector<vector<long> > &vFrames, const vector<double> &vTimes, long lCapacity, long lWindow)
+{
+	vector<long> vFrame;
+	vector<unsigned long long> vSum;
+	vector<long long> vDelta;
+	vector<double> vRate;
+	unsigned long long ullWant;
+	double dblTime;
+	double dblPerSecond;
+	long lFailures;
+	long lHeld;
+	long lChannels;
+	long idxAge;
+	long idxChan;
+	size_t idxNewest;
+
+	lFailures = 0;
+	idxNewest = vFrames.size() - 1;
+	lChannels = (long)vFrames[idxNewest].size();
+	lHeld = min((long)vFrames.size(), lCapacity);
+	CheckValue("history", "frames", (long long)idxNewest, History->Frames(), lHeld, &lFailures);
+	CheckValue("history", "channels", (long long)idxNewest, History->Channels(), lChannels, &lFailures);
+	CheckValue("history", "window frames", (long long)idxNewest, History->WindowFrames(), min(lWindow, lHeld), &lFailures);
+	for (idxAge=0;idxAge<lHeld;idxAge++) {
+		if (! History->GetFrame(idxAge, &vFrame, &dblTime) || (vFrame != vFrames[idxNewest - idxAge]) || (dblTime != vTimes[idxNewest - idxAge])) {
+			CheckValue("history", "frame at age", idxAge, 0, 1, &lFailures);
+		}
+	}
+	CheckValue("history", "frame past the oldest refused", lHeld, History->GetFrame(lHeld, &vFrame), 0, &lFailures);
+	if (! History->GetWindowSum(&vSum) || ((long)vSum.size() != lChannels)) {
+		CheckValue("history", "window sum accepted", (long long)idxNewest, 0, 1, &lFailures);
+	} else {
+		for (idxChan=0;idxChan<lChannels;idxChan++) {
+			ullWant = 0;
+			for (idxAge=0;idxAge<min(lWindow, lHeld);idxAge++) {
+				ullWant += vFrames[idxNewest - idxAge][idxChan];
+			}
+			CheckValue("history", "window sum channel", idxChan, vSum[idxChan], ullWant, &lFailures);
+		}
+	}
+	if (vFrames.size() < 2) {
+		CheckValue("history", "delta refused for one frame", 0, History->GetDelta(&vDelta), 0, &lFailures);
+		return lFailures;
+	}
+	if (! History->GetDelta(&vDelta) || ! History->GetRate(&vRate) || ((long)vDelta.size() != lChannels) || ((long)vRate.size() != lChannels)) {
+		CheckValue("history", "delta and rate accepted", (long long)idxNewest, 0, 1, &lFailures);
+		return lFailures;
+	}
+	dblPerSecond = vTimes[idxNewest] - vTimes[idxNewest - 1];
+	dblPerSecond = (dblPerSecond > 0) ? (1.0 / dblPerSecond) : 0;
+	for (idxChan=0;idxChan<lChannels;idxChan++) {
+		CheckValue("history", "delta channel", idxChan, vDelta[idxChan], (long long)vFrames[idxNewest][idxChan] - vFrames[idxNewest - 1][idxChan], &lFailures);
+		CheckNear("history", "rate channel", idxChan, vRate[idxChan], ((long long)vFrames[idxNewest][idxChan] - vFrames[idxNewest - 1][idxChan]) * dblPerSecond, &lFailures);
+	}
+	return lFailures;
+}
+
+// CDppSpectrumHistory frames, window sum, delta and rate over ring wraparound, window and channel count changes
+static bool CheckSpectrumHistory()
+{
+	CDppSpectrumHistory History;
+	mt19937 Random(47);
+	vector<vector<long> > vFrames;
+	vector<double> vTimes;
+	vector<long> vSpectrum;
+	double dblTime;
+	long lCapacity;
+	long lWindow;
+	long lChannels;
+	long lFailures;
+	long idxFrame;
+	long idxChan;
+
+	lFailures = 0;
+	lCapacity = 16;
+	lWindow = 5;
+	lChannels = 100;
+	dblTime = 0;
+	if (! History.Start(lCapacity, lWindow)) {
+		cout << "  history: Start failed" << endl;
+		return false;
+	}
+	for (idxFrame=0;idxFrame<90;idxFrame++) {
+		if (idxFrame == 25) {
+			lWindow = 12;
+		} else if (idxFrame == 40) {
+			lWindow = lCapacity;
+		} else if (idxFrame == 55) {
+			// a channel count change restarts the history
+			lChannels = 73;
+			vFrames.clear();
+			vTimes.clear();
+			lWindow = 3;
+		} else if (idxFrame == 58) {
+			lWindow = 10;
+		}
+		if ((idxFrame == 25) || (idxFrame == 40) || (idxFrame == 55) || (idxFrame == 58)) {
+			if (! History.SetWindow(lWindow)) {
+				CheckValue("history", "SetWindow accepted", lWindow, 0, 1, &lFailures);
+			}
+			if (! vFrames.empty()) {
+				lFailures += CompareHistory(&History, vFrames, vTimes, lCapacity, lWindow);
+			}
+		}
+		vSpectrum.resize(lChannels);
+		for (idxChan=0;idxChan<lChannels;idxChan++) {
+			vSpectrum[idxChan] = (long)(Random() % 100000);
+		}
+		// now and then two frames with the same time, the rate is then 0
+		dblTime += ((Random() % 8) == 0) ? 0 : 0.1 + (Random() % 100) / 100.0;
+		if (! History.Append(&vSpectrum[0], lChannels, dblTime)) {
+			CheckValue("history", "Append accepted", idxFrame, 0, 1, &lFailures);
+			continue;
+		}
+		vFrames.push_back(vSpectrum);
+		vTimes.push_back(dblTime);
+		lFailures += CompareHistory(&History, vFrames, vTimes, lCapacity, lWindow);
+	}
+	CheckValue("history", "window above capacity refused", lCapacity + 1, History.SetWindow(lCapacity + 1), 0, &lFailures);
+	History.Stop();
+	vSpectrum.assign(lChannels, 1);
+	CheckValue("history", "Append refused after Stop", 0, History.Append(&vSpectrum[0], lChannels, dblTime + 1), 0, &lFailures);
+	lFailures += CompareHistory(&History, vFrames, vTimes, lCapacity, lWindow);
+	cout << "history: " << ((lFailures == 0) ? "OK" : "FAILED") << endl;
+	return (lFailures == 0);
+}
+
+// compares pyramid points for random windows and pixel widths with scans of the spectrum
+static long ComparePyramid(CDppSpectrumPyramid *Pyramid, const vector<long> &vSpectrum, mt19937 *Random)
+{
+	vector<PYRAMID_POINT> vPoints;
+	unsigned long long ullSum;
+	long lChannels;
+	long lChanStart;
+	long lChans;
+	long lPixels;
+	long lStart;
+	long lEnd;
+	long lMin;
+	long lMax;
+	long lFailures;
+	long idxTry;
+	long idxPixel;
+	long idxChan;
+
+	lFailures = 0;
+	lChannels = (long)vSpectrum.size();
+	for (idxTry=0;idxTry<40;idxTry++) {
+		lChanStart = (long)((*Random)() % lChannels);
+		lChans = 1 + (long)((*Random)() % (lChannels - lChanStart));
+		lPixels = 1 + (long)((*Random)() % 1200);
+		if (idxTry == 0) {
+			// the whole spectrum, as the console plot asks for it
+			lChanStart = 0;
+			lChans = lChannels;
+			lPixels = 80;
+		}
+		if (! Pyramid->Query(lChanStart, lChans, lPixels, &vPoints) || ((long)vPoints.size() != min(lPixels, lChans))) {
+			CheckValue("pyramid", "Query accepted", lChanStart, 0, 1, &lFailures);
+			continue;
+		}
+		lPixels = min(lPixels, lChans);
+		for (idxPixel=0;idxPixel<lPixels;idxPixel++) {
+			lStart = lChanStart + (long)(((long long)idxPixel * lChans) / lPixels);
+			lEnd = lChanStart + (long)(((long long)(idxPixel + 1) * lChans) / lPixels);
+			lMin = vSpectrum[lStart];
+			lMax = vSpectrum[lStart];
+			ullSum = 0;
+			for (idxChan=lStart;idxChan<lEnd;idxChan++) {
+				lMin = min(lMin, vSpectrum[idxChan]);
+				lMax = max(lMax, vSpectrum[idxChan]);
+				ullSum += vSpectrum[idxChan];
+			}
+			CheckValue("pyramid", "point start", idxPixel, vPoints[idxPixel].lStart, lStart, &lFailures);
+			CheckValue("pyramid", "point end", idxPixel, vPoints[idxPixel].lEnd, lEnd - 1, &lFailures);
+			CheckValue("pyramid", "point min", idxPixel, vPoints[idxPixel].lMin, lMin, &lFailures);
+			CheckValue("pyramid", "point max", idxPixel, vPoints[idxPixel].lMax, lMax, &lFailures);
+			CheckValue("pyramid", "point sum", idxPixel, vPoints[idxPixel].ullSum, ullSum, &lFailures);
+		}
+	}
+	CheckValue("pyramid", "window past the end refused", lChannels, Pyramid->Query(lChannels - 1, 2, 10, &vPoints), 0, &lFailures);
+	return lFailures;
+}
+
+// CDppSpectrumPyramid points after full and partial updates, for several channel counts
+static bool CheckSpectrumPyramid()
+{
+	CDppSpectrumPyramid Pyramid;
+	mt19937 Random(48);
+	vector<long> vSpectrum;
+	long lChannelCounts[] = { 1, 7, 1000, 1024, 8192, 1000 };
+	long lChannels;
+	long lChanged;
+	long lFailures;
+	long idxChan;
+	int idxCount;
+	int idxUpdate;
+
+	lFailures = 0;
+	for (idxCount=0;idxCount<(int)(sizeof(lChannelCounts) / sizeof(long));idxCount++) {
+		lChannels = lChannelCounts[idxCount];
+		vSpectrum.resize(lChannels);
+		for (idxChan=0;idxChan<lChannels;idxChan++) {
+			vSpectrum[idxChan] = (long)(Random() % 5000);
+		}
+		CheckValue("pyramid", "changed on a new channel count", lChannels, Pyramid.Update(&vSpectrum[0], lChannels), lChannels, &lFailures);
+		CheckValue("pyramid", "channels", lChannels, Pyramid.Channels(), lChannels, &lFailures);
+		lFailures += ComparePyramid(&Pyramid, vSpectrum, &Random);
+		// counts going up (and sometimes down) in a few channels, as between spectrum reads
+		for (idxUpdate=0;idxUpdate<10;idxUpdate++) {
+			lChanged = 0;
+			for (idxChan=0;idxChan<lChannels;idxChan++) {
+				if ((Random() % 20) == 0) {
+					vSpectrum[idxChan] += 1 + (long)(Random() % 300);
+					lChanged++;
+				} else if ((Random() % 200) == 0) {
+					vSpectrum[idxChan] = (long)(Random() % 50) - 60;
+					lChanged++;
+				}
+			}
+			CheckValue("pyramid", "changed channels", idxUpdate, Pyramid.Update(&vSpectrum[0], lChannels), lChanged, &lFailures);
+			lFailures += ComparePyramid(&Pyramid, vSpectrum, &Random);
+		}
+	}
+	cout << "pyramid: " << ((lFailures == 0) ? "OK" : "FAILED") << endl;
+	return (lFailures == 0);
+}
+
+// CDppRoiIndex sums and region counts over random, clipped and edge ranges, checked by channel scans
+static bool CheckRoiIndex()
+{
+	mt19937 Random(49);
+	vector<long> vSpectrum;
+	vector<unsigned long long> vPrefix;
+	vector<ROI_RANGE> vRois;
+	vector<ROI_RESULT> vResults;
+	ROI_RANGE Roi;
+	unsigned long long ullGross;
+	unsigned long long ullLeft;
+	unsigned long long ullRight;
+	double dblLeft;
+	double dblRight;
+	double dblBackground;
+	long lChannelCounts[] = { 1, 2, 50, 1024, 16384 };
+	long lChannels;
+	long lWidth;
+	long lLow;
+	long lHigh;
+	long lInside;
+	long lLeft;
+	long lRight;
+	long lFailures;
+	long idxChan;
+	int idxCount;
+	int idxRoi;
+
+	lFailures = 0;
+	for (idxCount=0;idxCount<(int)(sizeof(lChannelCounts) / sizeof(long));idxCount++) {
+		lChannels = lChannelCounts[idxCount];
+		vSpectrum.resize(lChannels);
+		for (idxChan=0;idxChan<lChannels;idxChan++) {
+			vSpectrum[idxChan] = (long)(Random() % 2000000);
+		}
+		vPrefix.resize(lChannels + 1);
+		CDppRoiIndex::Build(&vSpectrum[0], lChannels, &vPrefix[0]);
+		// random ranges, ranges clipped at either end or entirely outside, and ranges at the spectrum ends
+		vRois.clear();
+		for (idxRoi=0;idxRoi<200;idxRoi++) {
+			Roi.lLow = (long)(Random() % (lChannels + 40)) - 20;
+			Roi.lHigh = Roi.lLow + (long)(Random() % (lChannels + 20)) - 5;
+			vRois.push_back(Roi);
+		}
+		Roi.lLow = 0; Roi.lHigh = 0; vRois.push_back(Roi);
+		Roi.lLow = lChannels - 1; Roi.lHigh = lChannels - 1; vRois.push_back(Roi);
+		Roi.lLow = 0; Roi.lHigh = lChannels - 1; vRois.push_back(Roi);
+		Roi.lLow = -100; Roi.lHigh = lChannels + 100; vRois.push_back(Roi);
+		Roi.lLow = lChannels; Roi.lHigh = lChannels + 10; vRois.push_back(Roi);
+		Roi.lLow = 5; Roi.lHigh = 4; vRois.push_back(Roi);
+		vResults.resize(vRois.size());
+		for (lWidth=0;lWidth<=12;lWidth+=3) {
+			if (! CDppRoiIndex::Query(&vPrefix[0], lChannels, &vRois[0], (int)vRois.size(), lWidth, &vResults[0])) {
+				CheckValue("roi", "Query accepted", lChannels, 0, 1, &lFailures);
+				continue;
+			}
+			for (idxRoi=0;idxRoi<(int)vRois.size();idxRoi++) {
+				lLow = max(vRois[idxRoi].lLow, 0L);
+				lHigh = min(vRois[idxRoi].lHigh, lChannels - 1);
+				lInside = 0;
+				ullGross = 0;
+				lLeft = 0;
+				lRight = 0;
+				ullLeft = 0;
+				ullRight = 0;
+				for (idxChan=0;idxChan<lChannels;idxChan++) {
+					if ((idxChan >= lLow) && (idxChan <= lHigh)) {
+						lInside++;
+						ullGross += vSpectrum[idxChan];
+					} else if ((idxChan < lLow) && (idxChan >= lLow - lWidth)) {
+						lLeft++;
+						ullLeft += vSpectrum[idxChan];
+					} else if ((idxChan > lHigh) && (idxChan <= lHigh + lWidth)) {
+						lRight++;
+						ullRight += vSpectrum[idxChan];
+					}
+				}
+				CheckValue("roi", "Sum", idxRoi, CDppRoiIndex::Sum(&vPrefix[0], lChannels, vRois[idxRoi].lLow, vRois[idxRoi].lHigh), ullGross, &lFailures);
+				CheckValue("roi", "channels", idxRoi, vResults[idxRoi].lChannels, lInside, &lFailures);
+				CheckValue("roi", "gross", idxRoi, vResults[idxRoi].ullGross, ullGross, &lFailures);
+				// mean of each side, the other side stands in when one is off the spectrum
+				dblBackground = 0;
+				if ((lInside > 0) && ((lLeft > 0) || (lRight > 0))) {
+					dblLeft = (lLeft > 0) ? ((double)ullLeft / lLeft) : ((double)ullRight / lRight);
+					dblRight = (lRight > 0) ? ((double)ullRight / lRight) : dblLeft;
+					dblBackground = (dblLeft + dblRight) * 0.5 * lInside;
+				}
+				CheckNear("roi", "background", idxRoi, vResults[idxRoi].dblBackground, dblBackground, &lFailures);
+				CheckNear("roi", "net", idxRoi, vResults[idxRoi].dblNet, (double)ullGross - dblBackground, &lFailures);
+			}
+		}
+	}
+	CheckValue("roi", "empty spectrum refused", 0, CDppRoiIndex::Query(&vPrefix[0], 0, &vRois[0], 1, 0, &vResults[0]), 0, &lFailures);
+	cout << "roi: " << ((lFailures == 0) ? "OK" : "FAILED") << endl;
+	return (lFailures == 0);
+}
+
+// double precision rebin of one spectrum, counts split by the energy overlap of each channel with each bin
+static void ReferenceRebin(const MERGE_GRID &Grid, const MERGE_INPUT &Input, vector<double> *vSum)
+{
+	const MERGE_CALIBRATION *Cal;
+	double dblLow;
+	double dblHigh;
+	long idxChan;
+	long idxBin;
+
+	Cal = &Input.Calibration;
+	for (idxChan=0;idxChan<Input.lChannels;idxChan++) {
+		dblLow = Cal->dblOffset + Cal->dblGain * (idxChan - 0.5) + Cal->dblQuadratic * (idxChan - 0.5) * (idxChan - 0.5);
+		dblHigh = Cal->dblOffset + Cal->dblGain * (idxChan + 0.5) + Cal->dblQuadratic * (idxChan + 0.5) * (idxChan + 0.5);
+		dblLow = (dblLow - Grid.dblStart) / Grid.dblWidth;
+		dblHigh = (dblHigh - Grid.dblStart) / Grid.dblWidth;
+		for (idxBin=max((long)floor(dblLow), 0L);(idxBin<Grid.lBins)&&(idxBin<dblHigh);idxBin++) {
+			(*vSum)[idxBin] += Input.pData[idxChan] * (min(dblHigh, idxBin + 1.0) - max(dblLow, (double)idxBin)) / (dblHigh - dblLow);
+		}
+	}
+}
+
+// CDppSpectrumMerger against an identity rebin and a double precision reference, batch and running merges, 1 and 8 threads
+static bool CheckSpectrumMerger()
+{
+	CDppSpectrumMerger Merger;
+	mt19937 Random(50);
+	MERGE_CALIBRATION Calibrations[4] = { { 0, 1.0, 0 }, { 3.2, 1.13, 0 }, { -2.5, 0.87, 2e-6 }, { 5, 1.5, -1e-5 } };
+	MERGE_CALIBRATION Identity = { 0, 1.0, 0 };
+	MERGE_GRID Grid;
+	MERGE_INPUT Input;
+	vector<MERGE_INPUT> vInputs;
+	vector<vector<long> > vSpectra(4);
+	vector<unsigned long long> vMerged;
+	vector<unsigned long long> vThreaded;
+	vector<unsigned long long> vRunning;
+	vector<double> vReference;
+	unsigned long long ullTotal;
+	unsigned long long ullMergedTotal;
+	double dblError;
+	double dblMaxError;
+	long lChannels;
+	long lFailures;
+	long idxChan;
+	long idxBin;
+	int idxDetector;
+
+	lFailures = 0;
+	lChannels = 4096;
+	for (idxDetector=0;idxDetector<4;idxDetector++) {
+		vSpectra[idxDetector].resize(lChannels);
+		for (idxChan=0;idxChan<lChannels;idxChan++) {
+			vSpectra[idxDetector][idxChan] = (long)(Random() % 20000);
+		}
+	}
+	// channel c is grid bin c, the merge is the input in fixed point
+	Grid.dblStart = -0.5;
+	Grid.dblWidth = 1.0;
+	Grid.lBins = lChannels;
+	Input.pData = &vSpectra[0][0];
+	Input.lChannels = lChannels;
+	Input.Calibration = Identity;
+	vInputs.assign(1, Input);
+	if (! CDppSpectrumMerger::Merge(Grid, vInputs, 1, &vMerged) || ((long)vMerged.size() != lChannels)) {
+		CheckValue("merger", "identity Merge accepted", 0, 0, 1, &lFailures);
+	} else {
+		for (idxChan=0;idxChan<lChannels;idxChan++) {
+			CheckValue("merger", "identity channel", idxChan, vMerged[idxChan], (long long)vSpectra[0][idxChan] * MERGE_WEIGHT_ONE, &lFailures);
+		}
+	}
+	// four gains over a grid that holds every channel, split in 8 thread blocks
+	Grid.dblStart = -10;
+	Grid.dblWidth = 0.4;
+	Grid.lBins = 16384;
+	vInputs.clear();
+	vReference.assign(Grid.lBins, 0);
+	ullTotal = 0;
+	for (idxDetector=0;idxDetector<4;idxDetector++) {
+		Input.pData = &vSpectra[idxDetector][0];
+		Input.Calibration = Calibrations[idxDetector];
+		vInputs.push_back(Input);
+		ReferenceRebin(Grid, Input, &vReference);
+		for (idxChan=0;idxChan<lChannels;idxChan++) {
+			ullTotal += vSpectra[idxDetector][idxChan];
+		}
+	}
+	if (! CDppSpectrumMerger::Merge(Grid, vInputs, 1, &vMerged) || ! CDppSpectrumMerger::Merge(Grid, vInputs, 8, &vThreaded) || ((long)vMerged.size() != Grid.lBins)) {
+		CheckValue("merger", "Merge accepted", 0, 0, 1, &lFailures);
+		cout << "merger: FAILED" << endl;
+		return false;
+	}
+	CheckValue("merger", "1 and 8 threads identical", 0, (vMerged == vThreaded), 1, &lFailures);
+	dblMaxError = 0;
+	ullMergedTotal = 0;
+	for (idxBin=0;idxBin<Grid.lBins;idxBin++) {
+		dblError = fabs((double)vMerged[idxBin] / MERGE_WEIGHT_ONE - vReference[idxBin]);
+		dblMaxError = max(dblMaxError, dblError);
+		ullMergedTotal += vMerged[idxBin];
+	}
+	if (dblMaxError >= 0.08) {
+		cout << "  merger: max error " << dblMaxError << " counts per bin, expected below 0.08" << endl;
+		lFailures++;
+	}
+	CheckValue("merger", "total counts", 0, ullMergedTotal, ullTotal * MERGE_WEIGHT_ONE, &lFailures);
+	// the running merge gives the same sums, also after a spectrum is replaced and a calibration changes
+	Merger.SetGrid(Grid.dblStart, Grid.dblWidth, Grid.lBins);
+	for (idxDetector=0;idxDetector<4;idxDetector++) {
+		Merger.SetCalibration(idxDetector, Calibrations[idxDetector]);
+		Merger.Update(idxDetector, &vSpectra[(idxDetector + 1) % 4][0], lChannels);
+	}
+	for (idxDetector=0;idxDetector<4;idxDetector++) {
+		if (! Merger.Update(idxDetector, &vSpectra[idxDetector][0], lChannels)) {
+			CheckValue("merger", "Update accepted", idxDetector, 0, 1, &lFailures);
+		}
+	}
+	Merger.GetMergedFixed(&vRunning);
+	CheckValue("merger", "running merge matches Merge", 0, (vRunning == vMerged), 1, &lFailures);
+	Merger.SetCalibration(3, Identity);
+	vInputs[3].Calibration = Identity;
+	Merger.Update(3, &vSpectra[3][0], lChannels);
+	CDppSpectrumMerger::Merge(Grid, vInputs, 8, &vMerged);
+	Merger.GetMergedFixed(&vRunning);
+	CheckValue("merger", "running merge after a calibration change", 0, (vRunning == vMerged), 1, &lFailures);
+	cout << "merger: " << ((lFailures == 0) ? "OK" : "FAILED") << " (max error " << dblMaxError << " counts per bin)" << endl;
+	return (lFailures == 0);
+}
+
+static void ShowUsage()
+{
+	cout << "Usage: gccDppSelfCheck [store|history|pyramid|roi|merger]" << endl;
+	cout << "  store   chunked spectrum store (levels, frame sums, ROI totals, spill file)" << endl;
+	cout << "  history spectrum history ring (frames, window sum, delta, rate)" << endl;
+	cout << "  pyramid min/max/sum plot pyramid (points after full and partial updates)" << endl;
+	cout << "  roi     prefix sum ROI index (gross, background, net)" << endl;
+	cout << "  merger  gain matched spectrum merge (reference rebin, totals, threads)" << endl;
+	cout << "  (no argument runs every check)" << endl;
+}
+
+int main(int argc, char* argv[])
+{
+	bool bAll;
+	bool bPassed;
+
+	if ((argc > 2) || ((argc == 2) && (strcmp(argv[1], "store") != 0) && (strcmp(argv[1], "history") != 0) && (strcmp(argv[1], "pyramid") != 0) && (strcmp(argv[1], "roi") != 0) && (strcmp(argv[1], "merger") != 0))) {
+		ShowUsage();
+		return 2;
+	}
+	bAll = (argc == 1);
+	bPassed = true;
+	if (bAll || (strcmp(argv[1], "store") == 0)) {
+		bPassed = CheckSpectrumStore() && bPassed;
+	}
+	if (bAll || (strcmp(argv[1], "history") == 0)) {
+		bPassed = CheckSpectrumHistory() && bPassed;
+	}
+	if (bAll || (strcmp(argv[1], "pyramid") == 0)) {
+		bPassed = CheckSpectrumPyramid() && bPassed;
+	}
+	if (bAll || (strcmp(argv[1], "roi") == 0)) {
+		bPassed = CheckRoiIndex() && bPassed;
+	}
+	if (bAll || (strcmp(argv[1], "merger") == 0)) {
+		bPassed = CheckSpectrumMerger() && bPassed;
+	}
+	return (bPassed ? 0 : 1);
+}
@@ -0,0 +1,95 @@
+# Makefile - gccDppSelfCheck (reference checks, no device needed)
+
+ifndef CFG
+CFG=Debug
+endif
+CC=gcc
+CFLAGS=-m32 
+CXX=g++
+CXXFLAGS=$(CFLAGS)
+ifeq "$(CFG)" "Debug"
+CFLAGS+=  -W -I./ -O0 -fexceptions -I../gccDppConsoleLinux/DeviceIO/ -I../gccDppConsoleLinux/ -g -fno-inline -D_DEBUG -D_CONSOLE 
+LD=$(CXX) $(CXXFLAGS)
+LDFLAGS=
+LDFLAGS+= 
+LIBS+= -pthread
+ifndef TARGET
+TARGET=gccDppSelfCheck
+endif
+endif
+ifeq "$(CFG)" "Release"
+CFLAGS+=  -W -I./ -O2 -fexceptions -I../gccDppConsoleLinux/DeviceIO/ -I../gccDppConsoleLinux/ -g  -fno-inline   -DNDEBUG -D_CONSOLE 
+LD=$(CXX) $(CXXFLAGS)
+LDFLAGS=
+LDFLAGS+= 
+LIBS+= -pthread
+ifndef TARGET
+TARGET=gccDppSelfCheck
+endif
+endif
+ifndef TARGET
+TARGET=gccDppSelfCheck
+endif
+.PHONY: all
+all: $(TARGET)
+
+%.o: %.c
+	$(CC) $(CFLAGS) $(CPPFLAGS) -o $@ -c $<
+
+%.o: %.cc
+	$(CXX) $(CXXFLAGS) $(CPPFLAGS) -c $<
+
+%.o: %.cpp
+	$(CXX) $(CXXFLAGS) $(CPPFLAGS) -c $<
+
+%.o: %.cxx
+	$(CXX) $(CXXFLAGS) $(CPPFLAGS) -c $<
+
+%.res: %.rc
+	$(RC) $(CPPFLAGS) -o $@ -i $<
+
+SOURCE_FILES= \
+	./DeviceIO/DppLog.cpp \
+	./DeviceIO/DppRoiIndex.cpp \
+	./DeviceIO/DppSpectrumHistory.cpp \
+	./DeviceIO/DppSpectrumMerger.cpp \
+	./DeviceIO/DppSpectrumPyramid.cpp \
+	./DeviceIO/DppSpectrumStore.cpp \
+	./gccDppSelfCheck.cpp
+
+HEADER_FILES= \
+	./DeviceIO/DppLog.h \
+	./DeviceIO/DppRoiIndex.h \
+	./DeviceIO/DppSpectrumHistory.h \
+	./DeviceIO/DppSpectrumMerger.h \
+	./DeviceIO/DppSpectrumPyramid.h \
+	./DeviceIO/DppSpectrumStore.h
+
+OBJ_FILES= \
+	./DppLog.o \
+	./DppRoiIndex.o \
+	./DppSpectrumHistory.o \
+	./DppSpectrumMerger.o \
+	./DppSpectrumPyramid.o \
+	./DppSpectrumStore.o \
+	./gccDppSelfCheck.o 
+
+RESOURCE_FILES= \
+
+SRCS=$(SOURCE_FILES) $(HEADER_FILES) $(RESOURCE_FILES) 
+
+OBJS=$(patsubst %.rc,%.res,$(patsubst %.cxx,%.o,$(patsubst %.cpp,%.o,$(patsubst %.cc,%.o,$(patsubst %.c,%.o,$(filter %.c %.cc %.cpp %.cxx %.rc,$(SRCS)))))))
+
+$(TARGET): $(OBJS)
+	$(LD) $(LDFLAGS) -o $@ $(OBJ_FILES) $(LIBS)
+
+.PHONY: clean
+clean:
+	-rm -f -v $(OBJS) $(TARGET) gccDppSelfCheck.dep
+
+.PHONY: depends
+depends:
+	-$(CXX) $(CXXFLAGS) $(CPPFLAGS) -MM $(filter %.c %.cc %.cpp %.cxx,$(SRCS)) > gccDppSelfCheck.dep
+
+-include gccDppSelfCheck.dep
+
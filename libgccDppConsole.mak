@@ -20,7 +20,7 @@ endif
 # Linker flags
 LDFLAGS = #-shared # Flag for creating shared object (.so)
 
-LDLIBS = -lusb-1.0
+LDLIBS = -lusb-1.0 -pthread
 # LDLIBS = -L/usr/include/libusb-1.0 -lusb-1.0
 LIBS = -L/usr/lib/x86_64-linux-gnu -lusb-1.0
 
@@ -31,6 +31,28 @@ TARGET_SO = libgccDppConsoleMiniX2.so
 SOURCE_FILES = \
 	./ConsoleHelper.cpp \
 	./DeviceIO/AsciiCmdUtilities.cpp \
+	./DeviceIO/DppCfgValidator.cpp \
+	./DeviceIO/DppStatusDecoder.cpp \
+	./DeviceIO/DppTelemetry.cpp \
+	./DeviceIO/DppTransportMetrics.cpp \
+	./DeviceIO/DppMetricsExporter.cpp \
+	./DeviceIO/DppCountRate.cpp \
+	./DeviceIO/DppStatusEvents.cpp \
+	./DeviceIO/DppClockSync.cpp \
+	./DeviceIO/DppLog.cpp \
+	./DeviceIO/DppDiagMonitor.cpp \
+	./DeviceIO/DppTrace.cpp \
+	./DeviceIO/DppMcaWriter.cpp \
+	./DeviceIO/DppMcaReader.cpp \
+	./DeviceIO/DppSpectrumArchive.cpp \
+	./DeviceIO/DppSpectrumCodec.cpp \
+	./DeviceIO/DppSpectrumStore.cpp \
+	./DeviceIO/DppJournal.cpp \
+	./DeviceIO/DppSpectrumHistory.cpp \
+	./DeviceIO/DppSpectrumPyramid.cpp \
+	./DeviceIO/DppRoiIndex.cpp \
+	./DeviceIO/DppSpectrumMerger.cpp \
+	./DeviceIO/DppMcaConverter.cpp \
 	./DeviceIO/DP5Protocol.cpp \
 	./DeviceIO/DP5Status.cpp \
 	./DeviceIO/DppUtilities.cpp \
@@ -44,6 +66,28 @@ SOURCE_FILES = \
 HEADER_FILES = \
 	./ConsoleHelper.h \
 	./DeviceIO/AsciiCmdUtilities.h \
+	./DeviceIO/DppCfgValidator.h \
+	./DeviceIO/DppStatusDecoder.h \
+	./DeviceIO/DppTelemetry.h \
+	./DeviceIO/DppTransportMetrics.h \
+	./DeviceIO/DppMetricsExporter.h \
+	./DeviceIO/DppCountRate.h \
+	./DeviceIO/DppStatusEvents.h \
+	./DeviceIO/DppClockSync.h \
+	./DeviceIO/DppLog.h \
+	./DeviceIO/DppDiagMonitor.h \
+	./DeviceIO/DppTrace.h \
+	./DeviceIO/DppMcaWriter.h \
+	./DeviceIO/DppMcaReader.h \
+	./DeviceIO/DppSpectrumArchive.h \
+	./DeviceIO/DppSpectrumCodec.h \
+	./DeviceIO/DppSpectrumStore.h \
+	./DeviceIO/DppJournal.h \
+	./DeviceIO/DppSpectrumHistory.h \
+	./DeviceIO/DppSpectrumPyramid.h \
+	./DeviceIO/DppRoiIndex.h \
+	./DeviceIO/DppSpectrumMerger.h \
+	./DeviceIO/DppMcaConverter.h \
 	./DeviceIO/DP5Protocol.h \
 	./DeviceIO/DP5Status.h \
 	./DeviceIO/DppConst.h \